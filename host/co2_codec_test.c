@@ -0,0 +1,734 @@
+/*!
+ *******************************************************************************
+ * @file co2_codec_test.c
+ *
+ * @brief Host round trip, fuzz and compression test of the CO2 codec
+ *
+ * - Encodes a week of synthetic office readings, sampled at a fixed period
+ *   with jitter, at an adaptive period, and from two sensors, decodes them
+ *   back and reports the bytes per sample and the throughput
+ * - Round trips the edge cases: extreme values, times going backwards, every
+ *   channel
+ * - Checks a sample that doesn't fit leaves the stream as it was
+ * - Round trips random streams, of random channel counts and buffer sizes,
+ *   with small and large changes of time and value
+ * - Decodes random bytes, which must stay within the buffer
+ *
+ * Build it with `HOST_SANITIZE` to have out of bounds accesses caught.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "co2_codec.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Largest amount of samples of a synthetic trace
+#define TRACE_MAX_SAMPLES                   (100000)
+
+//! @brief Days of readings of a synthetic trace
+#define TRACE_DAYS                          (7)
+
+//! @brief Times each trace is encoded and decoded to measure throughput
+#define TRACE_REPETITIONS                   (10)
+
+//! @brief Random streams round tripped
+#define FUZZ_STREAMS                        (20000)
+
+//! @brief Largest amount of samples of a random stream
+#define FUZZ_MAX_SAMPLES                    (64)
+
+//! @brief Random buffers decoded
+#define GARBAGE_BUFFERS                     (20000)
+
+//! @brief Largest size of a random buffer (in bytes)
+#define GARBAGE_MAX_SIZE                    (64)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Sample, as fed to the encoder
+typedef struct {
+        //! @brief Time (in seconds)
+        uint32_t time_s;
+
+        //! @brief Channel index
+        uint8_t channel;
+
+        //! @brief Concentration (in ppm)
+        uint16_t ppm;
+} sample_t;
+
+//! @brief How a synthetic trace is sampled
+typedef enum {
+        //! @brief 30 s period, one sample in ten is a second late
+        TRACE_KIND_FIXED = 0,
+
+        //! @brief Period from 5 to 160 s, shorter while the air changes
+        TRACE_KIND_ADAPTIVE,
+} trace_kind_t;
+
+//! @brief Synthetic trace
+typedef struct {
+        //! @brief Name, for the report
+        char const * p_name;
+
+        //! @brief How it is sampled
+        trace_kind_t kind;
+
+        //! @brief Amount of sensors
+        uint8_t channel_count;
+
+        //! @brief Largest bytes per sample expected
+        double max_bytes_per_sample;
+} trace_t;
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+//! @brief Synthetic traces encoded
+static trace_t const m_traces[] = {
+                {
+                                .p_name = "30 s, jitter, 1 sensor",
+                                .kind = TRACE_KIND_FIXED,
+                                .channel_count = 1,
+                                .max_bytes_per_sample = 1.25,
+                },
+                {
+                                .p_name = "adaptive 5-160 s, 1 sensor",
+                                .kind = TRACE_KIND_ADAPTIVE,
+                                .channel_count = 1,
+                                .max_bytes_per_sample = 1.25,
+                },
+                {
+                                .p_name = "30 s, jitter, 2 sensors",
+                                .kind = TRACE_KIND_FIXED,
+                                .channel_count = 2,
+                                .max_bytes_per_sample = 1.5,
+                },
+};
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Get a pseudo random number
+static uint32_t random_below(uint32_t const limit);
+
+//! @brief Generate a synthetic trace of office readings
+static size_t generate_trace(trace_t const * const p_trace);
+
+//! @brief Encode and decode a synthetic trace
+static bool run_trace(trace_t const * const p_trace);
+
+//! @brief Encode a list of samples
+static bool encode(co2_codec_t * const p_codec,
+                   uint8_t * const p_buffer,
+                   size_t const size,
+                   uint8_t const channel_count,
+                   sample_t const * const p_samples,
+                   size_t const count,
+                   size_t * const p_encoded);
+
+//! @brief Decode a stream and compare it with a list of samples
+static bool decode_matches(uint8_t const * const p_buffer,
+                           size_t const size,
+                           uint8_t const channel_count,
+                           sample_t const * const p_samples,
+                           size_t const count);
+
+//! @brief Round trip the edge cases
+static bool check_edge_cases(void);
+
+//! @brief Check a sample that doesn't fit leaves the stream as it was
+static bool check_full_buffer(void);
+
+//! @brief Round trip random streams
+static bool check_random_streams(void);
+
+//! @brief Decode random bytes
+static bool check_garbage(void);
+
+//! @brief Get a monotonic time
+static double now_s(void);
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief State of the pseudo random generator
+static uint32_t m_random = 12345;
+
+//! @brief Samples of the trace being run
+static sample_t m_samples[TRACE_MAX_SAMPLES];
+
+//! @brief Stream of the trace being run
+static uint8_t m_buffer[TRACE_MAX_SAMPLES * CO2_CODEC_SAMPLE_MAX_SIZE];
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+int main(void)
+{
+        bool success = true;
+        size_t i;
+
+        printf("%-28s %8s %10s %10s %12s %12s\n",
+               "trace", "samples", "B/sample", "max", "enc (M/s)",
+               "dec (M/s)");
+
+        for (i = 0; (sizeof(m_traces) / sizeof(m_traces[0])) > i; ++i) {
+                success = run_trace(&m_traces[i]) && success;
+        }
+
+        success = check_edge_cases() && success;
+        success = check_full_buffer() && success;
+        success = check_random_streams() && success;
+        success = check_garbage() && success;
+
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Get a pseudo random number
+ *
+ * Linear congruential generator, so runs are reproducible on every host.
+ *
+ * @param[in]           limit               Numbers are below this one
+ *
+ * @return              uint32_t            Pseudo random number
+ */
+static uint32_t random_below(uint32_t const limit)
+{
+        m_random = m_random * 1103515245U + 12345U;
+
+        return (m_random >> 8) % limit;
+}
+
+/*!
+ * @brief Generate a synthetic trace of office readings
+ *
+ * The concentration of each sensor drifts towards the one the occupancy of
+ * the hour leads to, with a 30 minutes time constant, plus +-5 ppm noise.
+ *
+ * @param[in]           p_trace             Pointer to the trace description
+ *
+ * @return              size_t              Amount of samples generated
+ */
+static size_t generate_trace(trace_t const * const p_trace)
+{
+        double ppm[CO2_CODEC_MAX_CHANNELS] = {450, 480, 500, 520};
+
+        double target;
+        double change;
+        uint32_t time_s = 1000;
+        uint32_t second = 0;
+        uint32_t period_s = 30;
+        uint32_t step_s;
+        uint32_t hour;
+        uint32_t occupancy;
+        size_t count = 0;
+        uint8_t channel;
+
+        while ((TRACE_DAYS * 86400U > second) &&
+               (TRACE_MAX_SAMPLES >= count + p_trace->channel_count)) {
+
+                hour = (second / 3600) % 24;
+                occupancy = (((9 <= hour) && (12 > hour)) ||
+                             ((13 <= hour) && (18 > hour))) ?
+                            2 + (hour % 3) : 0;
+
+                for (channel = 0; p_trace->channel_count > channel; ++channel) {
+                        target = 420.0 + occupancy * 250.0 + channel * 30.0;
+                        ppm[channel] += (target - ppm[channel]) *
+                                        (period_s / 1800.0);
+
+                        m_samples[count].time_s = time_s;
+                        m_samples[count].channel = channel;
+                        m_samples[count].ppm = (uint16_t)(ppm[channel] +
+                                                          random_below(11) - 5);
+                        ++count;
+                }
+
+                if (TRACE_KIND_ADAPTIVE == p_trace->kind) {
+                        change = ppm[0] - (420.0 + occupancy * 250.0);
+                        change = (0 > change) ? -change : change;
+                        period_s = (200 < change) ? 5 :
+                                   (100 < change) ? 20 :
+                                   (40 < change) ? 40 :
+                                   (15 < change) ? 80 : 160;
+                        step_s = period_s;
+                } else {
+                        step_s = period_s + ((0 == random_below(10)) ? 1 : 0);
+                }
+
+                time_s += step_s;
+                second += step_s;
+        }
+
+        return count;
+}
+
+/*!
+ * @brief Encode and decode a synthetic trace
+ *
+ * @param[in]           p_trace             Pointer to the trace description
+ *
+ * @return              bool                Whether the trace round trips and
+ *                                          is as small as expected
+ */
+static bool run_trace(trace_t const * const p_trace)
+{
+        co2_codec_t codec;
+        double start_s;
+        double encode_s;
+        double decode_s;
+        double bytes_per_sample;
+        size_t count;
+        size_t encoded = 0;
+        size_t size;
+        size_t i;
+        bool success = true;
+
+        count = generate_trace(p_trace);
+
+        start_s = now_s();
+
+        for (i = 0; (success) && (TRACE_REPETITIONS > i); ++i) {
+                success = encode(&codec,
+                                 m_buffer,
+                                 sizeof(m_buffer),
+                                 p_trace->channel_count,
+                                 m_samples,
+                                 count,
+                                 &encoded);
+        }
+
+        encode_s = now_s() - start_s;
+        size = co2_codec_get_size(&codec);
+
+        start_s = now_s();
+
+        for (i = 0; (success) && (TRACE_REPETITIONS > i); ++i) {
+                success = decode_matches(m_buffer,
+                                         size,
+                                         p_trace->channel_count,
+                                         m_samples,
+                                         count);
+        }
+
+        decode_s = now_s() - start_s;
+        bytes_per_sample = (double)size / (double)count;
+
+        printf("%-28s %8zu %10.2f %10.2f %12.1f %12.1f\n",
+               p_trace->p_name,
+               count,
+               bytes_per_sample,
+               p_trace->max_bytes_per_sample,
+               TRACE_REPETITIONS * count / encode_s / 1e6,
+               TRACE_REPETITIONS * count / decode_s / 1e6);
+
+        if (!success) {
+                printf("  unexpected: the trace doesn't round trip\n");
+
+        } else if (p_trace->max_bytes_per_sample < bytes_per_sample) {
+                printf("  unexpected: over %.2f bytes per sample\n",
+                       p_trace->max_bytes_per_sample);
+
+                success = false;
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Encode a list of samples
+ *
+ * Stops at the first sample that doesn't fit.
+ *
+ * @param[out]          p_codec             Pointer to the codec instance
+ * @param[out]          p_buffer            Pointer to the stream buffer
+ * @param[in]           size                Size of the stream buffer
+ * @param[in]           channel_count       Amount of channels
+ * @param[in]           p_samples           Pointer to the samples
+ * @param[in]           count               Amount of samples
+ * @param[out]          p_encoded           Pointer to store the amount of
+ *                                          samples encoded
+ *
+ * @return              bool                Whether every sample was encoded
+ */
+static bool encode(co2_codec_t * const p_codec,
+                   uint8_t * const p_buffer,
+                   size_t const size,
+                   uint8_t const channel_count,
+                   sample_t const * const p_samples,
+                   size_t const count,
+                   size_t * const p_encoded)
+{
+        bool success;
+
+        *p_encoded = 0;
+
+        success = co2_codec_encoder_init(p_codec,
+                                         p_buffer,
+                                         size,
+                                         channel_count);
+
+        while ((success) && (count > *p_encoded)) {
+                success = co2_codec_encode(p_codec,
+                                           p_samples[*p_encoded].time_s,
+                                           p_samples[*p_encoded].channel,
+                                           p_samples[*p_encoded].ppm);
+
+                if (success) {
+                        ++(*p_encoded);
+                }
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Decode a stream and compare it with a list of samples
+ *
+ * @param[in]           p_buffer            Pointer to the stream
+ * @param[in]           size                Size of the stream
+ * @param[in]           channel_count       Amount of channels
+ * @param[in]           p_samples           Pointer to the expected samples
+ * @param[in]           count               Amount of expected samples
+ *
+ * @return              bool                Whether every sample is decoded as
+ *                                          expected
+ */
+static bool decode_matches(uint8_t const * const p_buffer,
+                           size_t const size,
+                           uint8_t const channel_count,
+                           sample_t const * const p_samples,
+                           size_t const count)
+{
+        co2_codec_t codec;
+        uint32_t time_s;
+        uint8_t channel;
+        uint16_t ppm;
+        bool success;
+        size_t i;
+
+        success = co2_codec_decoder_init(&codec, p_buffer, size, channel_count);
+
+        for (i = 0; (success) && (count > i); ++i) {
+                success = co2_codec_decode(&codec, &time_s, &channel, &ppm) &&
+                          (p_samples[i].time_s == time_s) &&
+                          (p_samples[i].channel == channel) &&
+                          (p_samples[i].ppm == ppm);
+        }
+
+        return success && (co2_codec_get_size(&codec) <= size);
+}
+
+/*!
+ * @brief Round trip the edge cases
+ *
+ * @return              bool                Whether every case round trips
+ */
+static bool check_edge_cases(void)
+{
+        sample_t const samples[] = {
+                        {.time_s = 0, .channel = 0, .ppm = 0},
+                        {.time_s = UINT32_MAX, .channel = 1, .ppm = UINT16_MAX},
+                        {.time_s = 5, .channel = 2, .ppm = 1},
+                        {.time_s = 5, .channel = 3, .ppm = 400},
+                        {.time_s = 4, .channel = 0, .ppm = UINT16_MAX},
+                        {.time_s = 100000, .channel = 1, .ppm = 0},
+                        {.time_s = 0x80000000U, .channel = 2, .ppm = 5000},
+                        {.time_s = 0x7FFFFFFFU, .channel = 2, .ppm = 4999},
+                        {.time_s = UINT32_MAX, .channel = 0, .ppm = 400},
+                        {.time_s = 0, .channel = 0, .ppm = 400},
+        };
+
+        size_t const count = sizeof(samples) / sizeof(samples[0]);
+
+        co2_codec_t codec;
+        uint8_t buffer[sizeof(samples) / sizeof(samples[0]) *
+                       CO2_CODEC_SAMPLE_MAX_SIZE];
+        size_t encoded;
+        bool success;
+
+        success = encode(&codec,
+                         buffer,
+                         sizeof(buffer),
+                         CO2_CODEC_MAX_CHANNELS,
+                         samples,
+                         count,
+                         &encoded) &&
+                  decode_matches(buffer,
+                                 co2_codec_get_size(&codec),
+                                 CO2_CODEC_MAX_CHANNELS,
+                                 samples,
+                                 count);
+
+        success = success &&
+                  (!co2_codec_encode(&codec, 0, CO2_CODEC_MAX_CHANNELS, 400));
+
+        printf("\nedge cases round trip: %s\n", success ? "yes" : "no");
+
+        return success;
+}
+
+/*!
+ * @brief Check a sample that doesn't fit leaves the stream as it was
+ *
+ * @return              bool                Whether the samples that fit round
+ *                                          trip
+ */
+static bool check_full_buffer(void)
+{
+        co2_codec_t codec;
+        sample_t samples[64];
+        uint8_t buffer[12];
+        size_t size;
+        size_t encoded;
+        size_t i;
+        bool success;
+
+        for (i = 0; (sizeof(samples) / sizeof(samples[0])) > i; ++i) {
+                samples[i].time_s = 1000 + (uint32_t)i * 30;
+                samples[i].channel = 0;
+                samples[i].ppm = (uint16_t)(400 + i * i);
+        }
+
+        success = !encode(&codec,
+                          buffer,
+                          sizeof(buffer),
+                          1,
+                          samples,
+                          sizeof(samples) / sizeof(samples[0]),
+                          &encoded);
+
+        size = co2_codec_get_size(&codec);
+
+        // The samples before the one left out are kept as they were
+        success = success &&
+                  (size <= sizeof(buffer)) &&
+                  decode_matches(buffer, size, 1, samples, encoded);
+
+        printf("a %zu byte buffer holds %zu samples, the next one is left "
+               "out: %s\n",
+               sizeof(buffer),
+               encoded,
+               success ? "yes" : "no");
+
+        return success;
+}
+
+/*!
+ * @brief Round trip random streams
+ *
+ * Times and values change by small amounts most of the time, and by any
+ * amount, backwards included, now and then, so every field size is taken.
+ * Buffers are sized at random, the samples that fit must round trip.
+ *
+ * @return              bool                Whether every stream round trips
+ */
+static bool check_random_streams(void)
+{
+        co2_codec_t codec;
+        sample_t samples[FUZZ_MAX_SAMPLES];
+        uint8_t * p_buffer;
+        uint32_t time_s;
+        uint16_t ppm;
+        uint8_t channel_count;
+        size_t count;
+        size_t size;
+        size_t encoded;
+        size_t failures = 0;
+        size_t stream;
+        size_t i;
+
+        for (stream = 0; FUZZ_STREAMS > stream; ++stream) {
+                channel_count = (uint8_t)(1 + random_below(CO2_CODEC_MAX_CHANNELS));
+                count = 1 + random_below(FUZZ_MAX_SAMPLES);
+                size = 1 + random_below(count * CO2_CODEC_SAMPLE_MAX_SIZE);
+                time_s = random_below(UINT32_MAX);
+                ppm = (uint16_t)random_below(5000);
+
+                for (i = 0; count > i; ++i) {
+                        switch (random_below(4)) {
+                        case 0:
+                                time_s = random_below(UINT32_MAX);
+                                ppm = (uint16_t)random_below(UINT16_MAX + 1U);
+                                break;
+                        case 1:
+                                time_s += random_below(600) - 300;
+                                ppm = (uint16_t)(ppm + random_below(400) - 200);
+                                break;
+                        default:
+                                time_s += 30;
+                                ppm = (uint16_t)(ppm + random_below(7) - 3);
+                                break;
+                        }
+
+                        samples[i].time_s = time_s;
+                        samples[i].channel = (uint8_t)random_below(channel_count);
+                        samples[i].ppm = ppm;
+                }
+
+                // Exact size, so out of bounds accesses are caught by the
+                // sanitizer
+                p_buffer = malloc(size);
+
+                if (NULL == p_buffer) {
+                        ++failures;
+                        continue;
+                }
+
+                (void)encode(&codec,
+                             p_buffer,
+                             size,
+                             channel_count,
+                             samples,
+                             count,
+                             &encoded);
+
+                if ((size < co2_codec_get_size(&codec)) ||
+                    (!decode_matches(p_buffer,
+                                     co2_codec_get_size(&codec),
+                                     channel_count,
+                                     samples,
+                                     encoded))) {
+                        ++failures;
+                }
+
+                free(p_buffer);
+        }
+
+        printf("random streams round tripped: %u, failed: %zu\n",
+               FUZZ_STREAMS,
+               failures);
+
+        return (0 == failures);
+}
+
+/*!
+ * @brief Decode random bytes
+ *
+ * Whatever they decode into, the decoder must give up at the end of the
+ * buffer.
+ *
+ * @return              bool                Whether the decoder always stayed
+ *                                          within the buffer
+ */
+static bool check_garbage(void)
+{
+        co2_codec_t codec;
+        uint8_t * p_buffer;
+        uint32_t time_s;
+        uint8_t channel;
+        uint16_t ppm;
+        size_t size;
+        size_t decoded;
+        size_t failures = 0;
+        size_t buffer;
+        size_t i;
+
+        for (buffer = 0; GARBAGE_BUFFERS > buffer; ++buffer) {
+                size = 1 + random_below(GARBAGE_MAX_SIZE);
+                p_buffer = malloc(size);
+
+                if (NULL == p_buffer) {
+                        ++failures;
+                        continue;
+                }
+
+                for (i = 0; size > i; ++i) {
+                        p_buffer[i] = (uint8_t)random_below(UINT8_MAX + 1U);
+                }
+
+                decoded = 0;
+
+                if (co2_codec_decoder_init(&codec,
+                                           p_buffer,
+                                           size,
+                                           (uint8_t)(1 + random_below(
+                                                   CO2_CODEC_MAX_CHANNELS)))) {
+
+                        // A sample takes a bit at least
+                        while ((size * 8 >= decoded) &&
+                               (co2_codec_decode(&codec,
+                                                 &time_s,
+                                                 &channel,
+                                                 &ppm))) {
+                                ++decoded;
+                        }
+                }
+
+                if ((size * 8 < decoded) ||
+                    (size < co2_codec_get_size(&codec))) {
+                        ++failures;
+                }
+
+                free(p_buffer);
+        }
+
+        printf("random buffers decoded: %u, out of bounds: %zu\n",
+               GARBAGE_BUFFERS,
+               failures);
+
+        return (0 == failures);
+}
+
+/*!
+ * @brief Get a monotonic time
+ *
+ * @return              double              Time (in seconds)
+ */
+static double now_s(void)
+{
+        struct timespec now;
+
+        (void)clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
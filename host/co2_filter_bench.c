@@ -0,0 +1,432 @@
+/*!
+ *******************************************************************************
+ * @file co2_filter_bench.c
+ *
+ * @brief Host benchmark and checks of the CO2 reading filter
+ *
+ * Compares the fixed point filter against a floating point reference of the
+ * same median and moving average, measures how much sensor-like noise it
+ * removes, checks spike rejection and the restart after a gap, and reports
+ * the cost per reading for each median size.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "co2_filter.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Readings per accuracy run
+#define ACCURACY_READINGS                   (100000)
+
+//! @brief Readings per cost run
+#define COST_READINGS                       (5000000)
+
+//! @brief Time between readings (in milliseconds)
+#define READING_PERIOD_MS                   (10000)
+
+//! @brief Concentration around which the readings are generated (in ppm)
+#define BASE_PPM                            (1000)
+
+//! @brief Uniform noise amplitude added to the readings (in ppm)
+#define NOISE_PPM                           (30)
+
+//! @brief Largest deviation from the floating point reference allowed, half
+//!        a ppm from rounding the output plus the truncation of the 8
+//!        fractional bits, which adds up with the heaviest weights (in ppm)
+#define REFERENCE_MAX_ERROR_PPM             (1.5)
+
+//! @brief Default configuration, as in Kconfig
+#define DEFAULT_MEDIAN_SIZE                 (3)
+#define DEFAULT_EMA_SHIFT                   (2)
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Generate a noisy reading around a slowly moving concentration
+static uint32_t noisy_reading(size_t const index, int32_t * const p_noise);
+
+//! @brief Compare the filter against a floating point reference
+static bool check_reference(void);
+
+//! @brief Check how much noise the default filter removes
+static bool check_noise(void);
+
+//! @brief Check single reading spikes are dropped and gaps restart the filter
+static bool check_spikes_and_gaps(void);
+
+//! @brief Report the cost per reading for each median size
+static void report_cost(void);
+
+//! @brief Median of a small array, as the filter takes it
+static double reference_median(uint32_t const * const p_samples,
+                               size_t const count);
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+int main(void)
+{
+        bool success = true;
+
+        success = check_reference() && success;
+        success = check_noise() && success;
+        success = check_spikes_and_gaps() && success;
+
+        report_cost();
+
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Generate a noisy reading around a slowly moving concentration
+ *
+ * The concentration follows a slow triangle wave, so the moving average lag
+ * stays well under a ppm, and uniform noise is added on top.
+ *
+ * @param[in]           index               Reading index
+ * @param[out]          p_noise             Pointer to store the noise added
+ *
+ * @return              uint32_t            Reading (in ppm)
+ */
+static uint32_t noisy_reading(size_t const index, int32_t * const p_noise)
+{
+        int32_t const ramp = (int32_t)(index % 4000);
+        int32_t const drift = ((2000 > ramp) ? ramp : (4000 - ramp)) / 10;
+
+        *p_noise = (rand() % (2 * NOISE_PPM + 1)) - NOISE_PPM;
+
+        return (uint32_t)(BASE_PPM + drift + *p_noise);
+}
+
+/*!
+ * @brief Compare the filter against a floating point reference
+ *
+ * Feeds the same noisy readings to the filter and to a double precision
+ * median and moving average, for every median size and EMA shift, and reports
+ * the largest deviation.
+ *
+ * @return              bool                Whether the deviation is within
+ *                                          `REFERENCE_MAX_ERROR_PPM`
+ */
+static bool check_reference(void)
+{
+        co2_filter_t filter;
+        co2_filter_config_t config = {0};
+        uint32_t window[CO2_FILTER_MEDIAN_MAX_SIZE];
+        double reference;
+        double weight;
+        double error;
+        double max_error;
+        int32_t noise;
+        uint32_t ppm;
+        uint32_t output;
+        size_t count;
+        size_t i;
+        bool success = true;
+
+        printf("fixed point vs. floating point, max deviation (ppm)\n");
+        printf("%-8s", "median");
+
+        for (config.ema_shift = 0;
+             CO2_FILTER_EMA_MAX_SHIFT >= config.ema_shift;
+             ++config.ema_shift) {
+
+                printf("  shift %u", config.ema_shift);
+        }
+
+        printf("\n");
+
+        for (config.median_size = 1;
+             CO2_FILTER_MEDIAN_MAX_SIZE >= config.median_size;
+             config.median_size += 2) {
+
+                printf("%-8u", config.median_size);
+
+                for (config.ema_shift = 0;
+                     CO2_FILTER_EMA_MAX_SHIFT >= config.ema_shift;
+                     ++config.ema_shift) {
+
+                        srand(1);
+                        (void)co2_filter_init(&filter, &config);
+                        weight = 1.0 / (double)(1U << config.ema_shift);
+                        reference = 0.0;
+                        max_error = 0.0;
+                        count = 0;
+
+                        for (i = 0; ACCURACY_READINGS > i; ++i) {
+                                ppm = noisy_reading(i, &noise);
+                                output = co2_filter_update(
+                                                &filter,
+                                                ppm,
+                                                (uint32_t)(i * READING_PERIOD_MS));
+
+                                window[i % config.median_size] = ppm;
+
+                                if (config.median_size > count) {
+                                        ++count;
+                                }
+
+                                if (0 == i) {
+                                        reference = reference_median(window,
+                                                                     count);
+                                } else {
+                                        reference += weight * (reference_median(
+                                                        window,
+                                                        count) - reference);
+                                }
+
+                                error = fabs((double)output - reference);
+
+                                if (error > max_error) {
+                                        max_error = error;
+                                }
+                        }
+
+                        printf("  %7.2f", max_error);
+
+                        if (REFERENCE_MAX_ERROR_PPM < max_error) {
+
+                                success = false;
+                        }
+                }
+
+                printf("\n");
+        }
+
+        if (!success) {
+                printf("  unexpected: deviation over %.1f ppm\n",
+                       REFERENCE_MAX_ERROR_PPM);
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Check how much noise the default filter removes
+ *
+ * @return              bool                Whether the RMS error is at least
+ *                                          halved
+ */
+static bool check_noise(void)
+{
+        co2_filter_config_t const config = {
+                        .median_size = DEFAULT_MEDIAN_SIZE,
+                        .ema_shift = DEFAULT_EMA_SHIFT,
+        };
+
+        co2_filter_t filter;
+        int32_t noise;
+        uint32_t ppm;
+        double error;
+        double input_error = 0.0;
+        double output_error = 0.0;
+        double input_rms;
+        double output_rms;
+        size_t i;
+        bool success;
+
+        srand(1);
+        (void)co2_filter_init(&filter, &config);
+
+        for (i = 0; ACCURACY_READINGS > i; ++i) {
+                ppm = noisy_reading(i, &noise);
+                error = (double)co2_filter_update(
+                                &filter,
+                                ppm,
+                                (uint32_t)(i * READING_PERIOD_MS)) -
+                        (double)(ppm - (uint32_t)noise);
+
+                input_error += (double)noise * noise;
+                output_error += error * error;
+        }
+
+        input_rms = sqrt(input_error / ACCURACY_READINGS);
+        output_rms = sqrt(output_error / ACCURACY_READINGS);
+        success = (output_rms * 2.0 <= input_rms);
+
+        printf("\n+-%u ppm uniform noise, median %u, shift %u: RMS error "
+               "%.1f -> %.1f ppm\n",
+               NOISE_PPM,
+               DEFAULT_MEDIAN_SIZE,
+               DEFAULT_EMA_SHIFT,
+               input_rms,
+               output_rms);
+
+        if (!success) {
+                printf("  unexpected: RMS error not halved\n");
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Check single reading spikes are dropped and gaps restart the filter
+ *
+ * @return              bool                Whether both behave as expected
+ */
+static bool check_spikes_and_gaps(void)
+{
+        co2_filter_config_t const config = {
+                        .median_size = DEFAULT_MEDIAN_SIZE,
+                        .ema_shift = DEFAULT_EMA_SHIFT,
+                        .max_gap_ms = 3 * READING_PERIOD_MS,
+        };
+
+        co2_filter_t filter;
+        uint32_t time_ms = 0;
+        uint32_t output;
+        uint32_t max_output = 0;
+        size_t i;
+        bool success = true;
+
+        (void)co2_filter_init(&filter, &config);
+
+        for (i = 0; 20 > i; ++i) {
+                output = co2_filter_update(&filter,
+                                           (10 == i) ? 5000 : 800,
+                                           time_ms);
+                time_ms += READING_PERIOD_MS;
+
+                if (output > max_output) {
+                        max_output = output;
+                }
+        }
+
+        if (800 != max_output) {
+                printf("  unexpected: a single 5000 ppm spike moved the "
+                       "output to %u ppm\n",
+                       max_output);
+
+                success = false;
+        }
+
+        time_ms += 4 * READING_PERIOD_MS;
+        output = co2_filter_update(&filter, 1500, time_ms);
+
+        if (1500 != output) {
+                printf("  unexpected: the first reading after a gap gave %u "
+                       "ppm instead of 1500\n",
+                       output);
+
+                success = false;
+        }
+
+        printf("single reading spike dropped: %s, restart after a gap: %s\n",
+               (800 == max_output) ? "yes" : "no",
+               (1500 == output) ? "yes" : "no");
+
+        return success;
+}
+
+/*!
+ * @brief Report the cost per reading for each median size
+ *
+ * @return              -                   -
+ */
+static void report_cost(void)
+{
+        co2_filter_config_t config = {
+                        .ema_shift = DEFAULT_EMA_SHIFT,
+        };
+
+        co2_filter_t filter;
+        struct timespec start;
+        struct timespec end;
+        volatile uint32_t sink = 0;
+        uint32_t i;
+
+        printf("\ncost per reading\n");
+
+        for (config.median_size = 1;
+             CO2_FILTER_MEDIAN_MAX_SIZE >= config.median_size;
+             config.median_size += 2) {
+
+                (void)co2_filter_init(&filter, &config);
+                (void)clock_gettime(CLOCK_MONOTONIC, &start);
+
+                for (i = 0; COST_READINGS > i; ++i) {
+                        sink += co2_filter_update(&filter,
+                                                  900 + (i * 7919U) % 50U,
+                                                  i * 1000U);
+                }
+
+                (void)clock_gettime(CLOCK_MONOTONIC, &end);
+
+                printf("median %u: %5.1f ns\n",
+                       config.median_size,
+                       ((double)(end.tv_sec - start.tv_sec) * 1e9 +
+                        (double)(end.tv_nsec - start.tv_nsec)) /
+                       COST_READINGS);
+        }
+
+        (void)sink;
+}
+
+/*!
+ * @brief Median of a small array, as the filter takes it
+ *
+ * With an even amount of samples, the lower one of the two middle samples is
+ * taken.
+ *
+ * @param[in]           p_samples           Pointer to the samples
+ * @param[in]           count               Amount of samples
+ *
+ * @return              double              Median
+ */
+static double reference_median(uint32_t const * const p_samples,
+                               size_t const count)
+{
+        uint32_t sorted[CO2_FILTER_MEDIAN_MAX_SIZE];
+        uint32_t sample;
+        size_t i;
+        size_t j;
+
+        for (i = 0; count > i; ++i) {
+                sample = p_samples[i];
+
+                for (j = i; (0 < j) && (sorted[j - 1] > sample); --j) {
+                        sorted[j] = sorted[j - 1];
+                }
+
+                sorted[j] = sample;
+        }
+
+        return (double)sorted[(count - 1) / 2];
+}
@@ -0,0 +1,457 @@
+/*!
+ *******************************************************************************
+ * @file coap_test.c
+ *
+ * @brief Host test of the CoAP transport against a libcoap server
+ *
+ * Runs `coap_client.c` against a libcoap server in another thread, standing
+ * in for the Thingsboard CoAP device API at `CONFIG_CO2_MONITOR_COAP_SERVER_URI`.
+ * Checks confirmable and non-confirmable posts reach the server, the longest
+ * payload arrives whole in a single datagram, longer ones are refused
+ * without closing the session, and a rejected post opens a new one.
+ *
+ * Skipped if the server port can't be bound.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#include "coap3/coap.h"
+
+#include "sdkconfig.h"
+#include "display.h"
+#include "device_state.h"
+#include "coap_client.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Server address, as in `CONFIG_CO2_MONITOR_COAP_SERVER_URI`
+#define SERVER_ADDRESS                      (INADDR_LOOPBACK)
+#define SERVER_PORT                         (5683)
+
+//! @brief Resource `coap_client.c` posts to
+#define RESOURCE_PATH                       "api/v1/" CONFIG_CO2_MONITOR_DEVICE_TOKEN "/telemetry"
+
+//! @brief Payload the server rejects
+#define REJECTED                            "{\"rejected\": true}"
+
+//! @brief Routine telemetry
+#define TELEMETRY                           "{\"co2_concentration\": 800}"
+
+//! @brief Exit code telling CTest the test was skipped
+#define EXIT_SKIPPED                        (77)
+
+//! @brief Time to wait for a non-confirmable post (in milliseconds)
+#define TIMEOUT_MS                          (5000)
+
+//! @brief Time between checks while waiting (in milliseconds)
+#define POLL_MS                             (10)
+
+//! @brief Check a condition, reporting it if it doesn't hold
+#define CHECK(condition)                                                       \
+        do {                                                                   \
+                if (!(condition)) {                                            \
+                        printf("  failed at line %d: %s\n",                    \
+                               __LINE__,                                       \
+                               #condition);                                    \
+                        m_is_failed = true;                                    \
+                }                                                              \
+        } while (0)
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Start the server, bound to the local port
+static bool server_start(void);
+
+//! @brief Stop the server
+static void server_stop(void);
+
+//! @brief Serve until stopped
+static void * server_run(void * p_argument);
+
+//! @brief Take a post to the telemetry resource
+static void server_on_post(coap_resource_t * p_resource,
+                           coap_session_t * p_session,
+                           coap_pdu_t const * p_request,
+                           coap_string_t const * p_query,
+                           coap_pdu_t * p_response);
+
+//! @brief Fill a buffer with a JSON batch of a given length
+static void make_batch(char * const p_buffer, size_t const length);
+
+//! @brief Wait until the server has received a number of posts
+static bool wait_for(uint32_t const posts);
+
+//! @brief Get the exchange counters
+static coap_client_stats_t get_stats(void);
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+static coap_context_t * m_server = NULL;
+
+static pthread_t m_server_thread;
+
+//! @brief Whether the server keeps serving
+static volatile bool m_is_running = false;
+
+//! @brief Posts received by the server
+static volatile uint32_t m_received = 0;
+
+//! @brief Payload length of the last post received by the server
+static volatile size_t m_received_length = 0;
+
+//! @brief Link status last reported to the display
+static bool m_is_linked = false;
+
+//! @brief Whether any check failed
+static bool m_is_failed = false;
+
+//! @brief Longest payload posted, and one byte more
+static char m_payload[COAP_CLIENT_MAX_PAYLOAD + 2];
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+int main(void)
+{
+        coap_client_stats_t stats;
+
+        coap_startup();
+
+        if (!server_start()) {
+                printf("server port can't be bound, skipped\n");
+
+                // Code style exception for the shake of readability
+                return EXIT_SKIPPED;
+        }
+
+        CHECK(coap_client_init());
+
+        // Confirmable posts wait for the answer, non-confirmable ones don't
+        printf("posts\n");
+
+        CHECK(coap_client_post(TELEMETRY, true));
+        CHECK(1 == m_received);
+        CHECK(m_is_linked);
+
+        CHECK(coap_client_post(TELEMETRY, false));
+        CHECK(wait_for(2));
+
+        stats = get_stats();
+
+        CHECK(2 == stats.posts);
+        CHECK(1 == stats.acknowledged);
+        CHECK(0 == stats.failures);
+        CHECK(1 == stats.sessions);
+
+        // The longest payload arrives whole, longer ones aren't even sent
+        printf("payload size\n");
+
+        make_batch(m_payload, COAP_CLIENT_MAX_PAYLOAD);
+
+        CHECK(coap_client_post(m_payload, true));
+        CHECK(3 == m_received);
+        CHECK(COAP_CLIENT_MAX_PAYLOAD == m_received_length);
+
+        make_batch(m_payload, COAP_CLIENT_MAX_PAYLOAD + 1);
+
+        CHECK(!coap_client_post(m_payload, true));
+        CHECK(3 == m_received);
+        CHECK(m_is_linked);
+
+        stats = get_stats();
+
+        CHECK(3 == stats.posts);
+        CHECK(0 == stats.failures);
+        CHECK(1 == stats.sessions);
+
+        // Rejected posts fail, and the next post opens a new session
+        printf("rejected\n");
+
+        CHECK(!coap_client_post(REJECTED, true));
+        CHECK(!m_is_linked);
+        CHECK(coap_client_post(TELEMETRY, true));
+        CHECK(m_is_linked);
+
+        stats = get_stats();
+
+        CHECK(5 == stats.posts);
+        CHECK(3 == stats.acknowledged);
+        CHECK(1 == stats.failures);
+        CHECK(2 == stats.sessions);
+
+        server_stop();
+
+        printf("%s\n", (m_is_failed) ? "failed" : "passed");
+
+        return (m_is_failed) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*!
+ * @brief Stand-in of the display link status, records it
+ *
+ * @param[in]           linked              Whether the server is reachable
+ *
+ * @return              bool                Operation result
+ */
+bool display_set_link_status(bool const linked)
+{
+        m_is_linked = linked;
+
+        return true;
+}
+
+/*!
+ * @brief Stand-in of the device state link status, not used
+ *
+ * @param[in]           linked              Whether the server is reachable
+ *
+ * @return              -                   -
+ */
+void device_state_set_link(bool const linked)
+{
+        (void)linked;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Start the server, bound to the local port
+ *
+ * @return              bool                Operation result, fails if the
+ *                                          port can't be bound
+ */
+static bool server_start(void)
+{
+        coap_resource_t * p_resource;
+        coap_address_t address;
+        bool success;
+
+        coap_address_init(&address);
+        address.addr.sin.sin_family = AF_INET;
+        address.addr.sin.sin_addr.s_addr = htonl(SERVER_ADDRESS);
+        address.addr.sin.sin_port = htons(SERVER_PORT);
+        address.size = sizeof(address.addr.sin);
+
+        m_server = coap_new_context(NULL);
+
+        success = ((NULL != m_server) &&
+                   (NULL != coap_new_endpoint(m_server,
+                                              &address,
+                                              COAP_PROTO_UDP)));
+
+        if (success) {
+                p_resource = coap_resource_init(
+                                coap_make_str_const(RESOURCE_PATH), 0);
+
+                success = (NULL != p_resource);
+        }
+
+        if (success) {
+                coap_register_handler(p_resource,
+                                      COAP_REQUEST_POST,
+                                      server_on_post);
+                coap_add_resource(m_server, p_resource);
+
+                m_is_running = true;
+
+                success = (0 == pthread_create(&m_server_thread,
+                                               NULL,
+                                               server_run,
+                                               NULL));
+        }
+
+        if ((!success) && (NULL != m_server)) {
+                coap_free_context(m_server);
+                m_server = NULL;
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Stop the server
+ *
+ * @return              -                   -
+ */
+static void server_stop(void)
+{
+        m_is_running = false;
+
+        (void)pthread_join(m_server_thread, NULL);
+
+        coap_free_context(m_server);
+        m_server = NULL;
+}
+
+/*!
+ * @brief Serve until stopped
+ *
+ * @param               p_argument          Not used
+ *
+ * @return              void *              Always NULL
+ */
+static void * server_run(void * p_argument)
+{
+        (void)p_argument;
+
+        while (m_is_running) {
+                (void)coap_io_process(m_server, POLL_MS);
+        }
+
+        return NULL;
+}
+
+/*!
+ * @brief Take a post to the telemetry resource
+ *
+ * Runs from `coap_io_process`, in the server thread. Posts are accepted,
+ * unless their payload is `REJECTED`.
+ *
+ * @param               p_resource          Not used
+ * @param               p_session           Not used
+ * @param[in]           p_request           Pointer to the post
+ * @param               p_query             Not used
+ * @param[out]          p_response          Pointer to the answer
+ *
+ * @return              -                   -
+ */
+static void server_on_post(coap_resource_t * p_resource,
+                           coap_session_t * p_session,
+                           coap_pdu_t const * p_request,
+                           coap_string_t const * p_query,
+                           coap_pdu_t * p_response)
+{
+        uint8_t const * p_data = NULL;
+        size_t length = 0;
+        bool is_rejected;
+
+        (void)p_resource;
+        (void)p_session;
+        (void)p_query;
+
+        (void)coap_get_data(p_request, &length, &p_data);
+
+        is_rejected = ((strlen(REJECTED) == length) &&
+                       (0 == memcmp(REJECTED, p_data, length)));
+
+        m_received_length = length;
+        ++m_received;
+
+        coap_pdu_set_code(p_response,
+                          (is_rejected) ?
+                          COAP_RESPONSE_CODE_BAD_REQUEST :
+                          COAP_RESPONSE_CODE_CHANGED);
+}
+
+/*!
+ * @brief Fill a buffer with a JSON batch of a given length
+ *
+ * Repeats a telemetry entry, padding the array with spaces.
+ *
+ * @param[out]          p_buffer            Pointer where to write the batch,
+ *                                          at least `length + 1` long
+ * @param[in]           length              Batch length, terminator excluded
+ *
+ * @return              -                   -
+ */
+static void make_batch(char * const p_buffer, size_t const length)
+{
+        static char const * const p_entry =
+                        "{\"ts\": 1700000000000, \"values\": " TELEMETRY "}";
+
+        size_t const entry_length = strlen(p_entry);
+        size_t used = 1;
+
+        memset(p_buffer, ' ', length);
+        p_buffer[0] = '[';
+
+        while ((used + 1 + entry_length + 1) <= length) {
+                memcpy(&p_buffer[used], p_entry, entry_length);
+                used += entry_length;
+                p_buffer[used++] = ',';
+        }
+
+        p_buffer[(1 < used) ? (used - 1) : used] = ' ';
+        p_buffer[length - 1] = ']';
+        p_buffer[length] = '\0';
+}
+
+/*!
+ * @brief Wait until the server has received a number of posts
+ *
+ * @param[in]           posts               Posts to wait for
+ *
+ * @return              bool                False on timeout
+ */
+static bool wait_for(uint32_t const posts)
+{
+        uint32_t i;
+
+        for (i = 0; TIMEOUT_MS / POLL_MS > i; ++i) {
+                if (posts <= m_received) {
+                        // Code style exception for the shake of readability
+                        return true;
+                }
+
+                (void)usleep(POLL_MS * 1000);
+        }
+
+        printf("timed out: %u posts received\n", m_received);
+
+        return false;
+}
+
+/*!
+ * @brief Get the exchange counters
+ *
+ * @return              coap_client_stats_t Exchange counters
+ */
+static coap_client_stats_t get_stats(void)
+{
+        coap_client_stats_t stats = {0};
+
+        (void)coap_client_get_stats(&stats);
+
+        return stats;
+}
@@ -0,0 +1,345 @@
+/*!
+ *******************************************************************************
+ * @file mh_z19_bench.c
+ *
+ * @brief Host benchmark of the MH-Z19 driver against the sensor emulator
+ *
+ * Drives `mh_z19_get_gas_concentration` through the emulator under a few
+ * line conditions and reports the transaction latency percentiles and the
+ * error rates. Latency is measured on a simulated clock, which the emulator
+ * delay function advances, so runs are fast and reproducible. The host CPU
+ * time spent by the driver per transaction is reported as well.
+ *
+ * Fails if a clean line gives any error, or if the error rates of an impaired
+ * line don't match the configured impairments: replies short of a byte have
+ * to time out, and whole replies with a wrong check value have to be bad
+ * replies.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "winsen_mh_z19.h"
+#include "winsen_mh_z19_emulator.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Transactions run per scenario
+#define TRANSACTIONS                        (20000)
+
+//! @brief Error rate deviation tolerated from the configured impairments (in %)
+#define RATE_TOLERANCE_PERCENT              (1.0)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Line conditions to run the driver under
+typedef struct {
+        //! @brief Name, for the report
+        char const * p_name;
+
+        //! @brief Emulated sensor configuration
+        mh_z19_emulator_config_t config;
+} scenario_t;
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+//! @brief Scenarios run, a 9 byte frame takes about 9.4 ms each way at 9600
+//!        baud
+static scenario_t const m_scenarios[] = {
+                {
+                                .p_name = "clean",
+                                .config = {
+                                                .response_latency_ms = 20,
+                                                .concentration_ppm = 800,
+                                                .noise_ppm = 10,
+                                                .temperature_c = 25,
+                                                .seed = 1,
+                                },
+                },
+                {
+                                .p_name = "jitter 20 ms",
+                                .config = {
+                                                .response_latency_ms = 20,
+                                                .latency_jitter_ms = 20,
+                                                .concentration_ppm = 800,
+                                                .noise_ppm = 10,
+                                                .temperature_c = 25,
+                                                .seed = 2,
+                                },
+                },
+                {
+                                .p_name = "2% dropped, 2% corrupted",
+                                .config = {
+                                                .response_latency_ms = 20,
+                                                .latency_jitter_ms = 5,
+                                                .concentration_ppm = 800,
+                                                .noise_ppm = 10,
+                                                .temperature_c = 25,
+                                                .drop_byte_percent = 2,
+                                                .bad_checksum_percent = 2,
+                                                .seed = 3,
+                                },
+                },
+};
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Advance the simulated clock
+static void delay_ms(uint32_t const delay_ms);
+
+//! @brief Get the simulated clock
+static uint32_t time_us(void);
+
+//! @brief Run the driver under a scenario and report the results
+static bool run_scenario(scenario_t const * const p_scenario);
+
+//! @brief Order latencies, for `qsort`
+static int compare_latencies(void const * p_a, void const * p_b);
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Simulated clock (in microseconds)
+static uint32_t m_clock_us = 0;
+
+//! @brief Latency of every successful transaction (in microseconds)
+static uint32_t m_latencies_us[TRANSACTIONS];
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+int main(void)
+{
+        bool success = true;
+        size_t i;
+
+        printf("%-26s %9s %9s %9s %8s %8s %8s %10s\n",
+               "scenario", "p50 (ms)", "p99 (ms)", "max (ms)",
+               "ok (%)", "t/o (%)", "bad (%)", "cpu (ns)");
+
+        for (i = 0; (sizeof(m_scenarios) / sizeof(m_scenarios[0])) > i; ++i) {
+                success = run_scenario(&m_scenarios[i]) && success;
+        }
+
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Advance the simulated clock
+ *
+ * Follows the `mh_z19_emulator_delay_func` prototype
+ *
+ * @param[in]           delay_ms            Time to advance (in milliseconds)
+ *
+ * @return              -                   -
+ */
+static void delay_ms(uint32_t const delay_ms)
+{
+        m_clock_us += delay_ms * 1000;
+}
+
+/*!
+ * @brief Get the simulated clock
+ *
+ * Follows the `mh_z19_time_func` prototype
+ *
+ * @return              uint32_t            Simulated time (in microseconds)
+ */
+static uint32_t time_us(void)
+{
+        return m_clock_us;
+}
+
+/*!
+ * @brief Run the driver under a scenario and report the results
+ *
+ * @param[in]           p_scenario          Pointer to the scenario
+ *
+ * @return              bool                Whether the results are the
+ *                                          expected ones
+ */
+static bool run_scenario(scenario_t const * const p_scenario)
+{
+        mh_z19_emulator_config_t const * const p_config = &p_scenario->config;
+
+        // A reply short of a byte times out, whatever its check value
+        double const expected_timeout_percent = p_config->drop_byte_percent;
+        double const expected_bad_percent =
+                        (100.0 - p_config->drop_byte_percent) *
+                        p_config->bad_checksum_percent / 100.0;
+
+        mh_z19_emulator_t emulator = {0};
+        mh_z19_t sensor = {0};
+        mh_z19_stats_t stats;
+        struct timespec start;
+        struct timespec end;
+        uint32_t concentration;
+        uint32_t start_us;
+        size_t count = 0;
+        size_t out_of_range = 0;
+        double cpu_ns;
+        double timeout_percent;
+        double bad_percent;
+        bool success;
+        size_t i;
+
+        success = ((MH_Z19_ERROR_SUCCESS == mh_z19_emulator_init(&emulator,
+                                                                 p_config,
+                                                                 delay_ms)) &&
+                   (MH_Z19_ERROR_SUCCESS == mh_z19_init(&sensor,
+                                                        mh_z19_emulator_xfer,
+                                                        &emulator)) &&
+                   (MH_Z19_ERROR_SUCCESS == mh_z19_set_time_func(&sensor,
+                                                                 time_us)));
+
+        if (!success) {
+                printf("%-26s could not be set up\n", p_scenario->p_name);
+
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        (void)clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (i = 0; TRANSACTIONS > i; ++i) {
+                start_us = m_clock_us;
+
+                if (MH_Z19_ERROR_SUCCESS != mh_z19_get_gas_concentration(
+                                &sensor,
+                                &concentration)) {
+                        continue;
+                }
+
+                m_latencies_us[count++] = m_clock_us - start_us;
+
+                if ((concentration + p_config->noise_ppm <
+                     p_config->concentration_ppm) ||
+                    (concentration >
+                     p_config->concentration_ppm + p_config->noise_ppm)) {
+
+                        ++out_of_range;
+                }
+        }
+
+        (void)clock_gettime(CLOCK_MONOTONIC, &end);
+        (void)mh_z19_get_stats(&sensor, &stats);
+
+        cpu_ns = ((double)(end.tv_sec - start.tv_sec) * 1e9 +
+                  (double)(end.tv_nsec - start.tv_nsec)) / TRANSACTIONS;
+
+        qsort(m_latencies_us, count, sizeof(m_latencies_us[0]), compare_latencies);
+
+        timeout_percent = 100.0 * stats.timeouts / stats.transactions;
+        bad_percent = 100.0 * stats.bad_replies / stats.transactions;
+
+        printf("%-26s %9.1f %9.1f %9.1f %8.2f %8.2f %8.2f %10.0f\n",
+               p_scenario->p_name,
+               (0 != count) ? m_latencies_us[count * 50 / 100] / 1000.0 : 0.0,
+               (0 != count) ? m_latencies_us[count * 99 / 100] / 1000.0 : 0.0,
+               stats.max_time_us / 1000.0,
+               100.0 * stats.successes / stats.transactions,
+               timeout_percent,
+               bad_percent,
+               cpu_ns);
+
+        if ((TRANSACTIONS != stats.transactions) ||
+            (count != stats.successes) ||
+            (0 != out_of_range)) {
+
+                printf("  unexpected: %u transactions, %zu readings, "
+                       "%zu out of range\n",
+                       stats.transactions,
+                       count,
+                       out_of_range);
+
+                success = false;
+        }
+
+        if ((timeout_percent >
+             expected_timeout_percent + RATE_TOLERANCE_PERCENT) ||
+            (timeout_percent + RATE_TOLERANCE_PERCENT <
+             expected_timeout_percent)) {
+
+                printf("  unexpected: %.2f%% timeouts, %.2f%% expected\n",
+                       timeout_percent,
+                       expected_timeout_percent);
+
+                success = false;
+        }
+
+        if ((bad_percent > expected_bad_percent + RATE_TOLERANCE_PERCENT) ||
+            (bad_percent + RATE_TOLERANCE_PERCENT < expected_bad_percent)) {
+
+                printf("  unexpected: %.2f%% bad replies, %.2f%% expected\n",
+                       bad_percent,
+                       expected_bad_percent);
+
+                success = false;
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Order latencies, for `qsort`
+ *
+ * @param[in]           p_a                 Pointer to the first latency
+ * @param[in]           p_b                 Pointer to the second latency
+ *
+ * @return              int                 Negative, zero or positive if the
+ *                                          first one is shorter, equal or
+ *                                          longer
+ */
+static int compare_latencies(void const * p_a, void const * p_b)
+{
+        uint32_t const a = *(uint32_t const *)p_a;
+        uint32_t const b = *(uint32_t const *)p_b;
+
+        return (a > b) - (a < b);
+}
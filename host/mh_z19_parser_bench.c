@@ -0,0 +1,385 @@
+/*!
+ *******************************************************************************
+ * @file mh_z19_parser_bench.c
+ *
+ * @brief Host throughput benchmark of the MH-Z19 frame parser
+ *
+ * Feeds a stream of valid frames to the parser in reads of random sizes,
+ * popping every frame after each read as the UART transport does, and
+ * reports the bytes and frames parsed per second. The stream is fed clean,
+ * with stray bytes inserted, with bytes dropped and with corrupted bytes.
+ *
+ * Fails if a frame of the clean stream is lost, or if an impaired stream
+ * loses more than a frame per impairment, as the parser has to be aligned
+ * again right after it.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "winsen_mh_z19_parser.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Frames of the stream
+#define FRAMES                              (200000)
+
+//! @brief Times each stream is parsed to measure throughput
+#define REPETITIONS                         (10)
+
+//! @brief Largest size of the stream, impairments included (in bytes)
+#define STREAM_MAX_SIZE                     (FRAMES * (MH_Z19_PARSER_FRAME_SIZE + 1))
+
+//! @brief Largest read fed to the parser at once (in bytes)
+#define READ_MAX_SIZE                       (MH_Z19_PARSER_FRAME_SIZE * 2)
+
+//! @brief Command of the frames, a gas concentration reply
+#define COMMAND                             (0x86)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+//! @brief How the bytes of the stream are impaired
+typedef enum {
+        //! @brief Not at all
+        IMPAIRMENT_NONE = 0,
+
+        //! @brief A stray byte is inserted
+        IMPAIRMENT_STRAY,
+
+        //! @brief A byte is lost
+        IMPAIRMENT_DROP,
+
+        //! @brief A byte is flipped
+        IMPAIRMENT_CORRUPT,
+} impairment_t;
+
+//! @brief Stream parsed
+typedef struct {
+        //! @brief Name, for the report
+        char const * p_name;
+
+        //! @brief How its bytes are impaired
+        impairment_t impairment;
+
+        //! @brief Impaired frames (in %)
+        uint32_t percent;
+} scenario_t;
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+//! @brief Streams parsed
+static scenario_t const m_scenarios[] = {
+                {
+                                .p_name = "clean",
+                                .impairment = IMPAIRMENT_NONE,
+                                .percent = 0,
+                },
+                {
+                                .p_name = "1% stray bytes",
+                                .impairment = IMPAIRMENT_STRAY,
+                                .percent = 1,
+                },
+                {
+                                .p_name = "1% dropped bytes",
+                                .impairment = IMPAIRMENT_DROP,
+                                .percent = 1,
+                },
+                {
+                                .p_name = "1% corrupted bytes",
+                                .impairment = IMPAIRMENT_CORRUPT,
+                                .percent = 1,
+                },
+};
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Get a pseudo random number
+static uint32_t random_below(uint32_t const limit);
+
+//! @brief Generate the stream of a scenario
+static size_t generate_stream(scenario_t const * const p_scenario,
+                              uint32_t * const p_impaired);
+
+//! @brief Parse a stream in reads of random sizes
+static uint32_t parse_stream(size_t const size, uint32_t const seed);
+
+//! @brief Parse the stream of a scenario and report it
+static bool run_scenario(scenario_t const * const p_scenario);
+
+//! @brief Get a monotonic time
+static double now_s(void);
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief State of the pseudo random generator
+static uint32_t m_random = 12345;
+
+//! @brief Stream of the scenario being run
+static uint8_t m_stream[STREAM_MAX_SIZE];
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+int main(void)
+{
+        bool success = true;
+        size_t i;
+
+        printf("%-20s %8s %8s %8s %12s %12s\n",
+               "stream", "frames", "impaired", "lost", "MB/s", "Mframes/s");
+
+        for (i = 0; (sizeof(m_scenarios) / sizeof(m_scenarios[0])) > i; ++i) {
+                success = run_scenario(&m_scenarios[i]) && success;
+        }
+
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Get a pseudo random number
+ *
+ * Linear congruential generator, so runs are reproducible on every host.
+ *
+ * @param[in]           limit               Numbers are below this one
+ *
+ * @return              uint32_t            Pseudo random number
+ */
+static uint32_t random_below(uint32_t const limit)
+{
+        m_random = m_random * 1103515245U + 12345U;
+
+        return (m_random >> 8) % limit;
+}
+
+/*!
+ * @brief Generate the stream of a scenario
+ *
+ * Frames carry a random concentration. An impaired frame has a single byte
+ * inserted, dropped or flipped at a random position.
+ *
+ * @param[in]           p_scenario          Pointer to the scenario
+ * @param[out]          p_impaired          Pointer where to store the amount
+ *                                          of impaired frames
+ *
+ * @return              size_t              Size of the stream
+ */
+static size_t generate_stream(scenario_t const * const p_scenario,
+                              uint32_t * const p_impaired)
+{
+        uint8_t frame[MH_Z19_PARSER_FRAME_SIZE + 1] = {0xFF, COMMAND};
+        size_t length;
+        size_t size = 0;
+        size_t position;
+        uint32_t ppm;
+        uint32_t i;
+        uint8_t sum;
+        size_t j;
+
+        *p_impaired = 0;
+
+        for (i = 0; FRAMES > i; ++i) {
+                ppm = 400 + random_below(4600);
+                frame[2] = (uint8_t)(ppm >> 8);
+                frame[3] = (uint8_t)ppm;
+                frame[4] = (uint8_t)(40 + random_below(20));
+
+                sum = 0;
+
+                for (j = 1; MH_Z19_PARSER_FRAME_SIZE - 1 > j; ++j) {
+                        // Overflow is meant to happen
+                        sum += frame[j];
+                }
+
+                frame[MH_Z19_PARSER_FRAME_SIZE - 1] = (uint8_t)(~sum + 1);
+
+                length = MH_Z19_PARSER_FRAME_SIZE;
+                position = random_below(MH_Z19_PARSER_FRAME_SIZE);
+
+                if ((IMPAIRMENT_NONE != p_scenario->impairment) &&
+                    (p_scenario->percent > random_below(100))) {
+
+                        ++*p_impaired;
+
+                        switch (p_scenario->impairment) {
+                        case IMPAIRMENT_STRAY:
+                                memmove(&frame[position + 1],
+                                        &frame[position],
+                                        length - position);
+                                frame[position] = (uint8_t)random_below(256);
+                                ++length;
+                                break;
+                        case IMPAIRMENT_DROP:
+                                memmove(&frame[position],
+                                        &frame[position + 1],
+                                        length - position - 1);
+                                --length;
+                                break;
+                        case IMPAIRMENT_CORRUPT:
+                        default:
+                                frame[position] ^= (uint8_t)(1 +
+                                                             random_below(255));
+                                break;
+                        }
+                }
+
+                memcpy(&m_stream[size], frame, length);
+                size += length;
+
+                // The frame may have been impaired
+                frame[0] = 0xFF;
+                frame[1] = COMMAND;
+        }
+
+        return size;
+}
+
+/*!
+ * @brief Parse a stream in reads of random sizes
+ *
+ * @param[in]           size                Size of the stream
+ * @param[in]           seed                Seed of the read sizes
+ *
+ * @return              uint32_t            Frames found
+ */
+static uint32_t parse_stream(size_t const size, uint32_t const seed)
+{
+        uint8_t frame[MH_Z19_PARSER_FRAME_SIZE];
+        mh_z19_parser_t parser;
+        uint32_t random = seed;
+        uint32_t found = 0;
+        size_t offset = 0;
+        size_t read;
+
+        mh_z19_parser_reset(&parser);
+
+        while (size > offset) {
+                random = random * 1103515245U + 12345U;
+                read = 1 + ((random >> 8) % READ_MAX_SIZE);
+
+                if ((size - offset) < read) {
+                        read = size - offset;
+                }
+
+                offset += mh_z19_parser_push(&parser, &m_stream[offset], read);
+
+                while (mh_z19_parser_pop_frame(&parser, COMMAND, frame)) {
+                        ++found;
+                }
+        }
+
+        return found;
+}
+
+/*!
+ * @brief Parse the stream of a scenario and report it
+ *
+ * @param[in]           p_scenario          Pointer to the scenario
+ *
+ * @return              bool                Whether no more frames than the
+ *                                          impaired ones were lost
+ */
+static bool run_scenario(scenario_t const * const p_scenario)
+{
+        uint32_t impaired;
+        uint32_t found = 0;
+        uint32_t lost;
+        double start_s;
+        double elapsed_s;
+        size_t size;
+        uint32_t i;
+        bool success = true;
+
+        size = generate_stream(p_scenario, &impaired);
+
+        start_s = now_s();
+
+        for (i = 0; REPETITIONS > i; ++i) {
+                found = parse_stream(size, i + 1);
+        }
+
+        elapsed_s = now_s() - start_s;
+        lost = (FRAMES > found) ? (FRAMES - found) : 0;
+
+        printf("%-20s %8u %8u %8u %12.1f %12.2f\n",
+               p_scenario->p_name,
+               (unsigned int)FRAMES,
+               (unsigned int)impaired,
+               (unsigned int)lost,
+               REPETITIONS * size / elapsed_s / 1e6,
+               REPETITIONS * (double)found / elapsed_s / 1e6);
+
+        if (FRAMES < found) {
+                printf("  unexpected: more frames than sent\n");
+
+                success = false;
+
+        } else if (lost > impaired) {
+                printf("  unexpected: more frames lost than impaired\n");
+
+                success = false;
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Get a monotonic time
+ *
+ * @return              double              Time (in seconds)
+ */
+static double now_s(void)
+{
+        struct timespec now;
+
+        (void)clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
@@ -0,0 +1,468 @@
+/*!
+ *******************************************************************************
+ * @file mh_z19_parser_fuzz.c
+ *
+ * @brief Fuzz harness of the MH-Z19 frame parser
+ *
+ * `LLVMFuzzerTestOneInput` takes the input as a script of parser calls: each
+ * operation byte pushes a run of the following bytes, pushes a valid frame,
+ * pops a frame or flushes the parser. After every call it checks:
+ * - The ring stays within its buffer, and a push takes every byte that fits
+ * - Every byte pushed is either popped in a frame, discarded, flushed or
+ *   still buffered
+ * - Each byte discarded is counted as exactly one error, and the counters
+ *   never go back
+ * - Popped frames start with the start byte, carry the command asked for and
+ *   a valid check value, and a failed pop leaves nothing but the beginning of
+ *   a frame buffered
+ * - A valid frame pushed right after a flush is popped as is
+ *
+ * Built with `HOST_LIBFUZZER`, and Clang, it links against libFuzzer.
+ * Otherwise a `main` replays the files given as arguments, or runs inputs of
+ * a pseudo random generator, so it runs as a regular test.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "winsen_mh_z19_parser.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Start byte of every frame
+#define START_VALUE                         (0xFF)
+
+//! @brief Pseudo random inputs run without libFuzzer
+#define RANDOM_INPUTS                       (200000)
+
+//! @brief Largest size of a pseudo random input (in bytes)
+#define RANDOM_MAX_SIZE                     (256)
+
+//! @brief Largest size of an input file (in bytes)
+#define FILE_MAX_SIZE                       (1 << 20)
+
+//! @brief Abort if a condition doesn't hold, so libFuzzer reports the input
+#define CHECK(condition)                                                       \
+        do {                                                                   \
+                if (!(condition)) {                                            \
+                        printf("failed at line %d: %s\n",                      \
+                               __LINE__,                                       \
+                               #condition);                                    \
+                        abort();                                               \
+                }                                                              \
+        } while (0)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Parser calls an input is made of, chosen by the operation byte
+typedef enum {
+        //! @brief Push the next bytes, as many as the operation byte says
+        OPERATION_PUSH = 0,
+
+        //! @brief Push a valid frame, built from the next bytes
+        OPERATION_PUSH_FRAME,
+
+        //! @brief Pop a frame of any command
+        OPERATION_POP_ANY,
+
+        //! @brief Pop a frame of the command in the next byte
+        OPERATION_POP,
+
+        //! @brief Discard the buffered bytes
+        OPERATION_FLUSH,
+
+        OPERATION_COUNT,
+} operation_t;
+
+//! @brief Parser under test, and what it is expected to hold
+typedef struct {
+        //! @brief Parser instance
+        mh_z19_parser_t parser;
+
+        //! @brief Statistics after the last call
+        mh_z19_parser_stats_t stats;
+
+        //! @brief Bytes pushed
+        size_t pushed;
+
+        //! @brief Bytes popped in frames
+        size_t popped;
+
+        //! @brief Bytes discarded by flushes
+        size_t flushed;
+} fuzz_t;
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Run a script of parser calls
+int LLVMFuzzerTestOneInput(uint8_t const * p_data, size_t size);
+
+//! @brief Push bytes, checking every byte that fits is taken
+static void push(fuzz_t * const p_fuzz,
+                 uint8_t const * const p_data,
+                 size_t const size);
+
+//! @brief Push a valid frame, checking it is popped if the parser was empty
+static void push_frame(fuzz_t * const p_fuzz,
+                       uint8_t const * const p_payload,
+                       size_t const size);
+
+//! @brief Pop a frame, checking it is valid
+static void pop(fuzz_t * const p_fuzz, uint8_t const command);
+
+//! @brief Check the ring and the counters
+static void check_invariants(fuzz_t * const p_fuzz);
+
+//! @brief Get the check value of a frame
+static uint8_t check_value(uint8_t const * const p_frame);
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Run a script of parser calls
+ *
+ * @param[in]           p_data              Pointer to the script
+ * @param[in]           size                Size of the script
+ *
+ * @return              int                 Always 0, fails by aborting
+ */
+int LLVMFuzzerTestOneInput(uint8_t const * p_data, size_t size)
+{
+        fuzz_t fuzz;
+        size_t offset = 0;
+        size_t length;
+        uint8_t operation;
+
+        memset(&fuzz, 0, sizeof(fuzz));
+        mh_z19_parser_reset(&fuzz.parser);
+
+        while (size > offset) {
+                operation = p_data[offset++];
+                length = (size_t)(operation / OPERATION_COUNT) % 24;
+
+                if ((size - offset) < length) {
+                        length = size - offset;
+                }
+
+                switch ((operation_t)(operation % OPERATION_COUNT)) {
+                case OPERATION_PUSH:
+                        push(&fuzz, &p_data[offset], length);
+                        offset += length;
+                        break;
+                case OPERATION_PUSH_FRAME:
+                        push_frame(&fuzz, &p_data[offset], length);
+                        offset += length;
+                        break;
+                case OPERATION_POP_ANY:
+                        pop(&fuzz, MH_Z19_PARSER_ANY_COMMAND);
+                        break;
+                case OPERATION_POP:
+                        pop(&fuzz, (size > offset) ? p_data[offset++] : 0x86);
+                        break;
+                case OPERATION_FLUSH:
+                default:
+                        fuzz.flushed += fuzz.parser.count;
+                        mh_z19_parser_flush(&fuzz.parser);
+                        break;
+                }
+
+                check_invariants(&fuzz);
+        }
+
+        return 0;
+}
+
+#ifndef HOST_LIBFUZZER
+
+int main(int argc, char ** argv)
+{
+        static uint8_t input[FILE_MAX_SIZE];
+
+        uint32_t random = 12345;
+        FILE * p_file;
+        size_t size;
+        size_t i;
+        size_t j;
+        int arg;
+
+        // Replay the inputs given, such as a libFuzzer crash
+        for (arg = 1; argc > arg; ++arg) {
+                p_file = fopen(argv[arg], "rb");
+
+                if (NULL == p_file) {
+                        printf("%s can't be opened\n", argv[arg]);
+
+                        // Code style exception for the shake of readability
+                        return EXIT_FAILURE;
+                }
+
+                size = fread(input, 1, sizeof(input), p_file);
+                (void)fclose(p_file);
+
+                (void)LLVMFuzzerTestOneInput(input, size);
+        }
+
+        if (1 < argc) {
+                printf("%d inputs replayed\n", argc - 1);
+
+                // Code style exception for the shake of readability
+                return EXIT_SUCCESS;
+        }
+
+        // Start and command bytes are frequent, so frames show up often
+        for (i = 0; RANDOM_INPUTS > i; ++i) {
+                random = random * 1103515245U + 12345U;
+                size = (random >> 8) % RANDOM_MAX_SIZE;
+
+                for (j = 0; size > j; ++j) {
+                        random = random * 1103515245U + 12345U;
+
+                        switch ((random >> 8) % 8) {
+                        case 0:
+                                input[j] = START_VALUE;
+                                break;
+                        case 1:
+                                input[j] = 0x86;
+                                break;
+                        default:
+                                input[j] = (uint8_t)(random >> 16);
+                                break;
+                        }
+                }
+
+                (void)LLVMFuzzerTestOneInput(input, size);
+        }
+
+        printf("%d random inputs run, passed\n", RANDOM_INPUTS);
+
+        return EXIT_SUCCESS;
+}
+
+#endif //HOST_LIBFUZZER
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Push bytes, checking every byte that fits is taken
+ *
+ * @param[in,out]       p_fuzz              Pointer to the parser under test
+ * @param[in]           p_data              Pointer to the bytes
+ * @param[in]           size                Amount of bytes
+ *
+ * @return              -                   -
+ */
+static void push(fuzz_t * const p_fuzz,
+                 uint8_t const * const p_data,
+                 size_t const size)
+{
+        size_t const room = MH_Z19_PARSER_BUFFER_SIZE - p_fuzz->parser.count;
+        size_t const expected = (size < room) ? size : room;
+
+        size_t accepted;
+
+        accepted = mh_z19_parser_push(&p_fuzz->parser, p_data, size);
+
+        CHECK(expected == accepted);
+
+        p_fuzz->pushed += accepted;
+}
+
+/*!
+ * @brief Push a valid frame, checking it is popped if the parser was empty
+ *
+ * @param[in,out]       p_fuzz              Pointer to the parser under test
+ * @param[in]           p_payload           Pointer to the command and data
+ *                                          bytes of the frame
+ * @param[in]           size                Amount of bytes at `p_payload`,
+ *                                          missing ones are zero
+ *
+ * @return              -                   -
+ */
+static void push_frame(fuzz_t * const p_fuzz,
+                       uint8_t const * const p_payload,
+                       size_t const size)
+{
+        uint8_t frame[MH_Z19_PARSER_FRAME_SIZE] = {START_VALUE};
+        uint8_t popped[MH_Z19_PARSER_FRAME_SIZE];
+        bool const is_empty = (0 == p_fuzz->parser.count);
+
+        memcpy(&frame[1],
+               p_payload,
+               (MH_Z19_PARSER_FRAME_SIZE - 2 < size) ?
+               MH_Z19_PARSER_FRAME_SIZE - 2 : size);
+
+        frame[MH_Z19_PARSER_FRAME_SIZE - 1] = check_value(frame);
+
+        push(p_fuzz, frame, sizeof(frame));
+
+        if (is_empty) {
+                CHECK(mh_z19_parser_pop_frame(&p_fuzz->parser,
+                                              frame[1],
+                                              popped));
+                CHECK(0 == memcmp(frame, popped, sizeof(frame)));
+
+                p_fuzz->popped += sizeof(frame);
+        }
+}
+
+/*!
+ * @brief Pop a frame, checking it is valid
+ *
+ * @param[in,out]       p_fuzz              Pointer to the parser under test
+ * @param[in]           command             Command the frame has to carry, or
+ *                                          `MH_Z19_PARSER_ANY_COMMAND`
+ *
+ * @return              -                   -
+ */
+static void pop(fuzz_t * const p_fuzz, uint8_t const command)
+{
+        mh_z19_parser_t const * const p_parser = &p_fuzz->parser;
+
+        uint8_t frame[MH_Z19_PARSER_FRAME_SIZE];
+
+        if (mh_z19_parser_pop_frame(&p_fuzz->parser, command, frame)) {
+                CHECK(START_VALUE == frame[0]);
+                CHECK((MH_Z19_PARSER_ANY_COMMAND == command) ||
+                      (command == frame[1]));
+                CHECK(check_value(frame) ==
+                      frame[MH_Z19_PARSER_FRAME_SIZE - 1]);
+
+                p_fuzz->popped += sizeof(frame);
+
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        // Only the beginning of a frame is kept, waiting for the rest of it
+        CHECK(MH_Z19_PARSER_FRAME_SIZE > p_parser->count);
+
+        if (0 != p_parser->count) {
+                CHECK(START_VALUE == p_parser->buffer[p_parser->head]);
+        }
+
+        if ((1 < p_parser->count) &&
+            (MH_Z19_PARSER_ANY_COMMAND != command)) {
+
+                CHECK(command ==
+                      p_parser->buffer[(p_parser->head + 1) %
+                                       MH_Z19_PARSER_BUFFER_SIZE]);
+        }
+}
+
+/*!
+ * @brief Check the ring and the counters
+ *
+ * @param[in,out]       p_fuzz              Pointer to the parser under test
+ *
+ * @return              -                   -
+ */
+static void check_invariants(fuzz_t * const p_fuzz)
+{
+        mh_z19_parser_t const * const p_parser = &p_fuzz->parser;
+        mh_z19_parser_stats_t const * const p_last = &p_fuzz->stats;
+
+        mh_z19_parser_stats_t stats;
+        size_t needed;
+
+        mh_z19_parser_get_stats(p_parser, &stats);
+        needed = mh_z19_parser_bytes_needed(p_parser);
+
+        CHECK(MH_Z19_PARSER_BUFFER_SIZE > p_parser->head);
+        CHECK(MH_Z19_PARSER_BUFFER_SIZE >= p_parser->count);
+
+        CHECK(p_fuzz->pushed == (p_fuzz->popped +
+                                 stats.discarded_bytes +
+                                 p_fuzz->flushed +
+                                 p_parser->count));
+
+        CHECK(stats.discarded_bytes == (stats.start_byte_errors +
+                                        stats.command_errors +
+                                        stats.checksum_errors));
+
+        CHECK(stats.resyncs <= stats.discarded_bytes);
+
+        CHECK(stats.discarded_bytes >= p_last->discarded_bytes);
+        CHECK(stats.resyncs >= p_last->resyncs);
+        CHECK(stats.start_byte_errors >= p_last->start_byte_errors);
+        CHECK(stats.command_errors >= p_last->command_errors);
+        CHECK(stats.checksum_errors >= p_last->checksum_errors);
+
+        CHECK(((MH_Z19_PARSER_FRAME_SIZE <= p_parser->count) &&
+               (MH_Z19_PARSER_FRAME_SIZE == needed)) ||
+              ((MH_Z19_PARSER_FRAME_SIZE > p_parser->count) &&
+               (MH_Z19_PARSER_FRAME_SIZE - p_parser->count == needed)));
+
+        p_fuzz->stats = stats;
+}
+
+/*!
+ * @brief Get the check value of a frame
+ *
+ * check_value = inv(byte_1 + byte_2 + ... + byte_7) + 1
+ *
+ * @param[in]           p_frame             Pointer to the frame
+ *
+ * @return              uint8_t             Check value
+ */
+static uint8_t check_value(uint8_t const * const p_frame)
+{
+        uint8_t sum = 0x00;
+        size_t i;
+
+        for (i = 1; MH_Z19_PARSER_FRAME_SIZE - 1 > i; ++i) {
+                // Overflow is meant to happen
+                sum += p_frame[i];
+        }
+
+        return (uint8_t)(~sum + 1);
+}
@@ -0,0 +1,370 @@
+/*!
+ *******************************************************************************
+ * @file mqtt_mosquitto_test.c
+ *
+ * @brief Host test of the MQTT transport against a Mosquitto broker
+ *
+ * Runs `mqtt.c` over libmosquitto against a local broker standing in for
+ * Thingsboard, such as one started with `mosquitto -p 1883`, or the one at
+ * the `MQTT_BROKER_URI` environment variable. A second client subscribes to
+ * the telemetry topic, and the test checks every at least once message
+ * reaches it and is acknowledged, alarms included.
+ *
+ * Skipped if no broker can be reached.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <mosquitto.h>
+
+#include "sdkconfig.h"
+#include "display.h"
+#include "device_state.h"
+#include "mqtt.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Topic `mqtt.c` publishes to
+#define TOPIC                               "v1/devices/me/telemetry"
+
+//! @brief Broker used if `MQTT_BROKER_URI` isn't set, host and port
+#define DEFAULT_HOST                        "localhost"
+#define DEFAULT_PORT                        (1883)
+
+//! @brief Exit code telling CTest the test was skipped
+#define EXIT_SKIPPED                        (77)
+
+//! @brief Time to wait for the connection and the deliveries (in
+//!        milliseconds)
+#define TIMEOUT_MS                          (5000)
+
+//! @brief Time between checks while waiting (in milliseconds)
+#define POLL_MS                             (10)
+
+//! @brief Messages published of each kind
+#define TELEMETRY_COUNT                     (20)
+#define EVENT_COUNT                         (8)
+#define ALARM_COUNT                         (MQTT_URGENT_IN_FLIGHT)
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Start the client subscribed to the telemetry topic
+static struct mosquitto * subscribe(void);
+
+//! @brief Count the messages received by the subscriber
+static void on_message(struct mosquitto * p_mosquitto,
+                       void * p_context,
+                       struct mosquitto_message const * p_message);
+
+//! @brief Count the subscriptions acknowledged
+static void on_subscribe(struct mosquitto * p_mosquitto,
+                         void * p_context,
+                         int mid,
+                         int qos_count,
+                         int const * p_granted_qos);
+
+//! @brief Wait until the transport has connected and acknowledged messages
+static bool wait_for(uint32_t const connections, uint32_t const acknowledged);
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Messages received by the subscriber
+static volatile uint32_t m_received = 0;
+
+//! @brief Whether the subscription was acknowledged
+static volatile bool m_is_subscribed = false;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+int main(void)
+{
+        struct mosquitto * p_subscriber;
+        mqtt_stats_t stats;
+        char payload[64];
+        uint32_t i;
+        bool success;
+
+        p_subscriber = subscribe();
+
+        if (NULL == p_subscriber) {
+                printf("no broker reachable, skipped\n");
+
+                // Code style exception for the shake of readability
+                return EXIT_SKIPPED;
+        }
+
+        success = mqtt_init() && wait_for(1, 0);
+
+        for (i = 0; (success) && (TELEMETRY_COUNT > i); ++i) {
+                (void)snprintf(payload,
+                               sizeof(payload),
+                               "{\"co2_concentration\": %u}",
+                               (unsigned int)(800 + i));
+
+                success = mqtt_publish(payload, MQTT_QOS_AT_MOST_ONCE, false);
+        }
+
+        for (i = 0; (success) && (EVENT_COUNT > i); ++i) {
+                (void)snprintf(payload,
+                               sizeof(payload),
+                               "{\"ventilation_ach\": %u.00}",
+                               (unsigned int)i);
+
+                success = mqtt_publish(payload, MQTT_QOS_AT_LEAST_ONCE, false);
+        }
+
+        for (i = 0; (success) && (ALARM_COUNT > i); ++i) {
+                (void)snprintf(payload,
+                               sizeof(payload),
+                               "{\"co2_alarm\": %u}",
+                               (unsigned int)(i % 3));
+
+                success = mqtt_publish(payload, MQTT_QOS_AT_LEAST_ONCE, true);
+        }
+
+        success = success && wait_for(1, EVENT_COUNT + ALARM_COUNT);
+
+        // At most once messages may be lost, even on a local broker
+        for (i = 0;
+             (TIMEOUT_MS / POLL_MS > i) &&
+             (TELEMETRY_COUNT + EVENT_COUNT + ALARM_COUNT > m_received);
+             ++i) {
+                (void)usleep(POLL_MS * 1000);
+        }
+
+        (void)mqtt_get_stats(&stats);
+
+        printf("published: %u, acknowledged: %u, in flight: %u, dropped: %u, "
+               "received: %u of %u\n",
+               stats.published,
+               stats.acknowledged,
+               stats.in_flight,
+               stats.dropped,
+               m_received,
+               TELEMETRY_COUNT + EVENT_COUNT + ALARM_COUNT);
+
+        success = success &&
+                  (0 == stats.in_flight) &&
+                  (0 == stats.dropped) &&
+                  (EVENT_COUNT + ALARM_COUNT <= m_received);
+
+        (void)mosquitto_loop_stop(p_subscriber, true);
+        mosquitto_destroy(p_subscriber);
+
+        printf("%s\n", (success) ? "passed" : "failed");
+
+        return (success) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*!
+ * @brief Stand-in of the display link status, not used
+ *
+ * @param[in]           linked              Whether the server is reachable
+ *
+ * @return              bool                Operation result
+ */
+bool display_set_link_status(bool const linked)
+{
+        (void)linked;
+
+        return true;
+}
+
+/*!
+ * @brief Stand-in of the device state link status, not used
+ *
+ * @param[in]           linked              Whether the server is reachable
+ *
+ * @return              -                   -
+ */
+void device_state_set_link(bool const linked)
+{
+        (void)linked;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Start the client subscribed to the telemetry topic
+ *
+ * Connects to the broker at `MQTT_BROKER_URI`, `mqtt://host[:port]`, or to
+ * the local one.
+ *
+ * @return              struct mosquitto *  Client, NULL if the broker can't
+ *                                          be reached
+ */
+static struct mosquitto * subscribe(void)
+{
+        char const * const p_uri = getenv("MQTT_BROKER_URI");
+
+        struct mosquitto * p_subscriber;
+        char host[128] = DEFAULT_HOST;
+        int port = DEFAULT_PORT;
+        char const * p_colon;
+        uint32_t i;
+        bool success;
+
+        if ((NULL != p_uri) && (0 == strncmp(p_uri, "mqtt://", 7))) {
+                (void)snprintf(host, sizeof(host), "%s", p_uri + 7);
+                p_colon = strchr(p_uri + 7, ':');
+
+                if (NULL != p_colon) {
+                        host[p_colon - (p_uri + 7)] = '\0';
+                        port = atoi(p_colon + 1);
+                }
+        }
+
+        (void)mosquitto_lib_init();
+
+        p_subscriber = mosquitto_new(NULL, true, NULL);
+        success = (NULL != p_subscriber);
+
+        if (success) {
+                mosquitto_message_callback_set(p_subscriber, on_message);
+                mosquitto_subscribe_callback_set(p_subscriber, on_subscribe);
+
+                success = ((MOSQ_ERR_SUCCESS == mosquitto_connect(p_subscriber,
+                                                                  host,
+                                                                  port,
+                                                                  60)) &&
+                           (MOSQ_ERR_SUCCESS == mosquitto_subscribe(p_subscriber,
+                                                                    NULL,
+                                                                    TOPIC,
+                                                                    1)) &&
+                           (MOSQ_ERR_SUCCESS == mosquitto_loop_start(
+                                   p_subscriber)));
+        }
+
+        for (i = 0; (success) && (!m_is_subscribed) &&
+                    (TIMEOUT_MS / POLL_MS > i); ++i) {
+                (void)usleep(POLL_MS * 1000);
+        }
+
+        if ((!success) || (!m_is_subscribed)) {
+                if (NULL != p_subscriber) {
+                        mosquitto_destroy(p_subscriber);
+                }
+
+                p_subscriber = NULL;
+        }
+
+        return p_subscriber;
+}
+
+/*!
+ * @brief Count the messages received by the subscriber
+ *
+ * @param               p_mosquitto         Not used
+ * @param               p_context           Not used
+ * @param               p_message           Not used
+ *
+ * @return              -                   -
+ */
+static void on_message(struct mosquitto * p_mosquitto,
+                       void * p_context,
+                       struct mosquitto_message const * p_message)
+{
+        (void)p_mosquitto;
+        (void)p_context;
+        (void)p_message;
+
+        ++m_received;
+}
+
+/*!
+ * @brief Count the subscriptions acknowledged
+ *
+ * @param               p_mosquitto         Not used
+ * @param               p_context           Not used
+ * @param               mid                 Not used
+ * @param               qos_count           Not used
+ * @param               p_granted_qos       Not used
+ *
+ * @return              -                   -
+ */
+static void on_subscribe(struct mosquitto * p_mosquitto,
+                         void * p_context,
+                         int mid,
+                         int qos_count,
+                         int const * p_granted_qos)
+{
+        (void)p_mosquitto;
+        (void)p_context;
+        (void)mid;
+        (void)qos_count;
+        (void)p_granted_qos;
+
+        m_is_subscribed = true;
+}
+
+/*!
+ * @brief Wait until the transport has connected and acknowledged messages
+ *
+ * @param[in]           connections         Connections to wait for
+ * @param[in]           acknowledged        Acknowledgements to wait for
+ *
+ * @return              bool                False on timeout
+ */
+static bool wait_for(uint32_t const connections, uint32_t const acknowledged)
+{
+        mqtt_stats_t stats = {0};
+        uint32_t i;
+
+        for (i = 0; TIMEOUT_MS / POLL_MS > i; ++i) {
+                (void)mqtt_get_stats(&stats);
+
+                if ((connections <= stats.connections) &&
+                    (acknowledged <= stats.acknowledged)) {
+                        // Code style exception for the shake of readability
+                        return true;
+                }
+
+                (void)usleep(POLL_MS * 1000);
+        }
+
+        printf("timed out: %u connections, %u acknowledged\n",
+               stats.connections,
+               stats.acknowledged);
+
+        return false;
+}
@@ -0,0 +1,247 @@
+/*!
+ *******************************************************************************
+ * @file mqtt_test.c
+ *
+ * @brief Host test of the MQTT transport against a fake broker
+ *
+ * Runs `mqtt.c` against the in-process fake of the MQTT client, and checks
+ * the delivery guarantees: at most once messages are refused while
+ * disconnected, at least once messages are kept until acknowledged, up to
+ * the in flight limit, with some slots only urgent messages can take, and
+ * the link status follows the connection.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mqtt_client_fake.h"
+#include "display.h"
+#include "device_state.h"
+#include "mqtt.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Routine telemetry
+#define TELEMETRY                           "{\"co2_concentration\": 800}"
+
+//! @brief Alarm level change
+#define ALARM                               "{\"co2_alarm\": 2, \"co2_alarm_ppm\": 1500}"
+
+//! @brief Check a condition, reporting it if it doesn't hold
+#define CHECK(condition)                                                       \
+        do {                                                                   \
+                if (!(condition)) {                                            \
+                        printf("  failed at line %d: %s\n",                    \
+                               __LINE__,                                       \
+                               #condition);                                    \
+                        m_is_failed = true;                                    \
+                }                                                              \
+        } while (0)
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Publish a message until it is refused
+static uint32_t publish_until_refused(char const * const p_payload,
+                                      mqtt_qos_t const qos,
+                                      bool const is_urgent);
+
+//! @brief Get the connection counters
+static mqtt_stats_t get_stats(void);
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Link status last reported to the display
+static bool m_is_linked = false;
+
+//! @brief Whether any check failed
+static bool m_is_failed = false;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+int main(void)
+{
+        mqtt_stats_t stats;
+        uint32_t accepted;
+
+        CHECK(mqtt_init());
+
+        // Disconnected: routine telemetry is refused, at least once messages
+        // queue up to the in flight limit, the last slots only for alarms
+        printf("disconnected\n");
+
+        CHECK(!mqtt_publish(TELEMETRY, MQTT_QOS_AT_MOST_ONCE, false));
+
+        accepted = publish_until_refused(TELEMETRY,
+                                         MQTT_QOS_AT_LEAST_ONCE,
+                                         false);
+
+        CHECK(MQTT_MAX_IN_FLIGHT - MQTT_URGENT_IN_FLIGHT == accepted);
+
+        accepted = publish_until_refused(ALARM, MQTT_QOS_AT_LEAST_ONCE, true);
+
+        CHECK(MQTT_URGENT_IN_FLIGHT == accepted);
+        CHECK(0 == mqtt_client_fake_get_received());
+        CHECK(!m_is_linked);
+
+        stats = get_stats();
+
+        CHECK(MQTT_MAX_IN_FLIGHT == stats.in_flight);
+        CHECK(MQTT_MAX_IN_FLIGHT == stats.published);
+        CHECK(3 == stats.dropped);
+
+        // Connected: the outbox is sent, and acknowledged
+        printf("connected\n");
+
+        CHECK(mqtt_client_fake_set_connected(true));
+        CHECK(m_is_linked);
+        CHECK(MQTT_MAX_IN_FLIGHT == mqtt_client_fake_get_received());
+        CHECK(MQTT_MAX_IN_FLIGHT == mqtt_client_fake_acknowledge());
+
+        stats = get_stats();
+
+        CHECK(0 == stats.in_flight);
+        CHECK(MQTT_MAX_IN_FLIGHT == stats.acknowledged);
+        CHECK(1 == stats.connections);
+
+        CHECK(mqtt_publish(TELEMETRY, MQTT_QOS_AT_MOST_ONCE, false));
+        CHECK(mqtt_publish(ALARM, MQTT_QOS_AT_LEAST_ONCE, true));
+        CHECK(MQTT_MAX_IN_FLIGHT + 2 == mqtt_client_fake_get_received());
+
+        // Alarms in flight don't take the slots of routine messages
+        accepted = publish_until_refused(TELEMETRY,
+                                         MQTT_QOS_AT_LEAST_ONCE,
+                                         false);
+
+        CHECK(MQTT_MAX_IN_FLIGHT - MQTT_URGENT_IN_FLIGHT - 1 == accepted);
+
+        // Expired messages leave the flight as dropped
+        printf("expired\n");
+
+        CHECK(MQTT_MAX_IN_FLIGHT - MQTT_URGENT_IN_FLIGHT ==
+              mqtt_client_fake_expire());
+
+        stats = get_stats();
+
+        CHECK(0 == stats.in_flight);
+        CHECK(MQTT_MAX_IN_FLIGHT == stats.acknowledged);
+        CHECK(3 + 1 + (MQTT_MAX_IN_FLIGHT - MQTT_URGENT_IN_FLIGHT) ==
+              stats.dropped);
+
+        // Disconnected again
+        printf("reconnected\n");
+
+        CHECK(mqtt_client_fake_set_connected(false));
+        CHECK(!m_is_linked);
+        CHECK(!mqtt_publish(TELEMETRY, MQTT_QOS_AT_MOST_ONCE, false));
+        CHECK(mqtt_publish(ALARM, MQTT_QOS_AT_LEAST_ONCE, true));
+        CHECK(mqtt_client_fake_set_connected(true));
+        CHECK(m_is_linked);
+        CHECK(1 == mqtt_client_fake_acknowledge());
+        CHECK(2 == get_stats().connections);
+
+        printf("%s\n", (m_is_failed) ? "failed" : "passed");
+
+        return (m_is_failed) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*!
+ * @brief Stand-in of the display link status, records it
+ *
+ * @param[in]           linked              Whether the server is reachable
+ *
+ * @return              bool                Operation result
+ */
+bool display_set_link_status(bool const linked)
+{
+        m_is_linked = linked;
+
+        return true;
+}
+
+/*!
+ * @brief Stand-in of the device state link status, not used
+ *
+ * @param[in]           linked              Whether the server is reachable
+ *
+ * @return              -                   -
+ */
+void device_state_set_link(bool const linked)
+{
+        (void)linked;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Publish a message until it is refused
+ *
+ * @param[in]           p_payload           JSON telemetry, null terminated
+ * @param[in]           qos                 Delivery guarantee
+ * @param[in]           is_urgent           Whether the message is urgent
+ *
+ * @return              uint32_t            Times it was accepted
+ */
+static uint32_t publish_until_refused(char const * const p_payload,
+                                      mqtt_qos_t const qos,
+                                      bool const is_urgent)
+{
+        uint32_t accepted = 0;
+
+        while ((MQTT_MAX_IN_FLIGHT >= accepted) &&
+               (mqtt_publish(p_payload, qos, is_urgent))) {
+                ++accepted;
+        }
+
+        return accepted;
+}
+
+/*!
+ * @brief Get the connection counters
+ *
+ * @return              mqtt_stats_t        Connection counters
+ */
+static mqtt_stats_t get_stats(void)
+{
+        mqtt_stats_t stats = {0};
+
+        (void)mqtt_get_stats(&stats);
+
+        return stats;
+}
@@ -0,0 +1,142 @@
+/*!
+ *******************************************************************************
+ * @file uart.h
+ *
+ * @brief Host stand-in of the ESP-IDF UART driver definitions
+ *
+ * Only what the sensor transport uses. Implemented by `uart_fake.c`.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef UART_H
+#define UART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+#define UART_NUM_0                          (0)
+#define UART_NUM_1                          (1)
+#define UART_NUM_2                          (2)
+#define UART_NUM_MAX                        (3)
+
+#define UART_PIN_NO_CHANGE                  (-1)
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+typedef int uart_port_t;
+
+typedef enum {
+        UART_DATA_5_BITS = 0,
+        UART_DATA_6_BITS,
+        UART_DATA_7_BITS,
+        UART_DATA_8_BITS,
+} uart_word_length_t;
+
+typedef enum {
+        UART_PARITY_DISABLE = 0,
+        UART_PARITY_EVEN = 2,
+        UART_PARITY_ODD,
+} uart_parity_t;
+
+typedef enum {
+        UART_STOP_BITS_1 = 1,
+        UART_STOP_BITS_1_5,
+        UART_STOP_BITS_2,
+} uart_stop_bits_t;
+
+typedef enum {
+        UART_HW_FLOWCTRL_DISABLE = 0,
+        UART_HW_FLOWCTRL_RTS,
+        UART_HW_FLOWCTRL_CTS,
+        UART_HW_FLOWCTRL_CTS_RTS,
+} uart_hw_flowcontrol_t;
+
+typedef struct {
+        int baud_rate;
+        uart_word_length_t data_bits;
+        uart_parity_t parity;
+        uart_stop_bits_t stop_bits;
+        uart_hw_flowcontrol_t flow_ctrl;
+        uint8_t rx_flow_ctrl_thresh;
+} uart_config_t;
+
+typedef enum {
+        UART_DATA = 0,
+        UART_BREAK,
+        UART_BUFFER_FULL,
+        UART_FIFO_OVF,
+        UART_FRAME_ERR,
+        UART_PARITY_ERR,
+        UART_DATA_BREAK,
+        UART_PATTERN_DET,
+        UART_EVENT_MAX,
+} uart_event_type_t;
+
+typedef struct {
+        uart_event_type_t type;
+        size_t size;
+        bool timeout_flag;
+} uart_event_t;
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+esp_err_t uart_set_pin(uart_port_t const port,
+                       int const tx_pin,
+                       int const rx_pin,
+                       int const rts_pin,
+                       int const cts_pin);
+
+esp_err_t uart_param_config(uart_port_t const port,
+                            uart_config_t const * const p_config);
+
+esp_err_t uart_driver_install(uart_port_t const port,
+                              int const rx_buffer_size,
+                              int const tx_buffer_size,
+                              int const queue_size,
+                              QueueHandle_t * const p_queue,
+                              int const intr_alloc_flags);
+
+esp_err_t uart_set_rx_full_threshold(uart_port_t const port,
+                                     int const threshold);
+
+esp_err_t uart_set_rx_timeout(uart_port_t const port,
+                              uint8_t const timeout_symbols);
+
+int uart_read_bytes(uart_port_t const port,
+                    void * const p_buffer,
+                    uint32_t const length,
+                    TickType_t const wait_ticks);
+
+int uart_write_bytes(uart_port_t const port,
+                     void const * const p_data,
+                     size_t const size);
+
+esp_err_t uart_flush_input(uart_port_t const port);
+
+#endif //UART_H
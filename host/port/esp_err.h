@@ -0,0 +1,24 @@
+/*!
+ *******************************************************************************
+ * @file esp_err.h
+ *
+ * @brief Host stand-in of the ESP-IDF error codes
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef ESP_ERR_H
+#define ESP_ERR_H
+
+typedef int esp_err_t;
+
+#define ESP_OK                              (0)
+#define ESP_FAIL                            (-1)
+
+#endif //ESP_ERR_H
@@ -0,0 +1,44 @@
+/*!
+ *******************************************************************************
+ * @file esp_log.h
+ *
+ * @brief Host stand-in of the ESP-IDF logging, to the standard error
+ *
+ * Debug and verbose messages are left out.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+#include <stdio.h>
+
+#define ESP_LOG_PRINT(level, tag, format, ...)                                 \
+        fprintf(stderr, level " (%s): " format "\n", tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, format, ...)  ESP_LOG_PRINT("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)  ESP_LOG_PRINT("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)  ESP_LOG_PRINT("I", tag, format, ##__VA_ARGS__)
+// Compiled out, but still using their arguments
+#define ESP_LOGD(tag, format, ...)                                             \
+        do {                                                                   \
+                if (0) {                                                       \
+                        ESP_LOG_PRINT("D", tag, format, ##__VA_ARGS__);        \
+                }                                                              \
+        } while (0)
+
+#define ESP_LOGV(tag, format, ...)                                             \
+        do {                                                                   \
+                if (0) {                                                       \
+                        ESP_LOG_PRINT("V", tag, format, ##__VA_ARGS__);        \
+                }                                                              \
+        } while (0)
+
+#endif //ESP_LOG_H
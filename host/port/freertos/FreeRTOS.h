@@ -0,0 +1,45 @@
+/*!
+ *******************************************************************************
+ * @file FreeRTOS.h
+ *
+ * @brief Host stand-in of the FreeRTOS kernel definitions
+ *
+ * Critical sections are backed by a mutex, as host threads may run in
+ * parallel like the ESP32 cores. Ticks last a millisecond.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE                             (0)
+#define pdTRUE                              (1)
+#define pdFAIL                              (pdFALSE)
+#define pdPASS                              (pdTRUE)
+
+//! @brief Ticks last a millisecond
+#define portTICK_PERIOD_MS                  (1)
+#define portMAX_DELAY                       ((TickType_t)0xFFFFFFFFUL)
+#define pdMS_TO_TICKS(time_ms)              ((TickType_t)(time_ms))
+
+typedef pthread_mutex_t portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED        PTHREAD_MUTEX_INITIALIZER
+#define portENTER_CRITICAL(p_mux)           ((void)pthread_mutex_lock(p_mux))
+#define portEXIT_CRITICAL(p_mux)            ((void)pthread_mutex_unlock(p_mux))
+
+#endif //FREERTOS_H
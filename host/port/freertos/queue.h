@@ -0,0 +1,48 @@
+/*!
+ *******************************************************************************
+ * @file queue.h
+ *
+ * @brief Host stand-in of the FreeRTOS queue definitions
+ *
+ * Implemented by `freertos_fake.c`, over POSIX threads.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef void * QueueHandle_t;
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Create a queue
+QueueHandle_t xQueueCreate(UBaseType_t const length,
+                           UBaseType_t const item_size);
+
+//! @brief Send an item to the back of a queue
+BaseType_t xQueueSend(QueueHandle_t const queue,
+                      void const * const p_item,
+                      TickType_t const wait);
+
+//! @brief Receive an item from a queue
+BaseType_t xQueueReceive(QueueHandle_t const queue,
+                         void * const p_item,
+                         TickType_t const wait);
+
+//! @brief Empty a queue
+BaseType_t xQueueReset(QueueHandle_t const queue);
+
+#endif //QUEUE_H
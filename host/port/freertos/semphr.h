@@ -0,0 +1,30 @@
+/*!
+ *******************************************************************************
+ * @file semphr.h
+ *
+ * @brief Host stand-in of the FreeRTOS semaphore definitions
+ *
+ * As in FreeRTOS, semaphores are queues of items without data.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef SEMPHR_H
+#define SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define xSemaphoreCreateBinary()            xQueueCreate(1, 0)
+#define xSemaphoreTake(semaphore, wait)     xQueueReceive((semaphore), NULL, (wait))
+#define xSemaphoreGive(semaphore)           xQueueSend((semaphore), NULL, 0)
+
+#endif //SEMPHR_H
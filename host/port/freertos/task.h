@@ -0,0 +1,41 @@
+/*!
+ *******************************************************************************
+ * @file task.h
+ *
+ * @brief Host stand-in of the FreeRTOS task definitions
+ *
+ * Implemented by `freertos_fake.c`, over POSIX threads.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef TASK_H
+#define TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef void * TaskHandle_t;
+
+typedef void (* TaskFunction_t)(void * p_parameters);
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Create a task, run by a thread of its own
+BaseType_t xTaskCreate(TaskFunction_t const task,
+                       char const * const p_name,
+                       uint32_t const stack_depth,
+                       void * const p_parameters,
+                       UBaseType_t const priority,
+                       TaskHandle_t * const p_handle);
+
+#endif //TASK_H
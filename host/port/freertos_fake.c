@@ -0,0 +1,367 @@
+/*!
+ *******************************************************************************
+ * @file freertos_fake.c
+ *
+ * @brief Host stand-in of the FreeRTOS queues and tasks, over POSIX threads
+ *
+ * Queues are a ring of items, protected by a mutex, with a condition
+ * variable to wait on. Semaphores are queues of items without data, as in
+ * FreeRTOS. Each task runs in a thread of its own, its stack depth and
+ * priority are ignored.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Queue instance
+typedef struct {
+        //! @brief Protects the queue
+        pthread_mutex_t mutex;
+
+        //! @brief Signaled when an item is sent or received
+        pthread_cond_t changed;
+
+        //! @brief Items the queue can hold
+        UBaseType_t length;
+
+        //! @brief Size of an item (in bytes)
+        UBaseType_t item_size;
+
+        //! @brief Index of the oldest item
+        UBaseType_t head;
+
+        //! @brief Amount of items held
+        UBaseType_t count;
+
+        //! @brief Items, `length * item_size` bytes
+        uint8_t * p_items;
+} queue_t;
+
+//! @brief Task to start in a thread
+typedef struct {
+        //! @brief Task function
+        TaskFunction_t task;
+
+        //! @brief Parameter passed to `task`
+        void * p_parameters;
+} task_t;
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Wait on a queue until it changes or the wait expires
+static bool wait(queue_t * const p_queue,
+                 struct timespec const * const p_deadline,
+                 TickType_t const wait_ticks);
+
+//! @brief Run a task
+static void * task_run(void * p_argument);
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Create a queue
+ *
+ * @param[in]           length              Items the queue can hold
+ * @param[in]           item_size           Size of an item (in bytes)
+ *
+ * @return              QueueHandle_t       Queue, NULL on error
+ */
+QueueHandle_t xQueueCreate(UBaseType_t const length,
+                           UBaseType_t const item_size)
+{
+        queue_t * p_queue;
+
+        p_queue = calloc(1, sizeof(*p_queue));
+
+        if (NULL == p_queue) {
+                // Code style exception for the shake of readability
+                return NULL;
+        }
+
+        (void)pthread_mutex_init(&p_queue->mutex, NULL);
+        (void)pthread_cond_init(&p_queue->changed, NULL);
+        p_queue->length = length;
+        p_queue->item_size = item_size;
+        p_queue->p_items = calloc(length, (0 != item_size) ? item_size : 1);
+
+        if (NULL == p_queue->p_items) {
+                free(p_queue);
+                p_queue = NULL;
+        }
+
+        return p_queue;
+}
+
+/*!
+ * @brief Send an item to the back of a queue
+ *
+ * @param[in]           queue               Queue
+ * @param[in]           p_item              Pointer to the item
+ * @param[in]           wait_ticks          Time to wait for room (in ticks)
+ *
+ * @return              BaseType_t          `pdTRUE` if sent, `pdFALSE`
+ *                                          otherwise
+ */
+BaseType_t xQueueSend(QueueHandle_t const queue,
+                      void const * const p_item,
+                      TickType_t const wait_ticks)
+{
+        queue_t * const p_queue = (queue_t *)queue;
+
+        struct timespec deadline;
+        bool is_sent = false;
+        UBaseType_t tail;
+
+        (void)clock_gettime(CLOCK_REALTIME, &deadline);
+        (void)pthread_mutex_lock(&p_queue->mutex);
+
+        while ((p_queue->length <= p_queue->count) &&
+               (wait(p_queue, &deadline, wait_ticks))) {
+                // Wait for room
+        }
+
+        if (p_queue->length > p_queue->count) {
+                tail = (p_queue->head + p_queue->count) % p_queue->length;
+
+                if (0 != p_queue->item_size) {
+                        memcpy(&p_queue->p_items[tail * p_queue->item_size],
+                               p_item,
+                               p_queue->item_size);
+                }
+
+                ++p_queue->count;
+                is_sent = true;
+
+                (void)pthread_cond_broadcast(&p_queue->changed);
+        }
+
+        (void)pthread_mutex_unlock(&p_queue->mutex);
+
+        return (is_sent) ? pdTRUE : pdFALSE;
+}
+
+/*!
+ * @brief Receive an item from a queue
+ *
+ * @param[in]           queue               Queue
+ * @param[out]          p_item              Pointer where to copy the item
+ * @param[in]           wait_ticks          Time to wait for an item (in ticks)
+ *
+ * @return              BaseType_t          `pdTRUE` if received, `pdFALSE`
+ *                                          otherwise
+ */
+BaseType_t xQueueReceive(QueueHandle_t const queue,
+                         void * const p_item,
+                         TickType_t const wait_ticks)
+{
+        queue_t * const p_queue = (queue_t *)queue;
+
+        struct timespec deadline;
+        bool is_received = false;
+
+        (void)clock_gettime(CLOCK_REALTIME, &deadline);
+        (void)pthread_mutex_lock(&p_queue->mutex);
+
+        while ((0 == p_queue->count) &&
+               (wait(p_queue, &deadline, wait_ticks))) {
+                // Wait for an item
+        }
+
+        if (0 != p_queue->count) {
+                if (0 != p_queue->item_size) {
+                        memcpy(p_item,
+                               &p_queue->p_items[p_queue->head *
+                                                 p_queue->item_size],
+                               p_queue->item_size);
+                }
+
+                p_queue->head = (p_queue->head + 1) % p_queue->length;
+                --p_queue->count;
+                is_received = true;
+
+                (void)pthread_cond_broadcast(&p_queue->changed);
+        }
+
+        (void)pthread_mutex_unlock(&p_queue->mutex);
+
+        return (is_received) ? pdTRUE : pdFALSE;
+}
+
+/*!
+ * @brief Empty a queue
+ *
+ * @param[in]           queue               Queue
+ *
+ * @return              BaseType_t          Always `pdPASS`
+ */
+BaseType_t xQueueReset(QueueHandle_t const queue)
+{
+        queue_t * const p_queue = (queue_t *)queue;
+
+        (void)pthread_mutex_lock(&p_queue->mutex);
+        p_queue->head = 0;
+        p_queue->count = 0;
+        (void)pthread_cond_broadcast(&p_queue->changed);
+        (void)pthread_mutex_unlock(&p_queue->mutex);
+
+        return pdPASS;
+}
+
+/*!
+ * @brief Create a task, run by a thread of its own
+ *
+ * @param[in]           task                Task function
+ * @param               p_name              Not used
+ * @param               stack_depth         Not used
+ * @param[in]           p_parameters        Parameter passed to the task
+ * @param               priority            Not used
+ * @param[out]          p_handle            Pointer where to store the task
+ *                                          handle, may be NULL
+ *
+ * @return              BaseType_t          `pdPASS` if created, `pdFAIL`
+ *                                          otherwise
+ */
+BaseType_t xTaskCreate(TaskFunction_t const task,
+                       char const * const p_name,
+                       uint32_t const stack_depth,
+                       void * const p_parameters,
+                       UBaseType_t const priority,
+                       TaskHandle_t * const p_handle)
+{
+        task_t * p_task;
+        pthread_t thread;
+        bool success;
+
+        (void)p_name;
+        (void)stack_depth;
+        (void)priority;
+
+        p_task = malloc(sizeof(*p_task));
+        success = (NULL != p_task);
+
+        if (success) {
+                p_task->task = task;
+                p_task->p_parameters = p_parameters;
+
+                success = (0 == pthread_create(&thread, NULL, task_run, p_task));
+        }
+
+        if (success) {
+                (void)pthread_detach(thread);
+
+                if (NULL != p_handle) {
+                        *p_handle = p_task;
+                }
+        } else {
+                free(p_task);
+        }
+
+        return (success) ? pdPASS : pdFAIL;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Wait on a queue until it changes or the wait expires
+ *
+ * @note Must be called with the queue mutex taken
+ *
+ * @param[in,out]       p_queue             Pointer to the queue
+ * @param[in]           p_deadline          Pointer to the time the wait
+ *                                          started at
+ * @param[in]           wait_ticks          Time to wait (in ticks)
+ *
+ * @return              bool                False once the wait expired
+ */
+static bool wait(queue_t * const p_queue,
+                 struct timespec const * const p_deadline,
+                 TickType_t const wait_ticks)
+{
+        struct timespec deadline = *p_deadline;
+        int result;
+
+        if (0 == wait_ticks) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        if (portMAX_DELAY == wait_ticks) {
+                (void)pthread_cond_wait(&p_queue->changed, &p_queue->mutex);
+
+                // Code style exception for the shake of readability
+                return true;
+        }
+
+        deadline.tv_sec += (time_t)(wait_ticks * portTICK_PERIOD_MS / 1000);
+        deadline.tv_nsec += (long)(wait_ticks * portTICK_PERIOD_MS % 1000) *
+                            1000000L;
+
+        if (1000000000L <= deadline.tv_nsec) {
+                deadline.tv_nsec -= 1000000000L;
+                ++deadline.tv_sec;
+        }
+
+        result = pthread_cond_timedwait(&p_queue->changed,
+                                        &p_queue->mutex,
+                                        &deadline);
+
+        return (ETIMEDOUT != result);
+}
+
+/*!
+ * @brief Run a task
+ *
+ * @param[in]           p_argument          Pointer to the task to run
+ *
+ * @return              void *              Always NULL
+ */
+static void * task_run(void * p_argument)
+{
+        task_t * const p_task = (task_t *)p_argument;
+
+        p_task->task(p_task->p_parameters);
+
+        return NULL;
+}
@@ -0,0 +1,132 @@
+/*!
+ *******************************************************************************
+ * @file mqtt_client.h
+ *
+ * @brief Host stand-in of the ESP-IDF MQTT client API
+ *
+ * The subset `mqtt.c` uses, with the same semantics. Two implementations are
+ * built on the host: an in-process fake broker driven by the test
+ * (`mqtt_client_fake.c`), and a client of a real broker over libmosquitto
+ * (`mqtt_client_mosquitto.c`).
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef MQTT_CLIENT_H
+#define MQTT_CLIENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+//! @brief Register a handler for every event
+#define ESP_EVENT_ANY_ID                    (-1)
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Event family
+typedef char const * esp_event_base_t;
+
+//! @brief Event handler
+typedef void (*esp_event_handler_t)(void * p_handler_args,
+                                    esp_event_base_t base,
+                                    int32_t event_id,
+                                    void * p_event_data);
+
+//! @brief Client instance
+typedef struct esp_mqtt_client * esp_mqtt_client_handle_t;
+
+//! @brief Client events
+typedef enum {
+        MQTT_EVENT_ANY = -1,
+        MQTT_EVENT_ERROR = 0,
+        MQTT_EVENT_CONNECTED,
+        MQTT_EVENT_DISCONNECTED,
+        MQTT_EVENT_SUBSCRIBED,
+        MQTT_EVENT_UNSUBSCRIBED,
+        MQTT_EVENT_PUBLISHED,
+        MQTT_EVENT_DATA,
+        MQTT_EVENT_BEFORE_CONNECT,
+        MQTT_EVENT_DELETED,
+} esp_mqtt_event_id_t;
+
+//! @brief Event details
+typedef struct {
+        //! @brief Event
+        esp_mqtt_event_id_t event_id;
+
+        //! @brief Client the event comes from
+        esp_mqtt_client_handle_t client;
+
+        //! @brief Message the event is about, if any
+        int msg_id;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t * esp_mqtt_event_handle_t;
+
+//! @brief Client configuration
+typedef struct {
+        //! @brief Broker URI, `mqtt://host:port`
+        char const * uri;
+
+        //! @brief User name
+        char const * username;
+
+        //! @brief Time between pings while idle (in seconds)
+        int keepalive;
+} esp_mqtt_client_config_t;
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Create a client
+esp_mqtt_client_handle_t esp_mqtt_client_init(
+                esp_mqtt_client_config_t const * p_config);
+
+//! @brief Register a handler for the client events
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client,
+                                         esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler,
+                                         void * p_event_handler_arg);
+
+//! @brief Start connecting to the broker, and keep reconnecting
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+
+//! @brief Publish a message while connected
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client,
+                            char const * p_topic,
+                            char const * p_data,
+                            int length,
+                            int qos,
+                            int retain);
+
+//! @brief Queue a message in the outbox, to be published once connected
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client,
+                            char const * p_topic,
+                            char const * p_data,
+                            int length,
+                            int qos,
+                            int retain,
+                            bool is_stored);
+
+#endif //MQTT_CLIENT_H
@@ -0,0 +1,426 @@
+/*!
+ *******************************************************************************
+ * @file mqtt_client_fake.c
+ *
+ * @brief In-process fake of the MQTT client and broker, driven by a test
+ *
+ * Implements the client API of `mqtt_client.h` for a single client. Nothing
+ * goes over the network: the test connects and disconnects the client, and
+ * acknowledges or expires the at least once messages, and the events are
+ * dispatched right away, from the calling thread.
+ *
+ * As the ESP-IDF client, at most once messages published while disconnected
+ * are refused, and at least once messages are kept in the outbox, sent when
+ * connecting, until acknowledged or expired.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "mqtt_client.h"
+#include "mqtt_client_fake.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Messages the outbox can hold
+#define OUTBOX_SIZE                         (64)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+//! @brief At least once message in the outbox
+typedef struct {
+        //! @brief Message identifier
+        int msg_id;
+
+        //! @brief Whether the broker received it
+        bool is_sent;
+} outbox_message_t;
+
+//! @brief Client instance
+struct esp_mqtt_client {
+        //! @brief Handler of the client events
+        esp_event_handler_t event_handler;
+
+        //! @brief Argument passed to `event_handler`
+        void * p_event_handler_arg;
+
+        //! @brief Whether the client was started
+        bool is_started;
+
+        //! @brief Whether the client is connected to the broker
+        bool is_connected;
+
+        //! @brief Identifier of the last message
+        int msg_id;
+
+        //! @brief At least once messages not acknowledged yet
+        outbox_message_t outbox[OUTBOX_SIZE];
+
+        //! @brief Amount of messages in `outbox`
+        size_t outbox_count;
+
+        //! @brief Messages the broker received
+        uint32_t received;
+};
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Dispatch an event to the registered handler
+static void dispatch(esp_mqtt_event_id_t const event_id, int const msg_id);
+
+//! @brief Land every message sent from the outbox
+static size_t land(esp_mqtt_event_id_t const event_id,
+                   bool const is_unsent_landed);
+
+//! @brief Add a message to the outbox
+static int outbox_add(bool const is_sent);
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief The single client instance
+static struct esp_mqtt_client m_client;
+
+//! @brief Whether `m_client` was created
+static bool m_is_created = false;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Create a client
+ *
+ * @param[in]           p_config            Pointer to the configuration
+ *
+ * @return              esp_mqtt_client_handle_t
+ *                                          Client, NULL on error
+ */
+esp_mqtt_client_handle_t esp_mqtt_client_init(
+                esp_mqtt_client_config_t const * p_config)
+{
+        if ((NULL == p_config) || (m_is_created)) {
+                // Code style exception for the shake of readability
+                return NULL;
+        }
+
+        m_is_created = true;
+
+        return &m_client;
+}
+
+/*!
+ * @brief Register a handler for the client events
+ *
+ * @param[in]           client              Client
+ * @param[in]           event               Not used, every event is handled
+ * @param[in]           event_handler       Event handler
+ * @param[in]           p_event_handler_arg Argument passed to the handler
+ *
+ * @return              esp_err_t           Operation result
+ */
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client,
+                                         esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler,
+                                         void * p_event_handler_arg)
+{
+        (void)event;
+
+        if ((&m_client != client) || (NULL == event_handler)) {
+                // Code style exception for the shake of readability
+                return ESP_FAIL;
+        }
+
+        m_client.event_handler = event_handler;
+        m_client.p_event_handler_arg = p_event_handler_arg;
+
+        return ESP_OK;
+}
+
+/*!
+ * @brief Start the client, which stays disconnected until the test connects
+ *        it
+ *
+ * @param[in]           client              Client
+ *
+ * @return              esp_err_t           Operation result
+ */
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+        if (&m_client != client) {
+                // Code style exception for the shake of readability
+                return ESP_FAIL;
+        }
+
+        m_client.is_started = true;
+
+        return ESP_OK;
+}
+
+/*!
+ * @brief Publish a message while connected
+ *
+ * At least once messages are kept in the outbox until acknowledged, even if
+ * disconnected.
+ *
+ * @param[in]           client              Client
+ * @param[in]           p_topic             Topic
+ * @param[in]           p_data              Payload
+ * @param               length              Not used
+ * @param[in]           qos                 Delivery guarantee
+ * @param               retain              Not used
+ *
+ * @return              int                 Message identifier, 0 for at most
+ *                                          once messages, -1 on error
+ */
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client,
+                            char const * p_topic,
+                            char const * p_data,
+                            int length,
+                            int qos,
+                            int retain)
+{
+        (void)length;
+        (void)retain;
+
+        if ((&m_client != client) || (NULL == p_topic) || (NULL == p_data)) {
+                // Code style exception for the shake of readability
+                return -1;
+        }
+
+        if (0 != qos) {
+                // Code style exception for the shake of readability
+                return outbox_add(m_client.is_connected);
+        }
+
+        if (!m_client.is_connected) {
+                // Code style exception for the shake of readability
+                return -1;
+        }
+
+        ++m_client.received;
+
+        return 0;
+}
+
+/*!
+ * @brief Queue a message in the outbox, to be published once connected
+ *
+ * @param[in]           client              Client
+ * @param[in]           p_topic             Topic
+ * @param[in]           p_data              Payload
+ * @param               length              Not used
+ * @param[in]           qos                 Delivery guarantee, at least once
+ * @param               retain              Not used
+ * @param               is_stored           Not used
+ *
+ * @return              int                 Message identifier, -1 on error
+ */
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client,
+                            char const * p_topic,
+                            char const * p_data,
+                            int length,
+                            int qos,
+                            int retain,
+                            bool is_stored)
+{
+        (void)length;
+        (void)retain;
+        (void)is_stored;
+
+        if ((&m_client != client) || (NULL == p_topic) || (NULL == p_data) ||
+            (0 == qos)) {
+                // Code style exception for the shake of readability
+                return -1;
+        }
+
+        return outbox_add(false);
+}
+
+/*!
+ * @brief Connect the client to the fake broker, or drop the connection
+ *
+ * When connecting, the outbox is sent to the broker.
+ *
+ * @param[in]           is_connected        Whether to connect or disconnect
+ *
+ * @return              bool                False if the client isn't started
+ *                                          or already in that state
+ */
+bool mqtt_client_fake_set_connected(bool const is_connected)
+{
+        size_t i;
+
+        if ((!m_client.is_started) || (is_connected == m_client.is_connected)) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        m_client.is_connected = is_connected;
+
+        if (is_connected) {
+                for (i = 0; m_client.outbox_count > i; ++i) {
+                        if (!m_client.outbox[i].is_sent) {
+                                m_client.outbox[i].is_sent = true;
+                                ++m_client.received;
+                        }
+                }
+        }
+
+        dispatch((is_connected) ? MQTT_EVENT_CONNECTED : MQTT_EVENT_DISCONNECTED,
+                 0);
+
+        return true;
+}
+
+/*!
+ * @brief Acknowledge every at least once message the broker received
+ *
+ * @return              size_t              Amount of messages acknowledged
+ */
+size_t mqtt_client_fake_acknowledge(void)
+{
+        return land(MQTT_EVENT_PUBLISHED, false);
+}
+
+/*!
+ * @brief Expire every at least once message in the outbox
+ *
+ * @return              size_t              Amount of messages expired
+ */
+size_t mqtt_client_fake_expire(void)
+{
+        return land(MQTT_EVENT_DELETED, true);
+}
+
+/*!
+ * @brief Get the amount of messages the broker received
+ *
+ * @return              uint32_t            Messages received, resent ones
+ *                                          counted once
+ */
+uint32_t mqtt_client_fake_get_received(void)
+{
+        return m_client.received;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Dispatch an event to the registered handler
+ *
+ * @param[in]           event_id            Event
+ * @param[in]           msg_id              Message the event is about
+ *
+ * @return              -                   -
+ */
+static void dispatch(esp_mqtt_event_id_t const event_id, int const msg_id)
+{
+        esp_mqtt_event_t event = {
+                        .event_id = event_id,
+                        .client = &m_client,
+                        .msg_id = msg_id,
+        };
+
+        if (NULL != m_client.event_handler) {
+                m_client.event_handler(m_client.p_event_handler_arg,
+                                       "MQTT_EVENTS",
+                                       (int32_t)event_id,
+                                       &event);
+        }
+}
+
+/*!
+ * @brief Land every message sent from the outbox
+ *
+ * @param[in]           event_id            Event dispatched for each message
+ * @param[in]           is_unsent_landed    Whether messages the broker didn't
+ *                                          receive yet are landed too
+ *
+ * @return              size_t              Amount of messages landed
+ */
+static size_t land(esp_mqtt_event_id_t const event_id,
+                   bool const is_unsent_landed)
+{
+        size_t kept = 0;
+        size_t landed = 0;
+        size_t i;
+
+        for (i = 0; m_client.outbox_count > i; ++i) {
+                if ((m_client.outbox[i].is_sent) || (is_unsent_landed)) {
+                        dispatch(event_id, m_client.outbox[i].msg_id);
+                        ++landed;
+                } else {
+                        m_client.outbox[kept++] = m_client.outbox[i];
+                }
+        }
+
+        m_client.outbox_count = kept;
+
+        return landed;
+}
+
+/*!
+ * @brief Add a message to the outbox
+ *
+ * @param[in]           is_sent             Whether the broker receives it
+ *                                          right away
+ *
+ * @return              int                 Message identifier, -1 if the
+ *                                          outbox is full
+ */
+static int outbox_add(bool const is_sent)
+{
+        outbox_message_t * p_message;
+
+        if (OUTBOX_SIZE <= m_client.outbox_count) {
+                // Code style exception for the shake of readability
+                return -1;
+        }
+
+        p_message = &m_client.outbox[m_client.outbox_count++];
+        p_message->msg_id = ++m_client.msg_id;
+        p_message->is_sent = is_sent;
+
+        if (is_sent) {
+                ++m_client.received;
+        }
+
+        return p_message->msg_id;
+}
@@ -0,0 +1,43 @@
+/*!
+ *******************************************************************************
+ * @file mqtt_client_fake.h
+ *
+ * @brief In-process fake of the MQTT client and broker, driven by a test
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef MQTT_CLIENT_FAKE_H
+#define MQTT_CLIENT_FAKE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "mqtt_client.h"
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Connect the client to the fake broker, or drop the connection
+bool mqtt_client_fake_set_connected(bool const is_connected);
+
+//! @brief Acknowledge every at least once message the broker received
+size_t mqtt_client_fake_acknowledge(void);
+
+//! @brief Expire every at least once message in the outbox
+size_t mqtt_client_fake_expire(void);
+
+//! @brief Get the amount of messages the broker received
+uint32_t mqtt_client_fake_get_received(void);
+
+#endif //MQTT_CLIENT_FAKE_H
@@ -0,0 +1,649 @@
+/*!
+ *******************************************************************************
+ * @file mqtt_client_mosquitto.c
+ *
+ * @brief Host implementation of the MQTT client API over libmosquitto
+ *
+ * Lets `mqtt.c` talk to a real broker, such as a local Mosquitto standing in
+ * for Thingsboard. The `MQTT_BROKER_URI` environment variable, if set,
+ * overrides the configured broker. Events are dispatched from the
+ * libmosquitto network thread, as the ESP-IDF client does from its task.
+ *
+ * As the ESP-IDF client, at least once messages published or queued while
+ * disconnected are kept in an outbox and published once connected. Only one
+ * client is supported.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <mosquitto.h>
+
+#include "mqtt_client.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Environment variable overriding the configured broker
+#define BROKER_URI_VARIABLE                 "MQTT_BROKER_URI"
+
+//! @brief Port used if the URI doesn't tell
+#define DEFAULT_PORT                        (1883)
+
+//! @brief Longest broker host name
+#define HOST_MAX_LENGTH                     (128)
+
+//! @brief At least once messages the outbox can hold
+#define OUTBOX_SIZE                         (64)
+
+//! @brief Longest topic of a queued message, terminator included
+#define TOPIC_MAX_LENGTH                    (64)
+
+//! @brief Longest payload of a queued message, terminator included
+#define PAYLOAD_MAX_LENGTH                  (2048)
+
+//! @brief Shortest and longest time between reconnection attempts (in
+//!        seconds)
+#define RECONNECT_MIN_DELAY_S               (1)
+#define RECONNECT_MAX_DELAY_S               (30)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+//! @brief At least once message in the outbox
+typedef struct {
+        //! @brief Message identifier given to the caller
+        int msg_id;
+
+        //! @brief libmosquitto identifier, 0 until handed to libmosquitto
+        int mid;
+
+        //! @brief Topic, kept until handed to libmosquitto
+        char topic[TOPIC_MAX_LENGTH];
+
+        //! @brief Payload, kept until handed to libmosquitto
+        char payload[PAYLOAD_MAX_LENGTH];
+
+        //! @brief Length of `payload`
+        int length;
+
+        //! @brief Delivery guarantee
+        int qos;
+} outbox_message_t;
+
+//! @brief Client instance
+struct esp_mqtt_client {
+        //! @brief libmosquitto client
+        struct mosquitto * p_mosquitto;
+
+        //! @brief Broker host name
+        char host[HOST_MAX_LENGTH];
+
+        //! @brief Broker port
+        int port;
+
+        //! @brief Time between pings while idle (in seconds)
+        int keepalive;
+
+        //! @brief Handler of the client events
+        esp_event_handler_t event_handler;
+
+        //! @brief Argument passed to `event_handler`
+        void * p_event_handler_arg;
+
+        //! @brief Whether the client is connected to the broker
+        bool is_connected;
+
+        //! @brief Identifier of the last message
+        int msg_id;
+
+        //! @brief At least once messages not acknowledged yet
+        outbox_message_t outbox[OUTBOX_SIZE];
+
+        //! @brief Amount of messages in `outbox`
+        size_t outbox_count;
+
+        //! @brief Protects the members above, taken by the callers and by the
+        //!        network thread
+        pthread_mutex_t lock;
+};
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Take the broker host and port from a URI
+static bool parse_uri(char const * const p_uri,
+                      char * const p_host,
+                      int * const p_port);
+
+//! @brief Add a message to the outbox
+static int outbox_add(char const * const p_topic,
+                      char const * const p_data,
+                      int const length,
+                      int const qos);
+
+//! @brief Hand the outbox messages not handed yet to libmosquitto
+static void outbox_send(void);
+
+//! @brief Dispatch an event to the registered handler
+static void dispatch(esp_mqtt_event_id_t const event_id, int const msg_id);
+
+//! @brief Track the connection
+static void on_connect(struct mosquitto * p_mosquitto,
+                       void * p_context,
+                       int result);
+
+//! @brief Track the connection
+static void on_disconnect(struct mosquitto * p_mosquitto,
+                          void * p_context,
+                          int result);
+
+//! @brief Track the acknowledgements
+static void on_publish(struct mosquitto * p_mosquitto,
+                       void * p_context,
+                       int mid);
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief The single client instance
+static struct esp_mqtt_client m_client = {
+                .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Create a client
+ *
+ * @param[in]           p_config            Pointer to the configuration
+ *
+ * @return              esp_mqtt_client_handle_t
+ *                                          Client, NULL on error
+ */
+esp_mqtt_client_handle_t esp_mqtt_client_init(
+                esp_mqtt_client_config_t const * p_config)
+{
+        char const * p_uri;
+        bool success;
+
+        if ((NULL == p_config) || (NULL != m_client.p_mosquitto)) {
+                // Code style exception for the shake of readability
+                return NULL;
+        }
+
+        p_uri = getenv(BROKER_URI_VARIABLE);
+
+        if (NULL == p_uri) {
+                p_uri = p_config->uri;
+        }
+
+        success = ((MOSQ_ERR_SUCCESS == mosquitto_lib_init()) &&
+                   (parse_uri(p_uri, m_client.host, &m_client.port)));
+
+        if (success) {
+                m_client.keepalive = p_config->keepalive;
+                m_client.p_mosquitto = mosquitto_new(NULL, true, &m_client);
+
+                success = (NULL != m_client.p_mosquitto);
+        }
+
+        if ((success) && (NULL != p_config->username)) {
+                success = (MOSQ_ERR_SUCCESS == mosquitto_username_pw_set(
+                                m_client.p_mosquitto,
+                                p_config->username,
+                                NULL));
+        }
+
+        if (success) {
+                mosquitto_connect_callback_set(m_client.p_mosquitto, on_connect);
+                mosquitto_disconnect_callback_set(m_client.p_mosquitto,
+                                                  on_disconnect);
+                mosquitto_publish_callback_set(m_client.p_mosquitto, on_publish);
+        }
+
+        return (success) ? &m_client : NULL;
+}
+
+/*!
+ * @brief Register a handler for the client events
+ *
+ * @param[in]           client              Client
+ * @param[in]           event               Not used, every event is handled
+ * @param[in]           event_handler       Event handler
+ * @param[in]           p_event_handler_arg Argument passed to the handler
+ *
+ * @return              esp_err_t           Operation result
+ */
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client,
+                                         esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler,
+                                         void * p_event_handler_arg)
+{
+        (void)event;
+
+        if ((&m_client != client) || (NULL == event_handler)) {
+                // Code style exception for the shake of readability
+                return ESP_FAIL;
+        }
+
+        pthread_mutex_lock(&m_client.lock);
+        m_client.event_handler = event_handler;
+        m_client.p_event_handler_arg = p_event_handler_arg;
+        pthread_mutex_unlock(&m_client.lock);
+
+        return ESP_OK;
+}
+
+/*!
+ * @brief Start connecting to the broker, and keep reconnecting
+ *
+ * @param[in]           client              Client
+ *
+ * @return              esp_err_t           Operation result
+ */
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+        bool success = (&m_client == client);
+
+        if (success) {
+                success = (MOSQ_ERR_SUCCESS == mosquitto_reconnect_delay_set(
+                                m_client.p_mosquitto,
+                                RECONNECT_MIN_DELAY_S,
+                                RECONNECT_MAX_DELAY_S,
+                                true));
+        }
+
+        if (success) {
+                // A broker not up yet isn't an error, the network thread keeps
+                // trying
+                (void)mosquitto_connect_async(m_client.p_mosquitto,
+                                              m_client.host,
+                                              m_client.port,
+                                              m_client.keepalive);
+
+                success = (MOSQ_ERR_SUCCESS ==
+                           mosquitto_loop_start(m_client.p_mosquitto));
+        }
+
+        return (success) ? ESP_OK : ESP_FAIL;
+}
+
+/*!
+ * @brief Publish a message while connected
+ *
+ * At least once messages are kept in the outbox until acknowledged.
+ *
+ * @param[in]           client              Client
+ * @param[in]           p_topic             Topic
+ * @param[in]           p_data              Payload
+ * @param[in]           length              Payload length, 0 if null
+ *                                          terminated
+ * @param[in]           qos                 Delivery guarantee
+ * @param[in]           retain              Not supported, must be 0
+ *
+ * @return              int                 Message identifier, 0 for at most
+ *                                          once messages, -1 on error
+ */
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client,
+                            char const * p_topic,
+                            char const * p_data,
+                            int length,
+                            int qos,
+                            int retain)
+{
+        int const size = (0 == length) ? (int)strlen(p_data) : length;
+        int msg_id = -1;
+
+        if ((&m_client != client) || (0 != retain)) {
+                // Code style exception for the shake of readability
+                return -1;
+        }
+
+        if (0 != qos) {
+                // Code style exception for the shake of readability
+                return esp_mqtt_client_enqueue(client,
+                                               p_topic,
+                                               p_data,
+                                               size,
+                                               qos,
+                                               retain,
+                                               true);
+        }
+
+        pthread_mutex_lock(&m_client.lock);
+
+        if ((m_client.is_connected) &&
+            (MOSQ_ERR_SUCCESS == mosquitto_publish(m_client.p_mosquitto,
+                                                   NULL,
+                                                   p_topic,
+                                                   size,
+                                                   p_data,
+                                                   0,
+                                                   false))) {
+                msg_id = 0;
+        }
+
+        pthread_mutex_unlock(&m_client.lock);
+
+        return msg_id;
+}
+
+/*!
+ * @brief Queue a message in the outbox, to be published once connected
+ *
+ * @param[in]           client              Client
+ * @param[in]           p_topic             Topic
+ * @param[in]           p_data              Payload
+ * @param[in]           length              Payload length, 0 if null
+ *                                          terminated
+ * @param[in]           qos                 Delivery guarantee, at least once
+ * @param[in]           retain              Not supported, must be 0
+ * @param[in]           is_stored           Not used, always stored
+ *
+ * @return              int                 Message identifier, -1 on error
+ */
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client,
+                            char const * p_topic,
+                            char const * p_data,
+                            int length,
+                            int qos,
+                            int retain,
+                            bool is_stored)
+{
+        int const size = (0 == length) ? (int)strlen(p_data) : length;
+        int msg_id;
+
+        (void)is_stored;
+
+        if ((&m_client != client) || (0 == qos) || (0 != retain)) {
+                // Code style exception for the shake of readability
+                return -1;
+        }
+
+        pthread_mutex_lock(&m_client.lock);
+
+        msg_id = outbox_add(p_topic, p_data, size, qos);
+
+        if ((0 <= msg_id) && (m_client.is_connected)) {
+                outbox_send();
+        }
+
+        pthread_mutex_unlock(&m_client.lock);
+
+        return msg_id;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Take the broker host and port from a URI
+ *
+ * @param[in]           p_uri               URI, `mqtt://host[:port]`
+ * @param[out]          p_host              Pointer to a `HOST_MAX_LENGTH`
+ *                                          buffer where to copy the host
+ * @param[out]          p_port              Pointer where to copy the port
+ *
+ * @return              bool                False if the URI isn't supported
+ */
+static bool parse_uri(char const * const p_uri,
+                      char * const p_host,
+                      int * const p_port)
+{
+        static char const scheme[] = "mqtt://";
+
+        char const * p_start;
+        char const * p_colon;
+        size_t length;
+
+        if ((NULL == p_uri) ||
+            (0 != strncmp(p_uri, scheme, sizeof(scheme) - 1))) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        p_start = p_uri + sizeof(scheme) - 1;
+        p_colon = strchr(p_start, ':');
+        length = (NULL != p_colon) ? (size_t)(p_colon - p_start) : strlen(p_start);
+
+        if ((0 == length) || (HOST_MAX_LENGTH <= length)) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        memcpy(p_host, p_start, length);
+        p_host[length] = '\0';
+
+        *p_port = (NULL != p_colon) ? atoi(p_colon + 1) : DEFAULT_PORT;
+
+        return (0 < *p_port);
+}
+
+/*!
+ * @brief Add a message to the outbox
+ *
+ * Must be called with the lock taken.
+ *
+ * @param[in]           p_topic             Topic
+ * @param[in]           p_data              Payload
+ * @param[in]           length              Payload length
+ * @param[in]           qos                 Delivery guarantee
+ *
+ * @return              int                 Message identifier, -1 if the
+ *                                          outbox is full or the message too
+ *                                          long
+ */
+static int outbox_add(char const * const p_topic,
+                      char const * const p_data,
+                      int const length,
+                      int const qos)
+{
+        outbox_message_t * p_message;
+
+        if ((OUTBOX_SIZE <= m_client.outbox_count) ||
+            (TOPIC_MAX_LENGTH <= strlen(p_topic)) ||
+            (PAYLOAD_MAX_LENGTH <= length)) {
+                // Code style exception for the shake of readability
+                return -1;
+        }
+
+        p_message = &m_client.outbox[m_client.outbox_count++];
+        p_message->msg_id = ++m_client.msg_id;
+        p_message->mid = 0;
+        p_message->length = length;
+        p_message->qos = qos;
+
+        (void)strcpy(p_message->topic, p_topic);
+        memcpy(p_message->payload, p_data, (size_t)length);
+
+        return p_message->msg_id;
+}
+
+/*!
+ * @brief Hand the outbox messages not handed yet to libmosquitto
+ *
+ * libmosquitto resends them on its own after reconnecting, until they are
+ * acknowledged. Must be called with the lock taken.
+ *
+ * @return              -                   -
+ */
+static void outbox_send(void)
+{
+        outbox_message_t * p_message;
+        size_t i;
+
+        for (i = 0; m_client.outbox_count > i; ++i) {
+                p_message = &m_client.outbox[i];
+
+                if ((0 == p_message->mid) &&
+                    (MOSQ_ERR_SUCCESS != mosquitto_publish(m_client.p_mosquitto,
+                                                           &p_message->mid,
+                                                           p_message->topic,
+                                                           p_message->length,
+                                                           p_message->payload,
+                                                           p_message->qos,
+                                                           false))) {
+                        p_message->mid = 0;
+                }
+        }
+}
+
+/*!
+ * @brief Dispatch an event to the registered handler
+ *
+ * Must be called without the lock taken, the handler may publish.
+ *
+ * @param[in]           event_id            Event
+ * @param[in]           msg_id              Message the event is about
+ *
+ * @return              -                   -
+ */
+static void dispatch(esp_mqtt_event_id_t const event_id, int const msg_id)
+{
+        esp_mqtt_event_t event = {
+                        .event_id = event_id,
+                        .client = &m_client,
+                        .msg_id = msg_id,
+        };
+
+        if (NULL != m_client.event_handler) {
+                m_client.event_handler(m_client.p_event_handler_arg,
+                                       "MQTT_EVENTS",
+                                       (int32_t)event_id,
+                                       &event);
+        }
+}
+
+/*!
+ * @brief Track the connection
+ *
+ * Hands the outbox to libmosquitto once connected.
+ *
+ * @param               p_mosquitto         Not used
+ * @param               p_context           Not used
+ * @param[in]           result              Connection result, 0 on success
+ *
+ * @return              -                   -
+ */
+static void on_connect(struct mosquitto * p_mosquitto,
+                       void * p_context,
+                       int result)
+{
+        (void)p_mosquitto;
+        (void)p_context;
+
+        if (0 != result) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        pthread_mutex_lock(&m_client.lock);
+        m_client.is_connected = true;
+        outbox_send();
+        pthread_mutex_unlock(&m_client.lock);
+
+        dispatch(MQTT_EVENT_CONNECTED, 0);
+}
+
+/*!
+ * @brief Track the connection
+ *
+ * @param               p_mosquitto         Not used
+ * @param               p_context           Not used
+ * @param               result              Not used
+ *
+ * @return              -                   -
+ */
+static void on_disconnect(struct mosquitto * p_mosquitto,
+                          void * p_context,
+                          int result)
+{
+        (void)p_mosquitto;
+        (void)p_context;
+        (void)result;
+
+        pthread_mutex_lock(&m_client.lock);
+        m_client.is_connected = false;
+        pthread_mutex_unlock(&m_client.lock);
+
+        dispatch(MQTT_EVENT_DISCONNECTED, 0);
+}
+
+/*!
+ * @brief Track the acknowledgements
+ *
+ * libmosquitto reports at most once messages as soon as they are written,
+ * only the outbox ones are dispatched, once acknowledged.
+ *
+ * @param               p_mosquitto         Not used
+ * @param               p_context           Not used
+ * @param[in]           mid                 libmosquitto message identifier
+ *
+ * @return              -                   -
+ */
+static void on_publish(struct mosquitto * p_mosquitto,
+                       void * p_context,
+                       int mid)
+{
+        int msg_id = -1;
+        size_t i;
+
+        (void)p_mosquitto;
+        (void)p_context;
+
+        pthread_mutex_lock(&m_client.lock);
+
+        for (i = 0; (0 > msg_id) && (m_client.outbox_count > i); ++i) {
+                if (mid == m_client.outbox[i].mid) {
+                        msg_id = m_client.outbox[i].msg_id;
+
+                        m_client.outbox[i] =
+                                        m_client.outbox[--m_client.outbox_count];
+                }
+        }
+
+        pthread_mutex_unlock(&m_client.lock);
+
+        if (0 <= msg_id) {
+                dispatch(MQTT_EVENT_PUBLISHED, msg_id);
+        }
+}
@@ -0,0 +1,28 @@
+/*!
+ *******************************************************************************
+ * @file sdkconfig.h
+ *
+ * @brief Host stand-in of the configuration generated by ESP-IDF
+ *
+ * Only the options the modules built on the host depend on, with their
+ * default values.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+#define CONFIG_CO2_MONITOR_SENSOR_COUNT                 1
+#define CONFIG_CO2_MONITOR_DISPLAY_BACKLIGHT_TIMEOUT_S  30
+#define CONFIG_CO2_MONITOR_DEVICE_TOKEN                 "mytoken"
+#define CONFIG_CO2_MONITOR_MQTT_BROKER_URI              "mqtt://localhost:1883"
+#define CONFIG_CO2_MONITOR_COAP_SERVER_URI              "coap://127.0.0.1:5683"
+
+#endif //SDKCONFIG_H
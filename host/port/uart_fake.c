@@ -0,0 +1,332 @@
+/*!
+ *******************************************************************************
+ * @file uart_fake.c
+ *
+ * @brief In-process fake of the UART driver, driven by a test
+ *
+ * Implements the driver API of `driver/uart.h` for a single port. Nothing
+ * goes over a line: the test hands the received bytes over, which are
+ * buffered and announced with a data event, as the driver does, and the last
+ * write is kept for the test to check.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "driver/uart.h"
+#include "uart_fake.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Size of the receive and write buffers (in bytes)
+#define BUFFER_SIZE                         (256)
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Event queue of the installed driver, NULL until installed
+static QueueHandle_t m_event_q = NULL;
+
+//! @brief Protects the receive buffer
+static portMUX_TYPE m_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//! @brief Bytes received and not read yet
+static uint8_t m_received[BUFFER_SIZE];
+
+//! @brief Amount of bytes at `m_received`
+static size_t m_received_count = 0;
+
+//! @brief Bytes of the last write
+static uint8_t m_written[BUFFER_SIZE];
+
+//! @brief Amount of bytes at `m_written`
+static size_t m_written_count = 0;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Receive bytes, as if sent by the peer
+ *
+ * @param[in]           p_data              Pointer to the bytes
+ * @param[in]           size                Amount of bytes
+ *
+ * @return              bool                False if the driver isn't
+ *                                          installed or the bytes don't fit
+ */
+bool uart_fake_receive(uint8_t const * const p_data, size_t const size)
+{
+        uart_event_t const event = {.type = UART_DATA, .size = size};
+
+        bool success;
+
+        portENTER_CRITICAL(&m_lock);
+
+        success = ((NULL != m_event_q) &&
+                   ((BUFFER_SIZE - m_received_count) >= size));
+
+        if (success) {
+                memcpy(&m_received[m_received_count], p_data, size);
+                m_received_count += size;
+        }
+
+        portEXIT_CRITICAL(&m_lock);
+
+        return ((success) && (pdTRUE == xQueueSend(m_event_q, &event, 0)));
+}
+
+/*!
+ * @brief Report an overflow of the receive FIFO
+ *
+ * @return              bool                False if the driver isn't installed
+ */
+bool uart_fake_overflow(void)
+{
+        uart_event_t const event = {.type = UART_FIFO_OVF};
+
+        return ((NULL != m_event_q) &&
+                (pdTRUE == xQueueSend(m_event_q, &event, 0)));
+}
+
+/*!
+ * @brief Get the bytes of the last write
+ *
+ * @param[out]          p_buffer            Pointer where to copy the bytes
+ * @param[in]           size                Size of the buffer
+ *
+ * @return              size_t              Amount of bytes of the last write,
+ *                                          copied up to `size`
+ */
+size_t uart_fake_get_written(uint8_t * const p_buffer, size_t const size)
+{
+        size_t count;
+
+        portENTER_CRITICAL(&m_lock);
+
+        count = m_written_count;
+        memcpy(p_buffer, m_written, (size < count) ? size : count);
+
+        portEXIT_CRITICAL(&m_lock);
+
+        return count;
+}
+
+/*!
+ * @brief Set the pins of a port, accepted as is
+ *
+ * @param               port                Not used
+ * @param               tx_pin              Not used
+ * @param               rx_pin              Not used
+ * @param               rts_pin             Not used
+ * @param               cts_pin             Not used
+ *
+ * @return              esp_err_t           Always `ESP_OK`
+ */
+esp_err_t uart_set_pin(uart_port_t const port,
+                       int const tx_pin,
+                       int const rx_pin,
+                       int const rts_pin,
+                       int const cts_pin)
+{
+        (void)port;
+        (void)tx_pin;
+        (void)rx_pin;
+        (void)rts_pin;
+        (void)cts_pin;
+
+        return ESP_OK;
+}
+
+/*!
+ * @brief Configure a port, accepted as is
+ *
+ * @param               port                Not used
+ * @param               p_config            Not used
+ *
+ * @return              esp_err_t           Always `ESP_OK`
+ */
+esp_err_t uart_param_config(uart_port_t const port,
+                            uart_config_t const * const p_config)
+{
+        (void)port;
+        (void)p_config;
+
+        return ESP_OK;
+}
+
+/*!
+ * @brief Install the driver, creating its event queue
+ *
+ * @param               port                Not used
+ * @param               rx_buffer_size      Not used
+ * @param               tx_buffer_size      Not used
+ * @param[in]           queue_size          Events the queue can hold
+ * @param[out]          p_queue             Pointer where to store the queue
+ * @param               intr_alloc_flags    Not used
+ *
+ * @return              esp_err_t           `ESP_FAIL` if already installed or
+ *                                          the queue can't be created
+ */
+esp_err_t uart_driver_install(uart_port_t const port,
+                              int const rx_buffer_size,
+                              int const tx_buffer_size,
+                              int const queue_size,
+                              QueueHandle_t * const p_queue,
+                              int const intr_alloc_flags)
+{
+        (void)port;
+        (void)rx_buffer_size;
+        (void)tx_buffer_size;
+        (void)intr_alloc_flags;
+
+        if ((NULL != m_event_q) || (NULL == p_queue)) {
+                // Code style exception for the shake of readability
+                return ESP_FAIL;
+        }
+
+        m_event_q = xQueueCreate((UBaseType_t)queue_size, sizeof(uart_event_t));
+        *p_queue = m_event_q;
+
+        return (NULL != m_event_q) ? ESP_OK : ESP_FAIL;
+}
+
+/*!
+ * @brief Set the receive FIFO threshold, accepted as is
+ *
+ * @param               port                Not used
+ * @param               threshold           Not used
+ *
+ * @return              esp_err_t           Always `ESP_OK`
+ */
+esp_err_t uart_set_rx_full_threshold(uart_port_t const port,
+                                     int const threshold)
+{
+        (void)port;
+        (void)threshold;
+
+        return ESP_OK;
+}
+
+/*!
+ * @brief Set the receive timeout, accepted as is
+ *
+ * @param               port                Not used
+ * @param               timeout_symbols     Not used
+ *
+ * @return              esp_err_t           Always `ESP_OK`
+ */
+esp_err_t uart_set_rx_timeout(uart_port_t const port,
+                              uint8_t const timeout_symbols)
+{
+        (void)port;
+        (void)timeout_symbols;
+
+        return ESP_OK;
+}
+
+/*!
+ * @brief Read the received bytes, without waiting for more
+ *
+ * @param               port                Not used
+ * @param[out]          p_buffer            Pointer where to copy the bytes
+ * @param[in]           length              Largest amount of bytes to read
+ * @param               wait_ticks          Not used
+ *
+ * @return              int                 Amount of bytes read
+ */
+int uart_read_bytes(uart_port_t const port,
+                    void * const p_buffer,
+                    uint32_t const length,
+                    TickType_t const wait_ticks)
+{
+        size_t count;
+
+        (void)port;
+        (void)wait_ticks;
+
+        portENTER_CRITICAL(&m_lock);
+
+        count = (length < m_received_count) ? length : m_received_count;
+        memcpy(p_buffer, m_received, count);
+        memmove(m_received, &m_received[count], m_received_count - count);
+        m_received_count -= count;
+
+        portEXIT_CRITICAL(&m_lock);
+
+        return (int)count;
+}
+
+/*!
+ * @brief Write bytes, kept for the test to check
+ *
+ * @param               port                Not used
+ * @param[in]           p_data              Pointer to the bytes
+ * @param[in]           size                Amount of bytes
+ *
+ * @return              int                 Amount of bytes written, -1 if they
+ *                                          don't fit
+ */
+int uart_write_bytes(uart_port_t const port,
+                     void const * const p_data,
+                     size_t const size)
+{
+        (void)port;
+
+        if (BUFFER_SIZE < size) {
+                // Code style exception for the shake of readability
+                return -1;
+        }
+
+        portENTER_CRITICAL(&m_lock);
+        memcpy(m_written, p_data, size);
+        m_written_count = size;
+        portEXIT_CRITICAL(&m_lock);
+
+        return (int)size;
+}
+
+/*!
+ * @brief Discard the received bytes
+ *
+ * @param               port                Not used
+ *
+ * @return              esp_err_t           Always `ESP_OK`
+ */
+esp_err_t uart_flush_input(uart_port_t const port)
+{
+        (void)port;
+
+        portENTER_CRITICAL(&m_lock);
+        m_received_count = 0;
+        portEXIT_CRITICAL(&m_lock);
+
+        return ESP_OK;
+}
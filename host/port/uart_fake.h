@@ -0,0 +1,40 @@
+/*!
+ *******************************************************************************
+ * @file uart_fake.h
+ *
+ * @brief In-process fake of the UART driver, driven by a test
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef UART_FAKE_H
+#define UART_FAKE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "driver/uart.h"
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Receive bytes, as if sent by the peer
+bool uart_fake_receive(uint8_t const * const p_data, size_t const size);
+
+//! @brief Report an overflow of the receive FIFO
+bool uart_fake_overflow(void);
+
+//! @brief Get the bytes of the last write
+size_t uart_fake_get_written(uint8_t * const p_buffer, size_t const size);
+
+#endif //UART_FAKE_H
@@ -0,0 +1,479 @@
+/*!
+ *******************************************************************************
+ * @file sample_log_bench.c
+ *
+ * @brief Host benchmark and checks of the flash sample log
+ *
+ * Runs the sample log against the file backed flash emulator, on an area as
+ * large as the firmware history partition, and reports:
+ *
+ * - The write amplification for several batch sizes, over enough readings to
+ *   wrap the area around a few times
+ * - The flash reads and time taken to recover the log after a reset
+ * - The recovery after a power loss in the middle of a chunk write
+ * - The flash bytes read per reading when streaming the log
+ *
+ * Fails if readings are lost or reordered, if a bit is written back to 1, or
+ * if the write amplification is over the chunk header overhead.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sample_log.h"
+#include "sample_log_emulator.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief File backing the emulated area, in the working directory
+#define FLASH_PATH                          "sample_log_bench.bin"
+
+//! @brief Size of the area, as the history partition (in bytes)
+#define FLASH_SIZE                          (448 * 1024)
+
+//! @brief Size of the flash erase unit (in bytes)
+#define FLASH_SECTOR_SIZE                   (4096)
+
+//! @brief Readings appended per write amplification run, enough to wrap the
+//!        area around a few times
+#define READINGS                            (200000)
+
+//! @brief Size of a chunk header (in bytes)
+#define CHUNK_HEADER_SIZE                   (offsetof(sample_log_chunk_t, records))
+
+//! @brief Write amplification tolerated over the chunk header overhead, for
+//!        the sector headers (in %)
+#define AMPLIFICATION_TOLERANCE_PERCENT     (3.0)
+
+//! @brief Batch size of the recovery and power loss runs
+#define RECOVERY_BATCH_SIZE                 (16)
+
+//! @brief Bytes written into a chunk before emulating the power loss
+#define POWER_LOSS_AFTER_BYTES              (50)
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Open the emulated area and recover the log in it
+static bool boot(size_t const batch_size, double * const p_time_us);
+
+//! @brief Append readings with consecutive times
+static bool append(uint32_t const first_time_s, uint32_t const count);
+
+//! @brief Read the whole log back
+static bool read_back(uint32_t * const p_count,
+                      uint32_t * const p_last_time_s,
+                      uint32_t * const p_gaps);
+
+//! @brief Run the write amplification benchmark for a batch size
+static bool run_amplification(size_t const batch_size);
+
+//! @brief Run the recovery and power loss benchmarks
+static bool run_recovery(void);
+
+//! @brief Get a monotonic time
+static double now_us(void);
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Flash emulator instance
+static sample_log_emulator_t m_emulator;
+
+//! @brief Log instance
+static sample_log_t m_log;
+
+//! @brief Flash area backed by the emulator
+static sample_log_flash_t m_flash;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+int main(void)
+{
+        size_t const batch_sizes[] = {1, 4, 16, SAMPLE_LOG_MAX_BATCH_SIZE};
+
+        bool success = true;
+        size_t i;
+
+        printf("%-6s %8s %8s %12s %12s %10s\n",
+               "batch", "WA", "max WA", "writes/1000", "erases/1000",
+               "kept");
+
+        for (i = 0; (sizeof(batch_sizes) / sizeof(batch_sizes[0])) > i; ++i) {
+                success = run_amplification(batch_sizes[i]) && success;
+        }
+
+        success = run_recovery() && success;
+
+        (void)remove(FLASH_PATH);
+
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Open the emulated area and recover the log in it
+ *
+ * The operation counters of the emulator start over.
+ *
+ * @param[in]           batch_size          Readings written to flash at once
+ * @param[out]          p_time_us           Pointer to store the time the
+ *                                          recovery took (in microseconds)
+ *
+ * @return              bool                Whether the log could be recovered
+ */
+static bool boot(size_t const batch_size, double * const p_time_us)
+{
+        double start_us;
+        bool success;
+
+        memset(&m_emulator, 0, sizeof(m_emulator));
+        memset(&m_log, 0, sizeof(m_log));
+
+        success = ((SAMPLE_LOG_ERROR_SUCCESS == sample_log_emulator_init(
+                                &m_emulator,
+                                FLASH_PATH,
+                                FLASH_SIZE,
+                                FLASH_SECTOR_SIZE)) &&
+                   (SAMPLE_LOG_ERROR_SUCCESS == sample_log_emulator_get_flash(
+                                &m_emulator,
+                                &m_flash)));
+
+        start_us = now_us();
+
+        if (success) {
+                success = (SAMPLE_LOG_ERROR_SUCCESS ==
+                           sample_log_init(&m_log, &m_flash, batch_size));
+        }
+
+        *p_time_us = now_us() - start_us;
+
+        if (!success) {
+                printf("  unexpected: the log couldn't be recovered\n");
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Append readings with consecutive times
+ *
+ * @param[in]           first_time_s        Time of the first reading
+ * @param[in]           count               Amount of readings
+ *
+ * @return              bool                Whether every reading could be
+ *                                          appended
+ */
+static bool append(uint32_t const first_time_s, uint32_t const count)
+{
+        sample_log_record_t record = {0};
+        bool success = true;
+        uint32_t i;
+
+        for (i = 0; (success) && (count > i); ++i) {
+                record.time_s = first_time_s + i;
+                record.co2_ppm = (uint16_t)(400 + (i % 300));
+
+                success = (SAMPLE_LOG_ERROR_SUCCESS ==
+                           sample_log_append(&m_log, &record));
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Read the whole log back
+ *
+ * @param[out]          p_count             Pointer to store the amount of
+ *                                          readings
+ * @param[out]          p_last_time_s       Pointer to store the time of the
+ *                                          last reading
+ * @param[out]          p_gaps              Pointer to store the amount of
+ *                                          readings whose time doesn't follow
+ *                                          the previous one
+ *
+ * @return              bool                Whether the log could be read to
+ *                                          its end
+ */
+static bool read_back(uint32_t * const p_count,
+                      uint32_t * const p_last_time_s,
+                      uint32_t * const p_gaps)
+{
+        sample_log_cursor_t cursor = {0};
+        sample_log_record_t record;
+        sample_log_error_t result;
+
+        *p_count = 0;
+        *p_last_time_s = 0;
+        *p_gaps = 0;
+
+        while (SAMPLE_LOG_ERROR_SUCCESS == (result = sample_log_read_next(
+                        &m_log,
+                        &cursor,
+                        &record))) {
+
+                if ((0 != *p_count) && (record.time_s != *p_last_time_s + 1)) {
+                        ++(*p_gaps);
+                }
+
+                *p_last_time_s = record.time_s;
+                ++(*p_count);
+        }
+
+        return (SAMPLE_LOG_ERROR_END_OF_LOG == result);
+}
+
+/*!
+ * @brief Run the write amplification benchmark for a batch size
+ *
+ * Write amplification is the flash bytes written per reading byte logged.
+ * It should be close to a chunk with its header over its readings.
+ *
+ * @param[in]           batch_size          Readings written to flash at once
+ *
+ * @return              bool                Whether the results are the
+ *                                          expected ones
+ */
+static bool run_amplification(size_t const batch_size)
+{
+        double const max_amplification =
+                        (double)(CHUNK_HEADER_SIZE +
+                                 batch_size * sizeof(sample_log_record_t)) /
+                        (double)(batch_size * sizeof(sample_log_record_t)) *
+                        (1.0 + AMPLIFICATION_TOLERANCE_PERCENT / 100.0);
+
+        double amplification;
+        double time_us;
+        uint32_t count;
+        uint32_t last_time_s;
+        uint32_t gaps;
+        bool success;
+
+        (void)remove(FLASH_PATH);
+
+        success = boot(batch_size, &time_us) &&
+                  append(1, READINGS) &&
+                  (SAMPLE_LOG_ERROR_SUCCESS == sample_log_flush(&m_log)) &&
+                  read_back(&count, &last_time_s, &gaps);
+
+        if (!success) {
+                printf("%-6zu failed\n", batch_size);
+                (void)sample_log_emulator_deinit(&m_emulator);
+
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        amplification = (double)m_emulator.stats.bytes_written /
+                        (double)(READINGS * sizeof(sample_log_record_t));
+
+        printf("%-6zu %8.3f %8.3f %12.1f %12.2f %10u\n",
+               batch_size,
+               amplification,
+               max_amplification,
+               m_emulator.stats.writes * 1000.0 / READINGS,
+               m_emulator.stats.erases * 1000.0 / READINGS,
+               count);
+
+        if ((READINGS != last_time_s) || (0 != gaps) ||
+            (0 != m_emulator.stats.overwrites) ||
+            (max_amplification < amplification)) {
+
+                printf("  unexpected: last reading %u, %u gaps, %u bytes "
+                       "overwritten\n",
+                       last_time_s,
+                       gaps,
+                       m_emulator.stats.overwrites);
+
+                success = false;
+        }
+
+        (void)sample_log_emulator_deinit(&m_emulator);
+
+        return success;
+}
+
+/*!
+ * @brief Run the recovery and power loss benchmarks
+ *
+ * Fills the area, resets, and checks every reading is recovered. Then loses
+ * power while writing a chunk, resets again, and checks the readings before
+ * the torn chunk are kept and new ones are appended after them.
+ *
+ * @return              bool                Whether the results are the
+ *                                          expected ones
+ */
+static bool run_recovery(void)
+{
+        sample_log_emulator_stats_t boot_stats;
+        sample_log_stats_t stats;
+        double time_us;
+        uint32_t first_count;
+        uint32_t count;
+        uint32_t last_time_s;
+        uint32_t gaps;
+        uint32_t next_time_s;
+        bool success;
+
+        (void)remove(FLASH_PATH);
+
+        success = boot(RECOVERY_BATCH_SIZE, &time_us) &&
+                  append(1, READINGS) &&
+                  (SAMPLE_LOG_ERROR_SUCCESS == sample_log_flush(&m_log)) &&
+                  read_back(&first_count, &last_time_s, &gaps);
+
+        (void)sample_log_emulator_deinit(&m_emulator);
+
+        // Reset
+        success = success && boot(RECOVERY_BATCH_SIZE, &time_us);
+        boot_stats = m_emulator.stats;
+        success = success && read_back(&count, &last_time_s, &gaps);
+
+        printf("\nrecovery after a reset: %.0f us, %u reads, %u bytes read\n",
+               time_us,
+               boot_stats.reads,
+               boot_stats.bytes_read);
+
+        if ((success) &&
+            ((first_count != count) || (READINGS != last_time_s) ||
+             (0 != gaps))) {
+
+                printf("  unexpected: %u of %u readings recovered, last one "
+                       "%u, %u gaps\n",
+                       count,
+                       first_count,
+                       last_time_s,
+                       gaps);
+
+                success = false;
+        }
+
+        // Two and a half chunks, then lose power while writing the third one
+        next_time_s = READINGS + 1;
+        success = success &&
+                  append(next_time_s, RECOVERY_BATCH_SIZE * 5 / 2);
+
+        next_time_s += RECOVERY_BATCH_SIZE * 5 / 2;
+
+        success = success &&
+                  (SAMPLE_LOG_ERROR_SUCCESS ==
+                   sample_log_emulator_set_power_loss(&m_emulator,
+                                                      POWER_LOSS_AFTER_BYTES));
+
+        (void)append(next_time_s, RECOVERY_BATCH_SIZE);
+        (void)sample_log_emulator_deinit(&m_emulator);
+
+        // Reset, the readings of the torn chunk and the ones buffered are lost
+        success = success && boot(RECOVERY_BATCH_SIZE, &time_us);
+        boot_stats = m_emulator.stats;
+        success = success &&
+                  read_back(&count, &last_time_s, &gaps) &&
+                  (SAMPLE_LOG_ERROR_SUCCESS == sample_log_get_stats(&m_log,
+                                                                    &stats));
+
+        printf("recovery after a power loss: %.0f us, %u reads, last reading "
+               "%u, %u bad chunks\n",
+               time_us,
+               boot_stats.reads,
+               last_time_s,
+               stats.bad_chunks);
+
+        if ((success) &&
+            ((READINGS + 2 * RECOVERY_BATCH_SIZE != last_time_s) ||
+             (0 != gaps))) {
+
+                printf("  unexpected: last reading %u, %u gaps\n",
+                       last_time_s,
+                       gaps);
+
+                success = false;
+        }
+
+        // Appending carries on after the torn chunk
+        next_time_s = 2 * READINGS;
+        success = success &&
+                  append(next_time_s, 2 * RECOVERY_BATCH_SIZE) &&
+                  read_back(&count, &last_time_s, &gaps);
+
+        if ((success) &&
+            ((next_time_s + 2 * RECOVERY_BATCH_SIZE - 1 != last_time_s) ||
+             (1 != gaps) ||
+             (0 != m_emulator.stats.overwrites))) {
+
+                printf("  unexpected: after appending, last reading %u, %u "
+                       "gaps, %u bytes overwritten\n",
+                       last_time_s,
+                       gaps,
+                       m_emulator.stats.overwrites);
+
+                success = false;
+        }
+
+        // Streaming cost
+        m_emulator.stats.bytes_read = 0;
+        time_us = now_us();
+        success = success && read_back(&count, &last_time_s, &gaps);
+        time_us = now_us() - time_us;
+
+        printf("streaming %u readings: %.0f us, %.2f flash bytes read per "
+               "reading\n",
+               count,
+               time_us,
+               (double)m_emulator.stats.bytes_read / count);
+
+        (void)sample_log_emulator_deinit(&m_emulator);
+
+        return success;
+}
+
+/*!
+ * @brief Get a monotonic time
+ *
+ * @return              double              Time (in microseconds)
+ */
+static double now_us(void)
+{
+        struct timespec now;
+
+        (void)clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return (double)now.tv_sec * 1e6 + (double)now.tv_nsec / 1e3;
+}
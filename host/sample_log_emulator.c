@@ -0,0 +1,496 @@
+/*!
+ *******************************************************************************
+ * @file sample_log_emulator.c
+ *
+ * @brief File backed emulation of a NOR flash area for the sample log
+ *
+ * Lets the sample log run on a host, against a regular file: erasing sets the
+ * bytes to 0xFF and writing can only clear bits, as on the real flash. Every
+ * operation is counted, so write amplification and recovery cost can be
+ * measured, and a power loss can be emulated in the middle of a write to
+ * check the recovery.
+ *
+ * Built on a host together with `sample_log.c`, it isn't part of the firmware.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sample_log_emulator.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Bytes handled at once by the file operations
+#define EMULATOR_BLOCK_SIZE                 (256)
+
+#define EMULATOR_ERASED_VALUE               (0xFF)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Check an operation can be done on the emulated area
+static bool is_range_valid(sample_log_emulator_t const * const p_emulator,
+                           uint32_t const offset,
+                           size_t const size);
+
+//! @brief Fill a range of the file with erased bytes
+static bool fill_erased(FILE * const p_file,
+                        uint32_t const offset,
+                        size_t const size);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Open the file backing the emulated area
+ *
+ * The contents of an existing file are kept, as a flash keeps them across
+ * resets. A new file, or the missing end of a short one, starts erased.
+ *
+ * @param[out]          p_emulator          Pointer to the emulator instance
+ * @param[in]           p_path              Path of the backing file
+ * @param[in]           size                Size of the area (in bytes)
+ * @param[in]           sector_size         Size of the erase unit (in bytes)
+ *
+ * @return              sample_log_error_t  Operation result
+ * @retval              SAMPLE_LOG_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              SAMPLE_LOG_ERROR_ALREADY_INITIALIZED
+ *                                          Emulator is already initialized
+ * @retval              SAMPLE_LOG_ERROR_BAD_PARAMETER
+ *                                          Parameter is null, or the size is
+ *                                          not a multiple of the sector size
+ * @retval              SAMPLE_LOG_ERROR_IO_ERROR
+ *                                          File couldn't be opened
+ */
+sample_log_error_t sample_log_emulator_init(
+                sample_log_emulator_t * const p_emulator,
+                char const * const p_path,
+                uint32_t const size,
+                uint32_t const sector_size)
+{
+        sample_log_error_t result = SAMPLE_LOG_ERROR_SUCCESS;
+        long file_size = 0;
+
+        if ((NULL == p_emulator) || (NULL == p_path) ||
+            (0 == sector_size) || (0 == size) ||
+            (0 != (size % sector_size))) {
+                result = SAMPLE_LOG_ERROR_BAD_PARAMETER;
+        } else if (p_emulator->is_initialized) {
+                result = SAMPLE_LOG_ERROR_ALREADY_INITIALIZED;
+        } else {
+                p_emulator->p_file = fopen(p_path, "r+b");
+
+                if (NULL == p_emulator->p_file) {
+                        p_emulator->p_file = fopen(p_path, "w+b");
+                }
+
+                if (NULL == p_emulator->p_file) {
+                        result = SAMPLE_LOG_ERROR_IO_ERROR;
+                }
+        }
+
+        if (SAMPLE_LOG_ERROR_SUCCESS == result) {
+                if ((0 == fseek(p_emulator->p_file, 0, SEEK_END)) &&
+                    (0 <= (file_size = ftell(p_emulator->p_file)))) {
+                        if ((long)size > file_size) {
+                                if (!fill_erased(p_emulator->p_file,
+                                                 (uint32_t)file_size,
+                                                 size - (uint32_t)file_size)) {
+                                        result = SAMPLE_LOG_ERROR_IO_ERROR;
+                                }
+                        }
+                } else {
+                        result = SAMPLE_LOG_ERROR_IO_ERROR;
+                }
+
+                if (SAMPLE_LOG_ERROR_SUCCESS != result) {
+                        (void)fclose(p_emulator->p_file);
+                        p_emulator->p_file = NULL;
+                }
+        }
+
+        if (SAMPLE_LOG_ERROR_SUCCESS == result) {
+                p_emulator->size = size;
+                p_emulator->sector_size = sector_size;
+                p_emulator->power_loss_after_bytes = 0;
+                p_emulator->is_power_lost = false;
+                memset(&p_emulator->stats, 0, sizeof(p_emulator->stats));
+                p_emulator->is_initialized = true;
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Close the file backing the emulated area
+ *
+ * @param[in,out]       p_emulator          Pointer to the emulator instance
+ *
+ * @return              sample_log_error_t  Operation result
+ * @retval              SAMPLE_LOG_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              SAMPLE_LOG_ERROR_NOT_INITIALIZED
+ *                                          Emulator isn't initialized
+ * @retval              SAMPLE_LOG_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ * @retval              SAMPLE_LOG_ERROR_IO_ERROR
+ *                                          File couldn't be closed
+ */
+sample_log_error_t sample_log_emulator_deinit(
+                sample_log_emulator_t * const p_emulator)
+{
+        sample_log_error_t result = SAMPLE_LOG_ERROR_SUCCESS;
+
+        if (NULL == p_emulator) {
+                result = SAMPLE_LOG_ERROR_BAD_PARAMETER;
+        } else if (!p_emulator->is_initialized) {
+                result = SAMPLE_LOG_ERROR_NOT_INITIALIZED;
+        } else {
+                if (0 != fclose(p_emulator->p_file)) {
+                        result = SAMPLE_LOG_ERROR_IO_ERROR;
+                }
+
+                p_emulator->p_file = NULL;
+                p_emulator->is_initialized = false;
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Get the sample log flash area backed by the emulator
+ *
+ * @param[in]           p_emulator          Pointer to the emulator instance
+ * @param[out]          p_flash             Pointer where to copy the area
+ *
+ * @return              sample_log_error_t  Operation result
+ * @retval              SAMPLE_LOG_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              SAMPLE_LOG_ERROR_NOT_INITIALIZED
+ *                                          Emulator isn't initialized
+ * @retval              SAMPLE_LOG_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ */
+sample_log_error_t sample_log_emulator_get_flash(
+                sample_log_emulator_t * const p_emulator,
+                sample_log_flash_t * const p_flash)
+{
+        sample_log_error_t result = SAMPLE_LOG_ERROR_SUCCESS;
+
+        if ((NULL == p_emulator) || (NULL == p_flash)) {
+                result = SAMPLE_LOG_ERROR_BAD_PARAMETER;
+        } else if (!p_emulator->is_initialized) {
+                result = SAMPLE_LOG_ERROR_NOT_INITIALIZED;
+        } else {
+                p_flash->read_func = sample_log_emulator_read;
+                p_flash->write_func = sample_log_emulator_write;
+                p_flash->erase_func = sample_log_emulator_erase;
+                p_flash->p_context = p_emulator;
+                p_flash->size = p_emulator->size;
+                p_flash->sector_size = p_emulator->sector_size;
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Emulate a power loss after writing some more bytes
+ *
+ * The write reaching the limit is cut short, and every later operation fails
+ * until the emulator is initialized again, as after a reset
+ *
+ * @param[in,out]       p_emulator          Pointer to the emulator instance
+ * @param[in]           after_bytes         Bytes still written before losing
+ *                                          power, 0 to never lose it
+ *
+ * @return              sample_log_error_t  Operation result
+ * @retval              SAMPLE_LOG_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              SAMPLE_LOG_ERROR_NOT_INITIALIZED
+ *                                          Emulator isn't initialized
+ * @retval              SAMPLE_LOG_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ */
+sample_log_error_t sample_log_emulator_set_power_loss(
+                sample_log_emulator_t * const p_emulator,
+                uint32_t const after_bytes)
+{
+        sample_log_error_t result = SAMPLE_LOG_ERROR_SUCCESS;
+
+        if (NULL == p_emulator) {
+                result = SAMPLE_LOG_ERROR_BAD_PARAMETER;
+        } else if (!p_emulator->is_initialized) {
+                result = SAMPLE_LOG_ERROR_NOT_INITIALIZED;
+        } else {
+                p_emulator->power_loss_after_bytes = after_bytes;
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Read function backed by the emulator
+ *
+ * Follows the `sample_log_read_func` prototype
+ *
+ * @param[in]           p_context           Pointer to the emulator instance
+ * @param[in]           offset              Offset within the area
+ * @param[out]          p_buffer            Pointer where to read the data to
+ * @param[in]           size                Amount of bytes to read
+ *
+ * @return              bool                Operation result
+ */
+bool sample_log_emulator_read(void * const p_context,
+                              uint32_t const offset,
+                              void * const p_buffer,
+                              size_t const size)
+{
+        sample_log_emulator_t * const p_emulator =
+                        (sample_log_emulator_t *)p_context;
+        bool success;
+
+        success = (NULL != p_buffer) &&
+                  (is_range_valid(p_emulator, offset, size)) &&
+                  (0 == fseek(p_emulator->p_file, (long)offset, SEEK_SET)) &&
+                  (size == fread(p_buffer, 1, size, p_emulator->p_file));
+
+        if (success) {
+                ++p_emulator->stats.reads;
+                p_emulator->stats.bytes_read += size;
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Write function backed by the emulator
+ *
+ * Follows the `sample_log_write_func` prototype. Bits can only be cleared,
+ * bytes written over cleared bits are counted as overwrites.
+ *
+ * @param[in]           p_context           Pointer to the emulator instance
+ * @param[in]           offset              Offset within the area
+ * @param[in]           p_buffer            Pointer to the data to write
+ * @param[in]           size                Amount of bytes to write
+ *
+ * @return              bool                Operation result, false if power
+ *                                          was lost meanwhile
+ */
+bool sample_log_emulator_write(void * const p_context,
+                               uint32_t const offset,
+                               void const * const p_buffer,
+                               size_t const size)
+{
+        sample_log_emulator_t * const p_emulator =
+                        (sample_log_emulator_t *)p_context;
+        uint8_t const * const p_data = p_buffer;
+        uint8_t block[EMULATOR_BLOCK_SIZE];
+        size_t to_write = size;
+        size_t done = 0;
+        size_t count;
+        size_t i;
+        bool success;
+
+        success = (NULL != p_buffer) &&
+                  (is_range_valid(p_emulator, offset, size));
+
+        if ((success) && (0 != p_emulator->power_loss_after_bytes) &&
+            (p_emulator->power_loss_after_bytes <= size)) {
+                to_write = p_emulator->power_loss_after_bytes;
+                p_emulator->is_power_lost = true;
+        } else if ((success) && (0 != p_emulator->power_loss_after_bytes)) {
+                p_emulator->power_loss_after_bytes -= size;
+        }
+
+        while ((success) && (to_write > done)) {
+                count = to_write - done;
+
+                if (EMULATOR_BLOCK_SIZE < count) {
+                        count = EMULATOR_BLOCK_SIZE;
+                }
+
+                success = (0 == fseek(p_emulator->p_file,
+                                      (long)(offset + done),
+                                      SEEK_SET)) &&
+                          (count == fread(block, 1, count, p_emulator->p_file));
+
+                for (i = 0; (success) && (count > i); ++i) {
+                        if ((block[i] & p_data[done + i]) != p_data[done + i]) {
+                                ++p_emulator->stats.overwrites;
+                        }
+
+                        block[i] &= p_data[done + i];
+                }
+
+                success = (success) &&
+                          (0 == fseek(p_emulator->p_file,
+                                      (long)(offset + done),
+                                      SEEK_SET)) &&
+                          (count == fwrite(block, 1, count, p_emulator->p_file));
+
+                done += count;
+        }
+
+        if (success) {
+                ++p_emulator->stats.writes;
+                p_emulator->stats.bytes_written += to_write;
+                success = (0 == fflush(p_emulator->p_file)) &&
+                          (to_write == size);
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Erase function backed by the emulator
+ *
+ * Follows the `sample_log_erase_func` prototype
+ *
+ * @param[in]           p_context           Pointer to the emulator instance
+ * @param[in]           offset              Offset within the area, sector
+ *                                          aligned
+ * @param[in]           size                Amount of bytes to erase, multiple
+ *                                          of the sector size
+ *
+ * @return              bool                Operation result
+ */
+bool sample_log_emulator_erase(void * const p_context,
+                               uint32_t const offset,
+                               size_t const size)
+{
+        sample_log_emulator_t * const p_emulator =
+                        (sample_log_emulator_t *)p_context;
+        bool success;
+
+        success = (is_range_valid(p_emulator, offset, size)) &&
+                  (0 == (offset % p_emulator->sector_size)) &&
+                  (0 == (size % p_emulator->sector_size)) &&
+                  (fill_erased(p_emulator->p_file, offset, size));
+
+        if (success) {
+                p_emulator->stats.erases += size / p_emulator->sector_size;
+        }
+
+        return success;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Check an operation can be done on the emulated area
+ *
+ * @param[in]           p_emulator          Pointer to the emulator instance
+ * @param[in]           offset              Offset within the area
+ * @param[in]           size                Amount of bytes
+ *
+ * @return              bool                Whether the emulator is ready and
+ *                                          the range is within the area
+ */
+static bool is_range_valid(sample_log_emulator_t const * const p_emulator,
+                           uint32_t const offset,
+                           size_t const size)
+{
+        return (NULL != p_emulator) &&
+               (p_emulator->is_initialized) &&
+               (!p_emulator->is_power_lost) &&
+               (p_emulator->size >= offset) &&
+               ((p_emulator->size - offset) >= size);
+}
+
+/*!
+ * @brief Fill a range of the file with erased bytes
+ *
+ * @param[in]           p_file              File backing the area
+ * @param[in]           offset              Offset of the range
+ * @param[in]           size                Size of the range
+ *
+ * @return              bool                Operation result
+ */
+static bool fill_erased(FILE * const p_file,
+                        uint32_t const offset,
+                        size_t const size)
+{
+        uint8_t block[EMULATOR_BLOCK_SIZE];
+        size_t done = 0;
+        size_t count;
+        bool success;
+
+        memset(block, EMULATOR_ERASED_VALUE, sizeof(block));
+
+        success = (0 == fseek(p_file, (long)offset, SEEK_SET));
+
+        while ((success) && (size > done)) {
+                count = size - done;
+
+                if (EMULATOR_BLOCK_SIZE < count) {
+                        count = EMULATOR_BLOCK_SIZE;
+                }
+
+                success = (count == fwrite(block, 1, count, p_file));
+                done += count;
+        }
+
+        return (success) && (0 == fflush(p_file));
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
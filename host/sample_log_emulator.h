@@ -0,0 +1,143 @@
+/*!
+ *******************************************************************************
+ * @file sample_log_emulator.h
+ *
+ * @brief File backed emulation of a NOR flash area for the sample log
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef SAMPLE_LOG_EMULATOR_H
+#define SAMPLE_LOG_EMULATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "sample_log.h"
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Flash operations done through the emulator
+typedef struct {
+        //! @brief Read operations
+        uint32_t reads;
+
+        //! @brief Bytes read
+        uint32_t bytes_read;
+
+        //! @brief Write operations
+        uint32_t writes;
+
+        //! @brief Bytes written
+        uint32_t bytes_written;
+
+        //! @brief Sectors erased
+        uint32_t erases;
+
+        //! @brief Bytes written over bits already cleared, which a real flash
+        //!        wouldn't set back
+        uint32_t overwrites;
+} sample_log_emulator_stats_t;
+
+/*!
+ * @brief Emulator instance
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Whether the instance is initialized or not
+        bool is_initialized;
+
+        //! @brief File backing the flash area
+        FILE * p_file;
+
+        //! @brief Size of the area (in bytes)
+        uint32_t size;
+
+        //! @brief Size of the erase unit (in bytes)
+        uint32_t sector_size;
+
+        //! @brief Bytes left to write before emulating a power loss, 0 to
+        //!        never lose power
+        uint32_t power_loss_after_bytes;
+
+        //! @brief Whether power was lost, failing every operation until the
+        //!        emulator is initialized again
+        bool is_power_lost;
+
+        //! @brief Operation counters
+        sample_log_emulator_stats_t stats;
+} sample_log_emulator_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Open the file backing the emulated area
+sample_log_error_t sample_log_emulator_init(
+                sample_log_emulator_t * const p_emulator,
+                char const * const p_path,
+                uint32_t const size,
+                uint32_t const sector_size);
+
+//! @brief Close the file backing the emulated area
+sample_log_error_t sample_log_emulator_deinit(
+                sample_log_emulator_t * const p_emulator);
+
+//! @brief Get the sample log flash area backed by the emulator
+sample_log_error_t sample_log_emulator_get_flash(
+                sample_log_emulator_t * const p_emulator,
+                sample_log_flash_t * const p_flash);
+
+//! @brief Emulate a power loss after writing some more bytes
+sample_log_error_t sample_log_emulator_set_power_loss(
+                sample_log_emulator_t * const p_emulator,
+                uint32_t const after_bytes);
+
+//! @brief Read function backed by the emulator
+bool sample_log_emulator_read(void * const p_context,
+                              uint32_t const offset,
+                              void * const p_buffer,
+                              size_t const size);
+
+//! @brief Write function backed by the emulator
+bool sample_log_emulator_write(void * const p_context,
+                               uint32_t const offset,
+                               void const * const p_buffer,
+                               size_t const size);
+
+//! @brief Erase function backed by the emulator
+bool sample_log_emulator_erase(void * const p_context,
+                               uint32_t const offset,
+                               size_t const size);
+
+#endif //SAMPLE_LOG_EMULATOR_H
@@ -0,0 +1,375 @@
+/*!
+ *******************************************************************************
+ * @file sampling_scheduler_bench.c
+ *
+ * @brief Host benchmark of the adaptive sampling period against the emulated
+ *        sensor noise
+ *
+ * Reads the MH-Z19 emulator through the driver on a simulated clock, feeding
+ * every reading to the scheduler as the sensor task does, and sleeping for
+ * the period it returns. CO2 is stable for two hours, then rises at twice the
+ * fast rate for ten minutes, as a room filling up.
+ *
+ * Reports, for several sensor noise and noise floor pairs, the readings per
+ * hour while CO2 is stable, how long the period takes to reach the longest
+ * one, how long the rise takes to bring it back to the shortest one, and the
+ * readings taken during the rise.
+ *
+ * Fails if, with the default noise floor, the period doesn't back off while
+ * CO2 is stable, or the rise isn't caught within the longest period.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "winsen_mh_z19.h"
+#include "winsen_mh_z19_emulator.h"
+#include "sampling_scheduler.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Scheduler defaults, as in the Kconfig of the firmware
+#define MIN_PERIOD_MS                       (10 * 1000)
+#define MAX_PERIOD_MS                       (160 * 1000)
+#define FAST_RATE_PPM_PER_MIN               (50)
+#define DEFAULT_NOISE_FLOOR_PPM             (40)
+
+//! @brief Stable concentration (in ppm)
+#define STABLE_PPM                          (800)
+
+//! @brief Time CO2 is stable for, before the rise (in milliseconds)
+#define STABLE_MS                           (2 * 60 * 60 * 1000)
+
+//! @brief Rise of the concentration (in ppm per minute)
+#define RISE_PPM_PER_MIN                    (2 * FAST_RATE_PPM_PER_MIN)
+
+//! @brief Time CO2 rises for (in milliseconds)
+#define RISE_MS                             (10 * 60 * 1000)
+
+#define MS_PER_MINUTE                       (60 * 1000)
+#define MS_PER_HOUR                         (60 * MS_PER_MINUTE)
+
+//! @brief Fewest times the readings while stable are reduced, against
+//!        reading at the shortest period, for the period to be backing off
+#define MIN_STABLE_REDUCTION                (4)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Sensor noise and noise floor to run the scheduler with
+typedef struct {
+        //! @brief Maximum deviation of each reading (in ppm)
+        uint16_t sensor_noise_ppm;
+
+        //! @brief Changes between readings ignored by the scheduler (in ppm)
+        uint32_t noise_floor_ppm;
+} scenario_t;
+
+//! @brief Results of a run
+typedef struct {
+        //! @brief Readings taken in the last hour CO2 was stable
+        uint32_t stable_readings;
+
+        //! @brief Time the period first reached the longest one at (in
+        //!        milliseconds, 0 if it never did)
+        uint32_t max_period_at_ms;
+
+        //! @brief Time from the start of the rise until the period is back to
+        //!        the shortest one (in milliseconds, 0 if it never was)
+        uint32_t rise_caught_after_ms;
+
+        //! @brief Readings taken while CO2 was rising
+        uint32_t rise_readings;
+} results_t;
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+//! @brief Scenarios run, the MH-Z19B readings jitter by about 10 to 30 ppm
+static scenario_t const m_scenarios[] = {
+                {.sensor_noise_ppm = 10, .noise_floor_ppm = 10},
+                {.sensor_noise_ppm = 20, .noise_floor_ppm = 10},
+                {.sensor_noise_ppm = 30, .noise_floor_ppm = 10},
+                {.sensor_noise_ppm = 10, .noise_floor_ppm = DEFAULT_NOISE_FLOOR_PPM},
+                {.sensor_noise_ppm = 20, .noise_floor_ppm = DEFAULT_NOISE_FLOOR_PPM},
+                {.sensor_noise_ppm = 30, .noise_floor_ppm = DEFAULT_NOISE_FLOOR_PPM},
+};
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Advance the simulated clock
+static void delay_ms(uint32_t const delay_ms);
+
+//! @brief Get the simulated clock
+static uint32_t time_us(void);
+
+//! @brief Get the concentration the emulated sensor reports at a time
+static uint16_t concentration_at(uint32_t const time_ms);
+
+//! @brief Run the scheduler under a scenario
+static bool run_scenario(scenario_t const * const p_scenario,
+                         results_t * const p_results);
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Simulated clock (in milliseconds)
+static uint32_t m_clock_ms = 0;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+int main(void)
+{
+        uint32_t const fixed_readings = MS_PER_HOUR / MIN_PERIOD_MS;
+
+        scenario_t const * p_scenario;
+        results_t results;
+        bool success = true;
+        size_t i;
+
+        printf("%9s %9s %12s %12s %12s %12s\n",
+               "noise", "floor", "stable (/h)", "max at (s)",
+               "caught (s)", "rise (#)");
+
+        for (i = 0; (sizeof(m_scenarios) / sizeof(m_scenarios[0])) > i; ++i) {
+                p_scenario = &m_scenarios[i];
+
+                if (!run_scenario(p_scenario, &results)) {
+                        printf("%9u could not be set up\n",
+                               p_scenario->sensor_noise_ppm);
+
+                        success = false;
+                        continue;
+                }
+
+                printf("%9u %9u %12u %12.0f %12.0f %12u\n",
+                       p_scenario->sensor_noise_ppm,
+                       p_scenario->noise_floor_ppm,
+                       results.stable_readings,
+                       results.max_period_at_ms / 1000.0,
+                       results.rise_caught_after_ms / 1000.0,
+                       results.rise_readings);
+
+                if (DEFAULT_NOISE_FLOOR_PPM != p_scenario->noise_floor_ppm) {
+                        continue;
+                }
+
+                if ((0 == results.max_period_at_ms) ||
+                    (results.stable_readings * MIN_STABLE_REDUCTION >
+                     fixed_readings)) {
+
+                        printf("  unexpected: the period doesn't back off, "
+                               "%u readings per hour against %u\n",
+                               results.stable_readings,
+                               fixed_readings);
+
+                        success = false;
+                }
+
+                if ((0 == results.rise_caught_after_ms) ||
+                    (MAX_PERIOD_MS < results.rise_caught_after_ms)) {
+
+                        printf("  unexpected: the rise isn't caught within "
+                               "the longest period\n");
+
+                        success = false;
+                }
+        }
+
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Advance the simulated clock
+ *
+ * Follows the `mh_z19_emulator_delay_func` prototype
+ *
+ * @param[in]           delay_ms            Time to advance (in milliseconds)
+ *
+ * @return              -                   -
+ */
+static void delay_ms(uint32_t const delay_ms)
+{
+        m_clock_ms += delay_ms;
+}
+
+/*!
+ * @brief Get the simulated clock
+ *
+ * Follows the `mh_z19_time_func` prototype
+ *
+ * @return              uint32_t            Simulated time (in microseconds,
+ *                                          wrapping around)
+ */
+static uint32_t time_us(void)
+{
+        return m_clock_ms * 1000;
+}
+
+/*!
+ * @brief Get the concentration the emulated sensor reports at a time
+ *
+ * @param[in]           time_ms             Time (in milliseconds)
+ *
+ * @return              uint16_t            Concentration (in ppm)
+ */
+static uint16_t concentration_at(uint32_t const time_ms)
+{
+        uint32_t rise_ms = 0;
+
+        if (STABLE_MS < time_ms) {
+                rise_ms = time_ms - STABLE_MS;
+        }
+
+        if (RISE_MS < rise_ms) {
+                rise_ms = RISE_MS;
+        }
+
+        return (uint16_t)(STABLE_PPM +
+                          (uint64_t)rise_ms * RISE_PPM_PER_MIN / MS_PER_MINUTE);
+}
+
+/*!
+ * @brief Run the scheduler under a scenario
+ *
+ * The emulator has no way of changing its concentration, so it is set up
+ * again before each reading, with a seed of its own so the noise doesn't
+ * repeat.
+ *
+ * @param[in]           p_scenario          Pointer to the scenario
+ * @param[out]          p_results           Pointer where to store the results
+ *
+ * @return              bool                Operation result
+ */
+static bool run_scenario(scenario_t const * const p_scenario,
+                         results_t * const p_results)
+{
+        sampling_scheduler_config_t const scheduler_config = {
+                        .min_period_ms = MIN_PERIOD_MS,
+                        .max_period_ms = MAX_PERIOD_MS,
+                        .fast_rate_ppm_per_min = FAST_RATE_PPM_PER_MIN,
+                        .noise_ppm = p_scenario->noise_floor_ppm,
+        };
+
+        mh_z19_emulator_config_t config = {
+                        .response_latency_ms = 20,
+                        .noise_ppm = p_scenario->sensor_noise_ppm,
+                        .temperature_c = 25,
+        };
+
+        mh_z19_emulator_t emulator = {0};
+        sampling_scheduler_t scheduler;
+        mh_z19_t sensor = {0};
+        uint32_t concentration;
+        uint32_t period_ms;
+        uint32_t now_ms;
+        uint32_t seed = 0;
+        bool success;
+
+        m_clock_ms = 0;
+        *p_results = (results_t){0};
+
+        config.concentration_ppm = concentration_at(m_clock_ms);
+        config.seed = ++seed;
+
+        success = ((MH_Z19_ERROR_SUCCESS == mh_z19_emulator_init(&emulator,
+                                                                 &config,
+                                                                 delay_ms)) &&
+                   (MH_Z19_ERROR_SUCCESS == mh_z19_init(&sensor,
+                                                        mh_z19_emulator_xfer,
+                                                        &emulator)) &&
+                   (MH_Z19_ERROR_SUCCESS == mh_z19_set_time_func(&sensor,
+                                                                 time_us)) &&
+                   (sampling_scheduler_init(&scheduler, &scheduler_config)));
+
+        while ((success) && (STABLE_MS + 2 * RISE_MS > m_clock_ms)) {
+                now_ms = m_clock_ms;
+                config.concentration_ppm = concentration_at(now_ms);
+                config.seed = ++seed;
+
+                success = ((MH_Z19_ERROR_SUCCESS == mh_z19_emulator_init(
+                                        &emulator,
+                                        &config,
+                                        delay_ms)) &&
+                           (MH_Z19_ERROR_SUCCESS ==
+                            mh_z19_get_gas_concentration(&sensor,
+                                                         &concentration)));
+
+                if (!success) {
+                        break;
+                }
+
+                period_ms = sampling_scheduler_update(&scheduler,
+                                                      concentration,
+                                                      now_ms);
+
+                if ((0 == p_results->max_period_at_ms) &&
+                    (MAX_PERIOD_MS == period_ms)) {
+
+                        p_results->max_period_at_ms = now_ms;
+                }
+
+                if ((STABLE_MS - MS_PER_HOUR <= now_ms) && (STABLE_MS > now_ms)) {
+                        ++p_results->stable_readings;
+                }
+
+                if ((STABLE_MS <= now_ms) && (STABLE_MS + RISE_MS > now_ms)) {
+                        ++p_results->rise_readings;
+
+                        if ((0 == p_results->rise_caught_after_ms) &&
+                            (MIN_PERIOD_MS == period_ms)) {
+
+                                p_results->rise_caught_after_ms =
+                                                now_ms - STABLE_MS;
+                        }
+                }
+
+                m_clock_ms = now_ms + period_ms;
+        }
+
+        return success;
+}
@@ -0,0 +1,338 @@
+/*!
+ *******************************************************************************
+ * @file sensor_uart_test.c
+ *
+ * @brief Host test of the event driven UART transport of the sensors
+ *
+ * Runs `sensor_uart.c`, its task included, against the in-process fake of
+ * the UART driver and the stand-ins of the FreeRTOS queues and semaphores,
+ * and checks the transport serves the received frames as a byte stream:
+ * - A frame can be read in parts, as the driver does to resynchronize
+ * - A read spanning two frames waits for the second one
+ * - Reads time out, and longer reads than a frame are refused
+ * - Stray bytes before a frame are dropped by the parser
+ * - A request discards the bytes not read yet, counted as unclaimed
+ * - An overflow discards the partial frame
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "uart_fake.h"
+#include "winsen_mh_z19.h"
+#include "sensor_uart.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Time a reader is given to start waiting (in milliseconds), well
+//!        below the reply timeout of the transport
+#define READER_START_MS                     (20)
+
+//! @brief Time to wait for the transport task (in milliseconds)
+#define TIMEOUT_MS                          (1000)
+
+//! @brief Time between checks while waiting (in milliseconds)
+#define POLL_MS                             (1)
+
+//! @brief Check a condition, reporting it if it doesn't hold
+#define CHECK(condition)                                                       \
+        do {                                                                   \
+                if (!(condition)) {                                            \
+                        printf("  failed at line %d: %s\n",                    \
+                               __LINE__,                                       \
+                               #condition);                                    \
+                        m_is_failed = true;                                    \
+                }                                                              \
+        } while (0)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Read run by another thread
+typedef struct {
+        //! @brief Bytes read
+        uint8_t buffer[SENSOR_UART_FRAME_SIZE];
+
+        //! @brief Amount of bytes to read
+        size_t size;
+
+        //! @brief Read result
+        mh_z19_error_t result;
+} read_t;
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+//! @brief Gas concentration request
+static uint8_t const m_request[SENSOR_UART_FRAME_SIZE] = {
+                0xFF, 0x01, 0x86, 0x00, 0x00, 0x00, 0x00, 0x00, 0x79
+};
+
+//! @brief Gas concentration replies, 800 and 1200 ppm
+static uint8_t const m_reply_a[SENSOR_UART_FRAME_SIZE] = {
+                0xFF, 0x86, 0x03, 0x20, 0x41, 0x00, 0x00, 0x00, 0x16
+};
+
+static uint8_t const m_reply_b[SENSOR_UART_FRAME_SIZE] = {
+                0xFF, 0x86, 0x04, 0xB0, 0x41, 0x00, 0x00, 0x00, 0x85
+};
+
+//! @brief Bytes that can't start a frame
+static uint8_t const m_stray[] = {0x00, 0x86, 0x42};
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Write the request through the transport
+static bool request(void);
+
+//! @brief Read through the transport
+static mh_z19_error_t read_bytes(uint8_t * const p_buffer, size_t const size);
+
+//! @brief Run a read
+static void * read_run(void * p_argument);
+
+//! @brief Wait until the transport has counted an overflow
+static bool wait_for_overflows(uint32_t const overflows);
+
+//! @brief Get the transport statistics
+static sensor_uart_stats_t get_stats(void);
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Transport under test
+static sensor_uart_t m_uart;
+
+//! @brief Whether any check failed
+static bool m_is_failed = false;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+int main(void)
+{
+        sensor_uart_config_t const config = {
+                        .port = UART_NUM_2,
+                        .tx_pin = 17,
+                        .rx_pin = 16,
+                        .baud_rate = 9600,
+        };
+
+        uint8_t buffer[SENSOR_UART_FRAME_SIZE + 1];
+        sensor_uart_stats_t stats;
+        pthread_t reader;
+        read_t read = {.size = SENSOR_UART_FRAME_SIZE};
+
+        CHECK(sensor_uart_init(&m_uart, &config));
+
+        // The request reaches the line as is
+        printf("request\n");
+
+        CHECK(request());
+        CHECK(sizeof(m_request) == uart_fake_get_written(buffer,
+                                                         sizeof(buffer)));
+        CHECK(0 == memcmp(m_request, buffer, sizeof(m_request)));
+
+        // A frame read in parts, as the driver does to resynchronize
+        printf("partial reads\n");
+
+        CHECK(uart_fake_receive(m_reply_a, sizeof(m_reply_a)));
+        CHECK(MH_Z19_ERROR_SUCCESS == read_bytes(buffer, 4));
+        CHECK(MH_Z19_ERROR_SUCCESS == read_bytes(&buffer[4], 5));
+        CHECK(0 == memcmp(m_reply_a, buffer, sizeof(m_reply_a)));
+
+        // A read spanning two frames takes the rest of the first one, and
+        // waits for the second one
+        printf("spanning read\n");
+
+        CHECK(request());
+        CHECK(uart_fake_receive(m_reply_a, sizeof(m_reply_a)));
+        CHECK(MH_Z19_ERROR_SUCCESS == read_bytes(buffer, 5));
+        CHECK(0 == pthread_create(&reader, NULL, read_run, &read));
+
+        (void)usleep(READER_START_MS * 1000);
+
+        CHECK(uart_fake_receive(m_reply_b, sizeof(m_reply_b)));
+        CHECK(0 == pthread_join(reader, NULL));
+        CHECK(MH_Z19_ERROR_SUCCESS == read.result);
+        CHECK(0 == memcmp(&m_reply_a[5], read.buffer, 4));
+        CHECK(0 == memcmp(m_reply_b, &read.buffer[4], 5));
+
+        // The rest of the second frame is dropped by the next request
+        stats = get_stats();
+
+        CHECK(request());
+        CHECK(stats.unclaimed_frames + 1 == get_stats().unclaimed_frames);
+        CHECK(3 == get_stats().frames);
+
+        // Stray bytes before a frame are dropped
+        printf("stray bytes\n");
+
+        CHECK(uart_fake_receive(m_stray, sizeof(m_stray)));
+        CHECK(uart_fake_receive(m_reply_b, sizeof(m_reply_b)));
+        CHECK(MH_Z19_ERROR_SUCCESS == read_bytes(buffer, sizeof(m_reply_b)));
+        CHECK(0 == memcmp(m_reply_b, buffer, sizeof(m_reply_b)));
+
+        stats = get_stats();
+
+        CHECK(sizeof(m_stray) == stats.parser.discarded_bytes);
+        CHECK(1 == stats.parser.resyncs);
+
+        // Nothing received
+        printf("timeout\n");
+
+        CHECK(request());
+        CHECK(MH_Z19_ERROR_TIMEOUT == read_bytes(buffer, 1));
+
+        // Longer reads than a frame, and missing buffers, are refused
+        printf("bad parameters\n");
+
+        CHECK(MH_Z19_ERROR_BAD_PARAMETER ==
+              read_bytes(buffer, SENSOR_UART_FRAME_SIZE + 1));
+        CHECK(MH_Z19_ERROR_BAD_PARAMETER ==
+              sensor_uart_xfer(&m_uart, NULL, 1, NULL, 0));
+        CHECK(MH_Z19_ERROR_BAD_PARAMETER ==
+              sensor_uart_xfer(NULL, buffer, 1, NULL, 0));
+
+        // An overflow drops the partial frame
+        printf("overflow\n");
+
+        CHECK(request());
+        CHECK(uart_fake_receive(m_reply_a, 5));
+        CHECK(uart_fake_overflow());
+        CHECK(wait_for_overflows(1));
+        CHECK(uart_fake_receive(&m_reply_a[5], 4));
+        CHECK(uart_fake_receive(m_reply_b, sizeof(m_reply_b)));
+        CHECK(MH_Z19_ERROR_SUCCESS == read_bytes(buffer, sizeof(m_reply_b)));
+        CHECK(0 == memcmp(m_reply_b, buffer, sizeof(m_reply_b)));
+
+        printf("%s\n", (m_is_failed) ? "failed" : "passed");
+
+        return (m_is_failed) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Write the request through the transport
+ *
+ * @return              bool                Operation result
+ */
+static bool request(void)
+{
+        return (MH_Z19_ERROR_SUCCESS == sensor_uart_xfer(&m_uart,
+                                                         NULL,
+                                                         0,
+                                                         m_request,
+                                                         sizeof(m_request)));
+}
+
+/*!
+ * @brief Read through the transport
+ *
+ * @param[out]          p_buffer            Pointer where to read the bytes to
+ * @param[in]           size                Amount of bytes to read
+ *
+ * @return              mh_z19_error_t      Operation result
+ */
+static mh_z19_error_t read_bytes(uint8_t * const p_buffer, size_t const size)
+{
+        return sensor_uart_xfer(&m_uart, p_buffer, size, NULL, 0);
+}
+
+/*!
+ * @brief Run a read
+ *
+ * @param[in,out]       p_argument          Pointer to the read
+ *
+ * @return              void *              Always NULL
+ */
+static void * read_run(void * p_argument)
+{
+        read_t * const p_read = (read_t *)p_argument;
+
+        p_read->result = read_bytes(p_read->buffer, p_read->size);
+
+        return NULL;
+}
+
+/*!
+ * @brief Wait until the transport has counted an overflow
+ *
+ * @param[in]           overflows           Overflows to wait for
+ *
+ * @return              bool                False on timeout
+ */
+static bool wait_for_overflows(uint32_t const overflows)
+{
+        uint32_t i;
+
+        for (i = 0; TIMEOUT_MS / POLL_MS > i; ++i) {
+                if (overflows <= get_stats().overflows) {
+                        // Code style exception for the shake of readability
+                        return true;
+                }
+
+                (void)usleep(POLL_MS * 1000);
+        }
+
+        return false;
+}
+
+/*!
+ * @brief Get the transport statistics
+ *
+ * @return              sensor_uart_stats_t Transport statistics
+ */
+static sensor_uart_stats_t get_stats(void)
+{
+        sensor_uart_stats_t stats = {0};
+
+        (void)sensor_uart_get_stats(&m_uart, &stats);
+
+        return stats;
+}
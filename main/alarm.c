@@ -0,0 +1,335 @@
+/*!
+ *******************************************************************************
+ * @file alarm.c
+ *
+ * @brief CO2 threshold alarms of every sensor
+ *
+ * Raw readings are fed to a `co2_alarm` instance per sensor right from the
+ * sample bus notification, in the context of the task publishing them, so a
+ * level change is acted upon as soon as the reading is taken:
+ * - The change is recorded in a RAM log, keeping the latest
+ *   `ALARM_LOG_LENGTH` ones.
+ * - It is handed to the uplink task, which sends it ahead of any routine
+ *   telemetry.
+ * - A raised alarm wakes the display up, so the reading is shown.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "sensor.h"
+#include "sample_bus.h"
+#include "display.h"
+#include "uplink.h"
+#include "co2_alarm.h"
+
+#include "alarm.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+#define TAG                                 "alarm"
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Feed the samples published in the sample bus
+static void on_sample(void * const p_context);
+
+//! @brief Pass a level change on
+static void alarm_raise(alarm_record_t const * const p_record);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Name of each alarm level, for the logs
+static char const * const m_level_names[CO2_ALARM_LEVEL_COUNT] = {
+                "normal",
+                "warning",
+                "critical",
+};
+
+//! @brief Alarm of each sensor, only updated from `on_sample`
+static co2_alarm_t m_alarms[SENSOR_COUNT];
+
+//! @brief Latest level changes, circular
+static alarm_record_t m_log[ALARM_LOG_LENGTH];
+
+//! @brief Number of level changes recorded since initialization
+static uint32_t m_log_count = 0;
+
+//! @brief Protects `m_alarms` levels and `m_log`, taken only for a single
+//!        update or query
+static portMUX_TYPE m_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//! @brief Subscription to the sample bus
+static sample_bus_subscriber_t m_subscriber;
+
+//! @brief Whether `m_subscriber` is subscribed already
+static bool m_is_subscribed = false;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize the alarm module
+ *
+ * Clears every alarm and the log, and subscribes to the sample bus, which has
+ * to be initialized already. Initialize it before the display and the uplink
+ * subscribe to the bus, so a level change is already handed to them
+ * once they are notified of its reading.
+ *
+ * @return              bool                Operation result, fails if the
+ *                                          configured thresholds aren't valid
+ */
+bool alarm_init(void)
+{
+        co2_alarm_config_t const config = {
+                        .warning_ppm = CONFIG_CO2_MONITOR_ALARM_WARNING_PPM,
+                        .critical_ppm = CONFIG_CO2_MONITOR_ALARM_CRITICAL_PPM,
+                        .hysteresis_ppm = CONFIG_CO2_MONITOR_ALARM_HYSTERESIS_PPM,
+                        .dwell_s = CONFIG_CO2_MONITOR_ALARM_DWELL_S,
+        };
+
+        bool success = true;
+        size_t i;
+
+        portENTER_CRITICAL(&m_lock);
+
+        for (i = 0; SENSOR_COUNT > i; ++i) {
+                success = (success) && (co2_alarm_init(&m_alarms[i], &config));
+        }
+
+        m_log_count = 0;
+
+        portEXIT_CRITICAL(&m_lock);
+
+        if ((success) && (!m_is_subscribed)) {
+                success = sample_bus_subscribe(&m_subscriber, on_sample, NULL);
+                m_is_subscribed = success;
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Get the current alarm level of a sensor
+ *
+ * @param[in]           sensor              Index of the sensor
+ *
+ * @return              co2_alarm_level_t   Current level, none for unknown
+ *                                          sensors
+ */
+co2_alarm_level_t alarm_get_level(uint8_t const sensor)
+{
+        co2_alarm_level_t level;
+
+        if (SENSOR_COUNT <= sensor) {
+                // Code style exception for the shake of readability
+                return CO2_ALARM_LEVEL_NONE;
+        }
+
+        portENTER_CRITICAL(&m_lock);
+        level = co2_alarm_get_level(&m_alarms[sensor]);
+        portEXIT_CRITICAL(&m_lock);
+
+        return level;
+}
+
+/*!
+ * @brief Copy the latest alarm level changes, oldest first
+ *
+ * @param[out]          p_records           Pointer where to copy the changes
+ * @param[in]           max_count           Maximum number of changes to copy
+ *
+ * @return              size_t              Number of changes copied
+ */
+size_t alarm_get_log(alarm_record_t * const p_records, size_t const max_count)
+{
+        size_t count;
+        size_t i;
+        uint32_t first;
+
+        if (NULL == p_records) {
+                // Code style exception for the shake of readability
+                return 0;
+        }
+
+        portENTER_CRITICAL(&m_lock);
+
+        count = (ALARM_LOG_LENGTH < m_log_count) ?
+                ALARM_LOG_LENGTH : (size_t)m_log_count;
+
+        if (count > max_count) {
+                count = max_count;
+        }
+
+        first = m_log_count - (uint32_t)count;
+
+        for (i = 0; count > i; ++i) {
+                p_records[i] = m_log[(first + i) % ALARM_LOG_LENGTH];
+        }
+
+        portEXIT_CRITICAL(&m_lock);
+
+        return count;
+}
+
+/*!
+ * @brief Whether any sensor has a level change waiting for its dwell
+ *
+ * Readings should be taken often meanwhile, as the change is only confirmed
+ * by a reading taken once the dwell is over.
+ *
+ * @return              bool                Whether a change is pending
+ */
+bool alarm_is_pending(void)
+{
+        bool is_pending = false;
+        size_t i;
+
+        portENTER_CRITICAL(&m_lock);
+
+        for (i = 0; (!is_pending) && (SENSOR_COUNT > i); ++i) {
+                is_pending = co2_alarm_is_pending(&m_alarms[i]);
+        }
+
+        portEXIT_CRITICAL(&m_lock);
+
+        return is_pending;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Feed the samples published in the sample bus
+ *
+ * Runs in the publisher context, the level changes are passed on right away.
+ *
+ * @param[in]           p_context           Not used
+ *
+ * @return              -                   -
+ */
+static void on_sample(void * const p_context)
+{
+        sample_bus_sample_t const * p_sample;
+        alarm_record_t record;
+        uint32_t time_s;
+        uint32_t co2_ppm;
+        bool is_change;
+
+        (void)p_context;
+
+        p_sample = sample_bus_peek(&m_subscriber);
+
+        while (NULL != p_sample) {
+                co2_ppm = p_sample->reading.co2_ppm[SENSOR_STREAM_RAW];
+                time_s = p_sample->time_s;
+                record.sensor = p_sample->reading.sensor;
+
+                if ((sample_bus_release(&m_subscriber)) &&
+                    (SENSOR_COUNT > record.sensor)) {
+
+                        portENTER_CRITICAL(&m_lock);
+
+                        is_change = co2_alarm_update(
+                                        &m_alarms[record.sensor],
+                                        time_s,
+                                        (UINT16_MAX < co2_ppm) ?
+                                        UINT16_MAX : (uint16_t)co2_ppm,
+                                        &record.event);
+
+                        if (is_change) {
+                                m_log[m_log_count % ALARM_LOG_LENGTH] = record;
+                                ++m_log_count;
+                        }
+
+                        portEXIT_CRITICAL(&m_lock);
+
+                        if (is_change) {
+                                alarm_raise(&record);
+                        }
+                }
+
+                p_sample = sample_bus_peek(&m_subscriber);
+        }
+}
+
+/*!
+ * @brief Pass a level change on
+ *
+ * @param[in]           p_record            Pointer to the level change
+ *
+ * @return              -                   -
+ */
+static void alarm_raise(alarm_record_t const * const p_record)
+{
+        co2_alarm_event_t const * const p_event = &p_record->event;
+
+        ESP_LOGW(TAG, "Sensor %u: %s -> %s at %u ppm",
+                 p_record->sensor,
+                 m_level_names[p_event->previous_level],
+                 m_level_names[p_event->level],
+                 p_event->ppm);
+
+        if (!uplink_send_alarm(p_record)) {
+                ESP_LOGE(TAG, "Alarm couldn't be queued for sending");
+        }
+
+        if (p_event->level > p_event->previous_level) {
+                (void)display_wake();
+        }
+}
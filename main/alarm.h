@@ -0,0 +1,74 @@
+/*!
+ *******************************************************************************
+ * @file alarm.h
+ *
+ * @brief CO2 threshold alarms of every sensor
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef ALARM_H
+#define ALARM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "co2_alarm.h"
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+//! @brief Number of alarm level changes recorded
+#define ALARM_LOG_LENGTH                    (16)
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Alarm level change of a sensor
+typedef struct {
+        //! @brief Index of the sensor
+        uint8_t sensor;
+
+        //! @brief Level change
+        co2_alarm_event_t event;
+} alarm_record_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize the alarm module
+bool alarm_init(void);
+
+//! @brief Get the current alarm level of a sensor
+co2_alarm_level_t alarm_get_level(uint8_t const sensor);
+
+//! @brief Copy the latest alarm level changes, oldest first
+size_t alarm_get_log(alarm_record_t * const p_records, size_t const max_count);
+
+//! @brief Whether any sensor has a level change waiting for its dwell
+bool alarm_is_pending(void);
+
+#endif //ALARM_H
@@ -0,0 +1,903 @@
+/*!
+ *******************************************************************************
+ * @file backlog.c
+ *
+ * @brief Readings waiting to be sent again, across resets
+ *
+ * Every raw reading is already stored in the flash log of the history. So the
+ * backlog doesn't copy readings, it only keeps the time ranges of the ones
+ * that couldn't be sent, one per boot, and reads them again once the server
+ * is reachable:
+ * - The newest readings of this boot are read from a RAM tier of its own,
+ *   holding the last `RAM_READINGS` raw readings published.
+ * - The older ones, and the ones of earlier boots, are read from the flash
+ *   log, keeping only the readings of the boot of the range.
+ *
+ * Ranges are persisted in NVS, along with the wall clock time of their boot,
+ * so the readings of earlier boots are still sent after a reset, and
+ * timestamped. As the end of a range isn't persisted, the readings of an
+ * earlier boot are replayed up to the last one logged. Readings of a boot
+ * whose wall clock time was never known can't be timestamped, so they are
+ * dropped.
+ *
+ * Readings are returned oldest first, with their original times. They are
+ * only done with once the caller commits them, after sending them, or taken
+ * again if it rewinds the backlog instead. Ranges added while replaying are
+ * merged into the one of this boot, and replaying it starts over if the
+ * merged range starts earlier. Readings sent twice are harmless, as
+ * Thingsboard keeps a single value per key and timestamp.
+ *
+ * Its depth is only an estimate: readings are counted as they enter the
+ * backlog and as they are taken out, and the ones left once the range has
+ * been replayed are counted as dropped.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+
+#include "sample_bus.h"
+#include "history.h"
+#include "sample_log.h"
+#include "backlog.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+#define TAG                                 "backlog"
+
+#define RAM_READINGS                        (CONFIG_CO2_MONITOR_UPLINK_BACKLOG_RAM_READINGS)
+
+//! @brief Stored readings looked at by a single `backlog_next` call, so the
+//!        caller isn't held up while skipping the ones already sent
+#define SCAN_LIMIT                          (1024)
+
+//! @brief Ranges kept, the one of this boot and the ones of earlier boots
+#define RANGE_COUNT                         (4)
+
+//! @brief NVS namespace and key the ranges are persisted with
+#define NVS_NAMESPACE                       "backlog"
+#define NVS_KEY                             "ranges"
+
+//! @brief Progress through the oldest range after which it is persisted
+//!        again, so replaying doesn't write NVS on every commit (in seconds)
+#define PERSIST_STEP_S                      (600)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Replay phases of a range
+typedef enum {
+        //! @brief Replay not started, tier not chosen yet
+        PHASE_START = 0,
+
+        //! @brief Reading the part of the range only left in flash
+        PHASE_LOGGED,
+
+        //! @brief Reading the part of the range still held in RAM
+        PHASE_STORED,
+} phase_t;
+
+//! @brief Readings of a boot waiting to be sent, as persisted
+typedef struct {
+        //! @brief Wall clock time of the boot, 0 if unknown (in milliseconds
+        //!        since the epoch)
+        int64_t epoch_ms;
+
+        //! @brief Time of the first reading not sent yet (in seconds since
+        //!        the boot)
+        uint32_t from_s;
+
+        //! @brief Time of the last reading (in seconds since the boot)
+        uint32_t to_s;
+
+        //! @brief Boot counter the readings are logged with
+        uint8_t boot;
+} range_t;
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Store a new raw reading in the RAM tier
+static void on_sample(void * const p_context);
+
+//! @brief Restore the ranges of earlier boots
+static void backlog_restore(void);
+
+//! @brief Persist the ranges
+static void backlog_persist(void);
+
+//! @brief Drop the oldest range, to make room for a new one
+static void backlog_drop_oldest(void);
+
+//! @brief Whether a range holds readings of this boot
+static bool backlog_is_current(size_t const range);
+
+//! @brief Choose the tier the replay of a range starts with
+static void backlog_start(void);
+
+//! @brief Look at the next reading of the flash log
+static bool backlog_scan_logged(history_record_t * const p_record);
+
+//! @brief Look at the next reading held in RAM
+static bool backlog_scan_stored(history_record_t * const p_record);
+
+//! @brief Move on to the next range, once replayed
+static void backlog_finish(void);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Ranges waiting to be sent, oldest boot first
+static range_t m_ranges[RANGE_COUNT];
+
+//! @brief Amount of ranges in `m_ranges`
+static size_t m_range_count = 0;
+
+//! @brief Whether the newest range holds readings of this boot
+static bool m_is_current = false;
+
+//! @brief Range being replayed, the ones before it have been taken already
+static size_t m_range = 0;
+
+//! @brief Time the replay resumes at, the readings of the range before it
+//!        have been taken already (in seconds since its boot)
+static uint32_t m_watermark_s;
+
+//! @brief Whether readings have been taken since the last commit
+static bool m_is_taken = false;
+
+//! @brief Replay phase
+static phase_t m_phase = PHASE_START;
+
+//! @brief Position of the replay within the RAM tier
+static uint32_t m_stored_cursor;
+
+//! @brief Position of the replay within the flash log
+static sample_log_cursor_t m_logged_cursor;
+
+//! @brief Whether readings of the boot of the range have been found in the
+//!        flash log, the first reading of another boot after them ends it
+static bool m_is_boot_logged;
+
+//! @brief Time of the oldest reading held in RAM when the replay started, the
+//!        flash log is read up to it (in seconds since boot)
+static uint32_t m_stored_oldest_s;
+
+//! @brief Boot counter of the readings of this boot in the flash log
+static uint8_t m_boot;
+
+//! @brief Whether the readings are logged in flash
+static bool m_is_logged = false;
+
+//! @brief Wall clock time of this boot, 0 until known (in milliseconds since
+//!        the epoch)
+static int64_t m_epoch_ms = 0;
+
+//! @brief Handle to the NVS namespace the ranges are persisted in
+static nvs_handle_t m_nvs;
+
+//! @brief Whether the ranges are persisted
+static bool m_is_persistent = false;
+
+//! @brief Start of the oldest range when last persisted (in seconds since its
+//!        boot)
+static uint32_t m_persisted_from_s = 0;
+
+//! @brief Subscription to the sample bus
+static sample_bus_subscriber_t m_subscriber;
+
+//! @brief RAM tier, newest raw readings of this boot (circular)
+static history_record_t m_stored[RAM_READINGS];
+
+//! @brief Readings stored in the RAM tier since boot, the next one goes at
+//!        this count modulo `RAM_READINGS`
+static uint32_t m_stored_head = 0;
+
+//! @brief Protects the RAM tier, written from the publisher context
+static portMUX_TYPE m_stored_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//! @brief Backlog counters
+static backlog_stats_t m_stats;
+
+//! @brief Protects `m_stats`, taken only for a single update or query
+static portMUX_TYPE m_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize the backlog, restoring the readings of earlier boots
+ *
+ * The history and NVS have to be initialized already, NVS is by `app_main`.
+ * The backlog still works if the ranges can't be persisted, but is lost on
+ * reset.
+ *
+ * @return              bool                Operation result
+ */
+bool backlog_init(void)
+{
+        esp_err_t result;
+        bool success;
+
+        success = sample_bus_subscribe(&m_subscriber, on_sample, NULL);
+
+        // Ranges are only worth persisting if their readings are too
+        m_is_logged = history_get_logged_boot(&m_boot);
+
+        if ((success) && (m_is_logged)) {
+                result = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &m_nvs);
+
+                m_is_persistent = (ESP_OK == result);
+
+                if (m_is_persistent) {
+                        backlog_restore();
+                } else {
+                        ESP_LOGW(TAG, "Backlog can't be persisted: %s",
+                                 esp_err_to_name(result));
+                }
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Set the wall clock time of this boot
+ *
+ * Readings of this boot are only returned once it is known. Must always be
+ * called from the same task as `backlog_next`.
+ *
+ * @param[in]           epoch_ms            Wall clock time of the boot (in
+ *                                          milliseconds since the epoch)
+ *
+ * @return              -                   -
+ */
+void backlog_set_epoch(int64_t const epoch_ms)
+{
+        range_t * p_range;
+        bool is_first;
+
+        m_epoch_ms = epoch_ms;
+
+        if (!m_is_current) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        p_range = &m_ranges[m_range_count - 1];
+        is_first = (0 == p_range->epoch_ms);
+
+        // Follows the clock adjustments, as the live telemetry does
+        p_range->epoch_ms = epoch_ms;
+
+        if (is_first) {
+                backlog_persist();
+        }
+}
+
+/*!
+ * @brief Add the readings taken within a time range to the backlog
+ *
+ * The readings have to be stored in the history already. Must always be
+ * called from the same task as `backlog_next`.
+ *
+ * @param[in]           from_s              Time of the first reading (in
+ *                                          seconds since boot)
+ * @param[in]           to_s                Time of the last reading (in
+ *                                          seconds since boot)
+ * @param[in]           count               Amount of readings, only used for
+ *                                          the counters
+ *
+ * @return              -                   -
+ */
+void backlog_add(uint32_t const from_s,
+                 uint32_t const to_s,
+                 uint32_t const count)
+{
+        range_t * p_range;
+        size_t range;
+        bool is_new;
+
+        if (from_s > to_s) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        portENTER_CRITICAL(&m_stats_lock);
+        m_stats.queued += count;
+        m_stats.depth += count;
+        portEXIT_CRITICAL(&m_stats_lock);
+
+        is_new = !m_is_current;
+
+        if (is_new) {
+                if (RANGE_COUNT <= m_range_count) {
+                        backlog_drop_oldest();
+                }
+
+                p_range = &m_ranges[m_range_count++];
+                p_range->epoch_ms = m_epoch_ms;
+                p_range->from_s = from_s;
+                p_range->to_s = to_s;
+                p_range->boot = m_boot;
+
+                m_is_current = true;
+        } else {
+                p_range = &m_ranges[m_range_count - 1];
+
+                if (to_s > p_range->to_s) {
+                        p_range->to_s = to_s;
+                }
+        }
+
+        range = m_range_count - 1;
+
+        // Readings already taken have to be taken again
+        if ((range < m_range) ||
+            ((range == m_range) &&
+             ((is_new) || (from_s < m_watermark_s)))) {
+
+                m_range = range;
+                m_watermark_s = from_s;
+                m_phase = PHASE_START;
+        }
+
+        if (from_s < p_range->from_s) {
+                p_range->from_s = from_s;
+                is_new = true;
+        }
+
+        if (is_new) {
+                backlog_persist();
+        }
+}
+
+/*!
+ * @brief Get the oldest reading in the backlog, if found soon enough
+ *
+ * At most `SCAN_LIMIT` stored readings are looked at, so it may return
+ * nothing even if the backlog isn't empty, call it again later on.
+ *
+ * @param[out]          p_record            Pointer where to copy the reading,
+ *                                          its time is since its own boot
+ * @param[out]          p_epoch_ms          Pointer where to copy the wall
+ *                                          clock time of the reading (in
+ *                                          milliseconds since the epoch)
+ *
+ * @return              bool                Whether there was a reading
+ */
+bool backlog_next(history_record_t * const p_record,
+                  int64_t * const p_epoch_ms)
+{
+        bool is_found = false;
+        bool is_logged = false;
+        uint32_t scanned;
+
+        if ((NULL == p_record) || (NULL == p_epoch_ms)) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        for (scanned = 0;
+             ((m_range_count > m_range) && (!is_found) &&
+              ((!backlog_is_current(m_range)) || (0 != m_epoch_ms)) &&
+              (SCAN_LIMIT > scanned));
+             ++scanned) {
+
+                switch (m_phase) {
+                case PHASE_START:
+                        backlog_start();
+                        break;
+                case PHASE_LOGGED:
+                        is_found = backlog_scan_logged(p_record);
+                        is_logged = is_found;
+                        break;
+                case PHASE_STORED:
+                default:
+                        is_found = backlog_scan_stored(p_record);
+                        break;
+                }
+        }
+
+        if (is_found) {
+                m_watermark_s = p_record->time_s;
+                m_is_taken = true;
+
+                *p_epoch_ms = m_ranges[m_range].epoch_ms +
+                              ((int64_t)p_record->time_s * 1000);
+
+                portENTER_CRITICAL(&m_stats_lock);
+
+                ++m_stats.drained;
+
+                if (is_logged) {
+                        ++m_stats.from_flash;
+                }
+
+                if (0 != m_stats.depth) {
+                        --m_stats.depth;
+                }
+
+                portEXIT_CRITICAL(&m_stats_lock);
+        }
+
+        return is_found;
+}
+
+/*!
+ * @brief Done with the readings taken so far, they have been sent
+ *
+ * Ranges replayed to their end are dropped.
+ *
+ * @return              -                   -
+ */
+void backlog_commit(void)
+{
+        size_t const done = m_range;
+
+        m_is_taken = false;
+
+        if (m_range_count > done) {
+                if (m_watermark_s > m_ranges[done].from_s) {
+                        m_ranges[done].from_s = m_watermark_s;
+                }
+
+                memmove(&m_ranges[0],
+                        &m_ranges[done],
+                        (m_range_count - done) * sizeof(m_ranges[0]));
+        }
+
+        m_range_count -= done;
+        m_range = 0;
+        m_is_current = ((m_is_current) && (0 != m_range_count));
+
+        portENTER_CRITICAL(&m_stats_lock);
+        m_stats.boots = m_range_count - ((m_is_current) ? 1 : 0);
+        portEXIT_CRITICAL(&m_stats_lock);
+
+        // Overflow is meant to happen
+        if ((0 != done) ||
+            ((0 != m_range_count) &&
+             ((m_ranges[0].from_s - m_persisted_from_s) >= PERSIST_STEP_S))) {
+
+                backlog_persist();
+        }
+}
+
+/*!
+ * @brief Take the readings taken since the last commit again
+ *
+ * @return              -                   -
+ */
+void backlog_rewind(void)
+{
+        m_is_taken = false;
+        m_range = 0;
+        m_phase = PHASE_START;
+
+        if (0 != m_range_count) {
+                m_watermark_s = m_ranges[0].from_s;
+        }
+}
+
+/*!
+ * @brief Get the backlog counters
+ *
+ * @param[out]          p_stats             Pointer where to copy the counters
+ *
+ * @return              bool                Operation result
+ */
+bool backlog_get_stats(backlog_stats_t * const p_stats)
+{
+        bool const success = (NULL != p_stats);
+
+        if (success) {
+                portENTER_CRITICAL(&m_stats_lock);
+                *p_stats = m_stats;
+                portEXIT_CRITICAL(&m_stats_lock);
+        }
+
+        return success;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Restore the ranges of earlier boots
+ *
+ * Readings logged after a range was last persisted may not have been sent,
+ * so earlier boots are replayed up to their last reading.
+ *
+ * @return              -                   -
+ */
+static void backlog_restore(void)
+{
+        size_t size = sizeof(m_ranges);
+        esp_err_t result;
+        size_t range;
+
+        result = nvs_get_blob(m_nvs, NVS_KEY, m_ranges, &size);
+
+        if ((ESP_OK != result) || (0 != (size % sizeof(m_ranges[0])))) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        m_range_count = size / sizeof(m_ranges[0]);
+
+        for (range = 0; m_range_count > range; ++range) {
+                m_ranges[range].to_s = UINT32_MAX;
+        }
+
+        m_range = 0;
+        m_phase = PHASE_START;
+
+        if (0 != m_range_count) {
+                m_watermark_s = m_ranges[0].from_s;
+                m_persisted_from_s = m_ranges[0].from_s;
+        }
+
+        portENTER_CRITICAL(&m_stats_lock);
+        m_stats.boots = m_range_count;
+        portEXIT_CRITICAL(&m_stats_lock);
+
+        ESP_LOGI(TAG, "%u earlier boots with readings waiting",
+                 (unsigned int)m_range_count);
+}
+
+/*!
+ * @brief Persist the ranges
+ *
+ * @return              -                   -
+ */
+static void backlog_persist(void)
+{
+        esp_err_t result;
+
+        if (!m_is_persistent) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        if (0 == m_range_count) {
+                result = nvs_erase_key(m_nvs, NVS_KEY);
+
+                if (ESP_ERR_NVS_NOT_FOUND == result) {
+                        result = ESP_OK;
+                }
+        } else {
+                result = nvs_set_blob(m_nvs,
+                                      NVS_KEY,
+                                      m_ranges,
+                                      m_range_count * sizeof(m_ranges[0]));
+        }
+
+        if (ESP_OK == result) {
+                result = nvs_commit(m_nvs);
+        }
+
+        if (ESP_OK != result) {
+                ESP_LOGW(TAG, "Backlog couldn't be persisted: %s",
+                         esp_err_to_name(result));
+        }
+
+        m_persisted_from_s = (0 != m_range_count) ? m_ranges[0].from_s : 0;
+}
+
+/*!
+ * @brief Drop the oldest range, to make room for a new one
+ *
+ * @return              -                   -
+ */
+static void backlog_drop_oldest(void)
+{
+        ESP_LOGW(TAG, "Too many boots with readings waiting, oldest dropped");
+
+        memmove(&m_ranges[0],
+                &m_ranges[1],
+                (m_range_count - 1) * sizeof(m_ranges[0]));
+
+        --m_range_count;
+
+        if (0 != m_range) {
+                --m_range;
+        } else {
+                m_phase = PHASE_START;
+
+                if (0 != m_range_count) {
+                        m_watermark_s = m_ranges[0].from_s;
+                }
+        }
+
+        portENTER_CRITICAL(&m_stats_lock);
+
+        if (0 != m_stats.boots) {
+                --m_stats.boots;
+        }
+
+        portEXIT_CRITICAL(&m_stats_lock);
+}
+
+/*!
+ * @brief Whether a range holds readings of this boot
+ *
+ * @param[in]           range               Index of the range
+ *
+ * @return              bool                Whether it does
+ */
+static bool backlog_is_current(size_t const range)
+{
+        return ((m_is_current) && ((m_range_count - 1) == range));
+}
+
+/*!
+ * @brief Choose the tier the replay of a range starts with
+ *
+ * The flash log is only read if the RAM tier doesn't go back far enough,
+ * which is always the case for earlier boots.
+ *
+ * @return              -                   -
+ */
+static void backlog_start(void)
+{
+        bool const is_current = backlog_is_current(m_range);
+
+        uint32_t head;
+
+        m_stored_oldest_s = UINT32_MAX;
+
+        if (is_current) {
+                portENTER_CRITICAL(&m_stored_lock);
+
+                head = m_stored_head;
+                m_stored_cursor = (RAM_READINGS < head) ?
+                                  (head - RAM_READINGS) : 0;
+
+                if (head != m_stored_cursor) {
+                        m_stored_oldest_s =
+                                m_stored[m_stored_cursor % RAM_READINGS].time_s;
+                }
+
+                portEXIT_CRITICAL(&m_stored_lock);
+        }
+
+        if ((m_is_logged) && (m_stored_oldest_s > m_watermark_s)) {
+                memset(&m_logged_cursor, 0, sizeof(m_logged_cursor));
+                m_is_boot_logged = false;
+                m_phase = PHASE_LOGGED;
+        } else if (is_current) {
+                m_phase = PHASE_STORED;
+        } else {
+                backlog_finish();
+        }
+}
+
+/*!
+ * @brief Look at the next reading of the flash log
+ *
+ * Moves on to the RAM tier at the end of the readings of the boot, or once
+ * the readings are held in RAM too. Readings of an earlier boot whose wall
+ * clock time is unknown are dropped.
+ *
+ * @param[out]          p_record            Pointer where to copy the reading
+ *
+ * @return              bool                Whether it belongs to the backlog
+ */
+static bool backlog_scan_logged(history_record_t * const p_record)
+{
+        range_t const * const p_range = &m_ranges[m_range];
+        bool const is_current = backlog_is_current(m_range);
+
+        sample_log_record_t logged;
+
+        if ((!history_read_logged(&m_logged_cursor, &logged)) ||
+            ((m_is_boot_logged) && (p_range->boot != logged.boot))) {
+
+                if (is_current) {
+                        m_phase = PHASE_STORED;
+                } else {
+                        backlog_finish();
+                }
+
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        // Times of other boots can't be compared
+        if (p_range->boot != logged.boot) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        m_is_boot_logged = true;
+
+        if (logged.time_s > p_range->to_s) {
+                backlog_finish();
+        } else if (logged.time_s >= m_stored_oldest_s) {
+                m_phase = PHASE_STORED;
+        } else if ((logged.time_s >= m_watermark_s) &&
+                   (0 == p_range->epoch_ms)) {
+
+                portENTER_CRITICAL(&m_stats_lock);
+                ++m_stats.dropped;
+                portEXIT_CRITICAL(&m_stats_lock);
+        } else if (logged.time_s >= m_watermark_s) {
+                p_record->time_s = logged.time_s;
+                p_record->co2_ppm = logged.co2_ppm;
+                p_record->sensor = logged.sensor;
+
+                // Code style exception for the shake of readability
+                return true;
+        }
+
+        return false;
+}
+
+/*!
+ * @brief Look at the next reading held in RAM
+ *
+ * Ends the range once past it, or at the newest reading. Starts over if the
+ * reading was overwritten, to read it from the flash log instead.
+ *
+ * @param[out]          p_record            Pointer where to copy the reading
+ *
+ * @return              bool                Whether it belongs to the backlog
+ */
+static bool backlog_scan_stored(history_record_t * const p_record)
+{
+        bool is_overwritten;
+        bool is_end;
+
+        portENTER_CRITICAL(&m_stored_lock);
+
+        // Overflow is meant to happen
+        is_overwritten = (RAM_READINGS < (m_stored_head - m_stored_cursor));
+        is_end = (m_stored_head == m_stored_cursor);
+
+        if ((!is_overwritten) && (!is_end)) {
+                *p_record = m_stored[m_stored_cursor % RAM_READINGS];
+                ++m_stored_cursor;
+        }
+
+        portEXIT_CRITICAL(&m_stored_lock);
+
+        if (is_overwritten) {
+                m_phase = PHASE_START;
+
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        if ((is_end) || (p_record->time_s > m_ranges[m_range].to_s)) {
+                backlog_finish();
+
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        return (p_record->time_s >= m_watermark_s);
+}
+
+/*!
+ * @brief Move on to the next range, once replayed
+ *
+ * Once every range has been replayed, readings still counted in the backlog
+ * weren't found, so they are dropped. Ranges replayed without taking any
+ * reading are committed right away, as there is nothing to send.
+ *
+ * @return              -                   -
+ */
+static void backlog_finish(void)
+{
+        ++m_range;
+        m_phase = PHASE_START;
+
+        if (m_range_count > m_range) {
+                m_watermark_s = m_ranges[m_range].from_s;
+        } else {
+                portENTER_CRITICAL(&m_stats_lock);
+                m_stats.dropped += m_stats.depth;
+                m_stats.depth = 0;
+                portEXIT_CRITICAL(&m_stats_lock);
+        }
+
+        if (!m_is_taken) {
+                backlog_commit();
+        }
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Store a new raw reading in the RAM tier
+ *
+ * Runs from the publisher context, so it only copies the reading.
+ *
+ * @param[in]           p_context           Not used
+ *
+ * @return              -                   -
+ */
+static void on_sample(void * const p_context)
+{
+        sample_bus_sample_t const * p_sample;
+        history_record_t record;
+        uint32_t co2_ppm;
+
+        (void)p_context;
+
+        p_sample = sample_bus_peek(&m_subscriber);
+
+        while (NULL != p_sample) {
+                co2_ppm = p_sample->reading.co2_ppm[SENSOR_STREAM_RAW];
+
+                record.time_s = p_sample->time_s;
+                record.co2_ppm = (UINT16_MAX < co2_ppm) ?
+                                 UINT16_MAX : (uint16_t)co2_ppm;
+                record.sensor = p_sample->reading.sensor;
+
+                if (sample_bus_release(&m_subscriber)) {
+                        portENTER_CRITICAL(&m_stored_lock);
+                        m_stored[m_stored_head % RAM_READINGS] = record;
+                        ++m_stored_head;
+                        portEXIT_CRITICAL(&m_stored_lock);
+                }
+
+                p_sample = sample_bus_peek(&m_subscriber);
+        }
+}
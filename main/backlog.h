@@ -0,0 +1,96 @@
+/*!
+ *******************************************************************************
+ * @file backlog.h
+ *
+ * @brief Readings waiting to be sent again, across resets
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef BACKLOG_H
+#define BACKLOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "history.h"
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Backlog counters, since boot
+typedef struct {
+        //! @brief Readings waiting to be sent, estimated
+        uint32_t depth;
+
+        //! @brief Readings which couldn't be sent, and entered the backlog
+        uint32_t queued;
+
+        //! @brief Readings taken from the backlog
+        uint32_t drained;
+
+        //! @brief Readings taken from the backlog which were only left in flash
+        uint32_t from_flash;
+
+        //! @brief Readings which left the history before being taken, or
+        //!        of an earlier boot whose wall clock time was never known
+        uint32_t dropped;
+
+        //! @brief Earlier boots with readings waiting to be sent
+        uint32_t boots;
+} backlog_stats_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize the backlog, restoring the readings of earlier boots
+bool backlog_init(void);
+
+//! @brief Set the wall clock time of this boot
+void backlog_set_epoch(int64_t const epoch_ms);
+
+//! @brief Add the readings taken within a time range to the backlog
+void backlog_add(uint32_t const from_s,
+                 uint32_t const to_s,
+                 uint32_t const count);
+
+//! @brief Get the oldest reading in the backlog, if found soon enough
+bool backlog_next(history_record_t * const p_record,
+                  int64_t * const p_epoch_ms);
+
+//! @brief Done with the readings taken so far, they have been sent
+void backlog_commit(void);
+
+//! @brief Take the readings taken since the last commit again
+void backlog_rewind(void);
+
+//! @brief Get the backlog counters
+bool backlog_get_stats(backlog_stats_t * const p_stats);
+
+#endif //BACKLOG_H
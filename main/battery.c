@@ -33,6 +33,7 @@
 #include "driver/adc_common.h"
 
 #include "display.h"
+#include "device_state.h"
 
 #include "battery.h"
 
@@ -170,6 +171,7 @@ _Noreturn static void battery_task(void * pvParameters)
                 battery_level = raw_value * m_max_voltage / m_max_raw;
                 battery_level *= m_scale_factor;
 
+                device_state_set_battery(battery_level);
                 (void)display_set_battery_level(battery_level);
 
                 ESP_LOGI(TAG,"Max stack usage: %d of %d bytes", TASK_STACK_DEPTH - uxTaskGetStackHighWaterMark(NULL), TASK_STACK_DEPTH);
@@ -0,0 +1,245 @@
+/*!
+ *******************************************************************************
+ * @file co2_alarm.c
+ *
+ * @brief CO2 threshold alarm with hysteresis and minimum dwell
+ *
+ * Each sample calls for the most severe level whose threshold it reaches.
+ * Levels at or below the current one are held down to their threshold minus
+ * the hysteresis, so a concentration hovering around a threshold doesn't
+ * toggle the level.
+ *
+ * A level change is only taken once the samples have called for it during
+ * the dwell time, so a single spike doesn't raise the alarm. While rising (or
+ * falling) through several levels, the least severe (or most severe) one
+ * called for since the change started is taken, as it is the one that held
+ * all along.
+ *
+ * It doesn't depend on any framework, so it builds for the target as well as
+ * for a Linux host.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "co2_alarm.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Level a sample calls for, given the current one
+static co2_alarm_level_t target_level(co2_alarm_t const * const p_alarm,
+                                      uint16_t const ppm);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize an alarm instance
+ *
+ * @param[out]          p_alarm             Pointer to the alarm instance
+ * @param[in]           p_config            Pointer to the configuration
+ *
+ * @return              bool                Operation result, fails if the
+ *                                          critical threshold isn't above the
+ *                                          warning one, or the hysteresis
+ *                                          isn't below the warning threshold
+ */
+bool co2_alarm_init(co2_alarm_t * const p_alarm,
+                    co2_alarm_config_t const * const p_config)
+{
+        bool success = ((NULL != p_alarm) &&
+                        (NULL != p_config) &&
+                        (p_config->warning_ppm < p_config->critical_ppm) &&
+                        (p_config->hysteresis_ppm < p_config->warning_ppm));
+
+        if (success) {
+                memset(p_alarm, 0, sizeof(*p_alarm));
+                p_alarm->config = *p_config;
+                p_alarm->level = CO2_ALARM_LEVEL_NONE;
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Feed a new sample, telling whether it changed the level
+ *
+ * @param[in,out]       p_alarm             Pointer to the alarm instance
+ * @param[in]           time_s              Sample time (in seconds, wrapping
+ *                                          around is fine)
+ * @param[in]           ppm                 Sampled concentration (in ppm)
+ * @param[out]          p_event             Pointer where to copy the level
+ *                                          change
+ *
+ * @return              bool                Whether the level changed, and the
+ *                                          change was copied into `p_event`
+ */
+bool co2_alarm_update(co2_alarm_t * const p_alarm,
+                      uint32_t const time_s,
+                      uint16_t const ppm,
+                      co2_alarm_event_t * const p_event)
+{
+        co2_alarm_level_t target;
+        bool is_rising;
+        bool is_change = false;
+
+        if ((NULL == p_alarm) || (NULL == p_event)) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        target = target_level(p_alarm, ppm);
+        is_rising = (target > p_alarm->level);
+
+        if (target == p_alarm->level) {
+                p_alarm->has_candidate = false;
+        } else if ((!p_alarm->has_candidate) ||
+                   (is_rising != (p_alarm->candidate > p_alarm->level))) {
+
+                p_alarm->has_candidate = true;
+                p_alarm->candidate = target;
+                p_alarm->candidate_time_s = time_s;
+        } else if ((is_rising) ?
+                   (target < p_alarm->candidate) :
+                   (target > p_alarm->candidate)) {
+
+                p_alarm->candidate = target;
+        }
+
+        // Overflow is meant to happen
+        if ((p_alarm->has_candidate) &&
+            ((time_s - p_alarm->candidate_time_s) >= p_alarm->config.dwell_s)) {
+
+                p_event->time_s = time_s;
+                p_event->ppm = ppm;
+                p_event->level = p_alarm->candidate;
+                p_event->previous_level = p_alarm->level;
+
+                p_alarm->level = p_alarm->candidate;
+                p_alarm->has_candidate = false;
+                is_change = true;
+        }
+
+        return is_change;
+}
+
+/*!
+ * @brief Get the current level
+ *
+ * @param[in]           p_alarm             Pointer to the alarm instance
+ *
+ * @return              co2_alarm_level_t   Current level
+ */
+co2_alarm_level_t co2_alarm_get_level(co2_alarm_t const * const p_alarm)
+{
+        return (NULL != p_alarm) ? p_alarm->level : CO2_ALARM_LEVEL_NONE;
+}
+
+/*!
+ * @brief Whether a level change is waiting for its dwell
+ *
+ * The change is only confirmed by a sample taken once the dwell is over.
+ *
+ * @param[in]           p_alarm             Pointer to the alarm instance
+ *
+ * @return              bool                Whether a change is pending
+ */
+bool co2_alarm_is_pending(co2_alarm_t const * const p_alarm)
+{
+        return (NULL != p_alarm) ? p_alarm->has_candidate : false;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Level a sample calls for, given the current one
+ *
+ * @param[in]           p_alarm             Pointer to the alarm instance
+ * @param[in]           ppm                 Sampled concentration (in ppm)
+ *
+ * @return              co2_alarm_level_t   Level called for
+ */
+static co2_alarm_level_t target_level(co2_alarm_t const * const p_alarm,
+                                      uint16_t const ppm)
+{
+        uint32_t const thresholds_ppm[CO2_ALARM_LEVEL_COUNT] = {
+                        0,
+                        p_alarm->config.warning_ppm,
+                        p_alarm->config.critical_ppm,
+        };
+
+        co2_alarm_level_t level = CO2_ALARM_LEVEL_CRITICAL;
+        uint32_t threshold_ppm;
+
+        for (; CO2_ALARM_LEVEL_NONE < level; --level) {
+                threshold_ppm = thresholds_ppm[level];
+
+                // Levels already reached are left further down
+                if (level <= p_alarm->level) {
+                        threshold_ppm -= p_alarm->config.hysteresis_ppm;
+                }
+
+                if (ppm >= threshold_ppm) {
+                        break;
+                }
+        }
+
+        return level;
+}
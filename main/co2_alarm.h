@@ -0,0 +1,130 @@
+/*!
+ *******************************************************************************
+ * @file co2_alarm.h
+ *
+ * @brief CO2 threshold alarm with hysteresis and minimum dwell
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef CO2_ALARM_H
+#define CO2_ALARM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Alarm levels, from the least to the most severe
+typedef enum {
+        CO2_ALARM_LEVEL_NONE = 0,
+        CO2_ALARM_LEVEL_WARNING,
+        CO2_ALARM_LEVEL_CRITICAL,
+        CO2_ALARM_LEVEL_COUNT
+} co2_alarm_level_t;
+
+//! @brief Alarm configuration
+typedef struct {
+        //! @brief Concentration raising the warning level (in ppm)
+        uint16_t warning_ppm;
+
+        //! @brief Concentration raising the critical level (in ppm), above
+        //!        the warning one
+        uint16_t critical_ppm;
+
+        //! @brief How far below its threshold the concentration has to go to
+        //!        leave a level (in ppm)
+        uint16_t hysteresis_ppm;
+
+        //! @brief Time a new level has to hold before it is taken (in
+        //!        seconds, 0 for right away)
+        uint32_t dwell_s;
+} co2_alarm_config_t;
+
+//! @brief Change of alarm level
+typedef struct {
+        //! @brief Time of the sample taking the new level (in seconds)
+        uint32_t time_s;
+
+        //! @brief Sample taking the new level (in ppm)
+        uint16_t ppm;
+
+        //! @brief New level
+        co2_alarm_level_t level;
+
+        //! @brief Level left
+        co2_alarm_level_t previous_level;
+} co2_alarm_event_t;
+
+/*!
+ * @brief Alarm instance, for a single series of samples
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Alarm configuration
+        co2_alarm_config_t config;
+
+        //! @brief Current level
+        co2_alarm_level_t level;
+
+        //! @brief Whether a level change is waiting for its dwell
+        bool has_candidate;
+
+        //! @brief Level waiting for its dwell
+        co2_alarm_level_t candidate;
+
+        //! @brief Time the samples started calling for a level change (in
+        //!        seconds)
+        uint32_t candidate_time_s;
+} co2_alarm_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize an alarm instance
+bool co2_alarm_init(co2_alarm_t * const p_alarm,
+                    co2_alarm_config_t const * const p_config);
+
+//! @brief Feed a new sample, telling whether it changed the level
+bool co2_alarm_update(co2_alarm_t * const p_alarm,
+                      uint32_t const time_s,
+                      uint16_t const ppm,
+                      co2_alarm_event_t * const p_event);
+
+//! @brief Get the current level
+co2_alarm_level_t co2_alarm_get_level(co2_alarm_t const * const p_alarm);
+
+//! @brief Whether a level change is waiting for its dwell
+bool co2_alarm_is_pending(co2_alarm_t const * const p_alarm);
+
+#endif //CO2_ALARM_H
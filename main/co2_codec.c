@@ -0,0 +1,653 @@
+/*!
+ *******************************************************************************
+ * @file co2_codec.c
+ *
+ * @brief Compressed encoding of CO2 time series
+ *
+ * Bit packed encoding in the spirit of the Gorilla time series compression,
+ * adapted to integer CO2 readings:
+ *
+ * - Time is encoded as the change of the time elapsed between samples (delta
+ *   of delta), which is 0 for evenly spaced samples and takes a single bit.
+ * - Concentration is encoded as the change since the previous sample of the
+ *   same channel. XOR is meant for floating point values, integer deltas are
+ *   zig-zag encoded instead, so small changes of either sign are small
+ *   numbers.
+ *
+ * Each field starts with a unary prefix (up to four bits) telling its size:
+ *
+ *      prefix  time (delta of delta)   concentration (delta)
+ *      0       0                       0
+ *      10      4 bits zig-zag          3 bits zig-zag
+ *      110     9 bits zig-zag          5 bits zig-zag
+ *      1110    16 bits zig-zag         8 bits zig-zag
+ *      1111    32 bits                 16 bits, absolute value
+ *
+ * The first sample stores its time as 32 bits, with no prefix. When several
+ * series (channels) are interleaved in a stream, each sample has the channel
+ * index between both fields, and times and values are relative to the
+ * previous sample of the same channel, so each series stays evenly spaced.
+ * The first sample of a channel is relative to the previous sample of the
+ * stream. Slowly changing, evenly sampled readings take 1 to 2 bytes.
+ *
+ * The stream doesn't tell its own length: the decoder has to be told how many
+ * samples to decode, as the padding of the last byte could be taken for
+ * samples.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "co2_codec.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Amount of field sizes, and longest prefix
+#define BUCKET_COUNT                        (5)
+
+//! @brief Bits of the time of the first sample
+#define FIRST_TIME_BITS                     (32)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+//! @brief Bits after each prefix of the time field
+static uint8_t const m_time_bits[BUCKET_COUNT] = {0, 4, 9, 16, 32};
+
+//! @brief Bits after each prefix of the concentration field
+static uint8_t const m_ppm_bits[BUCKET_COUNT] = {0, 3, 5, 8, 16};
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Get the smallest bucket holding a value
+static uint8_t find_bucket(uint8_t const * const p_bits, uint32_t const value);
+
+//! @brief Bits taken by a field of a bucket, prefix included
+static uint8_t field_bits(uint8_t const * const p_bits, uint8_t const bucket);
+
+//! @brief Write a field, prefix included
+static void put_field(co2_codec_t * const p_codec,
+                      uint8_t const * const p_bits,
+                      uint8_t const bucket,
+                      uint32_t const value);
+
+//! @brief Read a field, prefix included
+static bool get_field(co2_codec_t * const p_codec,
+                      uint8_t const * const p_bits,
+                      uint8_t * const p_bucket,
+                      uint32_t * const p_value);
+
+//! @brief Write bits, most significant first
+static void put_bits(co2_codec_t * const p_codec,
+                     uint32_t const value,
+                     uint8_t const bits);
+
+//! @brief Read bits, most significant first
+static bool get_bits(co2_codec_t * const p_codec,
+                     uint8_t const bits,
+                     uint32_t * const p_value);
+
+//! @brief Get the time and time delta a sample of a channel is relative to
+static void get_reference(co2_codec_t const * const p_codec,
+                          uint8_t const channel,
+                          uint32_t * const p_time_s,
+                          uint32_t * const p_delta_s);
+
+//! @brief Update the state with a sample
+static void update(co2_codec_t * const p_codec,
+                   uint32_t const time_s,
+                   uint8_t const channel,
+                   uint16_t const ppm);
+
+//! @brief Map a signed value into an unsigned one, small for small magnitudes
+static uint32_t zigzag_encode(int32_t const value);
+
+//! @brief Undo `zigzag_encode`
+static int32_t zigzag_decode(uint32_t const value);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Start encoding a stream into a buffer
+ *
+ * @param[out]          p_codec             Pointer to the codec instance
+ * @param[out]          p_buffer            Buffer where to encode the stream
+ * @param[in]           size                Size of the buffer
+ * @param[in]           channel_count       Amount of interleaved series, up
+ *                                          to `CO2_CODEC_MAX_CHANNELS`
+ *
+ * @return              bool                Operation result
+ */
+bool co2_codec_encoder_init(co2_codec_t * const p_codec,
+                            uint8_t * const p_buffer,
+                            size_t const size,
+                            uint8_t const channel_count)
+{
+        bool success = (NULL != p_codec) && (NULL != p_buffer) &&
+                       (0 != channel_count) &&
+                       (CO2_CODEC_MAX_CHANNELS >= channel_count);
+
+        if (success) {
+                memset(p_codec, 0, sizeof(*p_codec));
+                p_codec->p_buffer = p_buffer;
+                p_codec->size = size;
+
+                while ((1U << p_codec->channel_bits) < channel_count) {
+                        ++p_codec->channel_bits;
+                }
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Append a sample to the stream
+ *
+ * @param[in,out]       p_codec             Pointer to the codec instance
+ * @param[in]           time_s              Time of the sample (in seconds)
+ * @param[in]           channel             Series the sample belongs to
+ * @param[in]           ppm                 CO2 concentration (in ppm)
+ *
+ * @return              bool                False if the sample doesn't fit in
+ *                                          the buffer, which is left as it was
+ */
+bool co2_codec_encode(co2_codec_t * const p_codec,
+                      uint32_t const time_s,
+                      uint8_t const channel,
+                      uint16_t const ppm)
+{
+        uint32_t reference_time_s;
+        uint32_t reference_delta_s;
+        uint32_t time_value;
+        uint32_t ppm_value;
+        uint8_t time_bucket = 0;
+        uint8_t ppm_bucket;
+        size_t bits;
+
+        if ((NULL == p_codec) ||
+            ((1U << p_codec->channel_bits) <= channel) ||
+            (CO2_CODEC_MAX_CHANNELS <= channel)) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        if (0 == p_codec->count) {
+                time_value = time_s;
+                bits = FIRST_TIME_BITS;
+        } else {
+                get_reference(p_codec,
+                              channel,
+                              &reference_time_s,
+                              &reference_delta_s);
+
+                // Overflow is meant to happen
+                time_value = zigzag_encode((int32_t)(time_s -
+                                                     reference_time_s -
+                                                     reference_delta_s));
+                time_bucket = find_bucket(m_time_bits, time_value);
+                bits = field_bits(m_time_bits, time_bucket);
+        }
+
+        ppm_value = zigzag_encode((int32_t)ppm -
+                                  (int32_t)p_codec->ppm[channel]);
+        ppm_bucket = find_bucket(m_ppm_bits, ppm_value);
+
+        if ((BUCKET_COUNT - 1) == ppm_bucket) {
+                ppm_value = ppm;
+        }
+
+        bits += p_codec->channel_bits + field_bits(m_ppm_bits, ppm_bucket);
+
+        if ((p_codec->size * 8) < (p_codec->bit_position + bits)) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        if (0 == p_codec->count) {
+                put_bits(p_codec, time_value, FIRST_TIME_BITS);
+        } else {
+                put_field(p_codec, m_time_bits, time_bucket, time_value);
+        }
+
+        put_bits(p_codec, channel, p_codec->channel_bits);
+        put_field(p_codec, m_ppm_bits, ppm_bucket, ppm_value);
+
+        update(p_codec, time_s, channel, ppm);
+
+        return true;
+}
+
+/*!
+ * @brief Start decoding a stream from a buffer
+ *
+ * @param[out]          p_codec             Pointer to the codec instance
+ * @param[in]           p_buffer            Buffer holding the stream, which
+ *                                          isn't modified
+ * @param[in]           size                Size of the buffer
+ * @param[in]           channel_count       Amount of interleaved series, as
+ *                                          given to the encoder
+ *
+ * @return              bool                Operation result
+ */
+bool co2_codec_decoder_init(co2_codec_t * const p_codec,
+                            uint8_t const * const p_buffer,
+                            size_t const size,
+                            uint8_t const channel_count)
+{
+        return co2_codec_encoder_init(p_codec,
+                                      (uint8_t *)p_buffer,
+                                      size,
+                                      channel_count);
+}
+
+/*!
+ * @brief Get the next sample of the stream
+ *
+ * The caller has to stop after the amount of samples encoded, see the file
+ * description
+ *
+ * @param[in,out]       p_codec             Pointer to the codec instance
+ * @param[out]          p_time_s            Time of the sample (in seconds)
+ * @param[out]          p_channel           Series the sample belongs to
+ * @param[out]          p_ppm               CO2 concentration (in ppm)
+ *
+ * @return              bool                False if the buffer ended before
+ *                                          the sample did
+ */
+bool co2_codec_decode(co2_codec_t * const p_codec,
+                      uint32_t * const p_time_s,
+                      uint8_t * const p_channel,
+                      uint16_t * const p_ppm)
+{
+        bool success;
+        uint32_t reference_time_s;
+        uint32_t reference_delta_s;
+        uint32_t time_value = 0;
+        uint32_t channel = 0;
+        uint32_t ppm_value = 0;
+        uint8_t bucket = 0;
+
+        success = (NULL != p_codec) && (NULL != p_time_s) &&
+                  (NULL != p_channel) && (NULL != p_ppm);
+
+        // Channel comes after the time, which is relative to the channel
+        if ((success) && (0 == p_codec->count)) {
+                success = get_bits(p_codec, FIRST_TIME_BITS, &time_value);
+        } else if (success) {
+                success = get_field(p_codec, m_time_bits, &bucket, &time_value);
+        }
+
+        success = (success) &&
+                  (get_bits(p_codec, p_codec->channel_bits, &channel)) &&
+                  (CO2_CODEC_MAX_CHANNELS > channel) &&
+                  (get_field(p_codec, m_ppm_bits, &bucket, &ppm_value));
+
+        if (success) {
+                if (0 != p_codec->count) {
+                        get_reference(p_codec,
+                                      (uint8_t)channel,
+                                      &reference_time_s,
+                                      &reference_delta_s);
+
+                        time_value = reference_time_s + reference_delta_s +
+                                     (uint32_t)zigzag_decode(time_value);
+                }
+
+                if ((BUCKET_COUNT - 1) != bucket) {
+                        ppm_value = (uint16_t)(p_codec->ppm[channel] +
+                                               zigzag_decode(ppm_value));
+                }
+
+                update(p_codec, time_value, (uint8_t)channel, (uint16_t)ppm_value);
+
+                *p_time_s = time_value;
+                *p_channel = (uint8_t)channel;
+                *p_ppm = (uint16_t)ppm_value;
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Get the size of the stream encoded or decoded so far
+ *
+ * @param[in]           p_codec             Pointer to the codec instance
+ *
+ * @return              size_t              Size (in bytes, rounded up)
+ */
+size_t co2_codec_get_size(co2_codec_t const * const p_codec)
+{
+        size_t size = 0;
+
+        if (NULL != p_codec) {
+                size = (p_codec->bit_position + 7) / 8;
+        }
+
+        return size;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Get the smallest bucket holding a value
+ *
+ * @param[in]           p_bits              Bits after each prefix
+ * @param[in]           value               Value to hold
+ *
+ * @return              uint8_t             Bucket index, the last bucket
+ *                                          holds anything
+ */
+static uint8_t find_bucket(uint8_t const * const p_bits, uint32_t const value)
+{
+        uint8_t bucket = 0;
+
+        while (((BUCKET_COUNT - 1) > bucket) &&
+               ((value >> p_bits[bucket]) != 0)) {
+                ++bucket;
+        }
+
+        return bucket;
+}
+
+/*!
+ * @brief Bits taken by a field of a bucket, prefix included
+ *
+ * @param[in]           p_bits              Bits after each prefix
+ * @param[in]           bucket              Bucket index
+ *
+ * @return              uint8_t             Amount of bits
+ */
+static uint8_t field_bits(uint8_t const * const p_bits, uint8_t const bucket)
+{
+        uint8_t prefix_bits = bucket + 1;
+
+        // Last prefix has no terminating zero
+        if ((BUCKET_COUNT - 1) == bucket) {
+                prefix_bits = bucket;
+        }
+
+        return prefix_bits + p_bits[bucket];
+}
+
+/*!
+ * @brief Write a field, prefix included
+ *
+ * @param[in,out]       p_codec             Pointer to the codec instance
+ * @param[in]           p_bits              Bits after each prefix
+ * @param[in]           bucket              Bucket index
+ * @param[in]           value               Value, fitting the bucket
+ *
+ * @return              -                   -
+ */
+static void put_field(co2_codec_t * const p_codec,
+                      uint8_t const * const p_bits,
+                      uint8_t const bucket,
+                      uint32_t const value)
+{
+        // `bucket` ones, and a zero unless it is the last bucket
+        if ((BUCKET_COUNT - 1) == bucket) {
+                put_bits(p_codec, (1U << bucket) - 1, bucket);
+        } else {
+                put_bits(p_codec, ((1U << bucket) - 1) << 1, bucket + 1);
+        }
+
+        put_bits(p_codec, value, p_bits[bucket]);
+}
+
+/*!
+ * @brief Read a field, prefix included
+ *
+ * @param[in,out]       p_codec             Pointer to the codec instance
+ * @param[in]           p_bits              Bits after each prefix
+ * @param[out]          p_bucket            Bucket index
+ * @param[out]          p_value             Value
+ *
+ * @return              bool                False if the buffer ended before
+ *                                          the field did
+ */
+static bool get_field(co2_codec_t * const p_codec,
+                      uint8_t const * const p_bits,
+                      uint8_t * const p_bucket,
+                      uint32_t * const p_value)
+{
+        uint32_t bit = 1;
+        uint8_t bucket = 0;
+        bool success = true;
+
+        while ((success) && (1 == bit) && ((BUCKET_COUNT - 1) > bucket)) {
+                success = get_bits(p_codec, 1, &bit);
+
+                if ((success) && (1 == bit)) {
+                        ++bucket;
+                }
+        }
+
+        *p_bucket = bucket;
+
+        return (success) && (get_bits(p_codec, p_bits[bucket], p_value));
+}
+
+/*!
+ * @brief Write bits, most significant first
+ *
+ * The caller checks there is room for them
+ *
+ * @param[in,out]       p_codec             Pointer to the codec instance
+ * @param[in]           value               Bits to write, right aligned
+ * @param[in]           bits                Amount of bits, up to 32
+ *
+ * @return              -                   -
+ */
+static void put_bits(co2_codec_t * const p_codec,
+                     uint32_t const value,
+                     uint8_t const bits)
+{
+        uint8_t remaining = bits;
+        uint8_t free_bits;
+        uint8_t count;
+        uint8_t chunk;
+        size_t byte;
+
+        while (0 < remaining) {
+                byte = p_codec->bit_position / 8;
+                free_bits = 8 - (p_codec->bit_position % 8);
+                count = (remaining < free_bits) ? remaining : free_bits;
+                chunk = (uint8_t)((value >> (remaining - count)) &
+                                  ((1U << count) - 1));
+
+                // Start every byte clean
+                if (8 == free_bits) {
+                        p_codec->p_buffer[byte] = 0;
+                }
+
+                p_codec->p_buffer[byte] |= (uint8_t)(chunk <<
+                                                     (free_bits - count));
+
+                p_codec->bit_position += count;
+                remaining -= count;
+        }
+}
+
+/*!
+ * @brief Read bits, most significant first
+ *
+ * @param[in,out]       p_codec             Pointer to the codec instance
+ * @param[in]           bits                Amount of bits, up to 32
+ * @param[out]          p_value             Bits read, right aligned
+ *
+ * @return              bool                False if the buffer ended before
+ */
+static bool get_bits(co2_codec_t * const p_codec,
+                     uint8_t const bits,
+                     uint32_t * const p_value)
+{
+        uint32_t value = 0;
+        uint8_t remaining = bits;
+        uint8_t available;
+        uint8_t count;
+        size_t byte;
+
+        if ((p_codec->size * 8) < (p_codec->bit_position + bits)) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        while (0 < remaining) {
+                byte = p_codec->bit_position / 8;
+                available = 8 - (p_codec->bit_position % 8);
+                count = (remaining < available) ? remaining : available;
+
+                value = (value << count) |
+                        ((p_codec->p_buffer[byte] >> (available - count)) &
+                         ((1U << count) - 1));
+
+                p_codec->bit_position += count;
+                remaining -= count;
+        }
+
+        *p_value = value;
+
+        return true;
+}
+
+/*!
+ * @brief Get the time and time delta a sample of a channel is relative to
+ *
+ * @param[in]           p_codec             Pointer to the codec instance
+ * @param[in]           channel             Channel of the sample
+ * @param[out]          p_time_s            Time of the previous sample of the
+ *                                          channel, or of the stream for its
+ *                                          first sample
+ * @param[out]          p_delta_s           Expected time between samples of
+ *                                          the channel
+ *
+ * @return              -                   -
+ */
+static void get_reference(co2_codec_t const * const p_codec,
+                          uint8_t const channel,
+                          uint32_t * const p_time_s,
+                          uint32_t * const p_delta_s)
+{
+        if (0 != (p_codec->seen_channels & (1U << channel))) {
+                *p_time_s = p_codec->channel_time_s[channel];
+                *p_delta_s = p_codec->delta_s[channel];
+        } else {
+                *p_time_s = p_codec->time_s;
+                *p_delta_s = 0;
+        }
+}
+
+/*!
+ * @brief Update the state with a sample
+ *
+ * @param[in,out]       p_codec             Pointer to the codec instance
+ * @param[in]           time_s              Time of the sample
+ * @param[in]           channel             Channel of the sample
+ * @param[in]           ppm                 CO2 concentration
+ *
+ * @return              -                   -
+ */
+static void update(co2_codec_t * const p_codec,
+                   uint32_t const time_s,
+                   uint8_t const channel,
+                   uint16_t const ppm)
+{
+        uint32_t reference_time_s;
+        uint32_t reference_delta_s;
+
+        get_reference(p_codec, channel, &reference_time_s, &reference_delta_s);
+
+        // Overflow is meant to happen
+        p_codec->delta_s[channel] = (0 == p_codec->count) ?
+                                    0 : (time_s - reference_time_s);
+        p_codec->channel_time_s[channel] = time_s;
+        p_codec->seen_channels |= (uint8_t)(1U << channel);
+        p_codec->time_s = time_s;
+        p_codec->ppm[channel] = ppm;
+        ++p_codec->count;
+}
+
+/*!
+ * @brief Map a signed value into an unsigned one, small for small magnitudes
+ *
+ * 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+ *
+ * @param[in]           value               Signed value
+ *
+ * @return              uint32_t            Zig-zag encoded value
+ */
+static uint32_t zigzag_encode(int32_t const value)
+{
+        return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/*!
+ * @brief Undo `zigzag_encode`
+ *
+ * @param[in]           value               Zig-zag encoded value
+ *
+ * @return              int32_t             Signed value
+ */
+static int32_t zigzag_decode(uint32_t const value)
+{
+        return (int32_t)((value >> 1) ^ (0U - (value & 1)));
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
@@ -0,0 +1,120 @@
+/*!
+ *******************************************************************************
+ * @file co2_codec.h
+ *
+ * @brief Compressed encoding of CO2 time series
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef CO2_CODEC_H
+#define CO2_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+//! @brief Largest amount of series interleaved in a stream
+#define CO2_CODEC_MAX_CHANNELS              (4)
+
+//! @brief Largest encoded sample (in bytes), rounded up
+#define CO2_CODEC_SAMPLE_MAX_SIZE           (8)
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief State shared by the encoder and the decoder
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Encoded stream
+        uint8_t * p_buffer;
+
+        //! @brief Size of `p_buffer` (in bytes)
+        size_t size;
+
+        //! @brief Position of the next bit in `p_buffer`
+        size_t bit_position;
+
+        //! @brief Bits used to tell the channel of each sample
+        uint8_t channel_bits;
+
+        //! @brief Amount of samples encoded or decoded so far
+        uint32_t count;
+
+        //! @brief Time of the previous sample, of any channel
+        uint32_t time_s;
+
+        //! @brief Channels with samples so far (bit mask)
+        uint8_t seen_channels;
+
+        //! @brief Time of the previous sample of each channel
+        uint32_t channel_time_s[CO2_CODEC_MAX_CHANNELS];
+
+        //! @brief Time elapsed between the two previous samples of each
+        //!        channel
+        uint32_t delta_s[CO2_CODEC_MAX_CHANNELS];
+
+        //! @brief Previous value of each channel
+        uint16_t ppm[CO2_CODEC_MAX_CHANNELS];
+} co2_codec_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Start encoding a stream into a buffer
+bool co2_codec_encoder_init(co2_codec_t * const p_codec,
+                            uint8_t * const p_buffer,
+                            size_t const size,
+                            uint8_t const channel_count);
+
+//! @brief Append a sample to the stream
+bool co2_codec_encode(co2_codec_t * const p_codec,
+                      uint32_t const time_s,
+                      uint8_t const channel,
+                      uint16_t const ppm);
+
+//! @brief Start decoding a stream from a buffer
+bool co2_codec_decoder_init(co2_codec_t * const p_codec,
+                            uint8_t const * const p_buffer,
+                            size_t const size,
+                            uint8_t const channel_count);
+
+//! @brief Get the next sample of the stream
+bool co2_codec_decode(co2_codec_t * const p_codec,
+                      uint32_t * const p_time_s,
+                      uint8_t * const p_channel,
+                      uint16_t * const p_ppm);
+
+//! @brief Get the size of the stream encoded or decoded so far
+size_t co2_codec_get_size(co2_codec_t const * const p_codec);
+
+#endif //CO2_CODEC_H
@@ -0,0 +1,261 @@
+/*!
+ *******************************************************************************
+ * @file co2_filter.c
+ *
+ * @brief Fixed-point filter for the CO2 readings
+ *
+ * Two stages, both in integer math:
+ * - A median over the last N samples, which drops single sample spikes
+ *   without delaying steps.
+ * - An exponential moving average of the median, with a weight of a power of
+ *   two, so it only takes shifts. The average is kept with 8 fractional bits,
+ *   so small changes aren't lost in the truncation.
+ *
+ * Samples further apart than the configured gap restart the filter, so a
+ * reading taken after a long pause isn't dragged towards old values.
+ *
+ * It doesn't depend on any framework, so it builds for the target as well as
+ * for a Linux host.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "co2_filter.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Fractional bits of the average
+#define AVERAGE_FRACTIONAL_BITS             (8)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Median of the samples in the window
+static uint32_t window_median(co2_filter_t const * const p_filter);
+
+//! @brief Feed a sample to the moving average, returns the rounded average
+static uint32_t average_update(co2_filter_t * const p_filter,
+                               uint32_t const ppm);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize a filter instance
+ *
+ * @param[out]          p_filter            Pointer to the filter instance
+ * @param[in]           p_config            Pointer to the configuration
+ *
+ * @return              bool                Operation result, fails if the
+ *                                          median size is even or out of
+ *                                          range, or the EMA shift is out of
+ *                                          range
+ */
+bool co2_filter_init(co2_filter_t * const p_filter,
+                     co2_filter_config_t const * const p_config)
+{
+        bool success = ((NULL != p_filter) &&
+                        (NULL != p_config) &&
+                        (0 != (p_config->median_size % 2)) &&
+                        (CO2_FILTER_MEDIAN_MAX_SIZE >= p_config->median_size) &&
+                        (CO2_FILTER_EMA_MAX_SHIFT >= p_config->ema_shift));
+
+        if (success) {
+                memset(p_filter, 0, sizeof(*p_filter));
+                p_filter->config = *p_config;
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Feed a new sample to the filter
+ *
+ * @param[in,out]       p_filter            Pointer to the filter instance
+ * @param[in]           ppm                 Sampled concentration (in ppm)
+ * @param[in]           time_ms             Sample time (in milliseconds,
+ *                                          wrapping around is fine)
+ *
+ * @return              uint32_t            Filtered concentration (in ppm)
+ */
+uint32_t co2_filter_update(co2_filter_t * const p_filter,
+                           uint32_t const ppm,
+                           uint32_t const time_ms)
+{
+        uint32_t max_gap_ms;
+        uint32_t median;
+
+        if (NULL == p_filter) {
+                // Code style exception for the shake of readability
+                return 0;
+        }
+
+        max_gap_ms = p_filter->config.max_gap_ms;
+
+        // Overflow is meant to happen
+        if ((0 != p_filter->count) &&
+            (0 != max_gap_ms) &&
+            ((time_ms - p_filter->last_time_ms) > max_gap_ms)) {
+
+                co2_filter_reset(p_filter);
+        }
+
+        p_filter->window[p_filter->next] = (UINT16_MAX < ppm) ?
+                                           UINT16_MAX : (uint16_t)ppm;
+
+        p_filter->next = (uint8_t)((p_filter->next + 1) %
+                                   p_filter->config.median_size);
+
+        if (p_filter->config.median_size > p_filter->count) {
+                ++p_filter->count;
+        }
+
+        p_filter->last_time_ms = time_ms;
+
+        median = window_median(p_filter);
+
+        return average_update(p_filter, median);
+}
+
+/*!
+ * @brief Forget the samples fed so far
+ *
+ * The next sample is taken as it is, as if it was the first one
+ *
+ * @param[in,out]       p_filter            Pointer to the filter instance
+ *
+ * @return              -                   -
+ */
+void co2_filter_reset(co2_filter_t * const p_filter)
+{
+        if (NULL != p_filter) {
+                p_filter->count = 0;
+                p_filter->next = 0;
+                p_filter->has_average = false;
+        }
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Median of the samples in the window
+ *
+ * The window is small, so it is insertion sorted into a copy. With an even
+ * amount of samples (window not full yet), the lower one of the two middle
+ * samples is taken.
+ *
+ * @param[in]           p_filter            Pointer to the filter instance
+ *
+ * @return              uint32_t            Median (in ppm)
+ */
+static uint32_t window_median(co2_filter_t const * const p_filter)
+{
+        uint16_t sorted[CO2_FILTER_MEDIAN_MAX_SIZE];
+        uint16_t sample;
+        size_t i;
+        size_t j;
+
+        for (i = 0; p_filter->count > i; ++i) {
+                sample = p_filter->window[i];
+
+                for (j = i; (0 < j) && (sorted[j - 1] > sample); --j) {
+                        sorted[j] = sorted[j - 1];
+                }
+
+                sorted[j] = sample;
+        }
+
+        return sorted[(p_filter->count - 1) / 2];
+}
+
+/*!
+ * @brief Feed a sample to the moving average, returns the rounded average
+ *
+ * The first sample after a reset initializes the average.
+ *
+ * @param[in,out]       p_filter            Pointer to the filter instance
+ * @param[in]           ppm                 Sample (in ppm)
+ *
+ * @return              uint32_t            Average (in ppm)
+ */
+static uint32_t average_update(co2_filter_t * const p_filter,
+                               uint32_t const ppm)
+{
+        uint32_t const shift = p_filter->config.ema_shift;
+        uint32_t const sample = ppm << AVERAGE_FRACTIONAL_BITS;
+
+        if (!p_filter->has_average) {
+                p_filter->average = sample;
+                p_filter->has_average = true;
+
+        } else if (sample > p_filter->average) {
+                p_filter->average += (sample - p_filter->average) >> shift;
+
+        } else {
+                p_filter->average -= (p_filter->average - sample) >> shift;
+        }
+
+        return (p_filter->average + (1U << (AVERAGE_FRACTIONAL_BITS - 1))) >>
+               AVERAGE_FRACTIONAL_BITS;
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
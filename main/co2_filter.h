@@ -0,0 +1,110 @@
+/*!
+ *******************************************************************************
+ * @file co2_filter.h
+ *
+ * @brief Fixed-point filter for the CO2 readings
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef CO2_FILTER_H
+#define CO2_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+//! @brief Largest median window supported
+#define CO2_FILTER_MEDIAN_MAX_SIZE          (7)
+
+//! @brief Largest EMA shift supported
+#define CO2_FILTER_EMA_MAX_SHIFT            (8)
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Filter configuration
+typedef struct {
+        //! @brief Samples in the median window, odd (1 disables the stage)
+        uint8_t median_size;
+
+        //! @brief EMA weight of a new sample is 1 / 2^ema_shift (0 disables
+        //!        the stage)
+        uint8_t ema_shift;
+
+        //! @brief Time between samples after which the filter starts over, as
+        //!        old samples no longer describe the current air (in
+        //!        milliseconds, 0 for never)
+        uint32_t max_gap_ms;
+} co2_filter_config_t;
+
+/*!
+ * @brief Filter instance
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Filter configuration
+        co2_filter_config_t config;
+
+        //! @brief Last samples, in arrival order (circular)
+        uint16_t window[CO2_FILTER_MEDIAN_MAX_SIZE];
+
+        //! @brief Amount of samples in `window`
+        uint8_t count;
+
+        //! @brief Position of the next sample in `window`
+        uint8_t next;
+
+        //! @brief Whether `average` holds a value
+        bool has_average;
+
+        //! @brief Average value (in 1/256 ppm)
+        uint32_t average;
+
+        //! @brief Time of the last sample (in milliseconds)
+        uint32_t last_time_ms;
+} co2_filter_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize a filter instance
+bool co2_filter_init(co2_filter_t * const p_filter,
+                     co2_filter_config_t const * const p_config);
+
+//! @brief Feed a new sample to the filter
+uint32_t co2_filter_update(co2_filter_t * const p_filter,
+                           uint32_t const ppm,
+                           uint32_t const time_ms);
+
+//! @brief Forget the samples fed so far
+void co2_filter_reset(co2_filter_t * const p_filter);
+
+#endif //CO2_FILTER_H
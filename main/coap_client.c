@@ -0,0 +1,588 @@
+/*!
+ *******************************************************************************
+ * @file coap_client.c
+ *
+ * @brief Telemetry transport over CoAP
+ *
+ * Posts to the Thingsboard CoAP device API over UDP, so there is neither a
+ * connection to set up nor headers to send with each post. The session is
+ * kept across posts, and only opened again after a failure, resolving the
+ * server address again.
+ *
+ * Confirmable posts are retransmitted by libcoap until the server answers,
+ * and wait for the answer. Non-confirmable ones are sent and forgotten,
+ * their answers, if any, only update the link status.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <netdb.h>
+#include <sys/socket.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "coap3/coap.h"
+
+#include "esp_log.h"
+#include "display.h"
+#include "device_state.h"
+#include "coap_client.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+#define TAG                                 "coap"
+
+#define SERVER_URI                          CONFIG_CO2_MONITOR_COAP_SERVER_URI
+#define TOKEN                               CONFIG_CO2_MONITOR_DEVICE_TOKEN
+
+//! @brief Longest server host name
+#define HOST_MAX_LENGTH                     (64)
+
+//! @brief Retransmissions of a confirmable post before giving up
+#define MAX_RETRANSMIT                      (2)
+
+//! @brief Longest a confirmable post waits for its answer (in milliseconds),
+//!        beyond the retransmissions
+#define RESPONSE_TIMEOUT_MS                 (30000)
+
+//! @brief Longest a single wait for incoming datagrams lasts (in milliseconds)
+#define IO_SLICE_MS                         (1000)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Open the session to the server, if not open yet
+static bool coap_client_open(void);
+
+//! @brief Close the session to the server
+static void coap_client_close(void);
+
+//! @brief Add the resource path and the content format to a post
+static bool coap_client_add_options(coap_pdu_t * const p_pdu);
+
+//! @brief Wait for the answer to the confirmable post in flight
+static bool coap_client_wait(void);
+
+//! @brief Whether a message carries the token of the post in flight
+static bool coap_client_is_pending(coap_pdu_t const * const p_pdu);
+
+//! @brief Take the answer to a post
+static coap_response_t coap_client_on_response(coap_session_t *p_session,
+                                               coap_pdu_t const *p_sent,
+                                               coap_pdu_t const *p_received,
+                                               coap_mid_t const mid);
+
+//! @brief Give up on a post
+static void coap_client_on_nack(coap_session_t *p_session,
+                                coap_pdu_t const *p_sent,
+                                coap_nack_reason_t const reason,
+                                coap_mid_t const mid);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Telemetry resource path, one Uri-Path option per segment
+static char const * const m_path_segments[] = {"api", "v1", TOKEN, "telemetry"};
+
+static coap_context_t * m_context = NULL;
+
+//! @brief Session to the server, NULL until the first post
+static coap_session_t * m_session = NULL;
+
+//! @brief Token of the confirmable post in flight
+static uint8_t m_token[8];
+
+//! @brief Length of `m_token`
+static size_t m_token_length = 0;
+
+//! @brief Whether the confirmable post in flight is still waiting an answer
+static bool m_is_waiting = false;
+
+//! @brief Whether the confirmable post in flight was answered
+static bool m_is_answered = false;
+
+//! @brief Code of the answer to the confirmable post in flight
+static coap_pdu_code_t m_response_code;
+
+//! @brief Exchange counters
+static coap_client_stats_t m_stats;
+
+//! @brief Protects `m_stats`, taken only for a single update or query
+static portMUX_TYPE m_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize the CoAP client
+ *
+ * The session is only opened with the first post, once the network is up.
+ *
+ * @return              bool                Operation result
+ */
+bool coap_client_init(void)
+{
+        bool success;
+
+        coap_startup();
+
+        m_context = coap_new_context(NULL);
+
+        success = (NULL != m_context);
+
+        if (success) {
+                coap_register_response_handler(m_context,
+                                               coap_client_on_response);
+                coap_register_nack_handler(m_context, coap_client_on_nack);
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Post telemetry to the server
+ *
+ * Must always be called from the same task. A confirmable post blocks until
+ * answered, or given up on after `MAX_RETRANSMIT` retransmissions.
+ *
+ * Payloads longer than `COAP_CLIENT_MAX_PAYLOAD` are refused without
+ * touching the session, as sending them again would never work.
+ *
+ * @param[in]           p_payload           JSON telemetry, null terminated
+ * @param[in]           is_confirmable      Whether to wait for the answer
+ *
+ * @return              bool                Whether the post was sent, and
+ *                                          accepted by the server if
+ *                                          confirmable
+ */
+bool coap_client_post(char const * const p_payload, bool const is_confirmable)
+{
+        coap_pdu_t * p_pdu = NULL;
+        coap_mid_t mid;
+        bool success = ((NULL != p_payload) && (NULL != m_context));
+
+        if ((success) && (COAP_CLIENT_MAX_PAYLOAD < strlen(p_payload))) {
+                ESP_LOGE(TAG, "Payload too long for a single datagram, dropped");
+
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        portENTER_CRITICAL(&m_stats_lock);
+        ++m_stats.posts;
+        portEXIT_CRITICAL(&m_stats_lock);
+
+        if (success) {
+                success = coap_client_open();
+        }
+
+        if (success) {
+                p_pdu = coap_new_pdu((is_confirmable) ?
+                                     COAP_MESSAGE_CON : COAP_MESSAGE_NON,
+                                     COAP_REQUEST_CODE_POST,
+                                     m_session);
+
+                success = (NULL != p_pdu);
+        }
+
+        if (success) {
+                coap_session_new_token(m_session, &m_token_length, m_token);
+
+                // Payloads up to `COAP_CLIENT_MAX_PAYLOAD` fit a single
+                // datagram unless the device token is unusually long
+                success = ((0 != coap_add_token(p_pdu, m_token_length, m_token)) &&
+                           (coap_client_add_options(p_pdu)) &&
+                           (0 != coap_add_data(p_pdu,
+                                               strlen(p_payload),
+                                               (uint8_t const *)p_payload)));
+
+                if (!success) {
+                        coap_delete_pdu(p_pdu);
+                }
+        }
+
+        if (success) {
+                m_is_answered = false;
+                m_is_waiting = is_confirmable;
+
+                // Takes the PDU over, even if it fails
+                mid = coap_send(m_session, p_pdu);
+
+                success = (COAP_INVALID_MID != mid);
+        }
+
+        if ((success) && (is_confirmable)) {
+                success = coap_client_wait();
+        } else if (success) {
+                // Takes any answer to previous posts
+                (void)coap_io_process(m_context, COAP_IO_NO_WAIT);
+        }
+
+        m_is_waiting = false;
+
+        if (!success) {
+                ESP_LOGE(TAG, "CoAP POST failed");
+
+                // Addresses are resolved again with the next post
+                coap_client_close();
+
+                if (!m_is_answered) {
+                        device_state_set_link(false);
+                        display_set_link_status(false);
+                }
+        }
+
+        portENTER_CRITICAL(&m_stats_lock);
+
+        if (!success) {
+                ++m_stats.failures;
+        } else if (is_confirmable) {
+                ++m_stats.acknowledged;
+        }
+
+        portEXIT_CRITICAL(&m_stats_lock);
+
+        return success;
+}
+
+/*!
+ * @brief Get the exchange counters
+ *
+ * @param[out]          p_stats             Pointer where to copy the counters
+ *
+ * @return              bool                Operation result
+ */
+bool coap_client_get_stats(coap_client_stats_t * const p_stats)
+{
+        bool const success = (NULL != p_stats);
+
+        if (success) {
+                portENTER_CRITICAL(&m_stats_lock);
+                *p_stats = m_stats;
+                portEXIT_CRITICAL(&m_stats_lock);
+        }
+
+        return success;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Open the session to the server, if not open yet
+ *
+ * @return              bool                Operation result, fails if the
+ *                                          server address can't be resolved
+ */
+static bool coap_client_open(void)
+{
+        struct addrinfo const hints = {
+                        .ai_family = AF_UNSPEC,
+                        .ai_socktype = SOCK_DGRAM,
+        };
+
+        struct addrinfo * p_result = NULL;
+        char host[HOST_MAX_LENGTH];
+        coap_address_t address;
+        coap_uri_t uri;
+        bool success;
+
+        if (NULL != m_session) {
+                // Code style exception for the shake of readability
+                return true;
+        }
+
+        success = ((0 == coap_split_uri((uint8_t const *)SERVER_URI,
+                                        strlen(SERVER_URI),
+                                        &uri)) &&
+                   (sizeof(host) > uri.host.length));
+
+        if (success) {
+                memcpy(host, uri.host.s, uri.host.length);
+                host[uri.host.length] = '\0';
+
+                success = ((0 == getaddrinfo(host, NULL, &hints, &p_result)) &&
+                           (NULL != p_result));
+        }
+
+        if (success) {
+                coap_address_init(&address);
+
+                switch (p_result->ai_family) {
+                case AF_INET:
+                        address.size = p_result->ai_addrlen;
+                        memcpy(&address.addr.sin,
+                               p_result->ai_addr,
+                               p_result->ai_addrlen);
+                        address.addr.sin.sin_port = htons(uri.port);
+                        break;
+                case AF_INET6:
+                        address.size = p_result->ai_addrlen;
+                        memcpy(&address.addr.sin6,
+                               p_result->ai_addr,
+                               p_result->ai_addrlen);
+                        address.addr.sin6.sin6_port = htons(uri.port);
+                        break;
+                default:
+                        success = false;
+                        break;
+                }
+        } else {
+                ESP_LOGE(TAG, "Couldn't resolve %s", SERVER_URI);
+        }
+
+        if (NULL != p_result) {
+                freeaddrinfo(p_result);
+        }
+
+        if (success) {
+                m_session = coap_new_client_session(m_context,
+                                                    NULL,
+                                                    &address,
+                                                    COAP_PROTO_UDP);
+
+                success = (NULL != m_session);
+        }
+
+        if (success) {
+                coap_session_set_max_retransmit(m_session, MAX_RETRANSMIT);
+
+                portENTER_CRITICAL(&m_stats_lock);
+                ++m_stats.sessions;
+                portEXIT_CRITICAL(&m_stats_lock);
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Close the session to the server
+ *
+ * @return              -                   -
+ */
+static void coap_client_close(void)
+{
+        if (NULL != m_session) {
+                coap_session_release(m_session);
+                m_session = NULL;
+        }
+}
+
+/*!
+ * @brief Add the resource path and the content format to a post
+ *
+ * Options are added in ascending number order, as CoAP encodes them.
+ *
+ * @param[in,out]       p_pdu               Pointer to the post
+ *
+ * @return              bool                Operation result
+ */
+static bool coap_client_add_options(coap_pdu_t * const p_pdu)
+{
+        uint8_t content_format[4];
+        size_t segment;
+        size_t length;
+        bool success = true;
+
+        for (segment = 0;
+             ((success) &&
+              ((sizeof(m_path_segments) / sizeof(m_path_segments[0])) > segment));
+             ++segment) {
+
+                success = (0 != coap_add_option(
+                                p_pdu,
+                                COAP_OPTION_URI_PATH,
+                                strlen(m_path_segments[segment]),
+                                (uint8_t const *)m_path_segments[segment]));
+        }
+
+        if (success) {
+                length = coap_encode_var_safe(content_format,
+                                              sizeof(content_format),
+                                              COAP_MEDIATYPE_APPLICATION_JSON);
+
+                success = (0 != coap_add_option(p_pdu,
+                                                COAP_OPTION_CONTENT_FORMAT,
+                                                length,
+                                                content_format));
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Wait for the answer to the confirmable post in flight
+ *
+ * Retransmissions are sent from here as well.
+ *
+ * @return              bool                Whether the post was answered with
+ *                                          a success code
+ */
+static bool coap_client_wait(void)
+{
+        uint32_t waited_ms = 0;
+        int spent_ms;
+
+        while ((m_is_waiting) && (RESPONSE_TIMEOUT_MS > waited_ms)) {
+                spent_ms = coap_io_process(m_context, IO_SLICE_MS);
+
+                if (0 > spent_ms) {
+                        break;
+                }
+
+                // Counted at least once, so the wait can't last forever
+                waited_ms += (0 == spent_ms) ? 1 : (uint32_t)spent_ms;
+        }
+
+        return ((m_is_answered) &&
+                (2 == COAP_RESPONSE_CLASS(m_response_code)));
+}
+
+/*!
+ * @brief Whether a message carries the token of the post in flight
+ *
+ * @param[in]           p_pdu               Pointer to the message
+ *
+ * @return              bool                Whether the tokens match
+ */
+static bool coap_client_is_pending(coap_pdu_t const * const p_pdu)
+{
+        coap_bin_const_t token;
+
+        if ((!m_is_waiting) || (NULL == p_pdu)) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        token = coap_pdu_get_token(p_pdu);
+
+        return ((m_token_length == token.length) &&
+                (0 == memcmp(m_token, token.s, token.length)));
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Take the answer to a post
+ *
+ * Runs from `coap_io_process`, in the task posting. Any answer updates the
+ * link status, including the ones to non-confirmable posts.
+ *
+ * @param               p_session           Not used
+ * @param               p_sent              Not used
+ * @param[in]           p_received          Pointer to the answer
+ * @param               mid                 Not used
+ *
+ * @return              coap_response_t     Always accepted
+ */
+static coap_response_t coap_client_on_response(coap_session_t *p_session,
+                                               coap_pdu_t const *p_sent,
+                                               coap_pdu_t const *p_received,
+                                               coap_mid_t const mid)
+{
+        coap_pdu_code_t const code = coap_pdu_get_code(p_received);
+        bool const is_accepted = (2 == COAP_RESPONSE_CLASS(code));
+
+        (void)p_session;
+        (void)p_sent;
+        (void)mid;
+
+        if (coap_client_is_pending(p_received)) {
+                m_response_code = code;
+                m_is_answered = true;
+                m_is_waiting = false;
+        }
+
+        if (!is_accepted) {
+                ESP_LOGE(TAG, "CoAP POST rejected: %d.%02d",
+                         COAP_RESPONSE_CLASS(code),
+                         code & 0x1F);
+        }
+
+        device_state_set_link(is_accepted);
+        display_set_link_status(is_accepted);
+
+        return COAP_RESPONSE_OK;
+}
+
+/*!
+ * @brief Give up on a post
+ *
+ * Runs from `coap_io_process`, in the task posting, once the retransmissions
+ * of a confirmable post run out, or the server resets it.
+ *
+ * @param               p_session           Not used
+ * @param[in]           p_sent              Pointer to the post, if known
+ * @param[in]           reason              Why the post was given up on
+ * @param               mid                 Not used
+ *
+ * @return              -                   -
+ */
+static void coap_client_on_nack(coap_session_t *p_session,
+                                coap_pdu_t const *p_sent,
+                                coap_nack_reason_t const reason,
+                                coap_mid_t const mid)
+{
+        (void)p_session;
+        (void)mid;
+
+        ESP_LOGD(TAG, "CoAP NACK: %d", (int)reason);
+
+        if ((NULL == p_sent) || (coap_client_is_pending(p_sent))) {
+                m_is_waiting = false;
+        }
+}
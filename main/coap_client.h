@@ -0,0 +1,78 @@
+/*!
+ *******************************************************************************
+ * @file coap_client.h
+ *
+ * @brief Telemetry transport over CoAP
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef COAP_CLIENT_H
+#define COAP_CLIENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+//! @brief Longest payload posted. Longer ones wouldn't fit a single datagram
+//!        of the default 1152 bytes, and would need a block-wise transfer,
+//!        not supported. Leaves room for the header, the token and the
+//!        options, with a device token of up to about 90 characters.
+#define COAP_CLIENT_MAX_PAYLOAD             (1024)
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Exchange counters, since boot
+typedef struct {
+        //! @brief Posts sent, confirmable or not
+        uint32_t posts;
+
+        //! @brief Confirmable posts answered with a success code
+        uint32_t acknowledged;
+
+        //! @brief Posts which couldn't be sent, and confirmable posts which
+        //!        weren't answered or were rejected
+        uint32_t failures;
+
+        //! @brief Sessions opened, each one resolving the server address
+        uint32_t sessions;
+} coap_client_stats_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize the CoAP client
+bool coap_client_init(void);
+
+//! @brief Post telemetry to the server
+bool coap_client_post(char const * const p_payload, bool const is_confirmable);
+
+//! @brief Get the exchange counters
+bool coap_client_get_stats(coap_client_stats_t * const p_stats);
+
+#endif //COAP_CLIENT_H
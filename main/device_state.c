@@ -0,0 +1,282 @@
+/*!
+ *******************************************************************************
+ * @file device_state.c
+ *
+ * @brief Snapshot of the latest state of the device
+ *
+ * Collects in a single record the latest values of the device: sensor
+ * readings, battery voltage, wifi and server link status and whether the
+ * display is on, so any module can pull them without queue traffic.
+ *
+ * The record is protected by a sequence lock: writers make the sequence
+ * number odd while they update the record, and readers copy the record and
+ * retry if the sequence number was odd or changed meanwhile. Readers never
+ * block writers nor take any lock, so a snapshot can be taken from any task or
+ * ISR.
+ *
+ * Each field has a single writer module. Writers are serialized among
+ * themselves by a critical section, which also keeps ISRs on the same core from
+ * interrupting a write and spinning forever on an odd sequence number.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#include "device_state.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Start updating the record
+static void write_begin(void);
+
+//! @brief Finish updating the record
+static void write_end(void);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Device state record
+static device_state_t m_state;
+
+//! @brief Sequence number, odd while the record is being updated
+static uint32_t m_sequence = 0;
+
+//! @brief Serializes the writers
+static portMUX_TYPE m_write_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Get a consistent snapshot of the device state
+ *
+ * Lock free, can be called from an ISR
+ *
+ * @param[out]          p_snapshot          Pointer where to copy the state
+ *
+ * @return              -                   -
+ */
+void device_state_get(device_state_t * const p_snapshot)
+{
+        uint32_t sequence_before;
+        uint32_t sequence_after;
+
+        if (NULL == p_snapshot) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        do {
+                sequence_before = __atomic_load_n(&m_sequence,
+                                                  __ATOMIC_ACQUIRE);
+
+                memcpy(p_snapshot, &m_state, sizeof(*p_snapshot));
+
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+                sequence_after = __atomic_load_n(&m_sequence,
+                                                 __ATOMIC_RELAXED);
+
+        } while ((0 != (sequence_before % 2)) ||
+                 (sequence_before != sequence_after));
+}
+
+/*!
+ * @brief Update the latest reading of a sensor
+ *
+ * Written by the sensor module only
+ *
+ * @param[in]           p_reading           Pointer to the reading
+ *
+ * @return              -                   -
+ */
+void device_state_set_reading(sensor_reading_t const * const p_reading)
+{
+        int64_t const now_us = esp_timer_get_time();
+
+        if ((NULL == p_reading) || (SENSOR_COUNT <= p_reading->sensor)) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        write_begin();
+        m_state.readings[p_reading->sensor] = *p_reading;
+        m_state.readings_time_us[p_reading->sensor] = now_us;
+        write_end();
+}
+
+/*!
+ * @brief Update the battery voltage
+ *
+ * Written by the battery module only
+ *
+ * @param[in]           battery_mv          Battery voltage (in mV)
+ *
+ * @return              -                   -
+ */
+void device_state_set_battery(uint32_t const battery_mv)
+{
+        int64_t const now_us = esp_timer_get_time();
+
+        write_begin();
+        m_state.battery_mv = battery_mv;
+        m_state.battery_time_us = now_us;
+        write_end();
+}
+
+/*!
+ * @brief Update the wifi status
+ *
+ * Written by the wifi module only
+ *
+ * @param[in]           status              Connection status
+ * @param[in]           p_wifi              Pointer to the access point, IP
+ *                                          address and signal strength
+ *
+ * @return              -                   -
+ */
+void device_state_set_wifi(wifi_status_t const status,
+                           display_wifi_status_t const * const p_wifi)
+{
+        int64_t const now_us = esp_timer_get_time();
+
+        if (NULL == p_wifi) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        write_begin();
+        m_state.wifi_status = status;
+        m_state.wifi = *p_wifi;
+        m_state.wifi_time_us = now_us;
+        write_end();
+}
+
+/*!
+ * @brief Update the server link status
+ *
+ * Written by the telemetry transport only
+ *
+ * @param[in]           linked              Whether the server was reached last
+ *
+ * @return              -                   -
+ */
+void device_state_set_link(bool const linked)
+{
+        int64_t const now_us = esp_timer_get_time();
+
+        write_begin();
+        m_state.linked = linked;
+        m_state.link_time_us = now_us;
+        write_end();
+}
+
+/*!
+ * @brief Update the display status
+ *
+ * Written by the display module only
+ *
+ * @param[in]           is_enabled          Whether the display is on
+ *
+ * @return              -                   -
+ */
+void device_state_set_display(bool const is_enabled)
+{
+        write_begin();
+        m_state.display_enabled = is_enabled;
+        write_end();
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Start updating the record
+ *
+ * Makes the sequence number odd, so readers know they have to retry
+ *
+ * @return              -                   -
+ */
+static void write_begin(void)
+{
+        portENTER_CRITICAL(&m_write_lock);
+
+        __atomic_store_n(&m_sequence, m_sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/*!
+ * @brief Finish updating the record
+ *
+ * Makes the sequence number even again, once the record is consistent
+ *
+ * @return              -                   -
+ */
+static void write_end(void)
+{
+        __atomic_store_n(&m_sequence, m_sequence + 1, __ATOMIC_RELEASE);
+
+        portEXIT_CRITICAL(&m_write_lock);
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
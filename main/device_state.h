@@ -0,0 +1,110 @@
+/*!
+ *******************************************************************************
+ * @file device_state.h
+ *
+ * @brief Snapshot of the latest state of the device
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef DEVICE_STATE_H
+#define DEVICE_STATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sensor.h"
+#include "display.h"
+#include "wifi.h"
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Latest state of the device
+ *
+ * Update times are in microseconds since boot, 0 means the field has never
+ * been updated.
+ */
+typedef struct {
+        //! @brief Latest reading of each sensor
+        sensor_reading_t readings[SENSOR_COUNT];
+
+        //! @brief Time of the latest reading of each sensor
+        int64_t readings_time_us[SENSOR_COUNT];
+
+        //! @brief Battery voltage (in mV)
+        uint32_t battery_mv;
+
+        //! @brief Time of the latest battery measurement
+        int64_t battery_time_us;
+
+        //! @brief Wifi connection status
+        wifi_status_t wifi_status;
+
+        //! @brief Access point, IP address and signal strength
+        display_wifi_status_t wifi;
+
+        //! @brief Time of the latest wifi status report
+        int64_t wifi_time_us;
+
+        //! @brief Whether the last post to the server succeeded
+        bool linked;
+
+        //! @brief Time of the latest post to the server
+        int64_t link_time_us;
+
+        //! @brief Whether the display is on
+        bool display_enabled;
+} device_state_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Get a consistent snapshot of the device state
+void device_state_get(device_state_t * const p_snapshot);
+
+//! @brief Update the latest reading of a sensor
+void device_state_set_reading(sensor_reading_t const * const p_reading);
+
+//! @brief Update the battery voltage
+void device_state_set_battery(uint32_t const battery_mv);
+
+//! @brief Update the wifi status
+void device_state_set_wifi(wifi_status_t const status,
+                           display_wifi_status_t const * const p_wifi);
+
+//! @brief Update the server link status
+void device_state_set_link(bool const linked);
+
+//! @brief Update the display status
+void device_state_set_display(bool const is_enabled);
+
+#endif //DEVICE_STATE_H
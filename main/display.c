@@ -23,6 +23,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -38,6 +39,9 @@
 #include "st7789.h"
 
 #include "display.h"
+#include "device_state.h"
+#include "sample_bus.h"
+#include "statistics.h"
 
 /*
  *******************************************************************************
@@ -54,12 +58,23 @@
 #define TASK_PRIORITY               TASKS_CONFIG_DISPLAY_PRIORITY
 #define TAG                                 "display"
 
+//! @brief Rate of change shown as a rising or falling trend (in ppm per hour)
+#define TREND_MIN_PPM_PER_HOUR              (120)
+
 /*
  *******************************************************************************
  * Data types                                                                  *
  *******************************************************************************
  */
 
+//! @brief Direction the concentration is heading to
+typedef enum {
+        TREND_STEADY = 0,
+        TREND_RISING,
+        TREND_FALLING,
+        TREND_COUNT
+} trend_t;
+
 /*
  *******************************************************************************
  * Constants                                                                   *
@@ -68,6 +83,13 @@
 
 xQueueHandle display_q;
 
+//! @brief Symbol shown for each trend
+static char const * const m_trend_symbols[TREND_COUNT] = {
+                "",
+                LV_SYMBOL_UP,
+                LV_SYMBOL_DOWN,
+};
+
 /*
  *******************************************************************************
  * Private Function Prototypes                                                 *
@@ -84,14 +106,21 @@ static void backlight_timer_cb(TimerHandle_t const timer_handle);
 
 static void display_enable_backlight(bool const is_enabled);
 
+static void display_paint(display_msg_t const * const p_message);
+
+static void display_replay(void);
+
+static void display_paint_concentration(device_state_t const * const p_state,
+                                        bool const force);
+
+static void display_paint_trend(uint8_t const sensor, bool const force);
+
 /*
  *******************************************************************************
  * Public Data Declarations                                                    *
  *******************************************************************************
  */
 
-extern TaskHandle_t sensor_task_h;
-
 extern TaskHandle_t battery_task_h;
 
 TaskHandle_t display_task_h = NULL;
@@ -134,6 +163,32 @@ static lv_color_t m_buffer_2[DISP_BUF_SIZE];
 
 static lv_disp_buf_t m_display_buffer;
 
+static lv_obj_t * m_co2_value;
+
+static lv_obj_t * m_ip_label;
+
+static lv_obj_t * m_trend_label;
+
+static lv_obj_t * m_battery_label;
+
+static lv_obj_t * m_wifi_sign_canvas;
+
+static lv_obj_t * m_battery_sign_canvas;
+
+static lv_obj_t * m_link_sign_canvas;
+
+//! @brief Subscription to the sample bus, polled while the display is on
+static sample_bus_subscriber_t m_subscriber;
+
+//! @brief Concentration shown (in ppm)
+static uint32_t m_shown_ppm;
+
+//! @brief Whether `m_shown_ppm` holds a value
+static bool m_is_ppm_shown = false;
+
+//! @brief Trend shown
+static trend_t m_shown_trend = TREND_STEADY;
+
 /*
  *******************************************************************************
  * Public Function Bodies                                                      *
@@ -196,8 +251,13 @@ bool display_init(void)
         }
 
         if (success) {
-                // Tell `sensor_task_h` and `battery_task_h` that our queue is ready to be used
-                (void)xTaskNotifyIndexed(sensor_task_h, 0, 0, eNoAction);
+                success = sample_bus_subscribe(&m_subscriber, NULL, NULL);
+        }
+
+        if (success) {
+                device_state_set_display(m_display_bckl_is_enabled);
+
+                // Tell `battery_task_h` that our queue is ready to be used
                 (void)xTaskNotifyIndexed(battery_task_h, 0, 0, eNoAction);
 
                 task_result = xTaskCreate((TaskFunction_t)display_task,
@@ -242,6 +302,26 @@ bool display_is_enabled(void)
         return m_display_bckl_is_enabled;
 }
 
+/*!
+ * @brief Turn the backlight on, or keep it on for longer
+ *
+ * Unlike the backlight button, it never turns the backlight off. Can be
+ * called from any task.
+ *
+ * @return              bool                False if the display task isn't
+ *                                          running yet
+ */
+bool display_wake(void)
+{
+        bool const success = (NULL != display_task_h);
+
+        if (success) {
+                (void)xTaskNotify(display_task_h, DISPLAY_NOTIFY_WAKE, eSetBits);
+        }
+
+        return success;
+}
+
 /*
  *******************************************************************************
  * Private Function Bodies                                                     *
@@ -288,9 +368,18 @@ static bool display_send_message(display_msg_type_t const type, void * value)
                         break;
                 }
 
-                queue_result = xQueueSend(display_q, &p_message, 0);
+                /* While the display is off, the message is dropped, the value
+                 * is painted from the device state when the display wakes up
+                 */
+                if (display_is_enabled()) {
+                        queue_result = xQueueSend(display_q, &p_message, 0);
 
-                success = (pdPASS == queue_result);
+                        success = (pdPASS == queue_result);
+                } else {
+                        vPortFree(p_message);
+                        p_message = NULL;
+                        success = true;
+                }
         }
 
         if (!success) {
@@ -320,9 +409,139 @@ static void display_enable_backlight(bool const is_enabled)
         }
 
         m_display_bckl_is_enabled = is_enabled;
+        device_state_set_display(is_enabled);
         st7789_enable_backlight(is_enabled);
 }
 
+/*!
+ * @brief Repaint every field with its last known value
+ *
+ * Values are taken from the device state. Messages still queued and samples
+ * published from before the display went off are discarded, as they are
+ * already superseded by it.
+ *
+ * @return              -                   -
+ */
+static void display_replay(void)
+{
+        display_msg_t * p_message = NULL;
+        display_msg_t message;
+        device_state_t state;
+
+        while (pdTRUE == xQueueReceive(display_q, &p_message, NO_WAIT)) {
+                vPortFree(p_message);
+                p_message = NULL;
+        }
+
+        sample_bus_skip(&m_subscriber);
+
+        device_state_get(&state);
+
+        display_paint_concentration(&state, true);
+
+        if (0 != state.battery_time_us) {
+                message.type = DISPLAY_MSG_BATTERY_LEVEL;
+                message.numeric_value = state.battery_mv;
+                display_paint(&message);
+        }
+
+        if (0 != state.wifi_time_us) {
+                message.type = DISPLAY_MSG_WIFI_STATUS;
+                message.wifi_status = state.wifi;
+                display_paint(&message);
+        }
+
+        if (0 != state.link_time_us) {
+                message.type = DISPLAY_MSG_LINK_STATUS;
+                message.flag = state.linked;
+                display_paint(&message);
+        }
+}
+
+/*!
+ * @brief Paint the highest concentration among the sensors, and its trend
+ *
+ * @param[in]           p_state             Pointer to the device state
+ * @param[in]           force               Paint even if the concentration
+ *                                          didn't change
+ *
+ * @return              -                   -
+ */
+static void display_paint_concentration(device_state_t const * const p_state,
+                                        bool const force)
+{
+        display_msg_t message;
+        bool has_reading = false;
+        bool is_painted = false;
+        uint8_t sensor = 0;
+        size_t i;
+
+        message.type = DISPLAY_MSG_CO2_PPM;
+        message.numeric_value = 0;
+
+        for (i = 0; SENSOR_COUNT > i; ++i) {
+                if ((0 != p_state->readings_time_us[i]) &&
+                    (p_state->readings[i].co2_ppm[DISPLAY_READINGS_STREAM] >=
+                     message.numeric_value)) {
+
+                        message.numeric_value =
+                                p_state->readings[i].co2_ppm[DISPLAY_READINGS_STREAM];
+                        sensor = (uint8_t)i;
+                        has_reading = true;
+                }
+        }
+
+        // Don't repaint the label for nothing
+        if ((has_reading) &&
+            ((force) ||
+             (!m_is_ppm_shown) ||
+             (message.numeric_value != m_shown_ppm))) {
+
+                display_paint(&message);
+                m_shown_ppm = message.numeric_value;
+                m_is_ppm_shown = true;
+                is_painted = true;
+        }
+
+        // The value width may have changed, so the symbol is placed again
+        if (has_reading) {
+                display_paint_trend(sensor, is_painted);
+        }
+}
+
+/*!
+ * @brief Paint the trend of a sensor next to the concentration
+ *
+ * @param[in]           sensor              Index of the sensor shown
+ * @param[in]           force               Paint even if the trend didn't
+ *                                          change
+ *
+ * @return              -                   -
+ */
+static void display_paint_trend(uint8_t const sensor, bool const force)
+{
+        trend_t trend = TREND_STEADY;
+        int32_t ppm_per_hour;
+
+        if (statistics_get_trend(sensor, &ppm_per_hour)) {
+                if (TREND_MIN_PPM_PER_HOUR <= ppm_per_hour) {
+                        trend = TREND_RISING;
+                } else if (-TREND_MIN_PPM_PER_HOUR >= ppm_per_hour) {
+                        trend = TREND_FALLING;
+                }
+        }
+
+        if ((force) || (trend != m_shown_trend)) {
+                lv_label_set_text(m_trend_label, m_trend_symbols[trend]);
+                lv_obj_align(m_trend_label,
+                             m_co2_value,
+                             LV_ALIGN_OUT_RIGHT_MID,
+                             5,
+                             0);
+                m_shown_trend = trend;
+        }
+}
+
 static void draw_network_symbol(lv_obj_t * canvas, int8_t strength)
 {
         int32_t const start_angle = 225;
@@ -514,33 +733,20 @@ static void draw_backend_link_symbol(lv_obj_t * canvas, bool linked)
                             &draw_dsc);
 }
 
-/*
- *******************************************************************************
- * Interrupt Service Routines / Tasks / Thread Main Functions                  *
- *******************************************************************************
+/*!
+ * @brief Paint the value carried by a message into its field
+ *
+ * @param[in]           p_message           Pointer to the message
+ *
+ * @return              -                   -
  */
-
-_Noreturn static void display_task(void * pvParameters)
+static void display_paint(display_msg_t const * const p_message)
 {
-        uint32_t const low_concentration_max = 1000;
-        uint32_t const high_concentration_min = 1500;
-        char const * ip_label_default_text = "No IP";
-        char const * battery_label_default_text = "";
+        uint32_t const low_concentration_max = CONFIG_CO2_MONITOR_ALARM_WARNING_PPM;
+        uint32_t const high_concentration_min = CONFIG_CO2_MONITOR_ALARM_CRITICAL_PPM;
         size_t const ssid_str_size = 33;
         size_t const ip_str_size = 16;
         size_t const separator_size = 3;
-        bool const backlight_automatic = (NULL != m_backlight_timer_h);
-
-        lv_obj_t * const scr = lv_scr_act();
-        lv_obj_t * const co2_value = lv_label_create(scr, NULL);
-        lv_obj_t * const units = lv_label_create(scr, NULL);
-        lv_obj_t * const ip_label = lv_label_create(scr, NULL);
-        lv_obj_t * const battery_label = lv_label_create(scr, NULL);
-        lv_obj_t * const wifi_sign_canvas = lv_canvas_create(scr, NULL);
-        lv_obj_t * const battery_sign_canvas = lv_canvas_create(scr, NULL);
-        lv_obj_t * const link_sign_canvas = lv_canvas_create(scr, NULL);
-
-        display_msg_t * p_message = NULL;
 
         int8_t rssi;
         uint32_t ip_addr;
@@ -551,181 +757,233 @@ _Noreturn static void display_task(void * pvParameters)
         char label_buffer[ssid_str_size + separator_size + ip_str_size];
         char ip_str[ip_str_size];
         bool style_changed;
-        BaseType_t queue_result;
-        BaseType_t notification_result;
         lv_color_t co2_value_color;
-        bool is_enabled;
 
-        /* configure CO2 concentration value style */
-        lv_style_set_text_font(&m_concentration_style, LV_STATE_DEFAULT, &lv_font_montserrat_48);
-        lv_style_set_text_color(&m_concentration_style, LV_STATE_DEFAULT, LV_COLOR_WHITE);
+        switch (p_message->type) {
 
-        /* configure CO2 concentration units style */
-        lv_style_set_text_font(&m_units_style, LV_STATE_DEFAULT, &lv_font_montserrat_16);
-        lv_style_set_text_color(&m_units_style, LV_STATE_DEFAULT, LV_COLOR_WHITE);
+        case DISPLAY_MSG_CO2_PPM:
+                co2_ppm = p_message->numeric_value;
 
-        lv_style_set_bg_color(&m_bg_style, LV_STATE_DEFAULT, LV_COLOR_BLACK);
+                style_changed = true;
 
-        lv_obj_add_style(units, LV_LABEL_PART_MAIN, &m_units_style);
-        lv_obj_set_pos(units, 80, 85);
-        lv_label_set_text(units, "ppm CO2");
+                if (low_concentration_max > co2_ppm) {
+                        co2_value_color = LV_COLOR_GREEN;
 
-        lv_obj_add_style(scr, LV_OBJ_PART_MAIN, &m_bg_style);
+                } else if ((low_concentration_max < co2_ppm) &&
+                           (high_concentration_min > co2_ppm)) {
 
-        lv_obj_add_style(co2_value, LV_LABEL_PART_MAIN, &m_concentration_style);
-        lv_label_set_text(co2_value, "-");
-        lv_label_set_long_mode(co2_value, LV_LABEL_LONG_EXPAND);
-        lv_obj_align(co2_value, NULL, LV_ALIGN_CENTER, 0, 0);
-        lv_label_set_align(co2_value, LV_LABEL_ALIGN_CENTER);
+                        co2_value_color =  LV_COLOR_ORANGE;
 
-        lv_obj_add_style(ip_label, LV_LABEL_PART_MAIN, &m_units_style);
-        lv_label_set_long_mode(ip_label, LV_LABEL_LONG_SROLL_CIRC);
-        lv_obj_set_width(ip_label, 100);
-        lv_label_set_text(ip_label, ip_label_default_text);
-        lv_obj_align(ip_label, NULL, LV_ALIGN_IN_TOP_RIGHT, 0, 0);
-        lv_label_set_anim_speed(ip_label, 100);
+                } else if (high_concentration_min < co2_ppm) {
+                        co2_value_color = LV_COLOR_RED;
 
-        lv_obj_align(battery_sign_canvas, NULL, LV_ALIGN_IN_BOTTOM_LEFT, 0, -20);
-        lv_obj_align(link_sign_canvas, wifi_sign_canvas, LV_ALIGN_OUT_RIGHT_MID, 0, 0);
+                } else {
+                        style_changed = false;
+                }
 
-        lv_obj_add_style(battery_label, LV_LABEL_PART_MAIN, &m_units_style);
-        lv_label_set_text(battery_label, battery_label_default_text);
-        lv_label_set_long_mode(battery_label, LV_LABEL_LONG_EXPAND);
-        lv_obj_align(battery_label, battery_sign_canvas, LV_ALIGN_OUT_RIGHT_MID, 0, 0);
-        lv_label_set_align(battery_label, LV_LABEL_ALIGN_LEFT);
+                if (style_changed) {
+                        lv_style_set_text_color(
+                                        &m_concentration_style,
+                                        LV_STATE_DEFAULT,
+                                        co2_value_color);
 
-        while (1) {
+                        lv_obj_add_style(
+                                        m_co2_value,
+                                        LV_LABEL_PART_MAIN,
+                                        &m_concentration_style);
+                }
 
-                notification_result = xTaskNotifyWait(0xFFFFFFFFUL,
-                                                      0xFFFFFFFFUL,
-                                                      NULL,
-                                                      m_display_task_refresh_rate);
+                sprintf(label_buffer, "%u", co2_ppm);
+                lv_label_set_text(m_co2_value, label_buffer);
+                lv_label_set_long_mode(m_co2_value, LV_LABEL_LONG_EXPAND);
+                lv_obj_align(m_co2_value, NULL, LV_ALIGN_CENTER, 0, 0);
 
-                // Handle backlight state only if automatic mode is configured
-                if ((pdPASS == notification_result) && (backlight_automatic)) {
+                break;
 
-                        is_enabled = display_is_enabled();
+        case DISPLAY_MSG_WIFI_STATUS:
+                ip_addr = p_message->wifi_status.ip;
+                rssi = p_message->wifi_status.rssi;
 
-                        display_enable_backlight(!is_enabled);
+                if (0 == strlen(p_message->wifi_status.ap_ssid)) {
+                        strcpy(label_buffer, DISPLAY_NO_AP_TEXT);
+                } else {
+                        strcpy(label_buffer,
+                                p_message->wifi_status.ap_ssid);
                 }
 
-                // Don't receive any messages if the display won't show them
-                if (portMAX_DELAY == m_display_task_refresh_rate) {
-                        // Code style exception for readability
-                        continue;
+                if (0 == ip_addr) {
+                        sprintf(ip_str, DISPLAY_NO_IP_TEXT);
+                } else {
+                        octets[3] = (uint8_t)((ip_addr >> 3) & 0x000000FF);
+                        octets[2] = (uint8_t)((ip_addr >> 2) & 0x000000FF);
+                        octets[1] = (uint8_t)((ip_addr >> 1) & 0x000000FF);
+                        octets[0] = (uint8_t)(ip_addr & 0x000000FF);
+
+                        sprintf(ip_str, "%u.%u.%u.%u",
+                                octets[0],
+                                octets[1],
+                                octets[2],
+                                octets[3]);
                 }
 
-                queue_result = xQueueReceive(display_q, &p_message, NO_WAIT);
+                strcat(label_buffer, ", ");
+                strcat(label_buffer, ip_str);
 
-                if ((pdTRUE == queue_result) && (NULL != p_message)) {
+                /* Only refresh label if it changed, so scroll
+                 * animation is not spoiled
+                 */
+                if (0 != strcmp(label_buffer,
+                                lv_label_get_text(m_ip_label))) {
+                        lv_label_set_text(m_ip_label, label_buffer);
+                }
 
-                        switch (p_message->type) {
+                draw_network_symbol(m_wifi_sign_canvas, rssi);
 
-                        case DISPLAY_MSG_CO2_PPM:
-                                co2_ppm = p_message->numeric_value;
+                break;
 
-                                style_changed = true;
+        case DISPLAY_MSG_BATTERY_LEVEL:
+                battery_level = p_message->numeric_value;
 
-                                if (low_concentration_max > co2_ppm) {
-                                        co2_value_color = LV_COLOR_GREEN;
+                sprintf(label_buffer, "%.2f V", ((float)battery_level) / 1000);
 
-                                } else if ((low_concentration_max < co2_ppm) &&
-                                           (high_concentration_min > co2_ppm)) {
+                draw_battery_symbol(m_battery_sign_canvas, 5);
+                lv_label_set_text(m_battery_label, label_buffer);
+                lv_label_set_long_mode(m_battery_label, LV_LABEL_LONG_EXPAND);
+                lv_obj_align(m_battery_label, m_battery_sign_canvas, LV_ALIGN_OUT_RIGHT_MID, 5, 0);
 
-                                        co2_value_color =  LV_COLOR_ORANGE;
+                break;
 
-                                } else if (high_concentration_min < co2_ppm) {
-                                        co2_value_color = LV_COLOR_RED;
+        case DISPLAY_MSG_LINK_STATUS:
+                linked = p_message->flag;
 
-                                } else {
-                                        style_changed = false;
-                                }
+                draw_backend_link_symbol(m_link_sign_canvas, linked);
+                lv_obj_align(m_link_sign_canvas, m_wifi_sign_canvas, LV_ALIGN_OUT_RIGHT_MID, 0, 0);
 
-                                if (style_changed) {
-                                        lv_style_set_text_color(
-                                                        &m_concentration_style,
-                                                        LV_STATE_DEFAULT,
-                                                        co2_value_color);
+                draw_battery_symbol(m_battery_sign_canvas, 5);
+                break;
 
-                                        lv_obj_add_style(
-                                                        co2_value,
-                                                        LV_LABEL_PART_MAIN,
-                                                        &m_concentration_style);
-                                }
+        default:
+                break;
 
-                                sprintf(label_buffer, "%u", co2_ppm);
-                                lv_label_set_text(co2_value, label_buffer);
-                                lv_label_set_long_mode(co2_value, LV_LABEL_LONG_EXPAND);
-                                lv_obj_align(co2_value, NULL, LV_ALIGN_CENTER, 0, 0);
+        }
+}
 
-                                break;
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
 
-                        case DISPLAY_MSG_WIFI_STATUS:
-                                ip_addr = p_message->wifi_status.ip;
-                                rssi = p_message->wifi_status.rssi;
+_Noreturn static void display_task(void * pvParameters)
+{
+        char const * ip_label_default_text = "No IP";
+        char const * battery_label_default_text = "";
+        bool const backlight_automatic = (NULL != m_backlight_timer_h);
+
+        lv_obj_t * const scr = lv_scr_act();
+        lv_obj_t * const units = lv_label_create(scr, NULL);
 
-                                if (0 == strlen(p_message->wifi_status.ap_ssid)) {
-                                        strcpy(label_buffer, DISPLAY_NO_AP_TEXT);
-                                } else {
-                                        strcpy(label_buffer,
-                                                p_message->wifi_status.ap_ssid);
-                                }
+        display_msg_t * p_message = NULL;
 
-                                if (0 == ip_addr) {
-                                        sprintf(ip_str, DISPLAY_NO_IP_TEXT);
-                                } else {
-                                        octets[3] = (uint8_t)((ip_addr >> 3) & 0x000000FF);
-                                        octets[2] = (uint8_t)((ip_addr >> 2) & 0x000000FF);
-                                        octets[1] = (uint8_t)((ip_addr >> 1) & 0x000000FF);
-                                        octets[0] = (uint8_t)(ip_addr & 0x000000FF);
+        BaseType_t queue_result;
+        BaseType_t notification_result;
+        uint32_t notification;
+        device_state_t state;
+        bool is_enabled;
 
-                                        sprintf(ip_str, "%u.%u.%u.%u",
-                                                octets[0],
-                                                octets[1],
-                                                octets[2],
-                                                octets[3]);
-                                }
+        m_co2_value = lv_label_create(scr, NULL);
+        m_ip_label = lv_label_create(scr, NULL);
+        m_trend_label = lv_label_create(scr, NULL);
+        m_battery_label = lv_label_create(scr, NULL);
+        m_wifi_sign_canvas = lv_canvas_create(scr, NULL);
+        m_battery_sign_canvas = lv_canvas_create(scr, NULL);
+        m_link_sign_canvas = lv_canvas_create(scr, NULL);
 
-                                strcat(label_buffer, ", ");
-                                strcat(label_buffer, ip_str);
+        /* configure CO2 concentration value style */
+        lv_style_set_text_font(&m_concentration_style, LV_STATE_DEFAULT, &lv_font_montserrat_48);
+        lv_style_set_text_color(&m_concentration_style, LV_STATE_DEFAULT, LV_COLOR_WHITE);
+
+        /* configure CO2 concentration units style */
+        lv_style_set_text_font(&m_units_style, LV_STATE_DEFAULT, &lv_font_montserrat_16);
+        lv_style_set_text_color(&m_units_style, LV_STATE_DEFAULT, LV_COLOR_WHITE);
+
+        lv_style_set_bg_color(&m_bg_style, LV_STATE_DEFAULT, LV_COLOR_BLACK);
+
+        lv_obj_add_style(units, LV_LABEL_PART_MAIN, &m_units_style);
+        lv_obj_set_pos(units, 80, 85);
+        lv_label_set_text(units, "ppm CO2");
 
-                                /* Only refresh label if it changed, so scroll
-                                 * animation is not spoiled
-                                 */
-                                if (0 != strcmp(label_buffer,
-                                                lv_label_get_text(ip_label))) {
-                                        lv_label_set_text(ip_label, label_buffer);
-                                }
+        lv_obj_add_style(scr, LV_OBJ_PART_MAIN, &m_bg_style);
 
-                                draw_network_symbol(wifi_sign_canvas, rssi);
+        lv_obj_add_style(m_co2_value, LV_LABEL_PART_MAIN, &m_concentration_style);
+        lv_label_set_text(m_co2_value, "-");
+        lv_label_set_long_mode(m_co2_value, LV_LABEL_LONG_EXPAND);
+        lv_obj_align(m_co2_value, NULL, LV_ALIGN_CENTER, 0, 0);
+        lv_label_set_align(m_co2_value, LV_LABEL_ALIGN_CENTER);
 
-                                break;
+        lv_obj_add_style(m_trend_label, LV_LABEL_PART_MAIN, &m_units_style);
+        lv_label_set_text(m_trend_label, m_trend_symbols[TREND_STEADY]);
+        lv_obj_align(m_trend_label, m_co2_value, LV_ALIGN_OUT_RIGHT_MID, 5, 0);
 
-                        case DISPLAY_MSG_BATTERY_LEVEL:
-                                battery_level = p_message->numeric_value;
+        lv_obj_add_style(m_ip_label, LV_LABEL_PART_MAIN, &m_units_style);
+        lv_label_set_long_mode(m_ip_label, LV_LABEL_LONG_SROLL_CIRC);
+        lv_obj_set_width(m_ip_label, 100);
+        lv_label_set_text(m_ip_label, ip_label_default_text);
+        lv_obj_align(m_ip_label, NULL, LV_ALIGN_IN_TOP_RIGHT, 0, 0);
+        lv_label_set_anim_speed(m_ip_label, 100);
 
-                                sprintf(label_buffer, "%.2f V", ((float)battery_level) / 1000);
+        lv_obj_align(m_battery_sign_canvas, NULL, LV_ALIGN_IN_BOTTOM_LEFT, 0, -20);
+        lv_obj_align(m_link_sign_canvas, m_wifi_sign_canvas, LV_ALIGN_OUT_RIGHT_MID, 0, 0);
 
-                                draw_battery_symbol(battery_sign_canvas, 5);
-                                lv_label_set_text(battery_label, label_buffer);
-                                lv_label_set_long_mode(battery_label, LV_LABEL_LONG_EXPAND);
-                                lv_obj_align(battery_label, battery_sign_canvas, LV_ALIGN_OUT_RIGHT_MID, 5, 0);
+        lv_obj_add_style(m_battery_label, LV_LABEL_PART_MAIN, &m_units_style);
+        lv_label_set_text(m_battery_label, battery_label_default_text);
+        lv_label_set_long_mode(m_battery_label, LV_LABEL_LONG_EXPAND);
+        lv_obj_align(m_battery_label, m_battery_sign_canvas, LV_ALIGN_OUT_RIGHT_MID, 0, 0);
+        lv_label_set_align(m_battery_label, LV_LABEL_ALIGN_LEFT);
 
-                                break;
+        while (1) {
 
-                        case DISPLAY_MSG_LINK_STATUS:
-                                linked = p_message->flag;
+                notification_result = xTaskNotifyWait(0xFFFFFFFFUL,
+                                                      0xFFFFFFFFUL,
+                                                      &notification,
+                                                      m_display_task_refresh_rate);
 
-                                draw_backend_link_symbol(link_sign_canvas, linked);
-                                lv_obj_align(link_sign_canvas, wifi_sign_canvas, LV_ALIGN_OUT_RIGHT_MID, 0, 0);
+                // Handle backlight state only if automatic mode is configured
+                if ((pdPASS == notification_result) && (backlight_automatic)) {
 
-                                draw_battery_symbol(battery_sign_canvas, 5);
-                                break;
+                        is_enabled = display_is_enabled();
 
-                        default:
-                                break;
+                        // A wake up only restarts the timeout if already on
+                        if (0 != (notification & DISPLAY_NOTIFY_TOGGLE)) {
+                                display_enable_backlight(!is_enabled);
+                        } else {
+                                display_enable_backlight(true);
+                        }
 
+                        // Values sent while the display was off weren't shown
+                        if (!is_enabled) {
+                                display_replay();
                         }
+                }
+
+                // Don't receive any messages if the display won't show them
+                if (portMAX_DELAY == m_display_task_refresh_rate) {
+                        // Code style exception for readability
+                        continue;
+                }
+
+                // New samples only tell the concentration may have changed
+                if (NULL != sample_bus_peek(&m_subscriber)) {
+                        sample_bus_skip(&m_subscriber);
+                        device_state_get(&state);
+                        display_paint_concentration(&state, false);
+                }
+
+                queue_result = xQueueReceive(display_q, &p_message, NO_WAIT);
+
+                if ((pdTRUE == queue_result) && (NULL != p_message)) {
+
+                        display_paint(p_message);
 
                         vPortFree(p_message);
                         p_message = NULL;
@@ -25,6 +25,18 @@
 #define DISPLAY_BACKLIGHT_TIMEOUT_MS        (CONFIG_CO2_MONITOR_DISPLAY_BACKLIGHT_TIMEOUT_S * 1000)
 #define DISPLAY_RSSI_NO_IP_VALUE            INT8_MIN
 
+#ifdef CONFIG_CO2_MONITOR_DISPLAY_STREAM_RAW
+#define DISPLAY_READINGS_STREAM             (SENSOR_STREAM_RAW)
+#else
+#define DISPLAY_READINGS_STREAM             (SENSOR_STREAM_FILTERED)
+#endif
+
+//! @brief Display task notification bit: toggle the backlight
+#define DISPLAY_NOTIFY_TOGGLE               (1UL << 0)
+
+//! @brief Display task notification bit: turn the backlight on
+#define DISPLAY_NOTIFY_WAKE                 (1UL << 1)
+
 /*
  *******************************************************************************
  * Public Data Types                                                           *
@@ -80,4 +92,7 @@ bool display_set_link_status(bool const linked);
 
 bool display_is_enabled(void);
 
+//! @brief Turn the backlight on, or keep it on for longer
+bool display_wake(void);
+
 #endif //MAIN_MAIN_DISPLAY_H_
@@ -0,0 +1,1066 @@
+/*!
+ *******************************************************************************
+ * @file history.c
+ *
+ * @brief On-device store of the sensor readings
+ *
+ * Readings are kept in RAM, so they can be shown or uploaded once somebody is
+ * interested in them again. Raw readings are taken from the sample bus as soon
+ * as they are published.
+ *
+ * Raw readings are compressed with `co2_codec` into a ring of fixed size
+ * blocks, each of them an independent stream with the sensor index as
+ * channel. Readings usually take one to two bytes, plus the first one of each
+ * block, which holds the full time and value. When the ring is full, the
+ * oldest block is dropped.
+ *
+ * Every stored reading gets a sequence number, which consumers use as a
+ * cursor: each of them keeps its own cursor and reads the readings stored
+ * after it, at its own pace. Readings dropped before a consumer got to them
+ * are skipped.
+ *
+ * On top of that, the readings of each sensor are downsampled into tiers of
+ * one minute, ten minutes and one hour buckets, keeping the minimum, mean and
+ * maximum of each bucket. Tiers cover 4 hours, 24 hours and 7 days.
+ *
+ * Raw readings are also appended to a log in the `history` flash partition,
+ * in batches, so they survive resets. They are handed through a queue to a
+ * module task, which writes the flash, so the sample bus notification, and
+ * the sensor task publishing the readings, never wait for a flash write or
+ * erase.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
+#include "sdkconfig.h"
+
+#include "sensor.h"
+#include "sample_bus.h"
+#include "sample_log.h"
+#include "co2_codec.h"
+#include "tasks_config.h"
+
+#include "history.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+#define TAG                                 "history"
+
+#define HISTORY_RAW_BYTES                   (CONFIG_CO2_MONITOR_HISTORY_RAW_BYTES)
+#define HISTORY_FLASH_BATCH_SIZE            (CONFIG_CO2_MONITOR_HISTORY_FLASH_BATCH_SIZE)
+
+#define LOG_TASK_STACK_DEPTH                TASKS_CONFIG_HISTORY_LOG_STACK_DEPTH
+#define LOG_TASK_PRIORITY                   TASKS_CONFIG_HISTORY_LOG_PRIORITY
+
+//! @brief Readings waiting to be written to flash, enough to ride out a
+//!        sector erase at the fastest sampling rate
+#define LOG_QUEUE_LENGTH                    (32)
+
+//! @brief Label of the flash partition holding the readings log
+#define PARTITION_LABEL                     "history"
+
+//! @brief Subtype of the flash partition holding the readings log
+#define PARTITION_SUBTYPE                   ((esp_partition_subtype_t)0x40)
+
+//! @brief Size of a block of raw readings
+#define BLOCK_SIZE                          (64)
+
+//! @brief Room for encoded readings in a block
+#define BLOCK_DATA_SIZE                     (BLOCK_SIZE - 4)
+
+//! @brief Amount of blocks of raw readings
+#define BLOCK_COUNT                         (HISTORY_RAW_BYTES / BLOCK_SIZE)
+
+#define TIER_1_MIN_BUCKETS                  (4 * 60)
+#define TIER_10_MIN_BUCKETS                 (24 * 6)
+#define TIER_1_HOUR_BUCKETS                 (7 * 24)
+
+#if (CO2_CODEC_MAX_CHANNELS < SENSOR_COUNT)
+#error "Sensor index doesn't fit in the encoded readings"
+#endif
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Block of compressed raw readings
+ *
+ * Its amount of readings is the difference between the first sequence number
+ * of the next block (or the head, for the newest one) and its own.
+ */
+typedef struct {
+        //! @brief Sequence number of the first reading
+        uint32_t first_sequence;
+
+        //! @brief Encoded readings
+        uint8_t data[BLOCK_DATA_SIZE];
+} block_t;
+
+//! @brief Decoder left where the last read reading was, to carry on from it
+typedef struct {
+        //! @brief Whether the decoder is usable
+        bool is_valid;
+
+        //! @brief First sequence number of the block being decoded
+        uint32_t first_sequence;
+
+        //! @brief Sequence number of the next reading to be decoded
+        uint32_t next_sequence;
+
+        //! @brief Decoder state
+        co2_codec_t codec;
+} reader_t;
+
+//! @brief Downsampled bucket, with `min_ppm > max_ppm` if it has no readings
+typedef struct {
+        uint16_t min_ppm;
+        uint16_t mean_ppm;
+        uint16_t max_ppm;
+} bucket_t;
+
+//! @brief Downsampling tier of a sensor
+typedef struct {
+        //! @brief Ring of closed buckets
+        bucket_t * p_buckets;
+
+        //! @brief Size of `p_buckets`
+        size_t capacity;
+
+        //! @brief Position of the newest closed bucket
+        size_t newest;
+
+        //! @brief Amount of closed buckets
+        size_t count;
+
+        //! @brief Number (start time / period) of the newest closed bucket
+        uint32_t newest_number;
+
+        //! @brief Whether a bucket is open, accumulating readings
+        bool is_open;
+
+        //! @brief Number of the open bucket
+        uint32_t open_number;
+
+        //! @brief Lowest reading of the open bucket
+        uint16_t open_min_ppm;
+
+        //! @brief Highest reading of the open bucket
+        uint16_t open_max_ppm;
+
+        //! @brief Sum of the readings of the open bucket
+        uint32_t open_sum_ppm;
+
+        //! @brief Amount of readings of the open bucket
+        uint32_t open_count;
+} tier_t;
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+//! @brief Bucket length of each tier (in seconds)
+static uint32_t const m_tier_periods_s[HISTORY_TIER_COUNT] = {60, 600, 3600};
+
+//! @brief Bucket without readings
+static bucket_t const m_empty_bucket = {
+                .min_ppm = UINT16_MAX,
+                .mean_ppm = 0,
+                .max_ppm = 0,
+};
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Store the samples published in the sample bus
+static void on_sample(void * const p_context);
+
+//! @brief Open the readings log in flash
+static bool log_init(void);
+
+//! @brief Hand a reading to the readings log task
+static void log_append(history_record_t const * const p_record);
+
+//! @brief Readings log task
+_Noreturn static void log_task(void * pvParameter);
+
+//! @brief Flash read function backed by a partition
+static bool partition_read(void * const p_context,
+                           uint32_t const offset,
+                           void * const p_buffer,
+                           size_t const size);
+
+//! @brief Flash write function backed by a partition
+static bool partition_write(void * const p_context,
+                            uint32_t const offset,
+                            void const * const p_buffer,
+                            size_t const size);
+
+//! @brief Flash erase function backed by a partition
+static bool partition_erase(void * const p_context,
+                            uint32_t const offset,
+                            size_t const size);
+
+//! @brief Append a raw reading to the newest block
+static void raw_add(history_record_t const * const p_record);
+
+//! @brief Start a new block, dropping the oldest one if the ring is full
+static void start_block(void);
+
+//! @brief Encode a reading into the newest block
+static bool encode_reading(history_record_t const * const p_record);
+
+//! @brief Feed a reading to a downsampling tier
+static void tier_add(tier_t * const p_tier,
+                     uint32_t const period_s,
+                     history_record_t const * const p_record);
+
+//! @brief Close the open bucket of a tier
+static void tier_close(tier_t * const p_tier, uint32_t const next_number);
+
+//! @brief Append a closed bucket to a tier
+static void tier_push(tier_t * const p_tier,
+                      uint32_t const number,
+                      bucket_t const * const p_bucket);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Ring of blocks of raw readings
+static block_t m_blocks[BLOCK_COUNT];
+
+//! @brief Position of the oldest block
+static size_t m_oldest_block = 0;
+
+//! @brief Amount of blocks in use
+static size_t m_block_count = 0;
+
+//! @brief Encoder of the newest block
+static co2_codec_t m_encoder;
+
+//! @brief Decoder of the last `history_read_next` call
+static reader_t m_reader;
+
+//! @brief Sequence number of the next reading to be stored
+static uint32_t m_head = 0;
+
+//! @brief One minute buckets of each sensor
+static bucket_t m_buckets_1_min[SENSOR_COUNT][TIER_1_MIN_BUCKETS];
+
+//! @brief Ten minutes buckets of each sensor
+static bucket_t m_buckets_10_min[SENSOR_COUNT][TIER_10_MIN_BUCKETS];
+
+//! @brief One hour buckets of each sensor
+static bucket_t m_buckets_1_hour[SENSOR_COUNT][TIER_1_HOUR_BUCKETS];
+
+//! @brief Downsampling tiers of each sensor
+static tier_t m_tiers[SENSOR_COUNT][HISTORY_TIER_COUNT];
+
+//! @brief Protects the members shared between producer and consumers
+static portMUX_TYPE m_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//! @brief Subscription to the sample bus
+static sample_bus_subscriber_t m_subscriber;
+
+//! @brief Whether `m_subscriber` is subscribed already
+static bool m_is_subscribed = false;
+
+//! @brief Readings log in flash
+static sample_log_t m_log;
+
+//! @brief Serializes the accesses to `m_log`
+static SemaphoreHandle_t m_log_mutex = NULL;
+
+//! @brief Whether `m_log` could be opened
+static bool m_is_log_available = false;
+
+//! @brief Readings waiting to be appended to `m_log`
+static QueueHandle_t m_log_q = NULL;
+
+//! @brief Handle of the readings log task
+static TaskHandle_t m_log_task_h = NULL;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize the history module
+ *
+ * Discards any reading stored in RAM, opens the readings log in flash and
+ * subscribes to the sample bus, which has to be initialized already. Without
+ * the flash partition, readings are only kept in RAM.
+ *
+ * @return              bool                Operation result
+ */
+bool history_init(void)
+{
+        bool success = true;
+        tier_t * p_tiers;
+        size_t i;
+
+        portENTER_CRITICAL(&m_lock);
+
+        m_head = 0;
+        m_reader.is_valid = false;
+        m_oldest_block = 0;
+        m_block_count = 0;
+
+        memset(m_tiers, 0, sizeof(m_tiers));
+
+        for (i = 0; SENSOR_COUNT > i; ++i) {
+                p_tiers = m_tiers[i];
+
+                p_tiers[HISTORY_TIER_1_MIN].p_buckets = m_buckets_1_min[i];
+                p_tiers[HISTORY_TIER_1_MIN].capacity = TIER_1_MIN_BUCKETS;
+                p_tiers[HISTORY_TIER_10_MIN].p_buckets = m_buckets_10_min[i];
+                p_tiers[HISTORY_TIER_10_MIN].capacity = TIER_10_MIN_BUCKETS;
+                p_tiers[HISTORY_TIER_1_HOUR].p_buckets = m_buckets_1_hour[i];
+                p_tiers[HISTORY_TIER_1_HOUR].capacity = TIER_1_HOUR_BUCKETS;
+        }
+
+        portEXIT_CRITICAL(&m_lock);
+
+        if (!m_is_log_available) {
+                m_is_log_available = log_init();
+        }
+
+        if (!m_is_subscribed) {
+                success = sample_bus_subscribe(&m_subscriber, on_sample, NULL);
+                m_is_subscribed = success;
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Store a reading
+ *
+ * @param[in]           p_record            Pointer to the reading
+ *
+ * @return              -                   -
+ */
+void history_add(history_record_t const * const p_record)
+{
+        size_t tier;
+
+        if ((NULL == p_record) || (SENSOR_COUNT <= p_record->sensor)) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        portENTER_CRITICAL(&m_lock);
+
+        raw_add(p_record);
+
+        for (tier = 0; HISTORY_TIER_COUNT > tier; ++tier) {
+                tier_add(&m_tiers[p_record->sensor][tier],
+                         m_tier_periods_s[tier],
+                         p_record);
+        }
+
+        portEXIT_CRITICAL(&m_lock);
+
+        log_append(p_record);
+}
+
+/*!
+ * @brief Get the next reading after a cursor
+ *
+ * A cursor pointing to readings that have already been dropped is moved to the
+ * oldest stored one. Start with 0 to get every stored reading, or with
+ * `history_get_head` to get only the ones stored from now on.
+ *
+ * The block holding the reading is decoded from its start, unless the
+ * previous call left off before the reading in the same block. Reading the
+ * history in order costs a single decode per reading.
+ *
+ * @param[in,out]       p_cursor            Pointer to the consumer cursor,
+ *                                          advanced past the returned reading
+ * @param[out]          p_record            Pointer where to copy the reading
+ *
+ * @return              bool                Whether there was a reading
+ */
+bool history_read_next(uint32_t * const p_cursor,
+                       history_record_t * const p_record)
+{
+        bool is_available = false;
+        block_t const * p_block = NULL;
+        uint32_t oldest;
+        uint32_t next_first;
+        uint8_t sensor;
+        size_t i;
+
+        if ((NULL == p_cursor) || (NULL == p_record)) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        portENTER_CRITICAL(&m_lock);
+
+        if (0 != m_block_count) {
+                oldest = m_blocks[m_oldest_block].first_sequence;
+
+                // Overflow is meant to happen
+                if ((*p_cursor - oldest) > (m_head - oldest)) {
+                        *p_cursor = oldest;
+                }
+
+                // Find the block holding the reading, newest readings first
+                for (i = m_block_count; (*p_cursor != m_head) && (0 < i); --i) {
+                        p_block = &m_blocks[(m_oldest_block + i - 1) %
+                                            BLOCK_COUNT];
+
+                        if (m_block_count > i) {
+                                next_first = m_blocks[(m_oldest_block + i) %
+                                                      BLOCK_COUNT].first_sequence;
+                        } else {
+                                next_first = m_head;
+                        }
+
+                        if ((*p_cursor - p_block->first_sequence) <
+                            (next_first - p_block->first_sequence)) {
+                                break;
+                        }
+                }
+        }
+
+        if ((NULL != p_block) && (*p_cursor != m_head)) {
+                // Overflow is meant to happen
+                is_available = (m_reader.is_valid) &&
+                               (m_reader.codec.p_buffer == p_block->data) &&
+                               (m_reader.first_sequence ==
+                                p_block->first_sequence) &&
+                               ((*p_cursor - p_block->first_sequence) >=
+                                (m_reader.next_sequence -
+                                 p_block->first_sequence));
+
+                if (!is_available) {
+                        m_reader.first_sequence = p_block->first_sequence;
+                        m_reader.next_sequence = p_block->first_sequence;
+                        is_available = co2_codec_decoder_init(
+                                        &m_reader.codec,
+                                        p_block->data,
+                                        sizeof(p_block->data),
+                                        SENSOR_COUNT);
+                }
+
+                // The cursor is within the block, so it ends before the data
+                do {
+                        is_available = (is_available) &&
+                                       (co2_codec_decode(&m_reader.codec,
+                                                         &p_record->time_s,
+                                                         &sensor,
+                                                         &p_record->co2_ppm));
+                } while ((is_available) &&
+                         (*p_cursor != m_reader.next_sequence++));
+
+                m_reader.is_valid = is_available;
+
+                if (is_available) {
+                        p_record->sensor = sensor;
+                        ++(*p_cursor);
+                }
+        }
+
+        portEXIT_CRITICAL(&m_lock);
+
+        return is_available;
+}
+
+/*!
+ * @brief Get the cursor of the next reading to be stored
+ *
+ * @return              uint32_t            Cursor value
+ */
+uint32_t history_get_head(void)
+{
+        uint32_t head;
+
+        portENTER_CRITICAL(&m_lock);
+        head = m_head;
+        portEXIT_CRITICAL(&m_lock);
+
+        return head;
+}
+
+/*!
+ * @brief Get the next reading after a cursor, from the readings log in flash
+ *
+ * Unlike `history_read_next`, it also returns readings from previous boots,
+ * but not the ones still waiting for their batch to be written. Start with a
+ * zeroed cursor to get every logged reading.
+ *
+ * @param[in,out]       p_cursor            Pointer to the reader cursor,
+ *                                          advanced past the returned reading
+ * @param[out]          p_record            Pointer where to copy the reading
+ *
+ * @return              bool                Whether there was a reading
+ */
+bool history_read_logged(sample_log_cursor_t * const p_cursor,
+                         sample_log_record_t * const p_record)
+{
+        sample_log_error_t result;
+
+        if (!m_is_log_available) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        (void)xSemaphoreTake(m_log_mutex, portMAX_DELAY);
+        result = sample_log_read_next(&m_log, p_cursor, p_record);
+        (void)xSemaphoreGive(m_log_mutex);
+
+        return (SAMPLE_LOG_ERROR_SUCCESS == result);
+}
+
+/*!
+ * @brief Get the boot counter the readings of this boot are logged with
+ *
+ * Tells the readings of this boot apart from the older ones returned by
+ * `history_read_logged`, as their times since boot can't be compared.
+ *
+ * @param[out]          p_boot              Pointer where to copy the counter
+ *
+ * @return              bool                False if the log isn't available
+ */
+bool history_get_logged_boot(uint8_t * const p_boot)
+{
+        sample_log_error_t result;
+
+        if (!m_is_log_available) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        (void)xSemaphoreTake(m_log_mutex, portMAX_DELAY);
+        result = sample_log_get_boot(&m_log, p_boot);
+        (void)xSemaphoreGive(m_log_mutex);
+
+        return (SAMPLE_LOG_ERROR_SUCCESS == result);
+}
+
+/*!
+ * @brief Get the latest downsampled readings of a sensor
+ *
+ * Only closed buckets are returned, and buckets without readings are skipped.
+ *
+ * @param[in]           tier                Resolution
+ * @param[in]           sensor              Index of the sensor
+ * @param[out]          p_aggregates        Array where to copy the buckets,
+ *                                          oldest first
+ * @param[in]           max_count           Size of `p_aggregates`
+ *
+ * @return              size_t              Amount of buckets copied
+ */
+size_t history_get_aggregates(history_tier_t const tier,
+                              uint8_t const sensor,
+                              history_aggregate_t * const p_aggregates,
+                              size_t const max_count)
+{
+        tier_t const * p_tier;
+        bucket_t const * p_bucket;
+        history_aggregate_t swap;
+        size_t found = 0;
+        size_t position;
+        size_t i;
+
+        if ((HISTORY_TIER_COUNT <= tier) ||
+            (SENSOR_COUNT <= sensor) ||
+            (NULL == p_aggregates)) {
+                // Code style exception for the shake of readability
+                return 0;
+        }
+
+        p_tier = &m_tiers[sensor][tier];
+
+        portENTER_CRITICAL(&m_lock);
+
+        // Walk from the newest bucket backwards
+        for (i = 0; (p_tier->count > i) && (max_count > found); ++i) {
+                position = (p_tier->newest + p_tier->capacity - i) %
+                           p_tier->capacity;
+                p_bucket = &p_tier->p_buckets[position];
+
+                if (p_bucket->min_ppm <= p_bucket->max_ppm) {
+                        p_aggregates[found].time_s = (p_tier->newest_number -
+                                                      (uint32_t)i) *
+                                                     m_tier_periods_s[tier];
+                        p_aggregates[found].min_ppm = p_bucket->min_ppm;
+                        p_aggregates[found].mean_ppm = p_bucket->mean_ppm;
+                        p_aggregates[found].max_ppm = p_bucket->max_ppm;
+                        ++found;
+                }
+        }
+
+        portEXIT_CRITICAL(&m_lock);
+
+        // Oldest first
+        for (i = 0; (found / 2) > i; ++i) {
+                swap = p_aggregates[i];
+                p_aggregates[i] = p_aggregates[found - 1 - i];
+                p_aggregates[found - 1 - i] = swap;
+        }
+
+        return found;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Store the samples published in the sample bus
+ *
+ * Runs in the publisher context, so samples can't be overwritten meanwhile
+ *
+ * @param[in]           p_context           Not used
+ *
+ * @return              -                   -
+ */
+static void on_sample(void * const p_context)
+{
+        sample_bus_sample_t const * p_sample;
+        history_record_t record;
+        uint32_t co2_ppm;
+
+        (void)p_context;
+
+        p_sample = sample_bus_peek(&m_subscriber);
+
+        while (NULL != p_sample) {
+                co2_ppm = p_sample->reading.co2_ppm[SENSOR_STREAM_RAW];
+
+                record.time_s = p_sample->time_s;
+                record.co2_ppm = (UINT16_MAX < co2_ppm) ?
+                                 UINT16_MAX : (uint16_t)co2_ppm;
+                record.sensor = p_sample->reading.sensor;
+
+                if (sample_bus_release(&m_subscriber)) {
+                        history_add(&record);
+                }
+
+                p_sample = sample_bus_peek(&m_subscriber);
+        }
+}
+
+/*!
+ * @brief Open the readings log in flash
+ *
+ * Also starts the task appending the readings to it.
+ *
+ * @return              bool                Operation result
+ */
+static bool log_init(void)
+{
+        esp_partition_t const * p_partition;
+        sample_log_flash_t flash;
+        sample_log_error_t result = SAMPLE_LOG_ERROR_IO_ERROR;
+        BaseType_t task_result;
+        bool success;
+
+        p_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                               PARTITION_SUBTYPE,
+                                               PARTITION_LABEL);
+
+        if (NULL == m_log_mutex) {
+                m_log_mutex = xSemaphoreCreateMutex();
+        }
+
+        if ((NULL != p_partition) && (NULL != m_log_mutex)) {
+                flash.read_func = partition_read;
+                flash.write_func = partition_write;
+                flash.erase_func = partition_erase;
+                flash.p_context = (void *)p_partition;
+                flash.size = p_partition->size;
+                flash.sector_size = SPI_FLASH_SEC_SIZE;
+
+                result = sample_log_init(&m_log,
+                                         &flash,
+                                         HISTORY_FLASH_BATCH_SIZE);
+        }
+
+        if (SAMPLE_LOG_ERROR_SUCCESS != result) {
+                ESP_LOGW(TAG, "Readings log not available: %d", result);
+        }
+
+        success = (SAMPLE_LOG_ERROR_SUCCESS == result);
+
+        if ((success) && (NULL == m_log_q)) {
+                m_log_q = xQueueCreate(LOG_QUEUE_LENGTH,
+                                       sizeof(sample_log_record_t));
+
+                success = (NULL != m_log_q);
+        }
+
+        if ((success) && (NULL == m_log_task_h)) {
+                task_result = xTaskCreate((TaskFunction_t)log_task,
+                                          "history_log_task",
+                                          LOG_TASK_STACK_DEPTH,
+                                          NULL,
+                                          LOG_TASK_PRIORITY,
+                                          &m_log_task_h);
+
+                success = (pdPASS == task_result);
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Hand a reading to the readings log task
+ *
+ * Never blocks: if the task is behind and its queue is full, the reading is
+ * only kept in RAM.
+ *
+ * @param[in]           p_record            Pointer to the reading
+ *
+ * @return              -                   -
+ */
+static void log_append(history_record_t const * const p_record)
+{
+        sample_log_record_t record;
+        BaseType_t queue_result;
+
+        if (!m_is_log_available) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        record.time_s = p_record->time_s;
+        record.co2_ppm = p_record->co2_ppm;
+        record.sensor = p_record->sensor;
+        record.boot = 0;
+
+        queue_result = xQueueSend(m_log_q, &record, 0);
+
+        if (pdTRUE != queue_result) {
+                ESP_LOGW(TAG, "Readings log behind, reading not logged");
+        }
+}
+
+/*!
+ * @brief Flash read function backed by a partition
+ *
+ * Follows the `sample_log_read_func` prototype
+ *
+ * @param[in]           p_context           Pointer to the partition
+ * @param[in]           offset              Offset within the partition
+ * @param[out]          p_buffer            Pointer where to read the data to
+ * @param[in]           size                Amount of bytes to read
+ *
+ * @return              bool                Operation result
+ */
+static bool partition_read(void * const p_context,
+                           uint32_t const offset,
+                           void * const p_buffer,
+                           size_t const size)
+{
+        return (ESP_OK == esp_partition_read((esp_partition_t const *)p_context,
+                                             offset,
+                                             p_buffer,
+                                             size));
+}
+
+/*!
+ * @brief Flash write function backed by a partition
+ *
+ * Follows the `sample_log_write_func` prototype
+ *
+ * @param[in]           p_context           Pointer to the partition
+ * @param[in]           offset              Offset within the partition
+ * @param[in]           p_buffer            Pointer to the data to write
+ * @param[in]           size                Amount of bytes to write
+ *
+ * @return              bool                Operation result
+ */
+static bool partition_write(void * const p_context,
+                            uint32_t const offset,
+                            void const * const p_buffer,
+                            size_t const size)
+{
+        return (ESP_OK == esp_partition_write((esp_partition_t const *)p_context,
+                                              offset,
+                                              p_buffer,
+                                              size));
+}
+
+/*!
+ * @brief Flash erase function backed by a partition
+ *
+ * Follows the `sample_log_erase_func` prototype
+ *
+ * @param[in]           p_context           Pointer to the partition
+ * @param[in]           offset              Offset within the partition
+ * @param[in]           size                Amount of bytes to erase
+ *
+ * @return              bool                Operation result
+ */
+static bool partition_erase(void * const p_context,
+                            uint32_t const offset,
+                            size_t const size)
+{
+        return (ESP_OK == esp_partition_erase_range(
+                        (esp_partition_t const *)p_context,
+                        offset,
+                        size));
+}
+
+/*!
+ * @brief Append a raw reading to the newest block
+ *
+ * A new block is started if there are none yet, or if the reading doesn't fit
+ * in the newest one.
+ *
+ * @param[in]           p_record            Pointer to the reading
+ *
+ * @return              -                   -
+ */
+static void raw_add(history_record_t const * const p_record)
+{
+        bool success = (0 != m_block_count) && (encode_reading(p_record));
+
+        if (!success) {
+                start_block();
+
+                // An empty block always has room for a reading
+                (void)encode_reading(p_record);
+        }
+
+        ++m_head;
+}
+
+/*!
+ * @brief Start a new block, dropping the oldest one if the ring is full
+ *
+ * @return              -                   -
+ */
+static void start_block(void)
+{
+        block_t * p_block;
+
+        if (BLOCK_COUNT == m_block_count) {
+                m_oldest_block = (m_oldest_block + 1) % BLOCK_COUNT;
+                --m_block_count;
+        }
+
+        p_block = &m_blocks[(m_oldest_block + m_block_count) % BLOCK_COUNT];
+        ++m_block_count;
+
+        p_block->first_sequence = m_head;
+
+        (void)co2_codec_encoder_init(&m_encoder,
+                                     p_block->data,
+                                     sizeof(p_block->data),
+                                     SENSOR_COUNT);
+}
+
+/*!
+ * @brief Encode a reading into the newest block
+ *
+ * @param[in]           p_record            Pointer to the reading
+ *
+ * @return              bool                False if the reading doesn't fit
+ *                                          in the block
+ */
+static bool encode_reading(history_record_t const * const p_record)
+{
+        return co2_codec_encode(&m_encoder,
+                                p_record->time_s,
+                                p_record->sensor,
+                                p_record->co2_ppm);
+}
+
+/*!
+ * @brief Feed a reading to a downsampling tier
+ *
+ * A reading falling in a later bucket than the open one closes it first.
+ *
+ * @param[in,out]       p_tier              Pointer to the tier
+ * @param[in]           period_s            Bucket length of the tier
+ * @param[in]           p_record            Pointer to the reading
+ *
+ * @return              -                   -
+ */
+static void tier_add(tier_t * const p_tier,
+                     uint32_t const period_s,
+                     history_record_t const * const p_record)
+{
+        uint32_t const number = p_record->time_s / period_s;
+        uint16_t const ppm = p_record->co2_ppm;
+
+        if ((p_tier->is_open) && (number > p_tier->open_number)) {
+                tier_close(p_tier, number);
+        }
+
+        if (!p_tier->is_open) {
+                p_tier->is_open = true;
+                p_tier->open_number = number;
+                p_tier->open_min_ppm = ppm;
+                p_tier->open_max_ppm = ppm;
+                p_tier->open_sum_ppm = 0;
+                p_tier->open_count = 0;
+        }
+
+        if (ppm < p_tier->open_min_ppm) {
+                p_tier->open_min_ppm = ppm;
+        }
+
+        if (ppm > p_tier->open_max_ppm) {
+                p_tier->open_max_ppm = ppm;
+        }
+
+        p_tier->open_sum_ppm += ppm;
+        ++p_tier->open_count;
+}
+
+/*!
+ * @brief Close the open bucket of a tier
+ *
+ * Buckets between the closed one and the next one are stored as empty, so
+ * buckets stay evenly spaced in time.
+ *
+ * @param[in,out]       p_tier              Pointer to the tier
+ * @param[in]           next_number         Number of the next bucket to open
+ *
+ * @return              -                   -
+ */
+static void tier_close(tier_t * const p_tier, uint32_t const next_number)
+{
+        bucket_t bucket;
+        uint32_t number;
+
+        bucket.min_ppm = p_tier->open_min_ppm;
+        bucket.max_ppm = p_tier->open_max_ppm;
+        bucket.mean_ppm = (uint16_t)((p_tier->open_sum_ppm +
+                                      (p_tier->open_count / 2)) /
+                                     p_tier->open_count);
+
+        tier_push(p_tier, p_tier->open_number, &bucket);
+
+        number = p_tier->open_number + 1;
+
+        // No point on storing more empty buckets than the tier holds
+        if ((next_number - number) > p_tier->capacity) {
+                number = next_number - (uint32_t)p_tier->capacity;
+        }
+
+        for (; next_number != number; ++number) {
+                tier_push(p_tier, number, &m_empty_bucket);
+        }
+
+        p_tier->is_open = false;
+}
+
+/*!
+ * @brief Append a closed bucket to a tier
+ *
+ * @param[in,out]       p_tier              Pointer to the tier
+ * @param[in]           number              Number of the bucket
+ * @param[in]           p_bucket            Pointer to the bucket
+ *
+ * @return              -                   -
+ */
+static void tier_push(tier_t * const p_tier,
+                      uint32_t const number,
+                      bucket_t const * const p_bucket)
+{
+        p_tier->newest = (p_tier->newest + 1) % p_tier->capacity;
+        p_tier->p_buckets[p_tier->newest] = *p_bucket;
+        p_tier->newest_number = number;
+
+        if (p_tier->capacity > p_tier->count) {
+                ++p_tier->count;
+        }
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Readings log task
+ *
+ * Appends the readings handed by `log_append` to the log. Flash is only
+ * written once per batch, which blocks for a few milliseconds, plus an erase
+ * once per sector.
+ *
+ * @param               pvParameter         Not used
+ *
+ * @return              -                   -
+ */
+_Noreturn static void log_task(void * pvParameter)
+{
+        sample_log_record_t record;
+        sample_log_error_t result;
+        BaseType_t queue_result;
+
+        (void)pvParameter;
+
+        while (1) {
+                queue_result = xQueueReceive(m_log_q, &record, portMAX_DELAY);
+
+                if (pdTRUE != queue_result) {
+                        // Code style exception for the shake of readability
+                        continue;
+                }
+
+                (void)xSemaphoreTake(m_log_mutex, portMAX_DELAY);
+                result = sample_log_append(&m_log, &record);
+                (void)xSemaphoreGive(m_log_mutex);
+
+                if (SAMPLE_LOG_ERROR_SUCCESS != result) {
+                        ESP_LOGW(TAG, "Readings log write failed: %d", result);
+                }
+        }
+}
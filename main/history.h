@@ -0,0 +1,119 @@
+/*!
+ *******************************************************************************
+ * @file history.h
+ *
+ * @brief On-device store of the sensor readings
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sample_log.h"
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Stored reading
+typedef struct {
+        //! @brief Time of the reading (in seconds since boot)
+        uint32_t time_s;
+
+        //! @brief CO2 concentration (in ppm)
+        uint16_t co2_ppm;
+
+        //! @brief Index of the sensor the reading comes from
+        uint8_t sensor;
+} history_record_t;
+
+//! @brief Resolutions the readings are downsampled to
+typedef enum {
+        //! @brief One minute buckets
+        HISTORY_TIER_1_MIN = 0,
+
+        //! @brief Ten minutes buckets
+        HISTORY_TIER_10_MIN,
+
+        //! @brief One hour buckets
+        HISTORY_TIER_1_HOUR,
+
+        //! @brief Fence member
+        HISTORY_TIER_COUNT
+} history_tier_t;
+
+//! @brief Readings of a sensor within a time bucket
+typedef struct {
+        //! @brief Start time of the bucket (in seconds since boot)
+        uint32_t time_s;
+
+        //! @brief Lowest CO2 concentration (in ppm)
+        uint16_t min_ppm;
+
+        //! @brief Mean CO2 concentration (in ppm)
+        uint16_t mean_ppm;
+
+        //! @brief Highest CO2 concentration (in ppm)
+        uint16_t max_ppm;
+} history_aggregate_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize the history module
+bool history_init(void);
+
+//! @brief Store a reading
+void history_add(history_record_t const * const p_record);
+
+//! @brief Get the next reading after a cursor
+bool history_read_next(uint32_t * const p_cursor,
+                       history_record_t * const p_record);
+
+//! @brief Get the cursor of the next reading to be stored
+uint32_t history_get_head(void);
+
+//! @brief Get the next reading after a cursor, from the readings log in flash
+bool history_read_logged(sample_log_cursor_t * const p_cursor,
+                         sample_log_record_t * const p_record);
+
+//! @brief Get the boot counter the readings of this boot are logged with
+bool history_get_logged_boot(uint8_t * const p_boot);
+
+//! @brief Get the latest downsampled readings of a sensor
+size_t history_get_aggregates(history_tier_t const tier,
+                              uint8_t const sensor,
+                              history_aggregate_t * const p_aggregates,
+                              size_t const max_count);
+
+#endif //HISTORY_H
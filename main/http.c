@@ -2,7 +2,10 @@
  *******************************************************************************
  * @file http.c
  *
- * @brief 
+ * @brief Telemetry transport over HTTP POST
+ *
+ * Posts to the Thingsboard HTTP device API, keeping the connection open
+ * across posts.
  *
  * @author Raúl Gotor (raulgotor@gmail.com)
  * @date 10.04.22
@@ -21,17 +24,16 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "freertos/queue.h"
-#include "tasks_config.h"
 
 #include "esp_http_client.h"
-#include "wifi.h"
 
 #include "esp_log.h"
 #include "display.h"
+#include "device_state.h"
+#include "http.h"
 
 /*
  *******************************************************************************
@@ -41,11 +43,6 @@
 
 #define TAG                                 "http"
 
-#define TASK_REFRESH_RATE_TICKS             (pdMS_TO_TICKS(TASKS_CONFIG_HTTP_REFRESH_RATE_MS))
-#define TASK_STACK_DEPTH                    TASKS_CONFIG_HTTP_STACK_DEPTH
-#define TASK_PRIORITY                       TASKS_CONFIG_HTTP_PRIORITY
-
-
 #define MAX_HTTP_OUTPUT_BUFFER              (100)
 
 #define SERVER_URL                          CONFIG_CO2_MONITOR_DEVICE_URL
@@ -74,19 +71,18 @@
  *******************************************************************************
  */
 
-_Noreturn static void http_task(void *pvParameter);
-
 static esp_err_t http_event_handler(esp_http_client_event_t *evt);
 
+//! @brief Post telemetry over the open connection, or a new one
+static esp_err_t http_perform(char const * const p_post_data,
+                              int * const p_code);
+
 /*
  *******************************************************************************
  * Public Data Declarations                                                    *
  *******************************************************************************
  */
 
-QueueHandle_t http_q = NULL;
-
-extern TaskHandle_t sensor_task_h;
 
 /*
  *******************************************************************************
@@ -96,18 +92,24 @@ extern TaskHandle_t sensor_task_h;
 
 char local_response_buffer[MAX_HTTP_OUTPUT_BUFFER] = {0};
 
+//! @brief Telemetry client, the connection is kept open across posts
 static esp_http_client_config_t config = {
-                .host = "httpbin.org",
-                .path = "/get",
-                .query = "esp",
+                .url = URL,
+                .method = HTTP_METHOD_POST,
                 .event_handler = http_event_handler,
                 .user_data = local_response_buffer,
                 .disable_auto_redirect = true,
+                // Probes the idle connection, so a dead one is noticed
+                .keep_alive_enable = true,
 };
 
 static esp_http_client_handle_t m_client;
 
-static const char * m_post_data_template = "{\"co2_concentration\": %d}";
+//! @brief Connection counters
+static http_stats_t m_stats;
+
+//! @brief Protects `m_stats`, taken only for a single update or query
+static portMUX_TYPE m_stats_lock = portMUX_INITIALIZER_UNLOCKED;
 
 /*
  *******************************************************************************
@@ -115,147 +117,180 @@ static const char * m_post_data_template = "{\"co2_concentration\": %d}";
  *******************************************************************************
  */
 
-bool http_init(void) {
-
+/*!
+ * @brief Initialize the HTTP client
+ *
+ * The connection is only opened with the first post.
+ *
+ * @return              bool                Operation result
+ */
+bool http_init(void)
+{
         bool success;
 
-        BaseType_t task_result;
-        TaskHandle_t http_task_h = NULL;
-
-        http_q = xQueueCreate(3, sizeof(uint32_t *));
-
-        success = (NULL != http_q);
-
-        if (success) {
-                // Tell `sensor_task_h` that our queue is ready to be used
-                (void)xTaskNotifyIndexed(sensor_task_h, 1, 0, eNoAction);
-
-                task_result = xTaskCreate((TaskFunction_t)http_task,
-                                          "http_task",
-                                          TASK_STACK_DEPTH,
-                                          NULL,
-                                          TASK_PRIORITY,
-                                          &http_task_h);
+        m_client = esp_http_client_init(&config);
 
-                success = (pdPASS == task_result);
-        }
+        success = (NULL != m_client);
 
+        // Headers are kept across requests, they are only set once
         if (success) {
-                m_client = esp_http_client_init(&config);
-
-                success = (NULL != m_client);
+                success = (ESP_OK == esp_http_client_set_header(m_client,
+                                                                HEADER_KEY,
+                                                                HEADER_VALUE));
         }
 
         return success;
 }
 
-/*
- *******************************************************************************
- * Private Function Bodies                                                     *
- *******************************************************************************
+/*!
+ * @brief Post telemetry to the server
+ *
+ * The connection is kept open across posts. If the post can't be sent over
+ * it, the server may have closed it meanwhile, so it is retried once over a
+ * new one. Updates the link status with the result.
+ *
+ * @param[in]           p_post_data         JSON telemetry, null terminated
+ *
+ * @return              bool                Whether the server accepted it
  */
-
-void http_send_data(uint32_t const data)
+bool http_post(char const * const p_post_data)
 {
-
-        ESP_LOGI(TAG,"Sending data to %s", URL);
-        bool linked = false;
+        uint32_t connections;
         esp_err_t esp_result;
+        bool is_reused;
         bool success;
-        int code;
-        char post_data[30];
+        int code = 0;
 
-        esp_result = esp_http_client_set_url(
-                        m_client,
-                        URL);
+        portENTER_CRITICAL(&m_stats_lock);
+        connections = m_stats.connections;
+        ++m_stats.posts;
+        portEXIT_CRITICAL(&m_stats_lock);
 
-        success = (ESP_OK == esp_result);
+        esp_result = http_perform(p_post_data, &code);
 
-        if (success) {
-                esp_result = esp_http_client_set_method(
-                                m_client,
-                                HTTP_METHOD_POST);
+        portENTER_CRITICAL(&m_stats_lock);
+        is_reused = (connections == m_stats.connections);
+        portEXIT_CRITICAL(&m_stats_lock);
 
-                success = (ESP_OK == esp_result);
-        }
+        if ((ESP_OK != esp_result) && (is_reused)) {
+                ESP_LOGD(TAG, "Open connection failed, reconnecting");
 
-        if (success) {
-                esp_result = esp_http_client_set_header(
-                                m_client,
-                                HEADER_KEY,
-                                HEADER_VALUE);
+                (void)esp_http_client_close(m_client);
 
-                success = (ESP_OK == esp_result);
+                esp_result = http_perform(p_post_data, &code);
+                is_reused = false;
         }
 
-        if (success) {
-                sprintf(post_data, m_post_data_template, data);
-                esp_result = esp_http_client_set_post_field(
-                                m_client,
-                                post_data,
-                                (int)strlen(post_data));
+        success = ((ESP_OK == esp_result) && (200 == code));
 
-                success = (ESP_OK == esp_result);
+        if (ESP_OK != esp_result) {
+                ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(esp_result));
+        } else if (!success) {
+                ESP_LOGE(TAG, "HTTP POST rejected: %d", code);
         }
 
-        if (success) {
-                esp_result = esp_http_client_perform(m_client);
+        portENTER_CRITICAL(&m_stats_lock);
 
-                success = (ESP_OK == esp_result);
+        if (!success) {
+                ++m_stats.failures;
         }
 
-        if (success) {
-                code = esp_http_client_get_status_code(m_client);
-                ESP_LOGI(TAG, "HTTP POST Status = %d, content_length = %i",
-                         code,
-                         esp_http_client_get_content_length(m_client));
+        if ((ESP_OK == esp_result) && (is_reused)) {
+                ++m_stats.reused;
+        }
 
-                if (200 == code) {
-                        linked = true;
-                }
-        } else {
-                ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(esp_result));
+        portEXIT_CRITICAL(&m_stats_lock);
+
+        device_state_set_link(success);
+        display_set_link_status(success);
+
+        return success;
+}
+
+/*!
+ * @brief Get the connection counters
+ *
+ * @param[out]          p_stats             Pointer where to copy the counters
+ *
+ * @return              bool                Operation result
+ */
+bool http_get_stats(http_stats_t * const p_stats)
+{
+        bool const success = (NULL != p_stats);
+
+        if (success) {
+                portENTER_CRITICAL(&m_stats_lock);
+                *p_stats = m_stats;
+                portEXIT_CRITICAL(&m_stats_lock);
         }
 
-        display_set_link_status(linked);
+        return success;
 }
 
 /*
  *******************************************************************************
- * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ * Private Function Bodies                                                     *
  *******************************************************************************
  */
 
-_Noreturn static void http_task(void *pvParameter)
+/*!
+ * @brief Post telemetry over the open connection, or a new one
+ *
+ * @param[in]           p_post_data         JSON telemetry, null terminated
+ * @param[out]          p_code              Pointer where to copy the HTTP
+ *                                          status code
+ *
+ * @return              esp_err_t           ESP_OK if the post was sent and
+ *                                          answered, whatever the status code
+ */
+static esp_err_t http_perform(char const * const p_post_data,
+                              int * const p_code)
 {
-        (void)pvParameter;
-        uint32_t co2_ppm;
-        BaseType_t queue_result;
-        wifi_status_t wifi_status;
+        esp_err_t esp_result;
 
-        for (;;) {
-                queue_result = xQueueReceive(http_q, &co2_ppm, TASK_REFRESH_RATE_TICKS);
+        ESP_LOGD(TAG, "Sending data to %s", URL);
 
-                wifi_status = wifi_get_status();
+        esp_result = esp_http_client_set_post_field(
+                        m_client,
+                        p_post_data,
+                        (int)strlen(p_post_data));
 
-                if (pdTRUE == queue_result && (WIFI_STATUS_CONNECTED == wifi_status)) {
-                        (void)http_send_data(co2_ppm);
-                }
+        if (ESP_OK == esp_result) {
+                esp_result = esp_http_client_perform(m_client);
+        }
+
+        if (ESP_OK == esp_result) {
+                *p_code = esp_http_client_get_status_code(m_client);
 
-                ESP_LOGI(TAG,"Max stack usage: %d of %d bytes", TASK_STACK_DEPTH - uxTaskGetStackHighWaterMark(NULL), TASK_STACK_DEPTH);
+                ESP_LOGD(TAG, "HTTP POST Status = %d, content_length = %i",
+                         *p_code,
+                         esp_http_client_get_content_length(m_client));
         }
+
+        return esp_result;
 }
 
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
+
 static esp_err_t http_event_handler(esp_http_client_event_t *evt)
 {
         static char *output_buffer;  // Buffer to store response of http request from event handler
         static int output_len;       // Stores number of bytes read
+        int copy_len;
         switch(evt->event_id) {
         case HTTP_EVENT_ERROR:
                 ESP_LOGD(TAG, "HTTP_EVENT_ERROR");
                 break;
         case HTTP_EVENT_ON_CONNECTED:
                 ESP_LOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
+
+                portENTER_CRITICAL(&m_stats_lock);
+                ++m_stats.connections;
+                portEXIT_CRITICAL(&m_stats_lock);
                 break;
         case HTTP_EVENT_HEADER_SENT:
                 ESP_LOGD(TAG, "HTTP_EVENT_HEADER_SENT");
@@ -272,7 +307,16 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
                 if (!esp_http_client_is_chunked_response(evt->client)) {
                         // If user_data buffer is configured, copy the response into the buffer
                         if (evt->user_data) {
-                                memcpy(evt->user_data + output_len, evt->data, evt->data_len);
+                                // The response isn't used, the rest is dropped
+                                copy_len = MAX_HTTP_OUTPUT_BUFFER - output_len;
+
+                                if (copy_len > evt->data_len) {
+                                        copy_len = evt->data_len;
+                                }
+
+                                if (0 < copy_len) {
+                                        memcpy(evt->user_data + output_len, evt->data, copy_len);
+                                }
                         } else {
                                 if (output_buffer == NULL) {
                                         output_buffer = (char *) malloc(esp_http_client_get_content_length(evt->client));
@@ -2,7 +2,7 @@
  *******************************************************************************
  * @file http.h
  *
- * @brief 
+ * @brief Telemetry transport over HTTP POST
  *
  * @author Raúl Gotor (raulgotor@gmail.com)
  * @date 10.04.22
@@ -16,6 +16,9 @@
 #ifndef HTTP_H
 #define HTTP_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
 /*
  *******************************************************************************
  * Public Macros                                                               *
@@ -29,6 +32,21 @@
  *******************************************************************************
  */
 
+//! @brief Connection counters, since boot
+typedef struct {
+        //! @brief Posts attempted
+        uint32_t posts;
+
+        //! @brief Posts sent over a connection already open
+        uint32_t reused;
+
+        //! @brief Connections opened, each one costing a TCP handshake
+        uint32_t connections;
+
+        //! @brief Posts which failed, even after reconnecting
+        uint32_t failures;
+} http_stats_t;
+
 /*
  *******************************************************************************
  * Public Constants                                                            *
@@ -42,8 +60,13 @@
  *******************************************************************************
  */
 
-void http_send_data(uint32_t const data);
-
+//! @brief Initialize the HTTP client
 bool http_init(void);
 
+//! @brief Post telemetry to the server
+bool http_post(char const * const p_post_data);
+
+//! @brief Get the connection counters
+bool http_get_stats(http_stats_t * const p_stats);
+
 #endif //HTTP_H
\ No newline at end of file
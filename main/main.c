@@ -28,6 +28,7 @@
 
 #include "esp_freertos_hooks.h"
 #include "esp_log.h"
+#include "nvs_flash.h"
 #include "driver/gpio.h"
 
 #include "lvgl.h"
@@ -35,11 +36,15 @@
 
 #include "disp_spi.h"
 
-#include "http.h"
+#include "uplink.h"
 #include "wifi.h"
 #include "battery.h"
 #include "display.h"
 #include "sensor.h"
+#include "history.h"
+#include "statistics.h"
+#include "alarm.h"
+#include "sample_bus.h"
 
 #include "main.h"
 
@@ -63,6 +68,22 @@
  *******************************************************************************
  */
 
+//! @brief Request to calibrate the zero point, with the calibration button
+static sensor_request_t const m_calibrate_request = {
+                .type = SENSOR_REQUEST_CALIBRATE_ZERO_POINT,
+                .sensor = SENSOR_ALL,
+                .done_cb = NULL,
+                .p_context = NULL,
+};
+
+//! @brief Request for a fresh reading to show when the display wakes up
+static sensor_request_t const m_wake_read_request = {
+                .type = SENSOR_REQUEST_READ,
+                .sensor = SENSOR_ALL,
+                .done_cb = NULL,
+                .p_context = NULL,
+};
+
 /*
  *******************************************************************************
  * Private Function Prototypes                                                 *
@@ -71,6 +92,8 @@
 
 static bool gpio_setup();
 
+static bool nvs_setup(void);
+
 static void IRAM_ATTR gpio_isr_handler(void *parameters);
 
 /*
@@ -98,7 +121,17 @@ void app_main(void) {
 
         bool success;
 
-        success = gpio_setup();
+        success = nvs_setup();
+
+        success = success & gpio_setup();
+
+        success = success & sample_bus_init();
+
+        success = success & history_init();
+
+        success = success & statistics_init();
+
+        success = success & alarm_init();
 
         success = success & sensor_init();
 
@@ -108,7 +141,7 @@ void app_main(void) {
 
         success = success & wifi_init();
 
-        success = success & http_init();
+        success = success & uplink_init();
 
 
         if (!success) {
@@ -172,6 +205,34 @@ static bool gpio_setup() {
         return success;
 }
 
+/*!
+ * @brief Initialize the NVS partition, erasing it if it can't be used
+ *
+ * Has to run before any module persisting its state, such as the backlog of
+ * the uplink. The partition is erased if it is full or was written by a
+ * newer NVS version, as it can't be read otherwise.
+ *
+ * @return              bool                Operation result
+ */
+static bool nvs_setup(void)
+{
+        esp_err_t esp_result;
+
+        esp_result = nvs_flash_init();
+
+        if ((ESP_ERR_NVS_NO_FREE_PAGES == esp_result) ||
+            (ESP_ERR_NVS_NEW_VERSION_FOUND == esp_result)) {
+
+                esp_result = nvs_flash_erase();
+
+                if (ESP_OK == esp_result) {
+                        esp_result = nvs_flash_init();
+                }
+        }
+
+        return (ESP_OK == esp_result);
+}
+
 /*
  *******************************************************************************
  * Interrupt Service Routines / Tasks / Thread Main Functions                  *
@@ -181,16 +242,35 @@ static bool gpio_setup() {
 static void IRAM_ATTR gpio_isr_handler(void * parameters) {
 
         gpio_num_t const gpio_num = (gpio_num_t)parameters;
+        BaseType_t higher_priority_task_woken = pdFALSE;
 
         switch (gpio_num) {
         case CALIBRATION_BUTTON:
-                //xTaskNotifyFromISR(sensor_task_h, gpio_num, eSetValueWithOverwrite, NULL);
+
+                /* Nothing is waiting on the calibration, so it is served after
+                 * the already queued requests
+                 */
+                (void)sensor_submit_from_isr(&m_calibrate_request,
+                                             SENSOR_PRIORITY_NORMAL,
+                                             &higher_priority_task_woken);
                 break;
         case BACKLIGHT_BUTTON:
 
-                xTaskNotifyFromISR(display_task_h, gpio_num, eSetValueWithOverwrite, NULL);
+                /* The display is about to wake up: read the sensors right away
+                 * instead of waiting for the next periodic read, so the display
+                 * is repainted with a fresh value
+                 */
+                if (!display_is_enabled()) {
+                        (void)sensor_submit_from_isr(&m_wake_read_request,
+                                                     SENSOR_PRIORITY_HIGH,
+                                                     &higher_priority_task_woken);
+                }
+
+                xTaskNotifyFromISR(display_task_h, DISPLAY_NOTIFY_TOGGLE, eSetBits, &higher_priority_task_woken);
                 break;
         default:
                 break;
         }
+
+        portYIELD_FROM_ISR(higher_priority_task_woken);
 }
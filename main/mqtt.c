@@ -0,0 +1,358 @@
+/*!
+ *******************************************************************************
+ * @file mqtt.c
+ *
+ * @brief Telemetry transport over MQTT
+ *
+ * Publishes to the Thingsboard MQTT device API, authenticating with the
+ * device token as user name. The client keeps a single connection open and
+ * reconnects on its own when it drops.
+ *
+ * At least once messages are kept in the client outbox until the broker
+ * acknowledges them, resent after reconnecting if needed, and queued in it
+ * while disconnected. At most `MQTT_MAX_IN_FLIGHT` of them are kept, so an
+ * outage can't use up the heap, and the last `MQTT_URGENT_IN_FLIGHT` are only
+ * taken by urgent messages, so routine ones can't crowd alarms out. At most
+ * once messages are only published while connected.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "mqtt_client.h"
+
+#include "esp_log.h"
+#include "display.h"
+#include "device_state.h"
+#include "mqtt.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+#define TAG                                 "mqtt"
+
+#define BROKER_URI                          CONFIG_CO2_MONITOR_MQTT_BROKER_URI
+#define TOKEN                               CONFIG_CO2_MONITOR_DEVICE_TOKEN
+#define TOPIC                               "v1/devices/me/telemetry"
+
+//! @brief Time between pings while idle (in seconds)
+#define KEEPALIVE_S                         (60)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Track the connection and the acknowledgements
+static void mqtt_event_handler(void *p_handler_args,
+                               esp_event_base_t base,
+                               int32_t event_id,
+                               void *p_event_data);
+
+//! @brief Count a message out of flight
+static void mqtt_land(bool const is_acknowledged);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Telemetry client configuration
+static esp_mqtt_client_config_t const m_config = {
+                .uri = BROKER_URI,
+                .username = TOKEN,
+                .keepalive = KEEPALIVE_S,
+};
+
+static esp_mqtt_client_handle_t m_client = NULL;
+
+//! @brief Whether the client is connected to the broker
+static bool m_is_connected = false;
+
+//! @brief Connection counters
+static mqtt_stats_t m_stats;
+
+//! @brief Protects `m_is_connected` and `m_stats`, taken only for a single
+//!        update or query
+static portMUX_TYPE m_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize the MQTT client and start connecting to the broker
+ *
+ * The client connects in the background, and keeps reconnecting until it
+ * succeeds.
+ *
+ * @return              bool                Operation result
+ */
+bool mqtt_init(void)
+{
+        bool success;
+
+        m_client = esp_mqtt_client_init(&m_config);
+
+        success = (NULL != m_client);
+
+        if (success) {
+                success = (ESP_OK == esp_mqtt_client_register_event(
+                                m_client,
+                                ESP_EVENT_ANY_ID,
+                                mqtt_event_handler,
+                                NULL));
+        }
+
+        if (success) {
+                success = (ESP_OK == esp_mqtt_client_start(m_client));
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Publish telemetry to the broker
+ *
+ * At least once messages are queued while disconnected, and sent once the
+ * client reconnects. The payload is copied, it can be reused right away.
+ *
+ * @param[in]           p_payload           JSON telemetry, null terminated
+ * @param[in]           qos                 Delivery guarantee
+ * @param[in]           is_urgent           Whether an at least once message
+ *                                          can take the in flight slots kept
+ *                                          for urgent ones
+ *
+ * @return              bool                False if the message was refused:
+ *                                          at most once while disconnected,
+ *                                          or at least once with too many in
+ *                                          flight already
+ */
+bool mqtt_publish(char const * const p_payload,
+                  mqtt_qos_t const qos,
+                  bool const is_urgent)
+{
+        bool const is_tracked = (MQTT_QOS_AT_LEAST_ONCE == qos);
+        uint32_t const max_in_flight = (is_urgent) ?
+                                       MQTT_MAX_IN_FLIGHT :
+                                       (MQTT_MAX_IN_FLIGHT - MQTT_URGENT_IN_FLIGHT);
+        bool is_connected;
+        bool is_taken;
+        int msg_id = -1;
+
+        if ((NULL == p_payload) || (NULL == m_client)) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        portENTER_CRITICAL(&m_lock);
+
+        is_connected = m_is_connected;
+
+        // Taken before publishing, the acknowledgement may come first
+        is_taken = ((is_tracked) && (max_in_flight > m_stats.in_flight));
+
+        if (is_taken) {
+                ++m_stats.in_flight;
+        }
+
+        portEXIT_CRITICAL(&m_lock);
+
+        if (((is_taken) || (!is_tracked)) && (is_connected)) {
+                msg_id = esp_mqtt_client_publish(m_client,
+                                                 TOPIC,
+                                                 p_payload,
+                                                 0,
+                                                 (int)qos,
+                                                 0);
+        } else if (is_taken) {
+                msg_id = esp_mqtt_client_enqueue(m_client,
+                                                 TOPIC,
+                                                 p_payload,
+                                                 0,
+                                                 (int)qos,
+                                                 0,
+                                                 true);
+        }
+
+        portENTER_CRITICAL(&m_lock);
+
+        if (0 <= msg_id) {
+                ++m_stats.published;
+        } else {
+                ++m_stats.dropped;
+
+                if ((is_taken) && (0 != m_stats.in_flight)) {
+                        --m_stats.in_flight;
+                }
+        }
+
+        portEXIT_CRITICAL(&m_lock);
+
+        ESP_LOGD(TAG, "Publish with QoS %d: message %d", (int)qos, msg_id);
+
+        return (0 <= msg_id);
+}
+
+/*!
+ * @brief Get the connection counters
+ *
+ * @param[out]          p_stats             Pointer where to copy the counters
+ *
+ * @return              bool                Operation result
+ */
+bool mqtt_get_stats(mqtt_stats_t * const p_stats)
+{
+        bool const success = (NULL != p_stats);
+
+        if (success) {
+                portENTER_CRITICAL(&m_lock);
+                *p_stats = m_stats;
+                portEXIT_CRITICAL(&m_lock);
+        }
+
+        return success;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Count a message out of flight
+ *
+ * @param[in]           is_acknowledged     Whether the broker acknowledged it,
+ *                                          or it was dropped instead
+ *
+ * @return              -                   -
+ */
+static void mqtt_land(bool const is_acknowledged)
+{
+        portENTER_CRITICAL(&m_lock);
+
+        if (0 != m_stats.in_flight) {
+                --m_stats.in_flight;
+        }
+
+        if (is_acknowledged) {
+                ++m_stats.acknowledged;
+        } else {
+                ++m_stats.dropped;
+        }
+
+        portEXIT_CRITICAL(&m_lock);
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Track the connection and the acknowledgements
+ *
+ * Runs in the MQTT client task. The link status follows the connection to
+ * the broker.
+ *
+ * @param               p_handler_args      Not used
+ * @param               base                Not used
+ * @param[in]           event_id            Event
+ * @param[in]           p_event_data        Pointer to the event details
+ *
+ * @return              -                   -
+ */
+static void mqtt_event_handler(void *p_handler_args,
+                               esp_event_base_t base,
+                               int32_t event_id,
+                               void *p_event_data)
+{
+        esp_mqtt_event_handle_t const p_event = p_event_data;
+
+        (void)p_handler_args;
+        (void)base;
+
+        switch ((esp_mqtt_event_id_t)event_id) {
+        case MQTT_EVENT_CONNECTED:
+                ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+
+                portENTER_CRITICAL(&m_lock);
+                m_is_connected = true;
+                ++m_stats.connections;
+                portEXIT_CRITICAL(&m_lock);
+
+                device_state_set_link(true);
+                display_set_link_status(true);
+                break;
+        case MQTT_EVENT_DISCONNECTED:
+                ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
+
+                portENTER_CRITICAL(&m_lock);
+                m_is_connected = false;
+                portEXIT_CRITICAL(&m_lock);
+
+                device_state_set_link(false);
+                display_set_link_status(false);
+                break;
+        case MQTT_EVENT_PUBLISHED:
+                ESP_LOGD(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", p_event->msg_id);
+
+                mqtt_land(true);
+                break;
+        case MQTT_EVENT_DELETED:
+                // Expired in the outbox before being acknowledged
+                ESP_LOGW(TAG, "MQTT_EVENT_DELETED, msg_id=%d", p_event->msg_id);
+
+                mqtt_land(false);
+                break;
+        case MQTT_EVENT_ERROR:
+                ESP_LOGD(TAG, "MQTT_EVENT_ERROR");
+                break;
+        default:
+                break;
+        }
+}
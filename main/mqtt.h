@@ -0,0 +1,92 @@
+/*!
+ *******************************************************************************
+ * @file mqtt.h
+ *
+ * @brief Telemetry transport over MQTT
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef MQTT_H
+#define MQTT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+//! @brief At least once messages kept until acknowledged
+#define MQTT_MAX_IN_FLIGHT                  (16)
+
+//! @brief Of `MQTT_MAX_IN_FLIGHT`, the ones only urgent messages can take
+#define MQTT_URGENT_IN_FLIGHT               (4)
+
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Delivery guarantees of a message
+typedef enum {
+        //! @brief Sent once, lost if the connection drops
+        MQTT_QOS_AT_MOST_ONCE = 0,
+
+        //! @brief Resent until acknowledged by the broker
+        MQTT_QOS_AT_LEAST_ONCE = 1,
+} mqtt_qos_t;
+
+//! @brief Connection counters, since boot
+typedef struct {
+        //! @brief Messages handed to the client
+        uint32_t published;
+
+        //! @brief At least once messages acknowledged by the broker
+        uint32_t acknowledged;
+
+        //! @brief At least once messages waiting to be acknowledged
+        uint32_t in_flight;
+
+        //! @brief Messages dropped, either refused or expired unacknowledged
+        uint32_t dropped;
+
+        //! @brief Connections to the broker established
+        uint32_t connections;
+} mqtt_stats_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize the MQTT client and start connecting to the broker
+bool mqtt_init(void);
+
+//! @brief Publish telemetry to the broker
+bool mqtt_publish(char const * const p_payload,
+                  mqtt_qos_t const qos,
+                  bool const is_urgent);
+
+//! @brief Get the connection counters
+bool mqtt_get_stats(mqtt_stats_t * const p_stats);
+
+#endif //MQTT_H
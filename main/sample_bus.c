@@ -0,0 +1,305 @@
+/*!
+ *******************************************************************************
+ * @file sample_bus.c
+ *
+ * @brief Publish / subscribe bus for the sensor samples
+ *
+ * The sensor module publishes every sample once into a fixed ring of slots,
+ * tagged with an increasing sequence number. Subscribers keep a cursor with
+ * the sequence number of the next sample they want, and read the samples in
+ * place, at their own pace: there is no allocation nor copy per sample and
+ * subscriber.
+ *
+ * The publisher never waits for the subscribers. Once the ring is full, the
+ * oldest sample is overwritten, and subscribers lagging behind lose it.
+ * Since subscribers read in place, a sample could be overwritten while being
+ * used, which `sample_bus_release` tells.
+ *
+ * There must be a single publisher.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "sample_bus.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Sample slots
+static sample_bus_sample_t m_slots[SAMPLE_BUS_SLOTS];
+
+//! @brief Sequence number of the next sample to be published
+static uint32_t m_head = 0;
+
+//! @brief Registered subscribers
+static sample_bus_subscriber_t * m_subscribers[SAMPLE_BUS_MAX_SUBSCRIBERS];
+
+//! @brief Amount of registered subscribers
+static size_t m_subscriber_count = 0;
+
+//! @brief Protects the subscriber registration
+static portMUX_TYPE m_subscribers_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize the bus
+ *
+ * Drops every subscriber. Must be called before any other module uses the bus.
+ *
+ * @return              bool                Operation result
+ */
+bool sample_bus_init(void)
+{
+        portENTER_CRITICAL(&m_subscribers_lock);
+        m_subscriber_count = 0;
+        portEXIT_CRITICAL(&m_subscribers_lock);
+
+        return true;
+}
+
+/*!
+ * @brief Subscribe to the samples published from now on
+ *
+ * @param[out]          p_subscriber        Pointer to the subscriber, must
+ *                                          outlive the bus
+ * @param[in]           notify_cb           Notification of a new sample (can
+ *                                          be null, to poll the bus instead)
+ * @param[in]           p_context           Context passed to `notify_cb`
+ *
+ * @return              bool                Operation result, fails if there
+ *                                          are too many subscribers
+ */
+bool sample_bus_subscribe(sample_bus_subscriber_t * const p_subscriber,
+                          sample_bus_notify_cb const notify_cb,
+                          void * const p_context)
+{
+        bool success = (NULL != p_subscriber);
+
+        if (success) {
+                p_subscriber->lost = 0;
+                p_subscriber->notify_cb = notify_cb;
+                p_subscriber->p_context = p_context;
+
+                portENTER_CRITICAL(&m_subscribers_lock);
+
+                success = (SAMPLE_BUS_MAX_SUBSCRIBERS > m_subscriber_count);
+
+                if (success) {
+                        p_subscriber->cursor = __atomic_load_n(&m_head,
+                                                               __ATOMIC_ACQUIRE);
+
+                        m_subscribers[m_subscriber_count] = p_subscriber;
+
+                        __atomic_store_n(&m_subscriber_count,
+                                         m_subscriber_count + 1,
+                                         __ATOMIC_RELEASE);
+                }
+
+                portEXIT_CRITICAL(&m_subscribers_lock);
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Publish a sample
+ *
+ * The sample is written into the slot of the oldest one, and then every
+ * subscriber with a notification callback is notified.
+ *
+ * @param[in]           p_reading           Pointer to the sensor reading
+ * @param[in]           time_s              Time of the sample (in seconds since
+ *                                          boot)
+ *
+ * @return              -                   -
+ */
+void sample_bus_publish(sensor_reading_t const * const p_reading,
+                        uint32_t const time_s)
+{
+        uint32_t const sequence = m_head;
+        sample_bus_sample_t * const p_slot = &m_slots[sequence % SAMPLE_BUS_SLOTS];
+        sample_bus_subscriber_t * p_subscriber;
+        size_t subscriber_count;
+        size_t i;
+
+        if (NULL == p_reading) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        p_slot->sequence = sequence;
+        p_slot->time_s = time_s;
+        p_slot->reading = *p_reading;
+
+        // Sample must be complete before subscribers can see it
+        __atomic_store_n(&m_head, sequence + 1, __ATOMIC_RELEASE);
+
+        subscriber_count = __atomic_load_n(&m_subscriber_count,
+                                           __ATOMIC_ACQUIRE);
+
+        for (i = 0; subscriber_count > i; ++i) {
+                p_subscriber = m_subscribers[i];
+
+                if (NULL != p_subscriber->notify_cb) {
+                        p_subscriber->notify_cb(p_subscriber->p_context);
+                }
+        }
+}
+
+/*!
+ * @brief Get the next unread sample, in place
+ *
+ * If the subscriber lagged behind and its next samples were overwritten, it
+ * skips to the oldest sample still in the bus, and the overwritten ones are
+ * counted as lost. The sample stays the next unread one until released.
+ *
+ * @param[in,out]       p_subscriber        Pointer to the subscriber
+ *
+ * @return              sample_bus_sample_t const *
+ *                                          Pointer to the sample, or null if
+ *                                          there are no unread samples
+ */
+sample_bus_sample_t const * sample_bus_peek(
+                sample_bus_subscriber_t * const p_subscriber)
+{
+        uint32_t head;
+        uint32_t unread;
+
+        if (NULL == p_subscriber) {
+                // Code style exception for the shake of readability
+                return NULL;
+        }
+
+        head = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+
+        // Overflow is meant to happen
+        unread = head - p_subscriber->cursor;
+
+        // The oldest slot may be being overwritten by the next sample already
+        if ((SAMPLE_BUS_SLOTS - 1) < unread) {
+                p_subscriber->lost += unread - (SAMPLE_BUS_SLOTS - 1);
+                p_subscriber->cursor = head - (SAMPLE_BUS_SLOTS - 1);
+        }
+
+        if (head == p_subscriber->cursor) {
+                // Code style exception for the shake of readability
+                return NULL;
+        }
+
+        return &m_slots[p_subscriber->cursor % SAMPLE_BUS_SLOTS];
+}
+
+/*!
+ * @brief Done with the sample got from `sample_bus_peek`
+ *
+ * Moves the subscriber on to the next sample.
+ *
+ * @param[in,out]       p_subscriber        Pointer to the subscriber
+ *
+ * @return              bool                False if the sample was overwritten
+ *                                          while being used, so what was read
+ *                                          from it can't be trusted
+ */
+bool sample_bus_release(sample_bus_subscriber_t * const p_subscriber)
+{
+        uint32_t head;
+        bool is_intact;
+
+        if (NULL == p_subscriber) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        // Whatever was read from the slot, was read before checking the head
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        head = __atomic_load_n(&m_head, __ATOMIC_RELAXED);
+
+        // Overflow is meant to happen
+        is_intact = (SAMPLE_BUS_SLOTS > (head - p_subscriber->cursor));
+
+        if (!is_intact) {
+                ++p_subscriber->lost;
+        }
+
+        ++p_subscriber->cursor;
+
+        return is_intact;
+}
+
+/*!
+ * @brief Drop every unread sample
+ *
+ * @param[in,out]       p_subscriber        Pointer to the subscriber
+ *
+ * @return              -                   -
+ */
+void sample_bus_skip(sample_bus_subscriber_t * const p_subscriber)
+{
+        if (NULL != p_subscriber) {
+                p_subscriber->cursor = __atomic_load_n(&m_head,
+                                                       __ATOMIC_ACQUIRE);
+        }
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
@@ -0,0 +1,121 @@
+/*!
+ *******************************************************************************
+ * @file sample_bus.h
+ *
+ * @brief Publish / subscribe bus for the sensor samples
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef SAMPLE_BUS_H
+#define SAMPLE_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sensor.h"
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+//! @brief Samples kept in the bus, the oldest one is overwritten when full
+#define SAMPLE_BUS_SLOTS                    (16)
+
+//! @brief Maximum amount of subscribers
+#define SAMPLE_BUS_MAX_SUBSCRIBERS          (8)
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Sample published in the bus
+typedef struct {
+        //! @brief Sequence number, increases by one on every sample
+        uint32_t sequence;
+
+        //! @brief Time of the sample (in seconds since boot)
+        uint32_t time_s;
+
+        //! @brief Sensor reading
+        sensor_reading_t reading;
+} sample_bus_sample_t;
+
+/*!
+ * @brief Notification of a new sample
+ *
+ * Called from the publisher context, so it must be short and never block
+ *
+ * @param[in]           p_context           Context given on subscription
+ *
+ * @return              -                   -
+ */
+typedef void (*sample_bus_notify_cb)(void * const p_context);
+
+/*!
+ * @brief Subscriber of the bus
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       subscribers can be statically allocated
+ */
+typedef struct {
+        //! @brief Sequence number of the next sample to read
+        uint32_t cursor;
+
+        //! @brief Samples overwritten before they were read
+        uint32_t lost;
+
+        //! @brief Notification of a new sample (can be null)
+        sample_bus_notify_cb notify_cb;
+
+        //! @brief Context passed to `notify_cb`
+        void * p_context;
+} sample_bus_subscriber_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize the bus
+bool sample_bus_init(void);
+
+//! @brief Subscribe to the samples published from now on
+bool sample_bus_subscribe(sample_bus_subscriber_t * const p_subscriber,
+                          sample_bus_notify_cb const notify_cb,
+                          void * const p_context);
+
+//! @brief Publish a sample
+void sample_bus_publish(sensor_reading_t const * const p_reading,
+                        uint32_t const time_s);
+
+//! @brief Get the next unread sample, in place
+sample_bus_sample_t const * sample_bus_peek(
+                sample_bus_subscriber_t * const p_subscriber);
+
+//! @brief Done with the sample got from `sample_bus_peek`
+bool sample_bus_release(sample_bus_subscriber_t * const p_subscriber);
+
+//! @brief Drop every unread sample
+void sample_bus_skip(sample_bus_subscriber_t * const p_subscriber);
+
+#endif //SAMPLE_BUS_H
@@ -0,0 +1,875 @@
+/*!
+ *******************************************************************************
+ * @file sample_log.c
+ *
+ * @brief Append-only log of readings in a raw flash area
+ *
+ * The flash area is used as a circular log of sectors. Sectors are written in
+ * order, each one tagged with an increasing sequence number in its header, and
+ * the sector with sequence number `n` always lives at position
+ * `n % sector_count`. Once the area is full, the oldest sector is erased and
+ * reused, so every sector is erased once per lap and wear is spread evenly.
+ *
+ * Readings are buffered in RAM and written in chunks of `batch_size` readings,
+ * each chunk with its own CRC-32, so flash is programmed once per batch.
+ * Chunks never straddle sectors: a chunk not fitting in the current sector
+ * starts the next one.
+ *
+ * On initialization, the write position is recovered reading the header of
+ * each sector, to find the newest one, and then walking the chunks of that
+ * sector only. A corrupted chunk, left by a reset while writing, closes its
+ * sector and writing goes on in the next one.
+ *
+ * Times are kept in seconds since boot, so every reading is tagged with a boot
+ * counter, increased on every initialization.
+ *
+ * The module isn't thread safe, calls have to be serialized by the caller.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "sample_log.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+#define SECTOR_MAGIC                        (0x474F4C53)
+
+#define SECTOR_HEADER_SIZE                  (sizeof(sector_header_t))
+#define CHUNK_HEADER_SIZE                   (sizeof(chunk_header_t))
+#define RECORD_SIZE                         (sizeof(sample_log_record_t))
+
+//! @brief Chunk `count` of an erased chunk header
+#define CHUNK_COUNT_ERASED                  (0xFFFF)
+
+//! @brief Members of a header covered by its CRC
+#define SECTOR_HEADER_CRC_SIZE              (offsetof(sector_header_t, crc))
+#define CHUNK_HEADER_CRC_SIZE               (offsetof(chunk_header_t, crc))
+
+//! @brief Readings read at once when checking a chunk
+#define CHECK_RECORDS                       (8)
+
+#define CRC32_INITIAL_VALUE                 (0xFFFFFFFF)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Header at the beginning of each sector
+typedef struct {
+        //! @brief `SECTOR_MAGIC`
+        uint32_t magic;
+
+        //! @brief Sequence number of the sector
+        uint32_t sequence;
+
+        //! @brief Boot the sector was started in
+        uint8_t boot;
+
+        //! @brief Not used, 0xFF
+        uint8_t reserved[3];
+
+        //! @brief CRC-32 of the members above
+        uint32_t crc;
+} sector_header_t;
+
+//! @brief Header of a chunk, same layout as the start of `sample_log_chunk_t`
+typedef struct {
+        uint16_t count;
+        uint8_t boot;
+        uint8_t reserved;
+        uint32_t crc;
+} chunk_header_t;
+
+//! @brief State of a chunk found in flash
+typedef enum {
+        CHUNK_STATE_VALID = 0,
+        CHUNK_STATE_ERASED,
+        CHUNK_STATE_CORRUPTED,
+        CHUNK_STATE_IO_ERROR,
+} chunk_state_t;
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+//! @brief CRC-32 (reflected 0x04C11DB7 polynomial) of every nibble value
+static uint32_t const m_crc32_table[16] = {
+                0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+                0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+                0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+                0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Find the newest sector and the write position within it
+static sample_log_error_t recover(sample_log_t * const p_log);
+
+//! @brief Read and check the header of a sector
+static sample_log_error_t read_sector_header(sample_log_t const * const p_log,
+                                             uint32_t const sequence,
+                                             bool * const p_is_valid,
+                                             sector_header_t * const p_header);
+
+//! @brief Read the header of a chunk, and optionally check its CRC
+static chunk_state_t read_chunk(sample_log_t const * const p_log,
+                                uint32_t const address,
+                                uint32_t const room,
+                                bool const check,
+                                chunk_header_t * const p_header);
+
+//! @brief Write the buffered chunk
+static sample_log_error_t write_chunk(sample_log_t * const p_log);
+
+//! @brief Erase the next sector and write its header
+static sample_log_error_t start_sector(sample_log_t * const p_log);
+
+//! @brief Get the flash address of a sector
+static uint32_t sector_address(sample_log_t const * const p_log,
+                               uint32_t const sequence);
+
+//! @brief Update a CRC-32 with a buffer
+static uint32_t crc32_update(uint32_t crc,
+                             void const * const p_buffer,
+                             size_t const size);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize the log, recovering its write position
+ *
+ * A blank area is a valid, empty log.
+ *
+ * @param[out]          p_log               Pointer to the log instance
+ * @param[in]           p_flash             Pointer to the flash area
+ * @param[in]           batch_size          Readings written to flash at once,
+ *                                          up to `SAMPLE_LOG_MAX_BATCH_SIZE`
+ *
+ * @return              sample_log_error_t  Operation result
+ * @retval              SAMPLE_LOG_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              SAMPLE_LOG_ERROR_ALREADY_INITIALIZED
+ *                                          Instance is already initialized
+ * @retval              SAMPLE_LOG_ERROR_BAD_PARAMETER
+ *                                          Parameter is null, or the area is
+ *                                          not made of at least two sectors
+ *                                          fitting a whole batch
+ * @retval              SAMPLE_LOG_ERROR_IO_ERROR
+ *                                          Flash couldn't be read
+ */
+sample_log_error_t sample_log_init(sample_log_t * const p_log,
+                                   sample_log_flash_t const * const p_flash,
+                                   size_t const batch_size)
+{
+        sample_log_error_t result = SAMPLE_LOG_ERROR_SUCCESS;
+
+        if ((NULL == p_log) || (NULL == p_flash) ||
+            (NULL == p_flash->read_func) ||
+            (NULL == p_flash->write_func) ||
+            (NULL == p_flash->erase_func) ||
+            (0 == batch_size) || (SAMPLE_LOG_MAX_BATCH_SIZE < batch_size) ||
+            (0 == p_flash->sector_size) ||
+            (0 != (p_flash->size % p_flash->sector_size)) ||
+            ((2 * p_flash->sector_size) > p_flash->size) ||
+            ((SECTOR_HEADER_SIZE + CHUNK_HEADER_SIZE +
+              (batch_size * RECORD_SIZE)) > p_flash->sector_size)) {
+                result = SAMPLE_LOG_ERROR_BAD_PARAMETER;
+        } else if (p_log->is_initialized) {
+                result = SAMPLE_LOG_ERROR_ALREADY_INITIALIZED;
+        } else {
+                p_log->flash = *p_flash;
+                p_log->sector_count = p_flash->size / p_flash->sector_size;
+                p_log->batch_size = batch_size;
+                p_log->chunk.count = 0;
+                memset(&p_log->stats, 0, sizeof(p_log->stats));
+
+                result = recover(p_log);
+        }
+
+        if (SAMPLE_LOG_ERROR_SUCCESS == result) {
+                p_log->is_initialized = true;
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Append a reading
+ *
+ * The reading is buffered, and written together with the rest of its batch
+ * once the batch is full. The boot counter of the reading is overwritten with
+ * the current one.
+ *
+ * @param[in,out]       p_log               Pointer to the log instance
+ * @param[in]           p_record            Pointer to the reading
+ *
+ * @return              sample_log_error_t  Operation result
+ * @retval              SAMPLE_LOG_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              SAMPLE_LOG_ERROR_NOT_INITIALIZED
+ *                                          Instance isn't initialized
+ * @retval              SAMPLE_LOG_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ * @retval              SAMPLE_LOG_ERROR_IO_ERROR
+ *                                          Batch couldn't be written, and its
+ *                                          readings are lost
+ */
+sample_log_error_t sample_log_append(sample_log_t * const p_log,
+                                     sample_log_record_t const * const p_record)
+{
+        sample_log_error_t result = SAMPLE_LOG_ERROR_SUCCESS;
+        sample_log_record_t * p_slot;
+
+        if ((NULL == p_log) || (NULL == p_record)) {
+                result = SAMPLE_LOG_ERROR_BAD_PARAMETER;
+        } else if (!p_log->is_initialized) {
+                result = SAMPLE_LOG_ERROR_NOT_INITIALIZED;
+        } else {
+                p_slot = &p_log->chunk.records[p_log->chunk.count];
+
+                *p_slot = *p_record;
+                p_slot->boot = p_log->boot;
+
+                ++p_log->chunk.count;
+                ++p_log->stats.appended;
+
+                if (p_log->batch_size <= p_log->chunk.count) {
+                        result = write_chunk(p_log);
+                }
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Write the readings appended so far, even if the batch isn't full
+ *
+ * @param[in,out]       p_log               Pointer to the log instance
+ *
+ * @return              sample_log_error_t  Operation result
+ * @retval              SAMPLE_LOG_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              SAMPLE_LOG_ERROR_NOT_INITIALIZED
+ *                                          Instance isn't initialized
+ * @retval              SAMPLE_LOG_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ * @retval              SAMPLE_LOG_ERROR_IO_ERROR
+ *                                          Readings couldn't be written, and
+ *                                          are lost
+ */
+sample_log_error_t sample_log_flush(sample_log_t * const p_log)
+{
+        sample_log_error_t result = SAMPLE_LOG_ERROR_SUCCESS;
+
+        if (NULL == p_log) {
+                result = SAMPLE_LOG_ERROR_BAD_PARAMETER;
+        } else if (!p_log->is_initialized) {
+                result = SAMPLE_LOG_ERROR_NOT_INITIALIZED;
+        } else if (0 != p_log->chunk.count) {
+                result = write_chunk(p_log);
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Get the next written reading after a cursor
+ *
+ * A zeroed cursor, or one pointing to readings that have already been erased,
+ * is moved to the oldest reading. Readings still buffered aren't returned.
+ * Each chunk's CRC is checked when the cursor enters it, and corrupted chunks
+ * are skipped together with the rest of their sector. Cursors have to be
+ * zeroed or got from this function, as they cache the chunk size.
+ *
+ * @param[in,out]       p_log               Pointer to the log instance
+ * @param[in,out]       p_cursor            Pointer to the reader cursor,
+ *                                          advanced past the returned reading
+ * @param[out]          p_record            Pointer where to copy the reading
+ *
+ * @return              sample_log_error_t  Operation result
+ * @retval              SAMPLE_LOG_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              SAMPLE_LOG_ERROR_NOT_INITIALIZED
+ *                                          Instance isn't initialized
+ * @retval              SAMPLE_LOG_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ * @retval              SAMPLE_LOG_ERROR_IO_ERROR
+ *                                          Flash couldn't be read
+ * @retval              SAMPLE_LOG_ERROR_END_OF_LOG
+ *                                          There are no more readings
+ */
+sample_log_error_t sample_log_read_next(sample_log_t * const p_log,
+                                        sample_log_cursor_t * const p_cursor,
+                                        sample_log_record_t * const p_record)
+{
+        sample_log_error_t result = SAMPLE_LOG_ERROR_SUCCESS;
+        sector_header_t sector_header;
+        chunk_header_t chunk_header;
+        chunk_state_t state;
+        uint32_t oldest;
+        uint32_t address;
+        bool is_found = false;
+        bool is_next_sector;
+        bool is_valid;
+
+        if ((NULL == p_log) || (NULL == p_cursor) || (NULL == p_record)) {
+                result = SAMPLE_LOG_ERROR_BAD_PARAMETER;
+        } else if (!p_log->is_initialized) {
+                result = SAMPLE_LOG_ERROR_NOT_INITIALIZED;
+        } else if (!p_log->has_head) {
+                result = SAMPLE_LOG_ERROR_END_OF_LOG;
+        }
+
+        while ((SAMPLE_LOG_ERROR_SUCCESS == result) && (!is_found)) {
+                is_next_sector = false;
+
+                oldest = 0;
+
+                if (p_log->head_sequence >= p_log->sector_count) {
+                        oldest = p_log->head_sequence - p_log->sector_count + 1;
+                }
+
+                // Overflow is meant to happen
+                if ((p_cursor->sector_sequence - oldest) >
+                    (p_log->head_sequence - oldest)) {
+                        memset(p_cursor, 0, sizeof(*p_cursor));
+                        p_cursor->sector_sequence = oldest;
+                }
+
+                address = sector_address(p_log, p_cursor->sector_sequence);
+
+                if (SECTOR_HEADER_SIZE > p_cursor->offset) {
+                        result = read_sector_header(p_log,
+                                                    p_cursor->sector_sequence,
+                                                    &is_valid,
+                                                    &sector_header);
+
+                        p_cursor->offset = SECTOR_HEADER_SIZE;
+                        p_cursor->index = 0;
+                        is_next_sector = !is_valid;
+                }
+
+                if ((SAMPLE_LOG_ERROR_SUCCESS != result) || (is_next_sector)) {
+                        // Nothing to read in this sector
+                } else if ((p_log->head_sequence == p_cursor->sector_sequence) &&
+                           (p_log->head_offset <= p_cursor->offset)) {
+                        result = SAMPLE_LOG_ERROR_END_OF_LOG;
+                } else if ((p_cursor->offset + CHUNK_HEADER_SIZE) >
+                           p_log->flash.sector_size) {
+                        is_next_sector = true;
+                } else {
+                        state = CHUNK_STATE_VALID;
+
+                        // Chunk header is only read, and checked, on entering it
+                        if (0 == p_cursor->index) {
+                                state = read_chunk(p_log,
+                                                   address + p_cursor->offset,
+                                                   p_log->flash.sector_size -
+                                                   p_cursor->offset,
+                                                   true,
+                                                   &chunk_header);
+
+                                p_cursor->count = chunk_header.count;
+                        }
+
+                        if (CHUNK_STATE_IO_ERROR == state) {
+                                result = SAMPLE_LOG_ERROR_IO_ERROR;
+                        } else if (CHUNK_STATE_VALID != state) {
+                                is_next_sector = true;
+                        } else if (!p_log->flash.read_func(
+                                        p_log->flash.p_context,
+                                        address + p_cursor->offset +
+                                        CHUNK_HEADER_SIZE +
+                                        (p_cursor->index * RECORD_SIZE),
+                                        p_record,
+                                        RECORD_SIZE)) {
+                                result = SAMPLE_LOG_ERROR_IO_ERROR;
+                        } else {
+                                ++p_cursor->index;
+
+                                if (p_cursor->count <= p_cursor->index) {
+                                        p_cursor->offset += CHUNK_HEADER_SIZE +
+                                                            (p_cursor->count *
+                                                             RECORD_SIZE);
+                                        p_cursor->index = 0;
+                                }
+
+                                is_found = true;
+                        }
+                }
+
+                if ((SAMPLE_LOG_ERROR_SUCCESS == result) && (is_next_sector)) {
+                        if (p_log->head_sequence == p_cursor->sector_sequence) {
+                                result = SAMPLE_LOG_ERROR_END_OF_LOG;
+                        } else {
+                                ++p_cursor->sector_sequence;
+                                p_cursor->offset = 0;
+                                p_cursor->index = 0;
+                        }
+                }
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Get the log statistics
+ *
+ * @param[in]           p_log               Pointer to the log instance
+ * @param[out]          p_stats             Pointer where to copy the statistics
+ *
+ * @return              sample_log_error_t  Operation result
+ * @retval              SAMPLE_LOG_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              SAMPLE_LOG_ERROR_NOT_INITIALIZED
+ *                                          Instance isn't initialized
+ * @retval              SAMPLE_LOG_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ */
+sample_log_error_t sample_log_get_stats(sample_log_t const * const p_log,
+                                        sample_log_stats_t * const p_stats)
+{
+        sample_log_error_t result = SAMPLE_LOG_ERROR_SUCCESS;
+
+        if ((NULL == p_log) || (NULL == p_stats)) {
+                result = SAMPLE_LOG_ERROR_BAD_PARAMETER;
+        } else if (!p_log->is_initialized) {
+                result = SAMPLE_LOG_ERROR_NOT_INITIALIZED;
+        } else {
+                *p_stats = p_log->stats;
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Get the boot counter the readings of this boot are logged with
+ *
+ * @param[in]           p_log               Pointer to the log instance
+ * @param[out]          p_boot              Pointer where to copy the counter
+ *
+ * @return              sample_log_error_t  Operation result
+ * @retval              SAMPLE_LOG_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              SAMPLE_LOG_ERROR_NOT_INITIALIZED
+ *                                          Instance isn't initialized
+ * @retval              SAMPLE_LOG_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ */
+sample_log_error_t sample_log_get_boot(sample_log_t const * const p_log,
+                                       uint8_t * const p_boot)
+{
+        sample_log_error_t result = SAMPLE_LOG_ERROR_SUCCESS;
+
+        if ((NULL == p_log) || (NULL == p_boot)) {
+                result = SAMPLE_LOG_ERROR_BAD_PARAMETER;
+        } else if (!p_log->is_initialized) {
+                result = SAMPLE_LOG_ERROR_NOT_INITIALIZED;
+        } else {
+                *p_boot = p_log->boot;
+        }
+
+        return result;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Find the newest sector and the write position within it
+ *
+ * @param[in,out]       p_log               Pointer to the log instance
+ *
+ * @return              sample_log_error_t  Operation result
+ */
+static sample_log_error_t recover(sample_log_t * const p_log)
+{
+        sample_log_error_t result = SAMPLE_LOG_ERROR_SUCCESS;
+        sector_header_t header;
+        chunk_header_t chunk_header;
+        chunk_state_t state = CHUNK_STATE_VALID;
+        uint32_t address;
+        uint32_t offset;
+        uint32_t i;
+        uint8_t boot = 0;
+        bool is_valid;
+
+        p_log->has_head = false;
+        p_log->head_sequence = 0;
+        p_log->head_offset = 0;
+
+        // Sector `i` holds sequence numbers `i`, `i + sector_count`...
+        for (i = 0; (SAMPLE_LOG_ERROR_SUCCESS == result) &&
+                    (p_log->sector_count > i); ++i) {
+                result = p_log->flash.read_func(p_log->flash.p_context,
+                                                i * p_log->flash.sector_size,
+                                                &header,
+                                                SECTOR_HEADER_SIZE) ?
+                         SAMPLE_LOG_ERROR_SUCCESS : SAMPLE_LOG_ERROR_IO_ERROR;
+
+                is_valid = (SECTOR_MAGIC == header.magic) &&
+                           (crc32_update(CRC32_INITIAL_VALUE,
+                                         &header,
+                                         SECTOR_HEADER_CRC_SIZE) ==
+                            header.crc) &&
+                           ((header.sequence % p_log->sector_count) == i);
+
+                if ((SAMPLE_LOG_ERROR_SUCCESS == result) && (is_valid) &&
+                    ((!p_log->has_head) ||
+                     (header.sequence > p_log->head_sequence))) {
+                        p_log->has_head = true;
+                        p_log->head_sequence = header.sequence;
+                        boot = header.boot;
+                }
+        }
+
+        if ((SAMPLE_LOG_ERROR_SUCCESS == result) && (p_log->has_head)) {
+                address = sector_address(p_log, p_log->head_sequence);
+                offset = SECTOR_HEADER_SIZE;
+
+                while ((CHUNK_STATE_VALID == state) &&
+                       ((offset + CHUNK_HEADER_SIZE) <=
+                        p_log->flash.sector_size)) {
+                        state = read_chunk(p_log,
+                                           address + offset,
+                                           p_log->flash.sector_size - offset,
+                                           true,
+                                           &chunk_header);
+
+                        if (CHUNK_STATE_VALID == state) {
+                                offset += CHUNK_HEADER_SIZE +
+                                          (chunk_header.count * RECORD_SIZE);
+                                boot = chunk_header.boot;
+                        }
+                }
+
+                if (CHUNK_STATE_IO_ERROR == state) {
+                        result = SAMPLE_LOG_ERROR_IO_ERROR;
+                } else if (CHUNK_STATE_CORRUPTED == state) {
+                        // Don't write after garbage, go on in the next sector
+                        ++p_log->stats.bad_chunks;
+                        offset = p_log->flash.sector_size;
+                }
+
+                p_log->head_offset = offset;
+                p_log->boot = (uint8_t)(boot + 1);
+        } else {
+                p_log->boot = 0;
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Read and check the header of a sector
+ *
+ * @param[in]           p_log               Pointer to the log instance
+ * @param[in]           sequence            Sequence number of the sector
+ * @param[out]          p_is_valid          Whether the header is valid and
+ *                                          belongs to `sequence`
+ * @param[out]          p_header            Pointer where to read the header
+ *
+ * @return              sample_log_error_t  Operation result
+ */
+static sample_log_error_t read_sector_header(sample_log_t const * const p_log,
+                                             uint32_t const sequence,
+                                             bool * const p_is_valid,
+                                             sector_header_t * const p_header)
+{
+        bool success;
+
+        success = p_log->flash.read_func(p_log->flash.p_context,
+                                         sector_address(p_log, sequence),
+                                         p_header,
+                                         SECTOR_HEADER_SIZE);
+
+        *p_is_valid = (success) &&
+                      (SECTOR_MAGIC == p_header->magic) &&
+                      (sequence == p_header->sequence) &&
+                      (crc32_update(CRC32_INITIAL_VALUE,
+                                    p_header,
+                                    SECTOR_HEADER_CRC_SIZE) == p_header->crc);
+
+        return success ? SAMPLE_LOG_ERROR_SUCCESS : SAMPLE_LOG_ERROR_IO_ERROR;
+}
+
+/*!
+ * @brief Read the header of a chunk, and optionally check its CRC
+ *
+ * The readings are read in small pieces to check the CRC, so checking doesn't
+ * need a whole chunk of stack
+ *
+ * @param[in]           p_log               Pointer to the log instance
+ * @param[in]           address             Flash address of the chunk
+ * @param[in]           room                Bytes left in the sector from
+ *                                          `address`
+ * @param[in]           check               Whether to check the CRC
+ * @param[out]          p_header            Pointer where to read the header
+ *
+ * @return              chunk_state_t       State of the chunk
+ */
+static chunk_state_t read_chunk(sample_log_t const * const p_log,
+                                uint32_t const address,
+                                uint32_t const room,
+                                bool const check,
+                                chunk_header_t * const p_header)
+{
+        sample_log_record_t records[CHECK_RECORDS];
+        chunk_state_t state = CHUNK_STATE_VALID;
+        uint32_t crc;
+        size_t done = 0;
+        size_t count;
+
+        if (!p_log->flash.read_func(p_log->flash.p_context,
+                                    address,
+                                    p_header,
+                                    CHUNK_HEADER_SIZE)) {
+                state = CHUNK_STATE_IO_ERROR;
+        } else if (CHUNK_COUNT_ERASED == p_header->count) {
+                state = CHUNK_STATE_ERASED;
+        } else if ((0 == p_header->count) ||
+                   (SAMPLE_LOG_MAX_BATCH_SIZE < p_header->count) ||
+                   ((CHUNK_HEADER_SIZE + (p_header->count * RECORD_SIZE)) >
+                    room)) {
+                state = CHUNK_STATE_CORRUPTED;
+        } else if (check) {
+                crc = crc32_update(CRC32_INITIAL_VALUE,
+                                   p_header,
+                                   CHUNK_HEADER_CRC_SIZE);
+
+                while ((CHUNK_STATE_VALID == state) &&
+                       (p_header->count > done)) {
+                        count = p_header->count - done;
+
+                        if (CHECK_RECORDS < count) {
+                                count = CHECK_RECORDS;
+                        }
+
+                        if (!p_log->flash.read_func(p_log->flash.p_context,
+                                                    address + CHUNK_HEADER_SIZE +
+                                                    (done * RECORD_SIZE),
+                                                    records,
+                                                    count * RECORD_SIZE)) {
+                                state = CHUNK_STATE_IO_ERROR;
+                        } else {
+                                crc = crc32_update(crc,
+                                                   records,
+                                                   count * RECORD_SIZE);
+                                done += count;
+                        }
+                }
+
+                if ((CHUNK_STATE_VALID == state) && (crc != p_header->crc)) {
+                        state = CHUNK_STATE_CORRUPTED;
+                }
+        }
+
+        return state;
+}
+
+/*!
+ * @brief Write the buffered chunk
+ *
+ * Starts a new sector if the chunk doesn't fit in the current one. The buffer
+ * is emptied even if the write fails, the sector is then closed so the
+ * next chunk doesn't follow a half written one.
+ *
+ * @param[in,out]       p_log               Pointer to the log instance
+ *
+ * @return              sample_log_error_t  Operation result
+ */
+static sample_log_error_t write_chunk(sample_log_t * const p_log)
+{
+        sample_log_error_t result = SAMPLE_LOG_ERROR_SUCCESS;
+        sample_log_chunk_t * const p_chunk = &p_log->chunk;
+        uint32_t const size = CHUNK_HEADER_SIZE + (p_chunk->count * RECORD_SIZE);
+
+        if ((!p_log->has_head) ||
+            ((p_log->head_offset + size) > p_log->flash.sector_size)) {
+                result = start_sector(p_log);
+        }
+
+        if (SAMPLE_LOG_ERROR_SUCCESS == result) {
+                p_chunk->boot = p_log->boot;
+                p_chunk->reserved = 0xFF;
+                p_chunk->crc = crc32_update(crc32_update(CRC32_INITIAL_VALUE,
+                                                         p_chunk,
+                                                         CHUNK_HEADER_CRC_SIZE),
+                                            p_chunk->records,
+                                            p_chunk->count * RECORD_SIZE);
+
+                if (p_log->flash.write_func(p_log->flash.p_context,
+                                            sector_address(p_log,
+                                                           p_log->head_sequence) +
+                                            p_log->head_offset,
+                                            p_chunk,
+                                            size)) {
+                        p_log->head_offset += size;
+                        ++p_log->stats.chunks_written;
+                        p_log->stats.bytes_written += size;
+                } else {
+                        p_log->head_offset = p_log->flash.sector_size;
+                        result = SAMPLE_LOG_ERROR_IO_ERROR;
+                }
+        }
+
+        if (SAMPLE_LOG_ERROR_SUCCESS != result) {
+                p_log->stats.lost += p_chunk->count;
+        }
+
+        p_chunk->count = 0;
+
+        return result;
+}
+
+/*!
+ * @brief Erase the next sector and write its header
+ *
+ * If it fails, the log stays in the current sector, so the next write tries
+ * again with the same sector
+ *
+ * @param[in,out]       p_log               Pointer to the log instance
+ *
+ * @return              sample_log_error_t  Operation result
+ */
+static sample_log_error_t start_sector(sample_log_t * const p_log)
+{
+        sample_log_error_t result = SAMPLE_LOG_ERROR_SUCCESS;
+        sector_header_t header;
+        uint32_t sequence = 0;
+        uint32_t address;
+
+        if (p_log->has_head) {
+                sequence = p_log->head_sequence + 1;
+        }
+
+        address = sector_address(p_log, sequence);
+
+        memset(&header, 0xFF, sizeof(header));
+        header.magic = SECTOR_MAGIC;
+        header.sequence = sequence;
+        header.boot = p_log->boot;
+        header.crc = crc32_update(CRC32_INITIAL_VALUE,
+                                  &header,
+                                  SECTOR_HEADER_CRC_SIZE);
+
+        if (!p_log->flash.erase_func(p_log->flash.p_context,
+                                     address,
+                                     p_log->flash.sector_size)) {
+                result = SAMPLE_LOG_ERROR_IO_ERROR;
+        } else {
+                ++p_log->stats.sectors_erased;
+
+                if (!p_log->flash.write_func(p_log->flash.p_context,
+                                             address,
+                                             &header,
+                                             SECTOR_HEADER_SIZE)) {
+                        result = SAMPLE_LOG_ERROR_IO_ERROR;
+                }
+        }
+
+        if (SAMPLE_LOG_ERROR_SUCCESS == result) {
+                p_log->stats.bytes_written += SECTOR_HEADER_SIZE;
+                p_log->has_head = true;
+                p_log->head_sequence = sequence;
+                p_log->head_offset = SECTOR_HEADER_SIZE;
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Get the flash address of a sector
+ *
+ * @param[in]           p_log               Pointer to the log instance
+ * @param[in]           sequence            Sequence number of the sector
+ *
+ * @return              uint32_t            Address of the sector
+ */
+static uint32_t sector_address(sample_log_t const * const p_log,
+                               uint32_t const sequence)
+{
+        return (sequence % p_log->sector_count) * p_log->flash.sector_size;
+}
+
+/*!
+ * @brief Update a CRC-32 with a buffer
+ *
+ * Half a byte at a time, trading some speed for a 64 bytes table
+ *
+ * @param[in]           crc                 CRC so far, or
+ *                                          `CRC32_INITIAL_VALUE` to start
+ * @param[in]           p_buffer            Pointer to the data
+ * @param[in]           size                Size of the data
+ *
+ * @return              uint32_t            Updated CRC
+ */
+static uint32_t crc32_update(uint32_t crc,
+                             void const * const p_buffer,
+                             size_t const size)
+{
+        uint8_t const * const p_bytes = p_buffer;
+        size_t i;
+
+        for (i = 0; size > i; ++i) {
+                crc ^= p_bytes[i];
+                crc = (crc >> 4) ^ m_crc32_table[crc & 0x0F];
+                crc = (crc >> 4) ^ m_crc32_table[crc & 0x0F];
+        }
+
+        return crc;
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
@@ -0,0 +1,273 @@
+/*!
+ *******************************************************************************
+ * @file sample_log.h
+ *
+ * @brief Append-only log of readings in a raw flash area
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+//! @brief Maximum amount of readings written to flash at once
+#define SAMPLE_LOG_MAX_BATCH_SIZE           (64)
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Different operation results thrown by the module
+typedef enum {
+        SAMPLE_LOG_ERROR_SUCCESS = 0,
+        SAMPLE_LOG_ERROR_ALREADY_INITIALIZED,
+        SAMPLE_LOG_ERROR_NOT_INITIALIZED,
+        SAMPLE_LOG_ERROR_BAD_PARAMETER,
+        SAMPLE_LOG_ERROR_IO_ERROR,
+        SAMPLE_LOG_ERROR_END_OF_LOG,
+        SAMPLE_LOG_ERROR_COUNT,
+} sample_log_error_t;
+
+/*!
+ * @brief Flash read function prototype
+ *
+ * @param[in]           p_context           Context registered together with
+ *                                          the function
+ * @param[in]           offset              Offset within the flash area
+ * @param[out]          p_buffer            Pointer where to read the data to
+ * @param[in]           size                Amount of bytes to read
+ *
+ * @return              bool                Operation result
+ */
+typedef bool (*sample_log_read_func)(void * const p_context,
+                                     uint32_t const offset,
+                                     void * const p_buffer,
+                                     size_t const size);
+
+/*!
+ * @brief Flash write function prototype
+ *
+ * As on NOR flash, writing can only clear bits, so only erased bytes are
+ * written
+ *
+ * @param[in]           p_context           Context registered together with
+ *                                          the function
+ * @param[in]           offset              Offset within the flash area
+ * @param[in]           p_buffer            Pointer to the data to write
+ * @param[in]           size                Amount of bytes to write
+ *
+ * @return              bool                Operation result
+ */
+typedef bool (*sample_log_write_func)(void * const p_context,
+                                      uint32_t const offset,
+                                      void const * const p_buffer,
+                                      size_t const size);
+
+/*!
+ * @brief Flash erase function prototype
+ *
+ * Sets all bytes of the range to 0xFF
+ *
+ * @param[in]           p_context           Context registered together with
+ *                                          the function
+ * @param[in]           offset              Offset within the flash area, sector
+ *                                          aligned
+ * @param[in]           size                Amount of bytes to erase, multiple
+ *                                          of the sector size
+ *
+ * @return              bool                Operation result
+ */
+typedef bool (*sample_log_erase_func)(void * const p_context,
+                                      uint32_t const offset,
+                                      size_t const size);
+
+//! @brief Flash area holding the log
+typedef struct {
+        //! @brief Read function
+        sample_log_read_func read_func;
+
+        //! @brief Write function
+        sample_log_write_func write_func;
+
+        //! @brief Erase function
+        sample_log_erase_func erase_func;
+
+        //! @brief Context passed to the functions
+        void * p_context;
+
+        //! @brief Size of the area (in bytes, multiple of `sector_size`)
+        uint32_t size;
+
+        //! @brief Size of the erase unit (in bytes)
+        uint32_t sector_size;
+} sample_log_flash_t;
+
+//! @brief Logged reading, as stored in flash
+typedef struct {
+        //! @brief Time of the reading (in seconds since boot)
+        uint32_t time_s;
+
+        //! @brief CO2 concentration (in ppm)
+        uint16_t co2_ppm;
+
+        //! @brief Index of the sensor the reading comes from
+        uint8_t sensor;
+
+        //! @brief Boot the reading was taken in, wrapping around
+        uint8_t boot;
+} sample_log_record_t;
+
+/*!
+ * @brief Batch of readings, as stored in flash
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Amount of readings, 0xFFFF if the chunk isn't written yet
+        uint16_t count;
+
+        //! @brief Boot the chunk was written in
+        uint8_t boot;
+
+        //! @brief Not used, 0xFF
+        uint8_t reserved;
+
+        //! @brief CRC-32 of the members above and the readings
+        uint32_t crc;
+
+        //! @brief Readings
+        sample_log_record_t records[SAMPLE_LOG_MAX_BATCH_SIZE];
+} sample_log_chunk_t;
+
+//! @brief Position of a reader within the log
+typedef struct {
+        //! @brief Sequence number of the sector
+        uint32_t sector_sequence;
+
+        //! @brief Offset of the chunk within the sector
+        uint32_t offset;
+
+        //! @brief Index of the reading within the chunk
+        uint16_t index;
+
+        //! @brief Amount of readings of the chunk, once checked
+        uint16_t count;
+} sample_log_cursor_t;
+
+//! @brief Log statistics since initialization
+typedef struct {
+        //! @brief Readings appended
+        uint32_t appended;
+
+        //! @brief Chunks written
+        uint32_t chunks_written;
+
+        //! @brief Bytes written, headers included
+        uint32_t bytes_written;
+
+        //! @brief Sectors erased
+        uint32_t sectors_erased;
+
+        //! @brief Chunks found corrupted
+        uint32_t bad_chunks;
+
+        //! @brief Readings lost because of write failures
+        uint32_t lost;
+} sample_log_stats_t;
+
+/*!
+ * @brief Log instance
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Whether the instance is initialized or not
+        bool is_initialized;
+
+        //! @brief Flash area holding the log
+        sample_log_flash_t flash;
+
+        //! @brief Amount of sectors of the area
+        uint32_t sector_count;
+
+        //! @brief Readings written to flash at once
+        size_t batch_size;
+
+        //! @brief Whether any sector has been written yet
+        bool has_head;
+
+        //! @brief Sequence number of the sector being written
+        uint32_t head_sequence;
+
+        //! @brief Offset of the next chunk within the sector being written
+        uint32_t head_offset;
+
+        //! @brief Boot counter, taken from the newest chunk on recovery
+        uint8_t boot;
+
+        //! @brief Chunk being filled, written once full
+        sample_log_chunk_t chunk;
+
+        //! @brief Statistics since initialization
+        sample_log_stats_t stats;
+} sample_log_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize the log, recovering its write position
+sample_log_error_t sample_log_init(sample_log_t * const p_log,
+                                   sample_log_flash_t const * const p_flash,
+                                   size_t const batch_size);
+
+//! @brief Append a reading
+sample_log_error_t sample_log_append(sample_log_t * const p_log,
+                                     sample_log_record_t const * const p_record);
+
+//! @brief Write the readings appended so far, even if the batch isn't full
+sample_log_error_t sample_log_flush(sample_log_t * const p_log);
+
+//! @brief Get the next written reading after a cursor
+sample_log_error_t sample_log_read_next(sample_log_t * const p_log,
+                                        sample_log_cursor_t * const p_cursor,
+                                        sample_log_record_t * const p_record);
+
+//! @brief Get the log statistics
+sample_log_error_t sample_log_get_stats(sample_log_t const * const p_log,
+                                        sample_log_stats_t * const p_stats);
+
+//! @brief Get the boot counter the readings of this boot are logged with
+sample_log_error_t sample_log_get_boot(sample_log_t const * const p_log,
+                                       uint8_t * const p_boot);
+
+#endif //SAMPLE_LOG_H
@@ -0,0 +1,238 @@
+/*!
+ *******************************************************************************
+ * @file sampling_scheduler.c
+ *
+ * @brief Adaptive sampling period driven by the CO2 rate of change
+ *
+ * Each new sample is compared against the previous one. While the rate of
+ * change is fast, the shortest period is used. Once it slows down below half
+ * of the fast rate, the period is doubled on every sample until it reaches
+ * the longest one. In between, the period is kept, so readings hovering
+ * around the limit don't make it oscillate.
+ *
+ * A single fast sample brings the period back to the shortest one, so a
+ * transient is caught at most one long period after it started.
+ *
+ * It doesn't depend on any framework, so it builds for the target as well as
+ * for a Linux host.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "sampling_scheduler.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+#define MS_PER_MINUTE                       (60 * 1000)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Rate of change between the last sample and a new one
+static uint32_t rate_ppm_per_min(sampling_scheduler_t const * const p_scheduler,
+                                 uint32_t const ppm,
+                                 uint32_t const time_ms);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize a scheduler instance
+ *
+ * The scheduler starts with the shortest period, until the first samples tell
+ * how fast CO2 is changing.
+ *
+ * @param[out]          p_scheduler         Pointer to the scheduler instance
+ * @param[in]           p_config            Pointer to the configuration
+ *
+ * @return              bool                Operation result, fails if the
+ *                                          periods are zero or swapped
+ */
+bool sampling_scheduler_init(sampling_scheduler_t * const p_scheduler,
+                             sampling_scheduler_config_t const * const p_config)
+{
+        bool success = ((NULL != p_scheduler) &&
+                        (NULL != p_config) &&
+                        (0 != p_config->min_period_ms) &&
+                        (p_config->min_period_ms <= p_config->max_period_ms));
+
+        if (success) {
+                memset(p_scheduler, 0, sizeof(*p_scheduler));
+                p_scheduler->config = *p_config;
+                p_scheduler->period_ms = p_config->min_period_ms;
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Feed a new sample to the scheduler
+ *
+ * @param[in,out]       p_scheduler         Pointer to the scheduler instance
+ * @param[in]           ppm                 Sampled concentration (in ppm)
+ * @param[in]           time_ms             Sample time (in milliseconds,
+ *                                          wrapping around is fine)
+ *
+ * @return              uint32_t            Period until the next sample (in
+ *                                          milliseconds)
+ */
+uint32_t sampling_scheduler_update(sampling_scheduler_t * const p_scheduler,
+                                   uint32_t const ppm,
+                                   uint32_t const time_ms)
+{
+        sampling_scheduler_config_t const * p_config;
+        uint32_t rate;
+
+        if (NULL == p_scheduler) {
+                // Code style exception for the shake of readability
+                return 0;
+        }
+
+        p_config = &p_scheduler->config;
+
+        if (p_scheduler->has_last_sample) {
+                rate = rate_ppm_per_min(p_scheduler, ppm, time_ms);
+
+                if (rate >= p_config->fast_rate_ppm_per_min) {
+                        p_scheduler->period_ms = p_config->min_period_ms;
+
+                } else if ((2 * rate) < p_config->fast_rate_ppm_per_min) {
+                        p_scheduler->period_ms *= 2;
+
+                        if (p_scheduler->period_ms > p_config->max_period_ms) {
+                                p_scheduler->period_ms = p_config->max_period_ms;
+                        }
+                }
+        }
+
+        p_scheduler->last_ppm = ppm;
+        p_scheduler->last_time_ms = time_ms;
+        p_scheduler->has_last_sample = true;
+
+        return p_scheduler->period_ms;
+}
+
+/*!
+ * @brief Get the current sampling period
+ *
+ * @param[in]           p_scheduler         Pointer to the scheduler instance
+ *
+ * @return              uint32_t            Current period (in milliseconds)
+ */
+uint32_t sampling_scheduler_get_period(
+                sampling_scheduler_t const * const p_scheduler)
+{
+        uint32_t period_ms = 0;
+
+        if (NULL != p_scheduler) {
+                period_ms = p_scheduler->period_ms;
+        }
+
+        return period_ms;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Rate of change between the last sample and a new one
+ *
+ * Changes within the configured noise are considered no change at all
+ *
+ * @param[in]           p_scheduler         Pointer to the scheduler instance
+ * @param[in]           ppm                 New concentration (in ppm)
+ * @param[in]           time_ms             New sample time (in milliseconds)
+ *
+ * @return              uint32_t            Rate of change (in ppm per minute)
+ */
+static uint32_t rate_ppm_per_min(sampling_scheduler_t const * const p_scheduler,
+                                 uint32_t const ppm,
+                                 uint32_t const time_ms)
+{
+        // Overflow is meant to happen
+        uint32_t elapsed_ms = time_ms - p_scheduler->last_time_ms;
+        uint64_t rate;
+        uint32_t delta;
+
+        if (ppm > p_scheduler->last_ppm) {
+                delta = ppm - p_scheduler->last_ppm;
+        } else {
+                delta = p_scheduler->last_ppm - ppm;
+        }
+
+        if (delta <= p_scheduler->config.noise_ppm) {
+                delta = 0;
+        }
+
+        if (0 == elapsed_ms) {
+                elapsed_ms = 1;
+        }
+
+        rate = ((uint64_t)delta * MS_PER_MINUTE) / elapsed_ms;
+
+        if (UINT32_MAX < rate) {
+                rate = UINT32_MAX;
+        }
+
+        return (uint32_t)rate;
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
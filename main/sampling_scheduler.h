@@ -0,0 +1,100 @@
+/*!
+ *******************************************************************************
+ * @file sampling_scheduler.h
+ *
+ * @brief Adaptive sampling period driven by the CO2 rate of change
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef SAMPLING_SCHEDULER_H
+#define SAMPLING_SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Scheduler configuration
+typedef struct {
+        //! @brief Period used while CO2 changes fast (in milliseconds)
+        uint32_t min_period_ms;
+
+        //! @brief Period used while CO2 is stable (in milliseconds)
+        uint32_t max_period_ms;
+
+        //! @brief Rate of change considered fast (in ppm per minute)
+        uint32_t fast_rate_ppm_per_min;
+
+        //! @brief Changes between samples ignored as sensor noise (in ppm)
+        uint32_t noise_ppm;
+} sampling_scheduler_config_t;
+
+/*!
+ * @brief Scheduler instance
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Scheduler configuration
+        sampling_scheduler_config_t config;
+
+        //! @brief Current sampling period (in milliseconds)
+        uint32_t period_ms;
+
+        //! @brief Whether `last_ppm` and `last_time_ms` hold a sample
+        bool has_last_sample;
+
+        //! @brief Concentration of the last sample (in ppm)
+        uint32_t last_ppm;
+
+        //! @brief Time of the last sample (in milliseconds)
+        uint32_t last_time_ms;
+} sampling_scheduler_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize a scheduler instance
+bool sampling_scheduler_init(sampling_scheduler_t * const p_scheduler,
+                             sampling_scheduler_config_t const * const p_config);
+
+//! @brief Feed a new sample to the scheduler
+uint32_t sampling_scheduler_update(sampling_scheduler_t * const p_scheduler,
+                                   uint32_t const ppm,
+                                   uint32_t const time_ms);
+
+//! @brief Get the current sampling period
+uint32_t sampling_scheduler_get_period(
+                sampling_scheduler_t const * const p_scheduler);
+
+#endif //SAMPLING_SCHEDULER_H
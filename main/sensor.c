@@ -24,14 +24,19 @@
 #include <string.h>
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_http_client.h"
 #include "driver/uart.h"
 #include "winsen_mh_z19.h"
-#include "freertos/semphr.h"
+#include "winsen_mh_z19_emulator.h"
 #include "tasks_config.h"
+#include "sensor_uart.h"
+#include "sampling_scheduler.h"
+#include "co2_filter.h"
+#include "device_state.h"
+#include "sample_bus.h"
+#include "alarm.h"
 
-#include "http.h"
-#include "display.h"
 #include "wifi.h"
 #include "main.h"
 
@@ -45,9 +50,22 @@
 
 #define TAG                                 "sensor"
 
-#define TASK_REFRESH_RATE_TICKS             (pdMS_TO_TICKS(TASKS_CONFIG_SENSOR_REFRESH_RATE_MS))
 #define TASK_STACK_DEPTH                    TASKS_CONFIG_SENSOR_STACK_DEPTH
 #define TASK_PRIORITY                       TASKS_CONFIG_SENSOR_PRIORITY
+#define TASK_STATS_RATE_TICKS               (pdMS_TO_TICKS(TASKS_CONFIG_SENSOR_STATS_RATE_MS))
+
+#define SENSOR_BAUD_RATE                    (9600)
+
+#define SAMPLING_MIN_PERIOD_MS              (CONFIG_CO2_MONITOR_SAMPLING_MIN_PERIOD_S * 1000)
+#define SAMPLING_MAX_PERIOD_MS              (CONFIG_CO2_MONITOR_SAMPLING_MAX_PERIOD_S * 1000)
+#define SAMPLING_FAST_RATE_PPM_PER_MIN      (CONFIG_CO2_MONITOR_SAMPLING_FAST_RATE_PPM_PER_MIN)
+#define SAMPLING_NOISE_PPM                  (CONFIG_CO2_MONITOR_SAMPLING_NOISE_PPM)
+#define SAMPLING_BACKGROUND_PERIOD_MS       (CONFIG_CO2_MONITOR_SAMPLING_BACKGROUND_PERIOD_S * 1000)
+
+#define FILTER_MEDIAN_SIZE                  (CONFIG_CO2_MONITOR_FILTER_MEDIAN_SIZE)
+#define FILTER_EMA_SHIFT                    (CONFIG_CO2_MONITOR_FILTER_EMA_SHIFT)
+#define FILTER_MAX_GAP_MS                   (SAMPLING_MAX_PERIOD_MS + SAMPLING_MIN_PERIOD_MS)
+
 
 /*
  *******************************************************************************
@@ -61,6 +79,8 @@
  *******************************************************************************
  */
 
+//! @brief Depth of the request queue
+static UBaseType_t const m_request_queue_size = 4;
 
 /*
  *******************************************************************************
@@ -71,14 +91,54 @@
 //! @brief Sensor task
 _Noreturn static void sensor_task(void *pvParameter);
 
-//! @brief Module mutex lock
-static inline bool sensor_lock(bool lock);
+//! @brief Initialize the transport used to talk to a sensor
+static bool transport_init(size_t const index,
+                           mh_z19_xfer_func * const p_xfer,
+                           void ** const pp_xfer_context);
+
+//! @brief Time function used to time the sensor transactions
+static uint32_t time_us(void);
+
+//! @brief Log the statistics of every sensor
+static void report_stats(void);
+
+//! @brief Transaction time below which a share of the transactions fall
+static uint32_t histogram_percentile_ms(uint32_t const * const p_histogram,
+                                        uint32_t const percent);
+
+//! @brief Read all the sensors, overlapping their transfers
+static void read_sensors(mh_z19_measurement_t * const p_measurements,
+                         mh_z19_error_t * const p_results);
 
+//! @brief Read all the sensors and publish their readings
+static mh_z19_error_t read_and_publish(
+                mh_z19_measurement_t * const p_measurements,
+                mh_z19_error_t * const p_results);
+
+//! @brief Periodic read, returns the time until the next one
+static TickType_t periodic_read(void);
+
+//! @brief Serve a request and report its completion
+static void serve_request(sensor_request_t const * const p_request);
+
+//! @brief Perform a configuration request on a single sensor
+static mh_z19_error_t configure_sensor(sensor_request_t const * const p_request,
+                                       size_t const index);
+
+//! @brief Whether anybody is interested in the sensor readings
+static bool is_output_needed(void);
+
+#ifdef CONFIG_CO2_MONITOR_SENSOR_EMULATOR
+//! @brief Delay function for the emulated sensor
+static void emulator_delay(uint32_t const delay_ms);
+#else
 //! @brief UART transfer function for esp32
-static mh_z19_error_t xfer_func(uint8_t const * const p_rx_buffer,
+static mh_z19_error_t xfer_func(void * const p_context,
+                                uint8_t * const p_rx_buffer,
                                 size_t const rx_buffer_size,
-                                uint8_t * const p_tx_buffer,
+                                uint8_t const * const p_tx_buffer,
                                 size_t const tx_buffer_size);
+#endif
 
 /*
  *******************************************************************************
@@ -89,29 +149,61 @@ static mh_z19_error_t xfer_func(uint8_t const * const p_rx_buffer,
 //! @brief Handler for the module's task
 TaskHandle_t sensor_task_h = NULL;
 
-//! @brief Handler for the display module queue
-extern xQueueHandle display_q;
-
-//! @brief Handler for the http module queue
-extern xQueueHandle http_q;
-
 /*
  *******************************************************************************
  * Static Data Declarations                                                    *
  *******************************************************************************
  */
 
-//! @brief UART instance used by this module
-static uart_port_t const m_uart_instance = UART_NUM_2;
-
-//! @brief UART TX gpio used by this module
-static int const m_uart_tx_pin = 33;
-
-//! @brief UART RX gpio used by this module
-static int const m_uart_rx_pin = 32;
-
-//! @brief Handle for the UART mutex used by this module
-static QueueHandle_t m_uart_mutex_q = NULL;
+//! @brief Driver instance of each sensor
+static mh_z19_t m_sensors[SENSOR_COUNT];
+
+#ifdef CONFIG_CO2_MONITOR_SENSOR_EMULATOR
+//! @brief Emulated sensors, one per driver instance
+static mh_z19_emulator_t m_emulators[SENSOR_COUNT];
+#else
+//! @brief UART peripheral and gpios of each sensor
+static sensor_uart_config_t const m_uart_configs[SENSOR_COUNT] = {
+                {
+                                .port = CONFIG_CO2_MONITOR_SENSOR_1_UART,
+                                .tx_pin = CONFIG_CO2_MONITOR_SENSOR_1_TX_PIN,
+                                .rx_pin = CONFIG_CO2_MONITOR_SENSOR_1_RX_PIN,
+                                .baud_rate = SENSOR_BAUD_RATE,
+                },
+#if (1 < SENSOR_COUNT)
+                {
+                                .port = CONFIG_CO2_MONITOR_SENSOR_2_UART,
+                                .tx_pin = CONFIG_CO2_MONITOR_SENSOR_2_TX_PIN,
+                                .rx_pin = CONFIG_CO2_MONITOR_SENSOR_2_RX_PIN,
+                                .baud_rate = SENSOR_BAUD_RATE,
+                },
+#endif
+#if (2 < SENSOR_COUNT)
+                {
+                                .port = CONFIG_CO2_MONITOR_SENSOR_3_UART,
+                                .tx_pin = CONFIG_CO2_MONITOR_SENSOR_3_TX_PIN,
+                                .rx_pin = CONFIG_CO2_MONITOR_SENSOR_3_RX_PIN,
+                                .baud_rate = SENSOR_BAUD_RATE,
+                },
+#endif
+};
+
+//! @brief Event driven UART transports, one per driver instance
+static sensor_uart_t m_sensor_uarts[SENSOR_COUNT];
+#endif
+
+//! @brief Sampling scheduler of each sensor
+static sampling_scheduler_t m_schedulers[SENSOR_COUNT];
+
+//! @brief Reading filter of each sensor
+static co2_filter_t m_filters[SENSOR_COUNT];
+
+//! @brief Queue of requests to be served by the sensor task
+static QueueHandle_t m_request_q = NULL;
+
+//! @brief Sensors which didn't confirm the automatic baseline correction off,
+//!        and may drift, so they are reported as degraded
+static bool m_is_abc_unconfirmed[SENSOR_COUNT];
 
 /*
  *******************************************************************************
@@ -122,77 +214,86 @@ static QueueHandle_t m_uart_mutex_q = NULL;
 /*!
  * @brief Initialize the sensor module
  *
- * This function initializes the needed hardware peripherals (UART), the sensor
- * driver and the corresponding module task
+ * This function initializes the needed hardware peripherals (one UART per
+ * sensor), a driver instance for each sensor and the corresponding module task
+ *
+ * From then on the sensors are owned by the module task, and any other module
+ * has to go through `sensor_submit` to use them.
  *
  * @return              bool                Operation result
  */
 bool sensor_init(void) {
 
-        uart_config_t const uart_config = {
-                        .baud_rate = 9600,
-                        .data_bits = UART_DATA_8_BITS,
-                        .parity = UART_PARITY_DISABLE,
-                        .stop_bits = UART_STOP_BITS_1,
-                        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        bool success = true;
+
+        sampling_scheduler_config_t const scheduler_config = {
+                        .min_period_ms = SAMPLING_MIN_PERIOD_MS,
+                        .max_period_ms = SAMPLING_MAX_PERIOD_MS,
+                        .fast_rate_ppm_per_min = SAMPLING_FAST_RATE_PPM_PER_MIN,
+                        .noise_ppm = SAMPLING_NOISE_PPM,
         };
 
-        int const uart_buffer_size = (1024 * 2);
-        bool success = true;
+        co2_filter_config_t const filter_config = {
+                        .median_size = FILTER_MEDIAN_SIZE,
+                        .ema_shift = FILTER_EMA_SHIFT,
+                        .max_gap_ms = FILTER_MAX_GAP_MS,
+        };
 
-        esp_err_t esp_result;
-        QueueHandle_t uart_queue;
         BaseType_t task_result;
         mh_z19_error_t mh_z19_result;
+        mh_z19_xfer_func xfer;
+        void * p_xfer_context;
+        size_t i;
 
-        esp_result = uart_set_pin(
-                        m_uart_instance,
-                        m_uart_tx_pin,
-                        m_uart_rx_pin,
-                        UART_PIN_NO_CHANGE,
-                        UART_PIN_NO_CHANGE);
-
-        success = (ESP_OK == esp_result);
-
-        if (success) {
-                esp_result = uart_param_config(m_uart_instance, &uart_config);
-
-                success = (ESP_OK == esp_result);
+        for (i = 0; (success) && (SENSOR_COUNT > i); ++i) {
+                success = sampling_scheduler_init(&m_schedulers[i],
+                                                  &scheduler_config);
         }
 
-        if (success) {
-                esp_result = uart_driver_install(
-                                m_uart_instance,
-                                uart_buffer_size,
-                                uart_buffer_size,
-                                10,
-                                &uart_queue,
-                                0);
-
-                success = (ESP_OK == esp_result);
+        for (i = 0; (success) && (SENSOR_COUNT > i); ++i) {
+                success = co2_filter_init(&m_filters[i], &filter_config);
         }
 
-        if (success) {
-                mh_z19_result = mh_z19_init(xfer_func);
+        for (i = 0; (success) && (SENSOR_COUNT > i); ++i) {
+                success = transport_init(i, &xfer, &p_xfer_context);
 
-                success = (MH_Z19_ERROR_SUCCESS == mh_z19_result);
-        }
+                if (success) {
+                        mh_z19_result = mh_z19_init(&m_sensors[i],
+                                                    xfer,
+                                                    p_xfer_context);
 
-        if (success) {
-                m_uart_mutex_q = xSemaphoreCreateMutex();
+                        success = (MH_Z19_ERROR_SUCCESS == mh_z19_result);
+                }
+
+                if (success) {
+                        mh_z19_result = mh_z19_set_time_func(&m_sensors[i],
+                                                             time_us);
 
-                success = (NULL != m_uart_mutex_q);
+                        success = (MH_Z19_ERROR_SUCCESS == mh_z19_result);
+                }
         }
 
-        if (success) {
+        // The module task doesn't exist yet, so the sensors can be used here.
+        // A sensor that doesn't answer is still read, as it may come back
+        for (i = 0; (success) && (SENSOR_COUNT > i); ++i) {
+                mh_z19_result = mh_z19_enable_abc(&m_sensors[i], false);
 
-                (void)sensor_lock(true);
+                m_is_abc_unconfirmed[i] =
+                                (MH_Z19_ERROR_SUCCESS != mh_z19_result);
 
-                mh_z19_result = mh_z19_enable_abc(false);
+                if (m_is_abc_unconfirmed[i]) {
+                        ESP_LOGW(TAG, "Sensor %d: ABC off not confirmed (%d), "
+                                      "degraded",
+                                 (int)i + 1,
+                                 mh_z19_result);
+                }
+        }
 
-                (void)sensor_lock(false);
+        if (success) {
+                m_request_q = xQueueCreate(m_request_queue_size,
+                                           sizeof(sensor_request_t));
 
-                success = (MH_Z19_ERROR_SUCCESS == mh_z19_result);
+                success = (NULL != m_request_q);
         }
 
         if (success) {
@@ -209,6 +310,82 @@ bool sensor_init(void) {
         return success;
 }
 
+/*!
+ * @brief Submit a request to the sensor task
+ *
+ * Requests are served one at a time, in between the periodic reads. High
+ * priority requests jump ahead of the already queued ones, by being sent to
+ * the front of the queue, so several of them are served the latest first.
+ * Only submit requests as high priority if their order doesn't matter. The
+ * request is copied, so it doesn't need to outlive this call.
+ *
+ * @param[in]           p_request           Pointer to the request
+ * @param[in]           priority            Request priority
+ *
+ * @return              bool                Whether the request was queued
+ */
+bool sensor_submit(sensor_request_t const * const p_request,
+                   sensor_priority_t const priority)
+{
+        BaseType_t queue_result;
+        bool success = ((NULL != m_request_q) &&
+                        (NULL != p_request) &&
+                        (SENSOR_REQUEST_COUNT > p_request->type));
+
+        if ((success) && (SENSOR_PRIORITY_HIGH == priority)) {
+                queue_result = xQueueSendToFront(m_request_q, p_request, 0);
+                success = (pdTRUE == queue_result);
+
+        } else if (success) {
+                queue_result = xQueueSendToBack(m_request_q, p_request, 0);
+                success = (pdTRUE == queue_result);
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Submit a request to the sensor task from an ISR
+ *
+ * Same as `sensor_submit`, but safe to be called from an interrupt
+ *
+ * @param[in]           p_request           Pointer to the request
+ * @param[in]           priority            Request priority
+ * @param[out]          p_higher_priority_task_woken
+ *                                          Set to `pdTRUE` if a context switch
+ *                                          is needed before leaving the ISR
+ *                                          (can be null)
+ *
+ * @return              bool                Whether the request was queued
+ */
+bool sensor_submit_from_isr(sensor_request_t const * const p_request,
+                            sensor_priority_t const priority,
+                            BaseType_t * const p_higher_priority_task_woken)
+{
+        BaseType_t queue_result;
+        bool success = ((NULL != m_request_q) &&
+                        (NULL != p_request) &&
+                        (SENSOR_REQUEST_COUNT > p_request->type));
+
+        if ((success) && (SENSOR_PRIORITY_HIGH == priority)) {
+                queue_result = xQueueSendToFrontFromISR(
+                                m_request_q,
+                                p_request,
+                                p_higher_priority_task_woken);
+
+                success = (pdTRUE == queue_result);
+
+        } else if (success) {
+                queue_result = xQueueSendToBackFromISR(
+                                m_request_q,
+                                p_request,
+                                p_higher_priority_task_woken);
+
+                success = (pdTRUE == queue_result);
+        }
+
+        return success;
+}
 
 /*
  *******************************************************************************
@@ -217,35 +394,451 @@ bool sensor_init(void) {
  */
 
 /*!
- * @brief Module mutex lock
+ * @brief Initialize the transport used to talk to a sensor
  *
- * Used to lock whatever needed by this module (basically, UART access)
+ * Depending on the application configuration, the transport is either the
+ * sensor's own UART peripheral or an emulated sensor. The emulated sensor
+ * behaviour is taken from the `Sensor emulator` menu.
  *
- * @param[in]           lock                Whether it needs to be locked our
- *                                          unlocked
+ * @param[in]           index               Index of the sensor
+ * @param[out]          p_xfer              Transfer function of the transport
+ * @param[out]          pp_xfer_context     Context to pass to `p_xfer`
  *
  * @return              bool                Operation result
  */
-static inline bool sensor_lock(bool lock)
+static bool transport_init(size_t const index,
+                           mh_z19_xfer_func * const p_xfer,
+                           void ** const pp_xfer_context)
+{
+#ifdef CONFIG_CO2_MONITOR_SENSOR_EMULATOR
+        mh_z19_emulator_config_t const config = {
+                        .response_latency_ms = CONFIG_CO2_MONITOR_SENSOR_EMULATOR_LATENCY_MS,
+                        .latency_jitter_ms = CONFIG_CO2_MONITOR_SENSOR_EMULATOR_JITTER_MS,
+                        .concentration_ppm = CONFIG_CO2_MONITOR_SENSOR_EMULATOR_CONCENTRATION_PPM,
+                        .noise_ppm = CONFIG_CO2_MONITOR_SENSOR_EMULATOR_NOISE_PPM,
+                        .temperature_c = 25,
+                        .status = 0,
+                        .drop_byte_percent = CONFIG_CO2_MONITOR_SENSOR_EMULATOR_DROP_BYTE_PERCENT,
+                        .bad_checksum_percent = CONFIG_CO2_MONITOR_SENSOR_EMULATOR_BAD_CHECKSUM_PERCENT,
+                        .seed = 0x2022U + (uint32_t)index,
+        };
+
+        mh_z19_error_t mh_z19_result;
+
+        mh_z19_result = mh_z19_emulator_init(&m_emulators[index],
+                                             &config,
+                                             emulator_delay);
+
+        *p_xfer = mh_z19_emulator_xfer;
+        *pp_xfer_context = &m_emulators[index];
+
+        ESP_LOGW(TAG, "Using emulated sensor %d", (int)index + 1);
+
+        return (MH_Z19_ERROR_SUCCESS == mh_z19_result);
+#else
+        *p_xfer = xfer_func;
+        *pp_xfer_context = &m_sensor_uarts[index];
+
+        return sensor_uart_init(&m_sensor_uarts[index], &m_uart_configs[index]);
+#endif
+}
+
+/*!
+ * @brief Time function used to time the sensor transactions
+ *
+ * @return              uint32_t            Time since boot, in microseconds
+ */
+static uint32_t time_us(void)
+{
+        return (uint32_t)esp_timer_get_time();
+}
+
+/*!
+ * @brief Log the statistics of every sensor
+ *
+ * Driver statistics tell whether the sensor answers and how fast, transport
+ * statistics (not available for emulated sensors) whether the UART line is
+ * healthy. Sensors which didn't confirm the ABC off at start up are reported
+ * as degraded.
+ *
+ * @return              -                   -
+ */
+static void report_stats(void)
+{
+        mh_z19_stats_t stats;
+        uint32_t const * p_bins;
+        size_t i;
+#ifndef CONFIG_CO2_MONITOR_SENSOR_EMULATOR
+        sensor_uart_stats_t uart_stats;
+#endif
+
+        for (i = 0; SENSOR_COUNT > i; ++i) {
+
+                if (MH_Z19_ERROR_SUCCESS != mh_z19_get_stats(&m_sensors[i],
+                                                             &stats)) {
+                        // Code style exception for the shake of readability
+                        continue;
+                }
+
+                p_bins = stats.time_histogram;
+
+                if (m_is_abc_unconfirmed[i]) {
+                        ESP_LOGW(TAG, "Sensor %d: degraded, ABC off not "
+                                      "confirmed",
+                                 (int)i + 1);
+                }
+
+                ESP_LOGI(TAG, "Sensor %d: %d transactions, %d ok, %d timeouts, "
+                              "%d I/O errors, %d bad replies, %d nacks",
+                         (int)i + 1,
+                         stats.transactions,
+                         stats.successes,
+                         stats.timeouts,
+                         stats.io_errors,
+                         stats.bad_replies,
+                         stats.nacks);
+
+                ESP_LOGI(TAG, "Sensor %d: p50 < %d ms, p99 < %d ms, max %d us, "
+                              "histogram %d %d %d %d %d %d %d %d",
+                         (int)i + 1,
+                         histogram_percentile_ms(p_bins, 50),
+                         histogram_percentile_ms(p_bins, 99),
+                         stats.max_time_us,
+                         p_bins[0], p_bins[1], p_bins[2], p_bins[3],
+                         p_bins[4], p_bins[5], p_bins[6], p_bins[7]);
+
+                ESP_LOGI(TAG, "Sensor %d: %d start byte errors, "
+                              "%d checksum errors, %d resyncs",
+                         (int)i + 1,
+                         stats.parser.start_byte_errors,
+                         stats.parser.checksum_errors,
+                         stats.parser.resyncs);
+
+#ifndef CONFIG_CO2_MONITOR_SENSOR_EMULATOR
+                if (sensor_uart_get_stats(&m_sensor_uarts[i], &uart_stats)) {
+                        ESP_LOGI(TAG, "Sensor %d UART: %d frames, %d unclaimed, "
+                                      "%d overflows, %d start byte errors, "
+                                      "%d checksum errors",
+                                 (int)i + 1,
+                                 uart_stats.frames,
+                                 uart_stats.unclaimed_frames,
+                                 uart_stats.overflows,
+                                 uart_stats.parser.start_byte_errors,
+                                 uart_stats.parser.checksum_errors);
+                }
+#endif
+        }
+}
+
+/*!
+ * @brief Transaction time below which a share of the transactions fall
+ *
+ * Resolution is limited to the histogram bin limits. If the share falls in the
+ * last bin, which has no upper limit, its lower limit is returned.
+ *
+ * @param[in]           p_histogram         Transaction time histogram
+ * @param[in]           percent             Share of transactions (in %)
+ *
+ * @return              uint32_t            Time limit (in milliseconds)
+ */
+static uint32_t histogram_percentile_ms(uint32_t const * const p_histogram,
+                                        uint32_t const percent)
+{
+        uint64_t total = 0;
+        uint64_t accumulated = 0;
+        size_t bin;
+
+        for (bin = 0; MH_Z19_STATS_HISTOGRAM_BINS > bin; ++bin) {
+                total += p_histogram[bin];
+        }
+
+        for (bin = 0; (MH_Z19_STATS_HISTOGRAM_BINS - 1) > bin; ++bin) {
+                accumulated += p_histogram[bin];
+
+                if ((accumulated * 100) >= (total * percent)) {
+                        break;
+                }
+        }
+
+        if ((MH_Z19_STATS_HISTOGRAM_BINS - 1) == bin) {
+                --bin;
+        }
+
+        return ((uint32_t)MH_Z19_STATS_HISTOGRAM_BASE_US << bin) / 1000;
+}
+
+/*!
+ * @brief Read all the sensors, overlapping their transfers
+ *
+ * The measurement request is sent to every sensor before collecting any of
+ * the replies, so the sensors answer in parallel and reading all of them takes
+ * about as long as reading one.
+ *
+ * @param[out]          p_measurements      Array of `SENSOR_COUNT` measurements
+ * @param[out]          p_results           Array of `SENSOR_COUNT` results
+ *
+ * @return              -                   -
+ */
+static void read_sensors(mh_z19_measurement_t * const p_measurements,
+                         mh_z19_error_t * const p_results)
+{
+        size_t i;
+
+        for (i = 0; SENSOR_COUNT > i; ++i) {
+                p_results[i] = mh_z19_request_measurement(&m_sensors[i]);
+        }
+
+        for (i = 0; SENSOR_COUNT > i; ++i) {
+                if (MH_Z19_ERROR_SUCCESS == p_results[i]) {
+                        p_results[i] = mh_z19_collect_measurement(
+                                        &m_sensors[i],
+                                        &p_measurements[i]);
+                }
+        }
+}
+
+/*!
+ * @brief Read all the sensors and publish their readings
+ *
+ * Each reading is filtered, stored into the device state and published in the
+ * sample bus, where the interested modules take it from.
+ *
+ * Readings carry both the raw and the filtered concentration, each consumer
+ * picks the stream it is configured for.
+ *
+ * @param[out]          p_measurements      Array of `SENSOR_COUNT` measurements
+ * @param[out]          p_results           Array of `SENSOR_COUNT` results
+ *
+ * @return              mh_z19_error_t      First error found, if any
+ */
+static mh_z19_error_t read_and_publish(
+                mh_z19_measurement_t * const p_measurements,
+                mh_z19_error_t * const p_results)
 {
-        BaseType_t semaphore_result;
+        int64_t const now_us = esp_timer_get_time();
+        uint32_t const now_ms = (uint32_t)(now_us / 1000);
+        uint32_t const now_s = (uint32_t)(now_us / 1000000);
+        mh_z19_error_t result = MH_Z19_ERROR_SUCCESS;
+        sensor_reading_t reading;
+        size_t i;
+
+        read_sensors(p_measurements, p_results);
+
+        for (i = 0; SENSOR_COUNT > i; ++i) {
+
+                if (MH_Z19_ERROR_SUCCESS != p_results[i]) {
+                        ESP_LOGW(TAG, "Sensor %d read failed: %d",
+                                 (int)i + 1,
+                                 p_results[i]);
+
+                        if (MH_Z19_ERROR_SUCCESS == result) {
+                                result = p_results[i];
+                        }
+
+                        // Code style exception for the shake of readability
+                        continue;
+                }
+
+                reading.sensor = (uint8_t)i;
+                reading.co2_ppm[SENSOR_STREAM_RAW] =
+                                p_measurements[i].concentration;
+                reading.co2_ppm[SENSOR_STREAM_FILTERED] =
+                                co2_filter_update(&m_filters[i],
+                                                  p_measurements[i].concentration,
+                                                  now_ms);
+
+                // Device state first, so it's up to date when subscribers run
+                device_state_set_reading(&reading);
+                sample_bus_publish(&reading, now_s);
+
+                ESP_LOGI(TAG,"Sensor %d: CO2 concentration %d ppm "
+                             "(filtered %d ppm), %d ºC%s",
+                         (int)i + 1,
+                         reading.co2_ppm[SENSOR_STREAM_RAW],
+                         reading.co2_ppm[SENSOR_STREAM_FILTERED],
+                         p_measurements[i].temperature,
+                         p_measurements[i].is_preheating ? " (preheating)" : "");
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Periodic read, returns the time until the next one
+ *
+ * Every successful reading is fed to the sensor's sampling scheduler, and the
+ * next read is scheduled after the shortest period among the sensors, so the
+ * fastest changing one sets the pace.
+ *
+ * If nobody is interested in the readings, the next read is scheduled after
+ * the background period instead, to spend as little CPU time as possible while
+ * still feeding the history.
+ *
+ * Either way, while an alarm level change waits for its dwell, the next read
+ * is scheduled after the shortest period at most, as the change is only
+ * confirmed by a reading taken once the dwell is over.
+ *
+ * @return              TickType_t          Time until the next periodic read
+ */
+static TickType_t periodic_read(void)
+{
+        mh_z19_measurement_t measurements[SENSOR_COUNT];
+        mh_z19_error_t results[SENSOR_COUNT];
+        uint32_t const now_ms = (uint32_t)(time_us() / 1000);
+        bool const is_background = !is_output_needed();
+        uint32_t period_ms = UINT32_MAX;
+        uint32_t sensor_period_ms;
+        size_t i;
+
+        (void)read_and_publish(measurements, results);
+
+        for (i = 0; SENSOR_COUNT > i; ++i) {
+                if (MH_Z19_ERROR_SUCCESS == results[i]) {
+                        sensor_period_ms = sampling_scheduler_update(
+                                        &m_schedulers[i],
+                                        measurements[i].concentration,
+                                        now_ms);
+                } else {
+                        sensor_period_ms = sampling_scheduler_get_period(
+                                        &m_schedulers[i]);
+                }
+
+                if (sensor_period_ms < period_ms) {
+                        period_ms = sensor_period_ms;
+                }
+        }
+
+        if (is_background) {
+                period_ms = SAMPLING_BACKGROUND_PERIOD_MS;
+        }
+
+        if ((alarm_is_pending()) && (SAMPLING_MIN_PERIOD_MS < period_ms)) {
+                period_ms = SAMPLING_MIN_PERIOD_MS;
+        }
+
+        return pdMS_TO_TICKS(period_ms);
+}
+
+/*!
+ * @brief Serve a request and report its completion
+ *
+ * @param[in]           p_request           Pointer to the request
+ *
+ * @return              -                   -
+ */
+static void serve_request(sensor_request_t const * const p_request)
+{
+        mh_z19_measurement_t measurements[SENSOR_COUNT];
+        mh_z19_error_t results[SENSOR_COUNT];
+        mh_z19_error_t result = MH_Z19_ERROR_SUCCESS;
+        mh_z19_error_t sensor_result;
+        size_t i;
+
+        if (SENSOR_REQUEST_READ == p_request->type) {
+                result = read_and_publish(measurements, results);
+
+        } else if (SENSOR_ALL == p_request->sensor) {
+                for (i = 0; SENSOR_COUNT > i; ++i) {
+                        sensor_result = configure_sensor(p_request, i);
+
+                        if (MH_Z19_ERROR_SUCCESS == result) {
+                                result = sensor_result;
+                        }
+                }
+
+        } else if (SENSOR_COUNT > p_request->sensor) {
+                result = configure_sensor(p_request, p_request->sensor);
 
-        if (lock) {
-                semaphore_result = xSemaphoreTake(m_uart_mutex_q, portMAX_DELAY);
         } else {
-                semaphore_result = xSemaphoreGive(m_uart_mutex_q);
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+        }
+
+        if (MH_Z19_ERROR_SUCCESS != result) {
+                ESP_LOGW(TAG, "Request %d failed: %d", p_request->type, result);
+        }
+
+        if (NULL != p_request->done_cb) {
+                p_request->done_cb(p_request, result);
+        }
+}
+
+/*!
+ * @brief Perform a configuration request on a single sensor
+ *
+ * @param[in]           p_request           Pointer to the request
+ * @param[in]           index               Index of the sensor
+ *
+ * @return              mh_z19_error_t      Operation result
+ */
+static mh_z19_error_t configure_sensor(sensor_request_t const * const p_request,
+                                       size_t const index)
+{
+        mh_z19_t * const p_sensor = &m_sensors[index];
+        mh_z19_error_t result;
+
+        switch (p_request->type) {
+        case SENSOR_REQUEST_CALIBRATE_ZERO_POINT:
+                result = mh_z19_calibrate_zero_point(p_sensor);
+                break;
+        case SENSOR_REQUEST_CALIBRATE_SPAN_POINT:
+                result = mh_z19_calibrate_span_point(p_sensor,
+                                                     p_request->span_ppm);
+                break;
+        case SENSOR_REQUEST_SET_ABC:
+                result = mh_z19_enable_abc(p_sensor, p_request->abc_enabled);
+                break;
+        case SENSOR_REQUEST_SET_RANGE:
+                result = mh_z19_set_range(p_sensor, p_request->range);
+                break;
+        default:
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+                break;
         }
 
-        return (pdTRUE == semaphore_result);
+        return result;
 }
 
+/*!
+ * @brief Whether anybody is interested in the sensor readings
+ *
+ * @return              bool                True if the display is on or there
+ *                                          is wifi connection
+ */
+static bool is_output_needed(void)
+{
+        device_state_t state;
+
+        device_state_get(&state);
+
+        return ((state.display_enabled) ||
+                (WIFI_STATUS_CONNECTED == state.wifi_status));
+}
+
+#ifdef CONFIG_CO2_MONITOR_SENSOR_EMULATOR
+/*!
+ * @brief Delay function for the emulated sensor
+ *
+ * @param[in]           delay_ms            Time to block, in milliseconds
+ *
+ * @return              -                   -
+ */
+static void emulator_delay(uint32_t const delay_ms)
+{
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+}
+#endif
+
+#ifndef CONFIG_CO2_MONITOR_SENSOR_EMULATOR
 /*!
  * @brief UART transfer function for esp32
  *
- * Translation unit between the application code and the hardware framework
+ * Translation unit between the application code and the hardware framework.
+ * The transfer itself is carried by the event driven `sensor_uart` transport,
+ * so reads sleep until the sensor reply has been received.
  *
  * @note `p_rx_buffer` and `p_tx_buffer` cannot be both null
  *
+ * @param[in]           p_context           Transport of the sensor
  * @param[out]          p_rx_buffer         Pointer to the buffer where to read
  *                                          the data to
  * @param[in]           rx_buffer_size      Size of the read buffer
@@ -260,50 +853,22 @@ static inline bool sensor_lock(bool lock)
  *                                          Parameter is null
  * @retval              MH_Z19_ERROR_IO_ERROR
  *                                          Error while doing a transfer operation
+ * @retval              MH_Z19_ERROR_TIMEOUT
+ *                                          No reply in time
  */
- static mh_z19_error_t xfer_func(uint8_t const * const p_rx_buffer,
+static mh_z19_error_t xfer_func(void * const p_context,
+                                uint8_t * const p_rx_buffer,
                                 size_t const rx_buffer_size,
-                                uint8_t * const p_tx_buffer,
+                                uint8_t const * const p_tx_buffer,
                                 size_t const tx_buffer_size)
 {
-
-        mh_z19_error_t result = MH_Z19_ERROR_SUCCESS;
-        bool is_rx_operation = true;
-        int uart_result;
-
-        if ((NULL == p_rx_buffer) != (0 == rx_buffer_size)) {
-                result = MH_Z19_ERROR_BAD_PARAMETER;
-
-        } else if ((NULL == p_tx_buffer) != (0 == tx_buffer_size)) {
-                result = MH_Z19_ERROR_BAD_PARAMETER;
-
-        } else if ((NULL == p_rx_buffer) && (NULL == p_tx_buffer)) {
-                result = MH_Z19_ERROR_BAD_PARAMETER;
-        } else if (0 != tx_buffer_size) {
-                is_rx_operation = false;
-        }
-
-        if ((MH_Z19_ERROR_SUCCESS == result) && (is_rx_operation)) {
-                uart_result = uart_read_bytes(m_uart_instance,
-                                              (void *)p_rx_buffer,
-                                              (uint32_t)rx_buffer_size, 100);
-
-                if (-1 == uart_result) {
-                        result = MH_Z19_ERROR_IO_ERROR;
-                }
-
-        } else if (MH_Z19_ERROR_SUCCESS == result) {
-                uart_result = uart_write_bytes(m_uart_instance,
-                                               (void *)p_tx_buffer,
-                                               (uint32_t)tx_buffer_size);
-
-                if (-1 == uart_result) {
-                        result = MH_Z19_ERROR_IO_ERROR;
-                }
-        }
-
-        return result;
+        return sensor_uart_xfer((sensor_uart_t *)p_context,
+                                p_rx_buffer,
+                                rx_buffer_size,
+                                p_tx_buffer,
+                                tx_buffer_size);
 }
+#endif
 
 /*
  *******************************************************************************
@@ -314,14 +879,22 @@ static inline bool sensor_lock(bool lock)
 /*!
  * @brief Sensor task
  *
- * This task will wait for `http_q` and `display_q` to be ready before entering
- * in an endless loop. The loop will wait for any notifications, and the loop rate
- * will be controlled by the timeout of the `xTaskNotifyWait`function.
+ * This task owns the sensors. It runs an endless loop, where it sleeps on the
+ * request queue until either a request arrives or the next periodic read is
+ * due.
+ *
+ * Periodic reads run on a fixed rate base, at the period chosen by the
+ * sampling schedulers: short while CO2 changes fast, long while it's stable.
+ *
+ * The periodic read is checked before taking every request, so requests can
+ * delay a read by the time it takes to serve a single one, but never starve
+ * it.
  *
  * The actions this module will perform are:
- * - Post sensor data to HTTP module (if wifi connection)
- * - Post sensor data to display module (if display is on)
- * - Calibrate sensor (if calibrate button was pressed)
+ * - Read the sensors and publish the readings (periodically, or on request)
+ * - Keep reading the sensors at a low rate into the history while nobody is
+ *   interested in the readings
+ * - Calibrate the sensors and change their settings (on request)
  *
  *
  * @param               pvParameter         Not used
@@ -330,68 +903,56 @@ static inline bool sensor_lock(bool lock)
  */
 _Noreturn static void sensor_task(void * pvParameter) {
 
-        uint32_t co2_ppm;
-        uint32_t io_pressed = 0;
-        mh_z19_error_t mh_z19_result;
-        BaseType_t task_notify_result;
+        sensor_request_t request;
+        BaseType_t queue_result;
+        TickType_t next_read_ticks;
+        TickType_t last_report_ticks;
+        TickType_t now_ticks;
+        TickType_t wait_ticks;
+        TickType_t period_ticks;
 
         (void)pvParameter;
 
-        // Wait for `http_q` and `display_q` to be ready
-        xTaskNotifyWaitIndexed(0,0,0,0, portMAX_DELAY);
-        xTaskNotifyWaitIndexed(1,0,0,0, portMAX_DELAY);
+        last_report_ticks = xTaskGetTickCount();
+        next_read_ticks = last_report_ticks;
 
         while (1) {
 
-                task_notify_result = xTaskNotifyWait(0, 0,
-                                                     &io_pressed,
-                                                     TASK_REFRESH_RATE_TICKS);
-
-                /*
-                 * Don't even read the sensor if there is no one interested in
-                 * the output
-                 */
-                if ((!display_is_enabled()) &&
-                    (WIFI_STATUS_CONNECTED != wifi_get_status())) {
+                now_ticks = xTaskGetTickCount();
 
-                        // Code style exception for the shake of readability
-                        continue;
-                }
+                // Signed difference, so the tick count can wrap around
+                if (0 <= (int32_t)(now_ticks - next_read_ticks)) {
 
-                (void)sensor_lock(true);
-                mh_z19_result = mh_z19_get_gas_concentration(&co2_ppm);
-                (void)sensor_lock(false);
+                        period_ticks = periodic_read();
 
-                if (MH_Z19_ERROR_SUCCESS == mh_z19_result) {
+                        /*
+                         * Next read is scheduled from the deadline, not from
+                         * now, so the processing time doesn't add drift. If
+                         * reads were missed, they are skipped rather than
+                         * done in a burst.
+                         */
+                        now_ticks = xTaskGetTickCount();
 
-                        // Don't sent info to display if it isn't active
-                        if ((NULL != display_q) && (display_is_enabled())) {
-                                (void)display_set_concentration(co2_ppm);
-                        }
+                        do {
+                                next_read_ticks += period_ticks;
+                        } while (0 <= (int32_t)(now_ticks - next_read_ticks));
+                }
 
-                        // Don't attempt to post to server if there is no wifi
-                        if ((NULL != http_q) &&
-                            (WIFI_STATUS_CONNECTED == wifi_get_status())) {
+                wait_ticks = next_read_ticks - now_ticks;
 
-                                (void)xQueueSend(http_q, &co2_ppm, 0);
-                        }
+                queue_result = xQueueReceive(m_request_q, &request, wait_ticks);
 
-                        ESP_LOGI(TAG,"CO2 concentration %d ppm", co2_ppm);
+                if (pdTRUE == queue_result) {
+                        serve_request(&request);
                 }
 
-                if ((MH_Z19_ERROR_SUCCESS == mh_z19_result) &&
-                    (pdPASS == task_notify_result) &&
-                    (display_is_enabled())) {
+                if (TASK_STATS_RATE_TICKS <=
+                    (xTaskGetTickCount() - last_report_ticks)) {
 
-                        if (CALIBRATION_BUTTON == io_pressed) {
-                                (void)sensor_lock(true);
-                                (void)mh_z19_calibrate_zero_point();
-                                (void)sensor_lock(false);
-                        }
-                }
+                        report_stats();
+                        last_report_ticks = xTaskGetTickCount();
 
-                ESP_LOGI(TAG,"Max stack usage: %d of %d bytes", TASK_STACK_DEPTH - uxTaskGetStackHighWaterMark(NULL), TASK_STACK_DEPTH);
+                        ESP_LOGI(TAG,"Max stack usage: %d of %d bytes", TASK_STACK_DEPTH - uxTaskGetStackHighWaterMark(NULL), TASK_STACK_DEPTH);
+                }
         }
 }
-
-
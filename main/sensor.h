@@ -26,12 +26,115 @@
 #include <freertos/task.h>
 #include <freertos/queue.h>
 
+#include "sdkconfig.h"
+#include "winsen_mh_z19.h"
+
+//! @brief Amount of sensors attached to the board
+#define SENSOR_COUNT                        (CONFIG_CO2_MONITOR_SENSOR_COUNT)
+
+//! @brief Sensor index addressing all the sensors at once
+#define SENSOR_ALL                          (0xFF)
+
 /*
  *******************************************************************************
  * Public Data Types                                                           *
  *******************************************************************************
  */
 
+//! @brief Streams of readings consumers can subscribe to
+typedef enum {
+        //! @brief Readings as they come from the sensor
+        SENSOR_STREAM_RAW = 0,
+
+        //! @brief Readings after the spike filter and the moving average
+        SENSOR_STREAM_FILTERED,
+
+        //! @brief Fence member
+        SENSOR_STREAM_COUNT
+} sensor_stream_t;
+
+//! @brief Reading of one of the sensors
+typedef struct {
+        //! @brief Index of the sensor the reading comes from
+        uint8_t sensor;
+
+        //! @brief CO2 concentration in each stream (in ppm)
+        uint32_t co2_ppm[SENSOR_STREAM_COUNT];
+} sensor_reading_t;
+
+//! @brief Operations that can be requested to the sensor task
+typedef enum {
+        //! @brief Read the sensors and publish the readings
+        SENSOR_REQUEST_READ = 0,
+
+        //! @brief Calibrate the zero point
+        SENSOR_REQUEST_CALIBRATE_ZERO_POINT,
+
+        //! @brief Calibrate the span point to `span_ppm`
+        SENSOR_REQUEST_CALIBRATE_SPAN_POINT,
+
+        //! @brief Enable / disable ABC according to `abc_enabled`
+        SENSOR_REQUEST_SET_ABC,
+
+        //! @brief Set the detection range to `range`
+        SENSOR_REQUEST_SET_RANGE,
+
+        //! @brief Fence member
+        SENSOR_REQUEST_COUNT
+} sensor_request_type_t;
+
+//! @brief Request priorities
+typedef enum {
+        //! @brief Served after the already queued requests
+        SENSOR_PRIORITY_NORMAL = 0,
+
+        //! @brief Served before the already queued requests. Several high
+        //!        priority requests are served the latest first, as each one
+        //!        is sent to the front of the queue
+        SENSOR_PRIORITY_HIGH,
+} sensor_priority_t;
+
+typedef struct sensor_request sensor_request_t;
+
+/*!
+ * @brief Request completion callback
+ *
+ * Called from the sensor task once the request has been served, so it must
+ * not block. When the request addresses `SENSOR_ALL`, `result` is the first
+ * error found, if any.
+ *
+ * @param[in]           p_request           Pointer to the served request
+ * @param[in]           result              Operation result
+ *
+ * @return              -                   -
+ */
+typedef void (*sensor_request_cb)(sensor_request_t const * const p_request,
+                                  mh_z19_error_t const result);
+
+//! @brief Request to the sensor task
+struct sensor_request {
+        //! @brief Operation to perform
+        sensor_request_type_t type;
+
+        //! @brief Index of the addressed sensor, or `SENSOR_ALL`
+        uint8_t sensor;
+
+        //! @brief Span point for `SENSOR_REQUEST_CALIBRATE_SPAN_POINT` (in ppm)
+        uint16_t span_ppm;
+
+        //! @brief Setting for `SENSOR_REQUEST_SET_ABC`
+        bool abc_enabled;
+
+        //! @brief Setting for `SENSOR_REQUEST_SET_RANGE`
+        mh_z19b_range_t range;
+
+        //! @brief Completion callback (can be null)
+        sensor_request_cb done_cb;
+
+        //! @brief Context for the completion callback
+        void * p_context;
+};
+
 /*
  *******************************************************************************
  * Public Constants                                                            *
@@ -47,4 +150,13 @@
 //! @brief Initialize the sensor module
 bool sensor_init(void);
 
+//! @brief Submit a request to the sensor task
+bool sensor_submit(sensor_request_t const * const p_request,
+                   sensor_priority_t const priority);
+
+//! @brief Submit a request to the sensor task from an ISR
+bool sensor_submit_from_isr(sensor_request_t const * const p_request,
+                            sensor_priority_t const priority,
+                            BaseType_t * const p_higher_priority_task_woken);
+
 #endif //SENSOR_H_
@@ -0,0 +1,572 @@
+/*!
+ *******************************************************************************
+ * @file sensor_uart.c
+ *
+ * @brief Event driven UART transport for the MH-Z19 sensor
+ *
+ * The UART driver is configured to raise a data event either when a whole
+ * frame is at the hardware FIFO or when the line goes idle (RX timeout). A
+ * module task drains those events, feeds the received bytes to a frame parser,
+ * which resynchronizes on the start byte, command and check value, and hands
+ * every valid frame to `frame_received`, which keeps it for the reader and
+ * wakes it up.
+ *
+ * Readers therefore block on a semaphore until their frame has arrived instead
+ * of polling the UART buffer with a tick based timeout.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "tasks_config.h"
+
+#include "esp_log.h"
+#include "driver/uart.h"
+#include "winsen_mh_z19.h"
+
+#include "sensor_uart.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+#define TAG                                 "sensor_uart"
+
+#define TASK_STACK_DEPTH                    TASKS_CONFIG_SENSOR_UART_STACK_DEPTH
+#define TASK_PRIORITY                       TASKS_CONFIG_SENSOR_UART_PRIORITY
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+//! @brief Size of the UART driver ring buffers
+static int const m_uart_buffer_size = (1024 * 2);
+
+//! @brief Depth of the UART driver event queue
+static int const m_event_queue_size = 10;
+
+//! @brief Idle time, in symbols, after which received data is reported
+static uint8_t const m_rx_timeout_symbols = 3;
+
+//! @brief Maximum time for the sensor to complete its reply
+static uint32_t const m_reply_timeout_ms = 100;
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Transport task
+_Noreturn static void sensor_uart_task(void * pvParameter);
+
+//! @brief Feed received bytes to the frame assembler
+static void assemble_frames(sensor_uart_t * const p_uart,
+                            uint8_t const * const p_data,
+                            size_t const size);
+
+//! @brief Frame received callback
+static void frame_received(sensor_uart_t * const p_uart,
+                           uint8_t const * const p_frame);
+
+//! @brief Take the bytes of the last frame not read yet
+static size_t claim_bytes(sensor_uart_t * const p_uart,
+                          uint8_t * const p_buffer,
+                          size_t const size);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize a transport instance
+ *
+ * Configures the UART peripheral, installs its driver with an event queue and
+ * starts the task that will be draining it.
+ *
+ * @param[out]          p_uart              Pointer to the instance to initialize
+ * @param[in]           p_config            Pointer to the transport configuration
+ *
+ * @return              bool                Operation result
+ */
+bool sensor_uart_init(sensor_uart_t * const p_uart,
+                      sensor_uart_config_t const * const p_config)
+{
+        uart_config_t uart_config = {
+                        .baud_rate = 9600,
+                        .data_bits = UART_DATA_8_BITS,
+                        .parity = UART_PARITY_DISABLE,
+                        .stop_bits = UART_STOP_BITS_1,
+                        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        };
+
+        bool success;
+        esp_err_t esp_result;
+        BaseType_t task_result;
+
+        success = ((NULL != p_uart) && (NULL != p_config));
+
+        if (success) {
+                memset(p_uart, 0, sizeof(*p_uart));
+                mh_z19_parser_reset(&p_uart->parser);
+                p_uart->port = p_config->port;
+                p_uart->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+                uart_config.baud_rate = p_config->baud_rate;
+
+                esp_result = uart_set_pin(
+                                p_config->port,
+                                p_config->tx_pin,
+                                p_config->rx_pin,
+                                UART_PIN_NO_CHANGE,
+                                UART_PIN_NO_CHANGE);
+
+                success = (ESP_OK == esp_result);
+        }
+
+        if (success) {
+                esp_result = uart_param_config(p_uart->port, &uart_config);
+
+                success = (ESP_OK == esp_result);
+        }
+
+        if (success) {
+                esp_result = uart_driver_install(
+                                p_uart->port,
+                                m_uart_buffer_size,
+                                m_uart_buffer_size,
+                                m_event_queue_size,
+                                &p_uart->event_q,
+                                0);
+
+                success = (ESP_OK == esp_result);
+        }
+
+        // Raise a data event as soon as a whole frame is at the FIFO...
+        if (success) {
+                esp_result = uart_set_rx_full_threshold(p_uart->port,
+                                                        SENSOR_UART_FRAME_SIZE);
+
+                success = (ESP_OK == esp_result);
+        }
+
+        // ... or if the line went idle before that
+        if (success) {
+                esp_result = uart_set_rx_timeout(p_uart->port,
+                                                 m_rx_timeout_symbols);
+
+                success = (ESP_OK == esp_result);
+        }
+
+        if (success) {
+                p_uart->frame_ready_sem = xSemaphoreCreateBinary();
+
+                success = (NULL != p_uart->frame_ready_sem);
+        }
+
+        if (success) {
+                task_result = xTaskCreate((TaskFunction_t)sensor_uart_task,
+                                          "sensor_uart_task",
+                                          TASK_STACK_DEPTH,
+                                          p_uart,
+                                          TASK_PRIORITY,
+                                          &p_uart->task_h);
+
+                success = (pdPASS == task_result);
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Transfer data through the transport
+ *
+ * Follows the `mh_z19_xfer_func` contract, with the transport instance as
+ * first parameter.
+ *
+ * Writing a request discards any partially assembled or unclaimed frame, so
+ * the next read only gets a reply to that request. Reading blocks until the
+ * transport task has delivered enough frames to fill the buffer, or until the
+ * sensor reply timeout expires waiting for one of them.
+ *
+ * Frames are read as a byte stream: a read shorter than a frame leaves the
+ * rest of the frame for the next read.
+ *
+ * @note Reads up to a frame size are supported
+ *
+ * @param[in]           p_uart              Pointer to the transport instance
+ * @param[out]          p_rx_buffer         Pointer to the buffer where to read
+ *                                          the data to
+ * @param[in]           rx_buffer_size      Size of the read buffer
+ * @param[in]           p_tx_buffer         Pointer to the buffer where to read
+ *                                          the data from
+ * @param[in]           tx_buffer_size      Size of the write buffer
+ *
+ * @return              mh_z19_error_t      Operation result
+ * @retval              MH_Z19_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              MH_Z19_ERROR_BAD_PARAMETER
+ *                                          Parameter is null or has a wrong size
+ * @retval              MH_Z19_ERROR_IO_ERROR
+ *                                          Error while writing the request
+ * @retval              MH_Z19_ERROR_TIMEOUT
+ *                                          No reply in time
+ */
+mh_z19_error_t sensor_uart_xfer(sensor_uart_t * const p_uart,
+                                uint8_t * const p_rx_buffer,
+                                size_t const rx_buffer_size,
+                                uint8_t const * const p_tx_buffer,
+                                size_t const tx_buffer_size)
+{
+        mh_z19_error_t result = MH_Z19_ERROR_SUCCESS;
+        bool is_rx_operation = true;
+        bool is_timed_out = false;
+        BaseType_t semaphore_result;
+        size_t copied = 0;
+        int uart_result;
+
+        if (NULL == p_uart) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+
+        } else if ((NULL == p_rx_buffer) != (0 == rx_buffer_size)) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+
+        } else if ((NULL == p_tx_buffer) != (0 == tx_buffer_size)) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+
+        } else if ((NULL == p_rx_buffer) && (NULL == p_tx_buffer)) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+
+        } else if (0 != tx_buffer_size) {
+                is_rx_operation = false;
+
+        } else if (SENSOR_UART_FRAME_SIZE < rx_buffer_size) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+        }
+
+        while ((MH_Z19_ERROR_SUCCESS == result) &&
+               (is_rx_operation) &&
+               (rx_buffer_size > copied)) {
+
+                // Claim what may have arrived before we got here
+                portENTER_CRITICAL(&p_uart->lock);
+
+                copied += claim_bytes(p_uart,
+                                      &p_rx_buffer[copied],
+                                      rx_buffer_size - copied);
+
+                p_uart->is_reader_waiting = ((rx_buffer_size > copied) &&
+                                             (!is_timed_out));
+
+                portEXIT_CRITICAL(&p_uart->lock);
+
+                // A frame delivered right at timeout is claimed above
+                if ((rx_buffer_size > copied) && (is_timed_out)) {
+                        result = MH_Z19_ERROR_TIMEOUT;
+
+                } else if (rx_buffer_size > copied) {
+                        semaphore_result = xSemaphoreTake(
+                                        p_uart->frame_ready_sem,
+                                        pdMS_TO_TICKS(m_reply_timeout_ms));
+
+                        portENTER_CRITICAL(&p_uart->lock);
+                        p_uart->is_reader_waiting = false;
+                        portEXIT_CRITICAL(&p_uart->lock);
+
+                        is_timed_out = (pdTRUE != semaphore_result);
+                }
+        }
+
+        if ((MH_Z19_ERROR_SUCCESS == result) && (!is_rx_operation)) {
+
+                portENTER_CRITICAL(&p_uart->lock);
+
+                if (0 != p_uart->pending_count) {
+                        ++p_uart->stats.unclaimed_frames;
+                }
+
+                p_uart->pending_count = 0;
+                mh_z19_parser_flush(&p_uart->parser);
+                portEXIT_CRITICAL(&p_uart->lock);
+
+                (void)xSemaphoreTake(p_uart->frame_ready_sem, 0);
+
+                uart_result = uart_write_bytes(p_uart->port,
+                                               (void *)p_tx_buffer,
+                                               (uint32_t)tx_buffer_size);
+
+                if (-1 == uart_result) {
+                        result = MH_Z19_ERROR_IO_ERROR;
+                }
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Get the transport statistics
+ *
+ * @param[in]           p_uart              Pointer to the transport instance
+ * @param[out]          p_stats             Pointer where to copy the statistics
+ *
+ * @return              bool                Operation result
+ */
+bool sensor_uart_get_stats(sensor_uart_t * const p_uart,
+                           sensor_uart_stats_t * const p_stats)
+{
+        bool success = ((NULL != p_uart) && (NULL != p_stats));
+
+        if (success) {
+                portENTER_CRITICAL(&p_uart->lock);
+                *p_stats = p_uart->stats;
+                mh_z19_parser_get_stats(&p_uart->parser, &p_stats->parser);
+                portEXIT_CRITICAL(&p_uart->lock);
+        }
+
+        return success;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Feed received bytes to the frame assembler
+ *
+ * Bytes are pushed to the frame parser, and each time it yields a valid frame,
+ * the frame is passed to `frame_received`. Bytes that can't belong to a valid
+ * frame are dropped by the parser.
+ *
+ * @param[in]           p_uart              Pointer to the transport instance
+ * @param[in]           p_data              Pointer to the received bytes
+ * @param[in]           size                Amount of received bytes
+ *
+ * @return              -                   -
+ */
+static void assemble_frames(sensor_uart_t * const p_uart,
+                            uint8_t const * const p_data,
+                            size_t const size)
+{
+        uint8_t frame[SENSOR_UART_FRAME_SIZE];
+        size_t pushed = 0;
+        bool is_complete;
+
+        while (size > pushed) {
+
+                portENTER_CRITICAL(&p_uart->lock);
+
+                pushed += mh_z19_parser_push(&p_uart->parser,
+                                             &p_data[pushed],
+                                             size - pushed);
+
+                is_complete = mh_z19_parser_pop_frame(&p_uart->parser,
+                                                      MH_Z19_PARSER_ANY_COMMAND,
+                                                      frame);
+
+                portEXIT_CRITICAL(&p_uart->lock);
+
+                while (is_complete) {
+                        frame_received(p_uart, frame);
+
+                        portENTER_CRITICAL(&p_uart->lock);
+
+                        is_complete = mh_z19_parser_pop_frame(
+                                        &p_uart->parser,
+                                        MH_Z19_PARSER_ANY_COMMAND,
+                                        frame);
+
+                        portEXIT_CRITICAL(&p_uart->lock);
+                }
+        }
+}
+
+/*!
+ * @brief Frame received callback
+ *
+ * Keeps a complete frame until it is read or a new request is sent, and
+ * wakes up the reader waiting for it, if any.
+ *
+ * @param[in]           p_uart              Pointer to the transport instance
+ * @param[in]           p_frame             Pointer to the received frame
+ *
+ * @return              -                   -
+ */
+static void frame_received(sensor_uart_t * const p_uart,
+                           uint8_t const * const p_frame)
+{
+        bool is_delivered;
+
+        portENTER_CRITICAL(&p_uart->lock);
+
+        ++p_uart->stats.frames;
+
+        if (0 != p_uart->pending_count) {
+                ++p_uart->stats.unclaimed_frames;
+        }
+
+        memcpy(p_uart->pending_frame, p_frame, SENSOR_UART_FRAME_SIZE);
+        p_uart->pending_index = 0;
+        p_uart->pending_count = SENSOR_UART_FRAME_SIZE;
+
+        is_delivered = p_uart->is_reader_waiting;
+        p_uart->is_reader_waiting = false;
+
+        portEXIT_CRITICAL(&p_uart->lock);
+
+        if (is_delivered) {
+                (void)xSemaphoreGive(p_uart->frame_ready_sem);
+        }
+}
+
+/*!
+ * @brief Take the bytes of the last frame not read yet
+ *
+ * @note Must be called with the instance lock taken
+ *
+ * @param[in]           p_uart              Pointer to the transport instance
+ * @param[out]          p_buffer            Pointer where to copy the bytes
+ * @param[in]           size                Maximum amount of bytes to copy
+ *
+ * @return              size_t              Amount of bytes copied
+ */
+static size_t claim_bytes(sensor_uart_t * const p_uart,
+                          uint8_t * const p_buffer,
+                          size_t const size)
+{
+        size_t const count = (size < p_uart->pending_count) ?
+                             size : p_uart->pending_count;
+
+        memcpy(p_buffer, &p_uart->pending_frame[p_uart->pending_index], count);
+        p_uart->pending_index += count;
+        p_uart->pending_count -= count;
+
+        return count;
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Transport task
+ *
+ * Sleeps on the UART driver event queue. Received data is read without
+ * blocking and fed to the frame assembler; on overflow conditions the input
+ * is flushed and any partial frame discarded.
+ *
+ * @param               pvParameter         Pointer to the transport instance
+ *
+ * @return              -                   -
+ */
+_Noreturn static void sensor_uart_task(void * pvParameter)
+{
+        sensor_uart_t * const p_uart = (sensor_uart_t *)pvParameter;
+        uint8_t data[SENSOR_UART_FRAME_SIZE * 2];
+        uart_event_t event;
+        BaseType_t queue_result;
+        size_t remaining;
+        size_t chunk;
+        int read;
+
+        while (1) {
+                queue_result = xQueueReceive(p_uart->event_q,
+                                             &event,
+                                             portMAX_DELAY);
+
+                if (pdTRUE != queue_result) {
+                        // Code style exception for the shake of readability
+                        continue;
+                }
+
+                switch (event.type) {
+
+                case UART_DATA:
+                        remaining = event.size;
+
+                        while (0 < remaining) {
+                                chunk = remaining;
+
+                                if (sizeof(data) < chunk) {
+                                        chunk = sizeof(data);
+                                }
+
+                                read = uart_read_bytes(p_uart->port,
+                                                       data,
+                                                       (uint32_t)chunk,
+                                                       0);
+
+                                if (0 >= read) {
+                                        break;
+                                }
+
+                                assemble_frames(p_uart, data, (size_t)read);
+                                remaining -= (size_t)read;
+                        }
+
+                        break;
+
+                case UART_FIFO_OVF:
+                case UART_BUFFER_FULL:
+                        ESP_LOGW(TAG, "RX overflow, flushing input");
+
+                        (void)uart_flush_input(p_uart->port);
+                        (void)xQueueReset(p_uart->event_q);
+
+                        portENTER_CRITICAL(&p_uart->lock);
+                        ++p_uart->stats.overflows;
+                        mh_z19_parser_flush(&p_uart->parser);
+                        portEXIT_CRITICAL(&p_uart->lock);
+
+                        break;
+
+                default:
+                        break;
+                }
+        }
+}
@@ -0,0 +1,139 @@
+/*!
+ *******************************************************************************
+ * @file sensor_uart.h
+ *
+ * @brief Event driven UART transport for the MH-Z19 sensor
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef SENSOR_UART_H
+#define SENSOR_UART_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "driver/uart.h"
+
+#include "winsen_mh_z19.h"
+#include "winsen_mh_z19_parser.h"
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+//! @brief Size of the frames exchanged with the sensor
+#define SENSOR_UART_FRAME_SIZE              MH_Z19_PARSER_FRAME_SIZE
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Transport configuration
+typedef struct {
+        uart_port_t port;
+        int tx_pin;
+        int rx_pin;
+        int baud_rate;
+} sensor_uart_config_t;
+
+//! @brief Transport statistics
+typedef struct {
+        //! @brief Frames received from the sensor
+        uint32_t frames;
+
+        //! @brief Frames nobody was waiting for, dropped by a later request
+        uint32_t unclaimed_frames;
+
+        //! @brief Times the received data overflowed the UART buffers
+        uint32_t overflows;
+
+        //! @brief Statistics of the frame parser
+        mh_z19_parser_stats_t parser;
+} sensor_uart_stats_t;
+
+/*!
+ * @brief Transport instance
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief UART peripheral used by the transport
+        uart_port_t port;
+
+        //! @brief Event queue filled by the UART driver
+        QueueHandle_t event_q;
+
+        //! @brief Given when a frame has been delivered to `p_rx_buffer`
+        SemaphoreHandle_t frame_ready_sem;
+
+        //! @brief Handle of the task draining `event_q`
+        TaskHandle_t task_h;
+
+        //! @brief Protects the members shared with the event task
+        portMUX_TYPE lock;
+
+        //! @brief Parser finding the frames within the received bytes
+        mh_z19_parser_t parser;
+
+        //! @brief Last complete frame received
+        uint8_t pending_frame[SENSOR_UART_FRAME_SIZE];
+
+        //! @brief Index of the first byte of `pending_frame` not read yet
+        size_t pending_index;
+
+        //! @brief Amount of bytes of `pending_frame` not read yet
+        size_t pending_count;
+
+        //! @brief Whether a reader is waiting for the next frame
+        bool is_reader_waiting;
+
+        //! @brief Statistics, except the parser ones
+        sensor_uart_stats_t stats;
+} sensor_uart_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize a transport instance
+bool sensor_uart_init(sensor_uart_t * const p_uart,
+                      sensor_uart_config_t const * const p_config);
+
+//! @brief Transfer data through the transport
+mh_z19_error_t sensor_uart_xfer(sensor_uart_t * const p_uart,
+                                uint8_t * const p_rx_buffer,
+                                size_t const rx_buffer_size,
+                                uint8_t const * const p_tx_buffer,
+                                size_t const tx_buffer_size);
+
+//! @brief Get the transport statistics
+bool sensor_uart_get_stats(sensor_uart_t * const p_uart,
+                           sensor_uart_stats_t * const p_stats);
+
+#endif //SENSOR_UART_H
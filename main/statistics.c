@@ -0,0 +1,319 @@
+/*!
+ *******************************************************************************
+ * @file statistics.c
+ *
+ * @brief Rolling statistics and ventilation estimates of every sensor
+ *
+ * Readings are taken from the sample bus as soon as they are published, so
+ * consumers get their summaries without going through the readings
+ * themselves:
+ * - Raw readings are fed to a `window_stats` instance per sensor, for the one
+ *   minute, fifteen minutes and one hour statistics.
+ * - Filtered readings are fed to a `ventilation` instance per sensor, which
+ *   estimates the air changes per hour from each decay of the concentration.
+ *   Only the latest estimate is kept.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#include "sensor.h"
+#include "sample_bus.h"
+#include "window_stats.h"
+#include "ventilation.h"
+
+#include "statistics.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+#define VENTILATION_OUTDOOR_PPM             (CONFIG_CO2_MONITOR_VENTILATION_OUTDOOR_PPM)
+
+#if (CONFIG_CO2_MONITOR_SAMPLING_MAX_PERIOD_S > CONFIG_CO2_MONITOR_SAMPLING_BACKGROUND_PERIOD_S)
+#define SAMPLING_LONGEST_PERIOD_S           (CONFIG_CO2_MONITOR_SAMPLING_MAX_PERIOD_S)
+#else
+#define SAMPLING_LONGEST_PERIOD_S           (CONFIG_CO2_MONITOR_SAMPLING_BACKGROUND_PERIOD_S)
+#endif
+
+//! @brief Time between readings giving a decay up, a couple of them missed
+#define VENTILATION_MAX_GAP_S               (2 * SAMPLING_LONGEST_PERIOD_S)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Feed the samples published in the sample bus
+static void on_sample(void * const p_context);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+//! @brief Statistics of each sensor
+static window_stats_t m_stats[SENSOR_COUNT];
+
+//! @brief Ventilation estimator of each sensor, only used from `on_sample`
+static ventilation_t m_ventilation[SENSOR_COUNT];
+
+//! @brief Latest ventilation estimate of each sensor
+static ventilation_event_t m_ventilation_events[SENSOR_COUNT];
+
+//! @brief Whether each sensor has a ventilation estimate yet
+static bool m_has_ventilation_event[SENSOR_COUNT];
+
+//! @brief Protects `m_stats` and the ventilation estimates, taken only for a
+//!        single update or query
+static portMUX_TYPE m_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//! @brief Subscription to the sample bus
+static sample_bus_subscriber_t m_subscriber;
+
+//! @brief Whether `m_subscriber` is subscribed already
+static bool m_is_subscribed = false;
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize the statistics module
+ *
+ * Forgets any reading fed so far and subscribes to the sample bus, which has
+ * to be initialized already. Initialize it before the consumers of the
+ * statistics subscribe to the bus, so the statistics already account for a
+ * sample once they are notified of it.
+ *
+ * @return              bool                Operation result
+ */
+bool statistics_init(void)
+{
+        ventilation_config_t const ventilation_config = {
+                        .outdoor_ppm = VENTILATION_OUTDOOR_PPM,
+                        .max_gap_s = VENTILATION_MAX_GAP_S,
+        };
+
+        bool success = true;
+        size_t i;
+
+        portENTER_CRITICAL(&m_lock);
+
+        for (i = 0; SENSOR_COUNT > i; ++i) {
+                success = (success) &&
+                          (window_stats_init(&m_stats[i])) &&
+                          (ventilation_init(&m_ventilation[i],
+                                            &ventilation_config));
+
+                m_has_ventilation_event[i] = false;
+        }
+
+        portEXIT_CRITICAL(&m_lock);
+
+        if ((success) && (!m_is_subscribed)) {
+                success = sample_bus_subscribe(&m_subscriber, on_sample, NULL);
+                m_is_subscribed = success;
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Get the statistics of a sensor over a window
+ *
+ * @param[in]           sensor              Index of the sensor
+ * @param[in]           window              Window to get the statistics of
+ * @param[out]          p_summary           Pointer where to copy the
+ *                                          statistics
+ *
+ * @return              bool                False if the window has no
+ *                                          readings
+ */
+bool statistics_get(uint8_t const sensor,
+                    window_stats_window_t const window,
+                    window_stats_summary_t * const p_summary)
+{
+        bool success;
+
+        if (SENSOR_COUNT <= sensor) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        portENTER_CRITICAL(&m_lock);
+        success = window_stats_get(&m_stats[sensor], window, p_summary);
+        portEXIT_CRITICAL(&m_lock);
+
+        return success;
+}
+
+/*!
+ * @brief Get the rate of change of the concentration of a sensor
+ *
+ * @param[in]           sensor              Index of the sensor
+ * @param[out]          p_ppm_per_hour      Pointer where to copy the rate of
+ *                                          change (in ppm per hour), positive
+ *                                          when rising
+ *
+ * @return              bool                False if there aren't readings
+ *                                          enough to tell
+ */
+bool statistics_get_trend(uint8_t const sensor,
+                          int32_t * const p_ppm_per_hour)
+{
+        bool success;
+
+        if (SENSOR_COUNT <= sensor) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        portENTER_CRITICAL(&m_lock);
+        success = window_stats_get_trend(&m_stats[sensor], p_ppm_per_hour);
+        portEXIT_CRITICAL(&m_lock);
+
+        return success;
+}
+
+/*!
+ * @brief Get the latest ventilation estimate of a sensor
+ *
+ * Estimates come once a decay of the concentration ends, consumers can tell
+ * a new one by its number.
+ *
+ * @param[in]           sensor              Index of the sensor
+ * @param[out]          p_event             Pointer where to copy the estimate
+ *
+ * @return              bool                False if there are no estimates
+ *                                          yet
+ */
+bool statistics_get_ventilation(uint8_t const sensor,
+                                ventilation_event_t * const p_event)
+{
+        bool success;
+
+        if ((SENSOR_COUNT <= sensor) || (NULL == p_event)) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        portENTER_CRITICAL(&m_lock);
+
+        success = m_has_ventilation_event[sensor];
+
+        if (success) {
+                *p_event = m_ventilation_events[sensor];
+        }
+
+        portEXIT_CRITICAL(&m_lock);
+
+        return success;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Feed the samples published in the sample bus
+ *
+ * Runs in the publisher context, every update takes constant time. The
+ * ventilation fit, in floating point, is run out of the critical section.
+ *
+ * @param[in]           p_context           Not used
+ *
+ * @return              -                   -
+ */
+static void on_sample(void * const p_context)
+{
+        sample_bus_sample_t const * p_sample;
+        ventilation_event_t event;
+        uint32_t time_s;
+        uint32_t co2_ppm;
+        uint32_t filtered_ppm;
+        bool is_event;
+        uint8_t sensor;
+
+        (void)p_context;
+
+        p_sample = sample_bus_peek(&m_subscriber);
+
+        while (NULL != p_sample) {
+                co2_ppm = p_sample->reading.co2_ppm[SENSOR_STREAM_RAW];
+                filtered_ppm = p_sample->reading.co2_ppm[SENSOR_STREAM_FILTERED];
+                time_s = p_sample->time_s;
+                sensor = p_sample->reading.sensor;
+
+                if ((sample_bus_release(&m_subscriber)) &&
+                    (SENSOR_COUNT > sensor)) {
+
+                        is_event = ventilation_update(
+                                        &m_ventilation[sensor],
+                                        time_s,
+                                        (UINT16_MAX < filtered_ppm) ?
+                                        UINT16_MAX : (uint16_t)filtered_ppm,
+                                        &event);
+
+                        portENTER_CRITICAL(&m_lock);
+
+                        window_stats_update(&m_stats[sensor],
+                                            time_s,
+                                            (UINT16_MAX < co2_ppm) ?
+                                            UINT16_MAX : (uint16_t)co2_ppm);
+
+                        if (is_event) {
+                                m_ventilation_events[sensor] = event;
+                                m_has_ventilation_event[sensor] = true;
+                        }
+
+                        portEXIT_CRITICAL(&m_lock);
+                }
+
+                p_sample = sample_bus_peek(&m_subscriber);
+        }
+}
@@ -0,0 +1,68 @@
+/*!
+ *******************************************************************************
+ * @file statistics.h
+ *
+ * @brief Rolling statistics and ventilation estimates of every sensor
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "window_stats.h"
+#include "ventilation.h"
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize the statistics module
+bool statistics_init(void);
+
+//! @brief Get the statistics of a sensor over a window
+bool statistics_get(uint8_t const sensor,
+                    window_stats_window_t const window,
+                    window_stats_summary_t * const p_summary);
+
+//! @brief Get the rate of change of the concentration of a sensor
+bool statistics_get_trend(uint8_t const sensor,
+                          int32_t * const p_ppm_per_hour);
+
+//! @brief Get the latest ventilation estimate of a sensor
+bool statistics_get_ventilation(uint8_t const sensor,
+                                ventilation_event_t * const p_event);
+
+#endif //STATISTICS_H
@@ -0,0 +1,1039 @@
+/*!
+ *******************************************************************************
+ * @file uplink.c
+ *
+ * @brief Telemetry uplink to the Thingsboard server
+ *
+ * Serializes the samples, aggregates, ventilation estimates and alarms into
+ * Thingsboard telemetry JSON, and sends it through the transport configured:
+ * HTTP POST (`http.c`), MQTT (`mqtt.c`) or CoAP (`coap_client.c`). Messages
+ * come in two classes:
+ * - Routine telemetry, batched into timestamped arrays, which may be lost.
+ * - Events (alarms and ventilation estimates), sent with at least once
+ *   delivery where the transport supports it.
+ *
+ * Readings which can't be sent, either because there is no wifi connection
+ * or because the transport fails, are added to the `backlog`. Once sending
+ * works again, the raw readings are taken from it and batched after the live
+ * telemetry, at most `BACKLOG_DRAIN_RATE` each time the task wakes up, so the
+ * live telemetry keeps flowing while the backlog drains.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "tasks_config.h"
+
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "wifi.h"
+
+#include "sensor.h"
+#include "sample_bus.h"
+#include "statistics.h"
+#include "alarm.h"
+#include "history.h"
+#include "backlog.h"
+#if defined(CONFIG_CO2_MONITOR_UPLINK_MQTT)
+#include "mqtt.h"
+#elif defined(CONFIG_CO2_MONITOR_UPLINK_COAP)
+#include "coap_client.h"
+#else
+#include "http.h"
+#endif
+#include "uplink.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+#define TAG                                 "uplink"
+
+#define TASK_REFRESH_RATE_TICKS             (pdMS_TO_TICKS(TASKS_CONFIG_UPLINK_REFRESH_RATE_MS))
+#define TASK_STACK_DEPTH                    TASKS_CONFIG_UPLINK_STACK_DEPTH
+#define TASK_PRIORITY                       TASKS_CONFIG_UPLINK_PRIORITY
+
+#ifdef CONFIG_CO2_MONITOR_HTTP_STREAM_RAW
+#define READINGS_STREAM                     (SENSOR_STREAM_RAW)
+#else
+#define READINGS_STREAM                     (SENSOR_STREAM_FILTERED)
+#endif
+
+//! @brief Time between posts of the aggregates of a sensor (in seconds)
+#define AGGREGATE_PERIOD_S                  (60)
+
+//! @brief Time span of the readings a telemetry entry stands for (in seconds)
+#ifdef CONFIG_CO2_MONITOR_HTTP_STREAM_AGGREGATES
+#define READINGS_SPAN_S                     (AGGREGATE_PERIOD_S)
+#else
+#define READINGS_SPAN_S                     (0)
+#endif
+
+#define BACKLOG_DRAIN_RATE                  (CONFIG_CO2_MONITOR_UPLINK_BACKLOG_DRAIN_RATE)
+
+//! @brief Alarm level changes waiting to be sent
+#define ALARM_QUEUE_LENGTH                  (8)
+
+#define BATCH_SIZE                          (CONFIG_CO2_MONITOR_HTTP_BATCH_SIZE)
+#define BATCH_MAX_AGE_S                     (CONFIG_CO2_MONITOR_HTTP_BATCH_MAX_AGE_S)
+
+//! @brief Longest telemetry entry, timestamp included
+#define BATCH_ENTRY_MAX_LENGTH              (224)
+
+//! @brief Longest JSON telemetry object
+#define VALUES_MAX_LENGTH                   (192)
+
+//! @brief Batch buffer size, brackets and terminator included. Over CoAP,
+//!        each batch has to fit a single datagram, so it is sent once the
+//!        next entry wouldn't fit, even if fewer than `BATCH_SIZE`.
+#if defined(CONFIG_CO2_MONITOR_UPLINK_COAP) && \
+    (((BATCH_SIZE * BATCH_ENTRY_MAX_LENGTH) + 2) > COAP_CLIENT_MAX_PAYLOAD)
+#define BATCH_BUFFER_SIZE                   (COAP_CLIENT_MAX_PAYLOAD + 1)
+#else
+#define BATCH_BUFFER_SIZE                   ((BATCH_SIZE * BATCH_ENTRY_MAX_LENGTH) + 3)
+#endif
+
+#if ((BATCH_ENTRY_MAX_LENGTH) + 3) > BATCH_BUFFER_SIZE
+#error "A single telemetry entry doesn't fit a batch"
+#endif
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Message classes, sent with a different delivery guarantee
+typedef enum {
+        //! @brief Routine telemetry, may be lost
+        UPLINK_CLASS_TELEMETRY = 0,
+
+        //! @brief Ventilation estimates, delivered at least once
+        UPLINK_CLASS_EVENT,
+
+        //! @brief Alarm level changes, delivered at least once, ahead of any
+        //!        other class
+        UPLINK_CLASS_ALARM,
+} uplink_class_t;
+
+//! @brief What telemetry stands for, which tells what to do if it can't be sent
+typedef enum {
+        //! @brief Not stored anywhere else, lost
+        UPLINK_SOURCE_LIVE = 0,
+
+        //! @brief Live readings, added to the backlog
+        UPLINK_SOURCE_READINGS,
+
+        //! @brief Readings taken from the backlog, given back to it
+        UPLINK_SOURCE_BACKLOG,
+} uplink_source_t;
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+_Noreturn static void uplink_task(void *pvParameter);
+
+//! @brief Wake the uplink task up when a new sample is published
+static void on_sample(void * const p_context);
+
+//! @brief Send a sample, or the aggregates of its sensor once they are due
+static void uplink_send_sample(sample_bus_sample_t const * const p_sample);
+
+//! @brief Send the aggregates of a sensor
+static void uplink_send_aggregate(uint8_t const sensor,
+                                  uint32_t const time_s,
+                                  window_stats_summary_t const * const p_summary);
+
+//! @brief Send the latest ventilation estimate of a sensor, if not sent yet
+static void uplink_send_ventilation(uint8_t const sensor);
+
+//! @brief Send every alarm level change queued
+static bool uplink_send_alarms(void);
+
+//! @brief Send backlogged readings, if sending works
+static void uplink_drain_backlog(void);
+
+//! @brief Drop every unread sample, adding them to the backlog
+static void uplink_skip_samples(void);
+
+//! @brief Add telemetry to the batch, sending the batch once full
+static void uplink_batch_add(uint32_t const time_s,
+                             char const * const p_values,
+                             uplink_class_t const message_class,
+                             bool const is_reading);
+
+//! @brief Add timestamped telemetry to the batch, sending the batch once full
+static void uplink_batch_insert(uint32_t const time_s,
+                                int64_t const epoch_ms,
+                                char const * const p_values,
+                                uplink_class_t const message_class,
+                                uplink_source_t const source);
+
+//! @brief Send the batch, if not empty
+static void uplink_batch_flush(void);
+
+//! @brief Send the batch if its oldest entry is too old
+static void uplink_batch_flush_aged(void);
+
+//! @brief Time of the first reading a telemetry entry stands for
+static uint32_t readings_from_s(uint32_t const time_s);
+
+//! @brief Send telemetry through the configured transport
+static bool uplink_send(char const * const p_payload,
+                        uplink_class_t const message_class);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+static const char * m_post_data_template = "{\"co2_concentration%s\": %d}";
+
+//! @brief Telemetry of a backlogged reading of a sensor. The backlog replays
+//!        raw readings, so unless the live readings are raw too, they get
+//!        their own key, not to mix both series
+#ifdef CONFIG_CO2_MONITOR_HTTP_STREAM_RAW
+static char const * const m_backlog_data_template = "{\"co2_concentration%s\": %d}";
+#else
+static char const * const m_backlog_data_template = "{\"co2_concentration_raw%s\": %d}";
+#endif
+
+//! @brief Telemetry of the aggregates of a sensor: mean, min, max and p95
+static char const * const m_aggregate_data_template =
+                "{\"co2_concentration%s\": %u, \"co2_min%s\": %u, "
+                "\"co2_max%s\": %u, \"co2_p95%s\": %u}";
+
+//! @brief Telemetry of a ventilation estimate of a sensor
+static char const * const m_ventilation_data_template =
+                "{\"ventilation_ach%s\": %u.%02u, \"ventilation_fit%s\": %u, "
+                "\"ventilation_duration%s\": %u, \"ventilation_start%s\": %u, "
+                "\"ventilation_end%s\": %u}";
+
+//! @brief Telemetry of an alarm level change of a sensor
+static char const * const m_alarm_data_template =
+                "{\"co2_alarm%s\": %u, \"co2_alarm_ppm%s\": %u}";
+
+//! @brief Timestamped entry of a Thingsboard telemetry array
+static char const * const m_batch_entry_template = "{\"ts\": %lld, \"values\": %s}";
+
+//! @brief Telemetry key suffix of each sensor, first one keeps the legacy key
+static char const * const m_sensor_key_suffixes[] = {"", "_2", "_3"};
+
+//! @brief Handler for the module's task
+static TaskHandle_t m_uplink_task_h = NULL;
+
+//! @brief Subscription to the sample bus
+static sample_bus_subscriber_t m_subscriber;
+
+//! @brief Alarm level changes waiting to be sent, ahead of any telemetry
+static QueueHandle_t m_alarm_q = NULL;
+
+//! @brief Telemetry waiting to be sent, as a Thingsboard array still missing
+//!        its closing bracket
+static char m_batch[BATCH_BUFFER_SIZE];
+
+//! @brief Length of `m_batch`
+static size_t m_batch_length = 0;
+
+//! @brief Entries in `m_batch`
+static size_t m_batch_count = 0;
+
+//! @brief Time of the oldest entry in `m_batch` (in seconds since boot)
+static uint32_t m_batch_time_s;
+
+//! @brief Most demanding class of the entries in `m_batch`
+static uplink_class_t m_batch_class = UPLINK_CLASS_TELEMETRY;
+
+//! @brief Readings in `m_batch`, backlogged if it can't be sent
+static uint32_t m_batch_readings = 0;
+
+//! @brief Time of the first reading in `m_batch` (in seconds since boot)
+static uint32_t m_batch_from_s;
+
+//! @brief Time of the last reading in `m_batch` (in seconds since boot)
+static uint32_t m_batch_to_s;
+
+//! @brief Readings taken from the backlog in `m_batch`, committed to it once
+//!        sent
+static uint32_t m_batch_replayed = 0;
+
+//! @brief Whether the last message could be sent
+static bool m_is_sending = true;
+
+//! @brief JSON telemetry object being serialized, only used from the task
+static char m_values[VALUES_MAX_LENGTH];
+
+//! @brief Time of the sample the last aggregates of each sensor were sent at
+//!        (in seconds since boot)
+static uint32_t m_aggregate_time_s[SENSOR_COUNT];
+
+//! @brief Whether the aggregates of each sensor have been sent yet
+static bool m_is_aggregate_sent[SENSOR_COUNT];
+
+//! @brief Number of the last ventilation estimate sent of each sensor
+static uint32_t m_ventilation_number[SENSOR_COUNT];
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize the uplink and its transport
+ *
+ * The network has to be initialized already.
+ *
+ * @return              bool                Operation result
+ */
+bool uplink_init(void)
+{
+        BaseType_t task_result;
+        bool success;
+
+#if defined(CONFIG_CO2_MONITOR_UPLINK_MQTT)
+        success = mqtt_init();
+#elif defined(CONFIG_CO2_MONITOR_UPLINK_COAP)
+        success = coap_client_init();
+#else
+        success = http_init();
+#endif
+
+        if (success) {
+                success = backlog_init();
+        }
+
+        if (success) {
+                m_alarm_q = xQueueCreate(ALARM_QUEUE_LENGTH,
+                                         sizeof(alarm_record_t));
+
+                success = (NULL != m_alarm_q);
+        }
+
+        if (success) {
+                success = sample_bus_subscribe(&m_subscriber, on_sample, NULL);
+        }
+
+        if (success) {
+                task_result = xTaskCreate((TaskFunction_t)uplink_task,
+                                          "uplink_task",
+                                          TASK_STACK_DEPTH,
+                                          NULL,
+                                          TASK_PRIORITY,
+                                          &m_uplink_task_h);
+
+                success = (pdPASS == task_result);
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Queue an alarm level change for sending, ahead of any telemetry
+ *
+ * Wakes the uplink task up right away. Changes are kept while there is no
+ * wifi connection, until the queue is full. Can be called from any task.
+ *
+ * @param[in]           p_record            Pointer to the level change
+ *
+ * @return              bool                False if the uplink isn't
+ *                                          initialized yet, or the queue is
+ *                                          full
+ */
+bool uplink_send_alarm(alarm_record_t const * const p_record)
+{
+        BaseType_t queue_result;
+        bool success = ((NULL != p_record) && (NULL != m_alarm_q));
+
+        if (success) {
+                queue_result = xQueueSend(m_alarm_q, p_record, 0);
+
+                success = (pdPASS == queue_result);
+        }
+
+        if ((success) && (NULL != m_uplink_task_h)) {
+                (void)xTaskNotifyGive(m_uplink_task_h);
+        }
+
+        return success;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Send a sample, or the aggregates of its sensor once they are due
+ *
+ * With aggregates configured, the one minute statistics of the sensor are
+ * sent at most once every `AGGREGATE_PERIOD_S`, instead of each reading.
+ * The statistics are the latest ones, which already account for the sample.
+ * Either way they are timestamped with the sample and batched.
+ *
+ * @param[in]           p_sample            Pointer to the sample
+ *
+ * @return              -                   -
+ */
+static void uplink_send_sample(sample_bus_sample_t const * const p_sample)
+{
+        uint8_t const sensor = p_sample->reading.sensor;
+#ifdef CONFIG_CO2_MONITOR_HTTP_STREAM_AGGREGATES
+        window_stats_summary_t summary;
+#endif
+
+        if (SENSOR_COUNT <= sensor) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+#ifdef CONFIG_CO2_MONITOR_HTTP_STREAM_AGGREGATES
+        // Overflow is meant to happen
+        if (((!m_is_aggregate_sent[sensor]) ||
+             ((p_sample->time_s - m_aggregate_time_s[sensor]) >=
+              AGGREGATE_PERIOD_S)) &&
+            (statistics_get(sensor, WINDOW_STATS_WINDOW_1_MIN, &summary))) {
+
+                uplink_send_aggregate(sensor, p_sample->time_s, &summary);
+
+                m_aggregate_time_s[sensor] = p_sample->time_s;
+                m_is_aggregate_sent[sensor] = true;
+        }
+#else
+        (void)snprintf(m_values,
+                       sizeof(m_values),
+                       m_post_data_template,
+                       m_sensor_key_suffixes[sensor],
+                       p_sample->reading.co2_ppm[READINGS_STREAM]);
+
+        uplink_batch_add(p_sample->time_s,
+                         m_values,
+                         UPLINK_CLASS_TELEMETRY,
+                         true);
+#endif
+}
+
+/*!
+ * @brief Send the aggregates of a sensor
+ *
+ * @param[in]           sensor              Index of the sensor
+ * @param[in]           time_s              Time of the aggregates (in seconds
+ *                                          since boot)
+ * @param[in]           p_summary           Pointer to the aggregates
+ *
+ * @return              -                   -
+ */
+static void uplink_send_aggregate(uint8_t const sensor,
+                                  uint32_t const time_s,
+                                  window_stats_summary_t const * const p_summary)
+{
+        char const * const p_suffix = m_sensor_key_suffixes[sensor];
+
+        (void)snprintf(m_values,
+                       sizeof(m_values),
+                       m_aggregate_data_template,
+                       p_suffix,
+                       p_summary->mean_ppm,
+                       p_suffix,
+                       p_summary->min_ppm,
+                       p_suffix,
+                       p_summary->max_ppm,
+                       p_suffix,
+                       p_summary->p95_ppm);
+
+        uplink_batch_add(time_s, m_values, UPLINK_CLASS_TELEMETRY, true);
+}
+
+/*!
+ * @brief Send the latest ventilation estimate of a sensor, if not sent yet
+ *
+ * Only the latest estimate is kept, so the ones replaced while offline are
+ * never sent.
+ *
+ * @param[in]           sensor              Index of the sensor
+ *
+ * @return              -                   -
+ */
+static void uplink_send_ventilation(uint8_t const sensor)
+{
+        char const * const p_suffix = m_sensor_key_suffixes[sensor];
+        ventilation_event_t event;
+
+        if ((!statistics_get_ventilation(sensor, &event)) ||
+            (m_ventilation_number[sensor] == event.number)) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        (void)snprintf(m_values,
+                       sizeof(m_values),
+                       m_ventilation_data_template,
+                       p_suffix,
+                       event.ach_centi / 100,
+                       event.ach_centi % 100,
+                       p_suffix,
+                       event.fit_percent,
+                       p_suffix,
+                       event.duration_s,
+                       p_suffix,
+                       event.start_ppm,
+                       p_suffix,
+                       event.end_ppm);
+
+        // Timestamped with the end of the decay
+        uplink_batch_add(event.start_time_s + event.duration_s,
+                         m_values,
+                         UPLINK_CLASS_EVENT,
+                         false);
+
+        m_ventilation_number[sensor] = event.number;
+}
+
+/*!
+ * @brief Send every alarm level change queued
+ *
+ * They are sent on their own, never batched. A change is only taken out of
+ * the queue once sent, so if sending fails it stays at the front, and it is
+ * sent again, in order, in the next cycle.
+ *
+ * @return              bool                Whether any change was sent
+ */
+static bool uplink_send_alarms(void)
+{
+        alarm_record_t record;
+        char const * p_suffix;
+        bool is_sent = false;
+        bool is_failed = false;
+
+        while ((!is_failed) &&
+               (pdTRUE == xQueuePeek(m_alarm_q, &record, 0))) {
+
+                p_suffix = m_sensor_key_suffixes[record.sensor];
+
+                (void)snprintf(m_values,
+                               sizeof(m_values),
+                               m_alarm_data_template,
+                               p_suffix,
+                               (unsigned int)record.event.level,
+                               p_suffix,
+                               record.event.ppm);
+
+                is_failed = !uplink_send(m_values, UPLINK_CLASS_ALARM);
+
+                if (!is_failed) {
+                        (void)xQueueReceive(m_alarm_q, &record, 0);
+                        is_sent = true;
+                }
+        }
+
+        return is_sent;
+}
+
+/*!
+ * @brief Send backlogged readings, if sending works
+ *
+ * At most `BACKLOG_DRAIN_RATE` readings are batched per call. They are only
+ * sent timestamped, so nothing is sent until the clock is synchronized.
+ * Readings of earlier boots are timestamped from the epoch of their own boot.
+ *
+ * Replayed readings are raw, as filtered readings can't be rebuilt, and a
+ * failed aggregate is sent as the raw readings it summarized. So they are
+ * sent under the `co2_concentration_raw` key, unless the live readings are
+ * raw too.
+ *
+ * @return              -                   -
+ */
+static void uplink_drain_backlog(void)
+{
+        uint32_t const now_s = (uint32_t)(esp_timer_get_time() / 1000000);
+
+        history_record_t record;
+        int64_t boot_epoch_ms;
+        int64_t epoch_ms;
+        uint32_t count;
+
+        if ((!m_is_sending) || (!wifi_get_epoch_ms(0, &boot_epoch_ms))) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        backlog_set_epoch(boot_epoch_ms);
+
+        for (count = 0; BACKLOG_DRAIN_RATE > count; ++count) {
+                // Readings are given back to the backlog only as a whole
+                // batch, so each one has to fit without sending the batch
+                if ((sizeof(m_batch) - m_batch_length) <
+                    (BATCH_ENTRY_MAX_LENGTH + 4)) {
+
+                        uplink_batch_flush();
+                }
+
+                if (!backlog_next(&record, &epoch_ms)) {
+                        break;
+                }
+
+                if (SENSOR_COUNT <= record.sensor) {
+                        continue;
+                }
+
+                (void)snprintf(m_values,
+                               sizeof(m_values),
+                               m_backlog_data_template,
+                               m_sensor_key_suffixes[record.sensor],
+                               record.co2_ppm);
+
+                uplink_batch_insert(now_s,
+                                    epoch_ms,
+                                    m_values,
+                                    UPLINK_CLASS_TELEMETRY,
+                                    UPLINK_SOURCE_BACKLOG);
+        }
+}
+
+/*!
+ * @brief Drop every unread sample, adding them to the backlog
+ *
+ * @return              -                   -
+ */
+static void uplink_skip_samples(void)
+{
+        sample_bus_sample_t const * p_sample;
+        uint32_t time_s;
+
+        p_sample = sample_bus_peek(&m_subscriber);
+
+        while (NULL != p_sample) {
+                time_s = p_sample->time_s;
+
+                if (sample_bus_release(&m_subscriber)) {
+                        backlog_add(time_s, time_s, 1);
+                }
+
+                p_sample = sample_bus_peek(&m_subscriber);
+        }
+}
+
+/*!
+ * @brief Add telemetry to the batch, sending the batch once full
+ *
+ * Until the clock is synchronized, entries can't be timestamped, so they are
+ * sent right away instead, and the server timestamps them on arrival.
+ *
+ * @param[in]           time_s              Time of the telemetry (in seconds
+ *                                          since boot)
+ * @param[in]           p_values            JSON telemetry object, null
+ *                                          terminated
+ * @param[in]           message_class       Class of the telemetry
+ * @param[in]           is_reading          Whether the telemetry stands for
+ *                                          readings, which are backlogged if
+ *                                          it can't be sent
+ *
+ * @return              -                   -
+ */
+static void uplink_batch_add(uint32_t const time_s,
+                             char const * const p_values,
+                             uplink_class_t const message_class,
+                             bool const is_reading)
+{
+        int64_t epoch_ms;
+
+        if (wifi_get_epoch_ms(time_s, &epoch_ms)) {
+                uplink_batch_insert(time_s,
+                                    epoch_ms,
+                                    p_values,
+                                    message_class,
+                                    (is_reading) ?
+                                    UPLINK_SOURCE_READINGS : UPLINK_SOURCE_LIVE);
+        } else if ((!uplink_send(p_values, message_class)) && (is_reading)) {
+                backlog_add(readings_from_s(time_s), time_s, 1);
+        }
+}
+
+/*!
+ * @brief Add timestamped telemetry to the batch, sending the batch once full
+ *
+ * @param[in]           time_s              Time the telemetry is batched at,
+ *                                          the batch ages from its first
+ *                                          entry, and time of the readings
+ *                                          for live ones (in seconds since
+ *                                          boot)
+ * @param[in]           epoch_ms            Timestamp of the telemetry (in
+ *                                          milliseconds since the epoch)
+ * @param[in]           p_values            JSON telemetry object, null
+ *                                          terminated
+ * @param[in]           message_class       Class of the telemetry
+ * @param[in]           source              What the telemetry stands for
+ *
+ * @return              -                   -
+ */
+static void uplink_batch_insert(uint32_t const time_s,
+                                int64_t const epoch_ms,
+                                char const * const p_values,
+                                uplink_class_t const message_class,
+                                uplink_source_t const source)
+{
+        bool const is_reading = (UPLINK_SOURCE_READINGS == source);
+
+        size_t available;
+        int length;
+
+        // Serialized in place, after the separator, keeping room for the
+        // closing bracket and the terminator
+        available = sizeof(m_batch) - m_batch_length - 2;
+
+        length = snprintf(&m_batch[m_batch_length + 1],
+                          available - 1,
+                          m_batch_entry_template,
+                          (long long)epoch_ms,
+                          p_values);
+
+        if ((0 <= length) && ((available - 1) <= (size_t)length) &&
+            (0 != m_batch_count)) {
+
+                uplink_batch_flush();
+
+                available = sizeof(m_batch) - 2;
+
+                length = snprintf(&m_batch[1],
+                                  available - 1,
+                                  m_batch_entry_template,
+                                  (long long)epoch_ms,
+                                  p_values);
+        }
+
+        if ((0 > length) || ((available - 1) <= (size_t)length)) {
+                ESP_LOGE(TAG, "Telemetry entry too long, dropped");
+
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        if (0 == m_batch_count) {
+                m_batch[m_batch_length] = '[';
+                m_batch_time_s = time_s;
+                m_batch_class = message_class;
+        } else {
+                m_batch[m_batch_length] = ',';
+
+                if (message_class > m_batch_class) {
+                        m_batch_class = message_class;
+                }
+        }
+
+        if ((is_reading) && (0 == m_batch_readings)) {
+                m_batch_from_s = readings_from_s(time_s);
+                m_batch_to_s = time_s;
+        } else if (is_reading) {
+                if (readings_from_s(time_s) < m_batch_from_s) {
+                        m_batch_from_s = readings_from_s(time_s);
+                }
+
+                if (time_s > m_batch_to_s) {
+                        m_batch_to_s = time_s;
+                }
+        }
+
+        if (is_reading) {
+                ++m_batch_readings;
+        }
+
+        if (UPLINK_SOURCE_BACKLOG == source) {
+                ++m_batch_replayed;
+        }
+
+        m_batch_length += 1 + (size_t)length;
+        ++m_batch_count;
+
+        if (BATCH_SIZE <= m_batch_count) {
+                uplink_batch_flush();
+        }
+}
+
+/*!
+ * @brief Send the batch, if not empty
+ *
+ * The batch is emptied even if sending it fails, its live readings are added
+ * to the backlog instead, and the ones taken from the backlog are given back.
+ *
+ * @return              -                   -
+ */
+static void uplink_batch_flush(void)
+{
+        bool is_sent;
+
+        if (0 == m_batch_count) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        m_batch[m_batch_length++] = ']';
+        m_batch[m_batch_length] = '\0';
+
+        ESP_LOGI(TAG, "Sending %u telemetry entries", (unsigned int)m_batch_count);
+
+        is_sent = uplink_send(m_batch, m_batch_class);
+
+        if ((!is_sent) && (0 != m_batch_readings)) {
+                backlog_add(m_batch_from_s, m_batch_to_s, m_batch_readings);
+        }
+
+        if ((is_sent) && (0 != m_batch_replayed)) {
+                backlog_commit();
+        } else if (0 != m_batch_replayed) {
+                backlog_rewind();
+        }
+
+        m_batch_length = 0;
+        m_batch_count = 0;
+        m_batch_readings = 0;
+        m_batch_replayed = 0;
+}
+
+/*!
+ * @brief Send the batch if its oldest entry is too old
+ *
+ * @return              -                   -
+ */
+static void uplink_batch_flush_aged(void)
+{
+        uint32_t const now_s = (uint32_t)(esp_timer_get_time() / 1000000);
+
+        // Overflow is meant to happen
+        if ((0 != m_batch_count) &&
+            ((now_s - m_batch_time_s) >= BATCH_MAX_AGE_S)) {
+
+                uplink_batch_flush();
+        }
+}
+
+/*!
+ * @brief Time of the first reading a telemetry entry stands for
+ *
+ * @param[in]           time_s              Time of the entry (in seconds since
+ *                                          boot)
+ *
+ * @return              uint32_t            Time of the first reading (in
+ *                                          seconds since boot)
+ */
+static uint32_t readings_from_s(uint32_t const time_s)
+{
+        return (READINGS_SPAN_S < time_s) ? (time_s - READINGS_SPAN_S) : 0;
+}
+
+/*!
+ * @brief Send telemetry through the configured transport
+ *
+ * Over MQTT, routine telemetry is published with QoS 0, events and alarms
+ * with QoS 1, and only alarms can take the in flight slots kept for urgent
+ * messages. Over CoAP, routine telemetry is posted non-confirmable, events
+ * and alarms confirmable. Over HTTP every post is acknowledged anyway.
+ *
+ * @param[in]           p_payload           JSON telemetry, null terminated
+ * @param[in]           message_class       Class of the telemetry
+ *
+ * @return              bool                Whether it could be sent
+ */
+static bool uplink_send(char const * const p_payload,
+                        uplink_class_t const message_class)
+{
+        bool success;
+
+#if defined(CONFIG_CO2_MONITOR_UPLINK_MQTT)
+        success = mqtt_publish(p_payload,
+                               (UPLINK_CLASS_TELEMETRY == message_class) ?
+                               MQTT_QOS_AT_MOST_ONCE : MQTT_QOS_AT_LEAST_ONCE,
+                               (UPLINK_CLASS_ALARM == message_class));
+#elif defined(CONFIG_CO2_MONITOR_UPLINK_COAP)
+        success = coap_client_post(p_payload,
+                                   (UPLINK_CLASS_TELEMETRY != message_class));
+#else
+        (void)message_class;
+
+        success = http_post(p_payload);
+#endif
+
+        if (!success) {
+                ESP_LOGW(TAG, "Telemetry couldn't be sent");
+        }
+
+        m_is_sending = success;
+
+        return success;
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Uplink task
+ *
+ * Sleeps until new samples are published in the sample bus, and batches
+ * them straight from the bus slots, oldest first, or the aggregates of their
+ * sensor if configured so, followed by any new ventilation estimate. The
+ * batch is sent once full, once its oldest entry is `BATCH_MAX_AGE_S` old,
+ * or right after an alarm. Samples published while there is no wifi
+ * connection, as well as batches which couldn't be sent, are added to the
+ * backlog, and up to `BACKLOG_DRAIN_RATE` backlogged readings are batched
+ * per cycle, after the live telemetry, once sending works again.
+ *
+ * Alarm level changes also wake it up, and are sent first, as well as
+ * between samples, so they only wait for the message in progress, if any.
+ *
+ * @param               pvParameter         Not used
+ *
+ * @return              -                   -
+ */
+_Noreturn static void uplink_task(void *pvParameter)
+{
+        (void)pvParameter;
+        sample_bus_sample_t const * p_sample;
+        wifi_status_t wifi_status;
+#if defined(CONFIG_CO2_MONITOR_UPLINK_MQTT)
+        mqtt_stats_t stats;
+#elif defined(CONFIG_CO2_MONITOR_UPLINK_COAP)
+        coap_client_stats_t stats;
+#else
+        http_stats_t stats;
+#endif
+        backlog_stats_t backlog_stats;
+        uint8_t sensor;
+
+        for (;;) {
+                (void)ulTaskNotifyTake(pdTRUE, TASK_REFRESH_RATE_TICKS);
+
+                wifi_status = wifi_get_status();
+
+                if (WIFI_STATUS_CONNECTED != wifi_status) {
+                        uplink_skip_samples();
+
+                        // Code style exception for the shake of readability
+                        continue;
+                }
+
+                if (uplink_send_alarms()) {
+                        uplink_batch_flush();
+                }
+
+                p_sample = sample_bus_peek(&m_subscriber);
+
+                while (NULL != p_sample) {
+                        uplink_send_sample(p_sample);
+
+                        if (!sample_bus_release(&m_subscriber)) {
+                                ESP_LOGW(TAG, "Sample overwritten while being sent");
+                        }
+
+                        if (uplink_send_alarms()) {
+                                uplink_batch_flush();
+                        }
+
+                        p_sample = sample_bus_peek(&m_subscriber);
+                }
+
+                for (sensor = 0; SENSOR_COUNT > sensor; ++sensor) {
+                        uplink_send_ventilation(sensor);
+                }
+
+                uplink_drain_backlog();
+
+                uplink_batch_flush_aged();
+
+#if defined(CONFIG_CO2_MONITOR_UPLINK_MQTT)
+                (void)mqtt_get_stats(&stats);
+
+                ESP_LOGI(TAG, "Published: %u, acknowledged: %u, in flight: %u, "
+                         "dropped: %u, connections: %u",
+                         stats.published,
+                         stats.acknowledged,
+                         stats.in_flight,
+                         stats.dropped,
+                         stats.connections);
+#elif defined(CONFIG_CO2_MONITOR_UPLINK_COAP)
+                (void)coap_client_get_stats(&stats);
+
+                ESP_LOGI(TAG, "Posts: %u, acknowledged: %u, failed: %u, sessions: %u",
+                         stats.posts,
+                         stats.acknowledged,
+                         stats.failures,
+                         stats.sessions);
+#else
+                (void)http_get_stats(&stats);
+
+                ESP_LOGI(TAG, "Posts: %u, reused: %u, connections: %u, failed: %u",
+                         stats.posts,
+                         stats.reused,
+                         stats.connections,
+                         stats.failures);
+#endif
+
+                (void)backlog_get_stats(&backlog_stats);
+
+                ESP_LOGI(TAG, "Backlog: %u readings, %u sent, %u from flash, "
+                         "%u dropped, %u earlier boots",
+                         backlog_stats.depth,
+                         backlog_stats.drained,
+                         backlog_stats.from_flash,
+                         backlog_stats.dropped,
+                         backlog_stats.boots);
+
+                ESP_LOGI(TAG,"Max stack usage: %d of %d bytes", TASK_STACK_DEPTH - uxTaskGetStackHighWaterMark(NULL), TASK_STACK_DEPTH);
+        }
+}
+
+/*!
+ * @brief Wake the uplink task up when a new sample is published
+ *
+ * @param[in]           p_context           Not used
+ *
+ * @return              -                   -
+ */
+static void on_sample(void * const p_context)
+{
+        (void)p_context;
+
+        if (NULL != m_uplink_task_h) {
+                (void)xTaskNotifyGive(m_uplink_task_h);
+        }
+}
@@ -0,0 +1,56 @@
+/*!
+ *******************************************************************************
+ * @file uplink.h
+ *
+ * @brief Telemetry uplink to the Thingsboard server
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef UPLINK_H
+#define UPLINK_H
+
+#include <stdbool.h>
+
+#include "alarm.h"
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize the uplink and its transport
+bool uplink_init(void);
+
+//! @brief Queue an alarm level change for sending, ahead of any telemetry
+bool uplink_send_alarm(alarm_record_t const * const p_record);
+
+#endif //UPLINK_H
@@ -0,0 +1,361 @@
+/*!
+ *******************************************************************************
+ * @file ventilation.c
+ *
+ * @brief Ventilation rate estimation from the CO2 decay curves
+ *
+ * Once nobody is producing CO2 in a room, its concentration decays towards the
+ * outdoor one as C(t) = C_out + (C_0 - C_out) * e^(-ACH * t), ACH being the
+ * air changes per hour. The logarithm of the excess over outdoors is then a
+ * straight line, with a slope of -ACH, so it is fitted by least squares, kept
+ * as running sums: each sample costs constant time and memory.
+ *
+ * Decays are told from the stream:
+ * - A decay starts when the concentration falls some ppm below its peak, and
+ *   is still well above outdoors.
+ * - It ends when the concentration rises again above the lowest one of the
+ *   decay (somebody is back, or the ventilation stopped), or gets too close to
+ *   outdoors to tell the excess from the noise.
+ * - Decays which are too short, or whose samples don't follow an exponential,
+ *   are dropped. The rest are reported as an event, once they end.
+ *
+ * The samples are expected to be already filtered. The estimate is only as
+ * good as the outdoor concentration configured: the further the real one is
+ * from it, the more the fit bends at the end of the decay.
+ *
+ * It doesn't depend on any framework, so it builds for the target as well as
+ * for a Linux host.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#include "ventilation.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Fall below the peak starting a decay (in ppm)
+#define START_DROP_PPM                      (50)
+
+//! @brief Least excess over outdoors to start a decay (in ppm)
+#define START_MIN_EXCESS_PPM                (200)
+
+//! @brief Least excess over outdoors fitted (in ppm)
+#define MIN_EXCESS_PPM                      (40)
+
+//! @brief Rise over the lowest sample of a decay ending it (in ppm)
+#define END_RISE_PPM                        (30)
+
+//! @brief Shortest decay reported (in seconds)
+#define MIN_DURATION_S                      (15 * 60)
+
+//! @brief Fewest samples of a decay reported
+#define MIN_SAMPLES                         (5)
+
+//! @brief Least coefficient of determination of a decay reported
+#define MIN_FIT                             (0.8)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Start fitting a decay
+static void decay_start(ventilation_t * const p_estimator,
+                        uint32_t const time_s,
+                        uint16_t const ppm);
+
+//! @brief Add a sample to the decay fit
+static void decay_add(ventilation_t * const p_estimator,
+                      uint32_t const time_s,
+                      uint16_t const ppm);
+
+//! @brief Stop fitting a decay, telling whether it makes an event
+static bool decay_finish(ventilation_t * const p_estimator,
+                         ventilation_event_t * const p_event);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize an estimator instance
+ *
+ * @param[out]          p_estimator         Pointer to the estimator instance
+ * @param[in]           p_config            Pointer to the configuration
+ *
+ * @return              bool                Operation result, fails if the
+ *                                          outdoor concentration is 0
+ */
+bool ventilation_init(ventilation_t * const p_estimator,
+                      ventilation_config_t const * const p_config)
+{
+        bool success = ((NULL != p_estimator) &&
+                        (NULL != p_config) &&
+                        (0 != p_config->outdoor_ppm));
+
+        if (success) {
+                memset(p_estimator, 0, sizeof(*p_estimator));
+                p_estimator->config = *p_config;
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Feed a new sample, telling whether it completed a decay event
+ *
+ * A sample coming after a gap longer than configured drops the decay being
+ * fitted, if any.
+ *
+ * @param[in,out]       p_estimator         Pointer to the estimator instance
+ * @param[in]           time_s              Sample time (in seconds)
+ * @param[in]           ppm                 Sampled concentration (in ppm)
+ * @param[out]          p_event             Pointer where to copy the event
+ *
+ * @return              bool                Whether a decay event ended, and
+ *                                          was copied into `p_event`
+ */
+bool ventilation_update(ventilation_t * const p_estimator,
+                        uint32_t const time_s,
+                        uint16_t const ppm,
+                        ventilation_event_t * const p_event)
+{
+        uint32_t outdoor_ppm;
+        uint32_t max_gap_s;
+        bool is_event = false;
+
+        if ((NULL == p_estimator) || (NULL == p_event)) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        outdoor_ppm = p_estimator->config.outdoor_ppm;
+        max_gap_s = p_estimator->config.max_gap_s;
+
+        // Overflow is meant to happen
+        if ((p_estimator->has_samples) &&
+            (0 != max_gap_s) &&
+            ((time_s - p_estimator->last_time_s) > max_gap_s)) {
+
+                ventilation_reset(p_estimator);
+        }
+
+        if (!p_estimator->has_samples) {
+                p_estimator->has_samples = true;
+                p_estimator->peak_ppm = ppm;
+        }
+
+        p_estimator->last_time_s = time_s;
+
+        if (p_estimator->is_decaying) {
+                if ((ppm > (p_estimator->lowest_ppm + END_RISE_PPM)) ||
+                    (ppm < (outdoor_ppm + MIN_EXCESS_PPM))) {
+
+                        is_event = decay_finish(p_estimator, p_event);
+                        p_estimator->peak_ppm = ppm;
+                } else {
+                        decay_add(p_estimator, time_s, ppm);
+                }
+        } else if (ppm > p_estimator->peak_ppm) {
+                p_estimator->peak_ppm = ppm;
+        } else if ((ppm <= (p_estimator->peak_ppm - START_DROP_PPM)) &&
+                   (ppm >= (outdoor_ppm + START_MIN_EXCESS_PPM))) {
+
+                decay_start(p_estimator, time_s, ppm);
+        }
+
+        return is_event;
+}
+
+/*!
+ * @brief Forget the samples fed so far
+ *
+ * The decay being fitted, if any, is dropped
+ *
+ * @param[in,out]       p_estimator         Pointer to the estimator instance
+ *
+ * @return              -                   -
+ */
+void ventilation_reset(ventilation_t * const p_estimator)
+{
+        if (NULL != p_estimator) {
+                p_estimator->has_samples = false;
+                p_estimator->is_decaying = false;
+        }
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Start fitting a decay
+ *
+ * @param[in,out]       p_estimator         Pointer to the estimator instance
+ * @param[in]           time_s              Time of the first sample
+ * @param[in]           ppm                 First sample, above outdoors
+ *
+ * @return              -                   -
+ */
+static void decay_start(ventilation_t * const p_estimator,
+                        uint32_t const time_s,
+                        uint16_t const ppm)
+{
+        p_estimator->is_decaying = true;
+        p_estimator->start_time_s = time_s;
+        p_estimator->start_ppm = ppm;
+        p_estimator->lowest_ppm = ppm;
+        p_estimator->count = 0;
+        p_estimator->sum_t = 0.0;
+        p_estimator->sum_y = 0.0;
+        p_estimator->sum_tt = 0.0;
+        p_estimator->sum_ty = 0.0;
+        p_estimator->sum_yy = 0.0;
+
+        decay_add(p_estimator, time_s, ppm);
+}
+
+/*!
+ * @brief Add a sample to the decay fit
+ *
+ * @param[in,out]       p_estimator         Pointer to the estimator instance
+ * @param[in]           time_s              Sample time
+ * @param[in]           ppm                 Sample, above outdoors
+ *
+ * @return              -                   -
+ */
+static void decay_add(ventilation_t * const p_estimator,
+                      uint32_t const time_s,
+                      uint16_t const ppm)
+{
+        double const t = (double)(time_s - p_estimator->start_time_s);
+        double const y = log((double)(ppm - p_estimator->config.outdoor_ppm));
+
+        p_estimator->sum_t += t;
+        p_estimator->sum_y += y;
+        p_estimator->sum_tt += t * t;
+        p_estimator->sum_ty += t * y;
+        p_estimator->sum_yy += y * y;
+        ++p_estimator->count;
+
+        p_estimator->end_time_s = time_s;
+        p_estimator->end_ppm = ppm;
+
+        if (p_estimator->lowest_ppm > ppm) {
+                p_estimator->lowest_ppm = ppm;
+        }
+}
+
+/*!
+ * @brief Stop fitting a decay, telling whether it makes an event
+ *
+ * @param[in,out]       p_estimator         Pointer to the estimator instance
+ * @param[out]          p_event             Pointer where to copy the event
+ *
+ * @return              bool                Whether the decay makes an event
+ */
+static bool decay_finish(ventilation_t * const p_estimator,
+                         ventilation_event_t * const p_event)
+{
+        double const n = (double)p_estimator->count;
+        double const sum_t = p_estimator->sum_t;
+        double const sum_y = p_estimator->sum_y;
+        double t_spread = 0.0;
+        double y_spread = 0.0;
+        double covariance = 0.0;
+        double slope = 0.0;
+        double fit = 0.0;
+        uint32_t duration_s;
+        bool is_event;
+
+        p_estimator->is_decaying = false;
+
+        duration_s = p_estimator->end_time_s - p_estimator->start_time_s;
+
+        is_event = (MIN_SAMPLES <= p_estimator->count) &&
+                   (MIN_DURATION_S <= duration_s);
+
+        // Sums scaled by n, so they don't need a division each
+        if (is_event) {
+                t_spread = (n * p_estimator->sum_tt) - (sum_t * sum_t);
+                y_spread = (n * p_estimator->sum_yy) - (sum_y * sum_y);
+                covariance = (n * p_estimator->sum_ty) - (sum_t * sum_y);
+
+                is_event = (0.0 < t_spread) && (0.0 < y_spread) &&
+                           (0.0 > covariance);
+        }
+
+        if (is_event) {
+                slope = covariance / t_spread;
+                fit = (covariance * covariance) / (t_spread * y_spread);
+
+                is_event = (MIN_FIT <= fit);
+        }
+
+        if (is_event) {
+                ++p_estimator->events;
+
+                p_event->number = p_estimator->events;
+                p_event->start_time_s = p_estimator->start_time_s;
+                p_event->duration_s = duration_s;
+                p_event->start_ppm = p_estimator->start_ppm;
+                p_event->end_ppm = p_estimator->end_ppm;
+                p_event->samples = (UINT16_MAX < p_estimator->count) ?
+                                   UINT16_MAX : (uint16_t)p_estimator->count;
+                p_event->ach_centi = (uint32_t)((-slope * 3600.0 * 100.0) + 0.5);
+                p_event->fit_percent = (uint8_t)((fit * 100.0) + 0.5);
+        }
+
+        return is_event;
+}
@@ -0,0 +1,160 @@
+/*!
+ *******************************************************************************
+ * @file ventilation.h
+ *
+ * @brief Ventilation rate estimation from the CO2 decay curves
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef VENTILATION_H
+#define VENTILATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Estimator configuration
+typedef struct {
+        //! @brief Outdoor CO2 concentration the room decays towards (in ppm)
+        uint16_t outdoor_ppm;
+
+        //! @brief Time between samples after which a decay is given up, as
+        //!        it can't be told what happened in between (in seconds, 0
+        //!        for never)
+        uint32_t max_gap_s;
+} ventilation_config_t;
+
+//! @brief Decay period with its estimated ventilation rate
+typedef struct {
+        //! @brief Events found so far, this one included
+        uint32_t number;
+
+        //! @brief Time of the first sample of the decay (in seconds)
+        uint32_t start_time_s;
+
+        //! @brief Time between the first and the last sample of the decay (in
+        //!        seconds)
+        uint32_t duration_s;
+
+        //! @brief Concentration at the start of the decay (in ppm)
+        uint16_t start_ppm;
+
+        //! @brief Concentration at the end of the decay (in ppm)
+        uint16_t end_ppm;
+
+        //! @brief Samples the rate is estimated from
+        uint16_t samples;
+
+        //! @brief Air changes per hour (in hundredths)
+        uint32_t ach_centi;
+
+        //! @brief Coefficient of determination of the fit (in percent)
+        uint8_t fit_percent;
+} ventilation_event_t;
+
+/*!
+ * @brief Estimator instance, for a single series of samples
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Estimator configuration
+        ventilation_config_t config;
+
+        //! @brief Whether any sample has been fed since the last reset
+        bool has_samples;
+
+        //! @brief Time of the last sample (in seconds)
+        uint32_t last_time_s;
+
+        //! @brief Highest sample since the last decay, while not decaying
+        uint16_t peak_ppm;
+
+        //! @brief Whether a decay is being fitted
+        bool is_decaying;
+
+        //! @brief Time of the first sample of the decay (in seconds)
+        uint32_t start_time_s;
+
+        //! @brief First sample of the decay (in ppm)
+        uint16_t start_ppm;
+
+        //! @brief Time of the last sample of the decay (in seconds)
+        uint32_t end_time_s;
+
+        //! @brief Last sample of the decay (in ppm)
+        uint16_t end_ppm;
+
+        //! @brief Lowest sample of the decay (in ppm)
+        uint16_t lowest_ppm;
+
+        //! @brief Samples of the decay
+        uint32_t count;
+
+        //! @brief Sum of the sample times, relative to `start_time_s`
+        double sum_t;
+
+        //! @brief Sum of the logarithms of the concentration over outdoors
+        double sum_y;
+
+        //! @brief Sum of the squared sample times
+        double sum_tt;
+
+        //! @brief Sum of the sample times by the logarithms
+        double sum_ty;
+
+        //! @brief Sum of the squared logarithms
+        double sum_yy;
+
+        //! @brief Events found so far
+        uint32_t events;
+} ventilation_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize an estimator instance
+bool ventilation_init(ventilation_t * const p_estimator,
+                      ventilation_config_t const * const p_config);
+
+//! @brief Feed a new sample, telling whether it completed a decay event
+bool ventilation_update(ventilation_t * const p_estimator,
+                        uint32_t const time_s,
+                        uint16_t const ppm,
+                        ventilation_event_t * const p_event);
+
+//! @brief Forget the samples fed so far
+void ventilation_reset(ventilation_t * const p_estimator);
+
+#endif //VENTILATION_H
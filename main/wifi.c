@@ -21,8 +21,11 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <sys/time.h>
 #include <esp_log.h>
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_sntp.h"
 #include "esp_freertos_hooks.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -31,6 +34,7 @@
 #include "esp_wifi.h"
 #include "esp_netif.h"
 #include "display.h"
+#include "device_state.h"
 #include "esp_http_client.h"
 
 #include "wifi_manager.h"
@@ -44,6 +48,12 @@
 
 #define TAG "WiFi"
 
+#define SNTP_SERVER                         CONFIG_CO2_MONITOR_SNTP_SERVER
+
+//! @brief Seconds since the epoch the clock is taken as synchronized after
+//!        (2022-01-01), before that it still counts from boot
+#define SYNCHRONIZED_EPOCH_S                (1640995200LL)
+
 /*
  *******************************************************************************
  * Data types                                                                  *
@@ -70,6 +80,9 @@ static void wifi_report_status(void);
 static void wifi_set_connection_status_active(void * p_param);
 
 static void wifi_set_connection_status_inactive(void * p_param);
+
+//! @brief Start synchronizing the clock, if not started yet
+static void wifi_start_sntp(void);
 /*
  *******************************************************************************
  * Public Data Declarations                                                    *
@@ -126,6 +139,39 @@ wifi_status_t wifi_get_status(void) {
         return m_wifi_status;
 }
 
+/*!
+ * @brief Convert a time since boot into milliseconds since the epoch
+ *
+ * @param[in]           time_s              Time since boot (in seconds)
+ * @param[out]          p_epoch_ms          Pointer where to copy the time
+ *                                          since the epoch (in milliseconds)
+ *
+ * @return              bool                False until the clock has been
+ *                                          synchronized
+ */
+bool wifi_get_epoch_ms(uint32_t const time_s, int64_t * const p_epoch_ms)
+{
+        struct timeval now;
+        int64_t boot_ms;
+        int64_t now_ms;
+        bool success;
+
+        now_ms = esp_timer_get_time() / 1000;
+        (void)gettimeofday(&now, NULL);
+
+        success = ((NULL != p_epoch_ms) &&
+                   (SYNCHRONIZED_EPOCH_S <= (int64_t)now.tv_sec));
+
+        if (success) {
+                boot_ms = (((int64_t)now.tv_sec * 1000) +
+                           (now.tv_usec / 1000)) - now_ms;
+
+                *p_epoch_ms = boot_ms + ((int64_t)time_s * 1000);
+        }
+
+        return success;
+}
+
 /*
  *******************************************************************************
  * Private Function Bodies                                                     *
@@ -145,9 +191,32 @@ static void wifi_set_connection_status_active(void * p_param)
         (void)p_param;
         m_wifi_status = WIFI_STATUS_CONNECTED;
 
+        wifi_start_sntp();
         wifi_report_status();
 }
 
+/*!
+ * @brief Start synchronizing the clock, if not started yet
+ *
+ * Once started, SNTP keeps polling the server on its own, also across
+ * reconnections.
+ *
+ * @return              -                   -
+ */
+static void wifi_start_sntp(void)
+{
+        if (sntp_enabled()) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        ESP_LOGI(TAG, "Synchronizing the clock with %s", SNTP_SERVER);
+
+        sntp_setoperatingmode(SNTP_OPMODE_POLL);
+        sntp_setservername(0, SNTP_SERVER);
+        sntp_init();
+}
+
 /*
  *******************************************************************************
  * Interrupt Service Routines / Tasks / Thread Main Functions                  *
@@ -177,6 +246,7 @@ static void wifi_report_status(void)
                 memcpy(disp_wifi_status.ap_ssid, ap.ssid, strlen((char *)ap.ssid));
         }
 
+        device_state_set_wifi(m_wifi_status, &disp_wifi_status);
         display_set_wifi_status(disp_wifi_status);
 
         ESP_LOGI(TAG, "IP: " IPSTR ", RSSI: %d", IP2STR(&ip_info.ip), disp_wifi_status.rssi);
@@ -17,6 +17,9 @@
 #ifndef WIFI_H
 #define WIFI_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
 /*
  *******************************************************************************
  * Public Macros                                                               *
@@ -54,5 +57,8 @@ bool wifi_init();
 
 wifi_status_t wifi_get_status(void);
 
+//! @brief Convert a time since boot into milliseconds since the epoch
+bool wifi_get_epoch_ms(uint32_t const time_s, int64_t * const p_epoch_ms);
+
 
 #endif //WIFI_H
\ No newline at end of file
@@ -0,0 +1,640 @@
+/*!
+ *******************************************************************************
+ * @file window_stats.c
+ *
+ * @brief Rolling statistics of the CO2 readings over fixed time windows
+ *
+ * The last minute, fifteen minutes and hour of samples are tracked at once.
+ * Every window holds the newest samples of a single sample ring, so each
+ * sample is stored once. Feeding a sample drops the ones that went out of
+ * each window and adds the new one, in constant time (amortized) and fixed
+ * memory:
+ * - Mean: running sum of the samples in the window.
+ * - Minimum and maximum: monotonic deques of the samples which could still
+ *   become the lowest or highest one, so the answer is always at their front.
+ * - Percentiles: histogram of fixed width buckets, updated as samples come
+ *   and go. The rank is looked up by walking the buckets, and samples are
+ *   taken as evenly spread within their bucket.
+ *
+ * Windows keep at most the samples taken at the fastest default sampling
+ * period (10 seconds). When sampling faster, the oldest samples are dropped
+ * before their time, and the window covers less time, as told by its span.
+ *
+ * The trend is the slope between the centroids (mean time, mean value) of
+ * the one minute and the fifteen minutes windows, which filters the noise of
+ * a single sample, unlike the difference between the two last ones.
+ *
+ * It doesn't depend on any framework, so it builds for the target as well as
+ * for a Linux host.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "window_stats.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+//! @brief Size of the sample ring, enough for the longest window
+#define SAMPLE_CAPACITY                     (WINDOW_STATS_1_HOUR_MAX_SAMPLES)
+
+//! @brief Percentile reported in the window summary
+#define SUMMARY_PERCENTILE                  (95)
+
+//! @brief Window the newest centroid of the trend is taken from
+#define TREND_SHORT_WINDOW                  (WINDOW_STATS_WINDOW_1_MIN)
+
+//! @brief Window the oldest centroid of the trend is taken from
+#define TREND_LONG_WINDOW                   (WINDOW_STATS_WINDOW_15_MIN)
+
+//! @brief Shortest time between centroids to tell a trend (in seconds)
+#define TREND_MIN_SEPARATION_S              (60)
+
+#if (UINT16_MAX < SAMPLE_CAPACITY)
+#error "Sample positions don't fit in the deques"
+#endif
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+//! @brief Length of each window (in seconds)
+static uint32_t const m_window_lengths_s[WINDOW_STATS_WINDOW_COUNT] = {
+                60,
+                15 * 60,
+                60 * 60,
+};
+
+//! @brief Most samples kept in each window
+static uint16_t const m_window_capacities[WINDOW_STATS_WINDOW_COUNT] = {
+                WINDOW_STATS_1_MIN_MAX_SAMPLES,
+                WINDOW_STATS_15_MIN_MAX_SAMPLES,
+                WINDOW_STATS_1_HOUR_MAX_SAMPLES,
+};
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Position in the sample ring of a sample, counting back from newest
+static uint16_t ring_position(window_stats_t const * const p_stats,
+                              uint16_t const age);
+
+//! @brief Add the newest sample of the ring to a window
+static void window_push(window_stats_t * const p_stats,
+                        window_stats_window_state_t * const p_window,
+                        uint16_t const position);
+
+//! @brief Drop the oldest sample of a window
+static void window_pop(window_stats_t * const p_stats,
+                       window_stats_window_state_t * const p_window);
+
+//! @brief Approximate percentile of a window with samples
+static uint16_t window_percentile(window_stats_t const * const p_stats,
+                                  window_stats_window_state_t const * const p_window,
+                                  uint8_t const percent);
+
+//! @brief Histogram bucket a sample falls in
+static size_t histogram_bucket(uint16_t const ppm);
+
+//! @brief Get an item of a deque, counting from the oldest one
+static uint16_t deque_at(window_stats_deque_t const * const p_deque,
+                         uint16_t const index);
+
+//! @brief Append an item to a deque
+static void deque_push_back(window_stats_deque_t * const p_deque,
+                            uint16_t const position);
+
+//! @brief Drop the oldest item of a deque
+static void deque_pop_front(window_stats_deque_t * const p_deque);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize a statistics instance
+ *
+ * @param[out]          p_stats             Pointer to the statistics instance
+ *
+ * @return              bool                Operation result
+ */
+bool window_stats_init(window_stats_t * const p_stats)
+{
+        window_stats_window_state_t * p_window;
+        uint16_t * p_items;
+        size_t i;
+
+        if (NULL == p_stats) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        memset(p_stats, 0, sizeof(*p_stats));
+
+        p_items = p_stats->deque_items;
+
+        for (i = 0; WINDOW_STATS_WINDOW_COUNT > i; ++i) {
+                p_window = &p_stats->windows[i];
+
+                p_window->capacity = m_window_capacities[i];
+
+                p_window->min_deque.p_items = p_items;
+                p_window->min_deque.capacity = p_window->capacity;
+                p_items += p_window->capacity;
+
+                p_window->max_deque.p_items = p_items;
+                p_window->max_deque.capacity = p_window->capacity;
+                p_items += p_window->capacity;
+        }
+
+        return true;
+}
+
+/*!
+ * @brief Feed a new sample
+ *
+ * A sample coming after a gap longer than the longest window restarts the
+ * statistics. A sample older than the newest one is taken as simultaneous.
+ *
+ * @param[in,out]       p_stats             Pointer to the statistics instance
+ * @param[in]           time_s              Sample time (in seconds)
+ * @param[in]           ppm                 Sampled concentration (in ppm)
+ *
+ * @return              -                   -
+ */
+void window_stats_update(window_stats_t * const p_stats,
+                         uint32_t const time_s,
+                         uint16_t const ppm)
+{
+        uint32_t const longest_s = m_window_lengths_s[WINDOW_STATS_WINDOW_1_HOUR];
+        window_stats_window_state_t * p_window;
+        uint32_t sample_time_s = time_s;
+        uint32_t relative_s;
+        uint16_t oldest;
+        uint16_t position;
+        size_t i;
+
+        if (NULL == p_stats) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        if ((p_stats->has_samples) && (p_stats->last_time_s > sample_time_s)) {
+                sample_time_s = p_stats->last_time_s;
+        }
+
+        if ((p_stats->has_samples) &&
+            ((sample_time_s - p_stats->last_time_s) >= longest_s)) {
+
+                window_stats_reset(p_stats);
+        }
+
+        if (!p_stats->has_samples) {
+                p_stats->base_time_s = sample_time_s;
+                p_stats->has_samples = true;
+        }
+
+        p_stats->last_time_s = sample_time_s;
+        relative_s = sample_time_s - p_stats->base_time_s;
+
+        // Make room first, so the slot taken by the sample is in no window
+        for (i = 0; WINDOW_STATS_WINDOW_COUNT > i; ++i) {
+                p_window = &p_stats->windows[i];
+
+                while (0 != p_window->count) {
+                        oldest = ring_position(p_stats, p_window->count);
+
+                        if ((p_window->capacity > p_window->count) &&
+                            ((relative_s - p_stats->times_s[oldest]) <
+                             m_window_lengths_s[i])) {
+                                break;
+                        }
+
+                        window_pop(p_stats, p_window);
+                }
+        }
+
+        position = p_stats->next;
+        p_stats->times_s[position] = relative_s;
+        p_stats->samples_ppm[position] = ppm;
+        p_stats->next = (uint16_t)((position + 1) % SAMPLE_CAPACITY);
+
+        for (i = 0; WINDOW_STATS_WINDOW_COUNT > i; ++i) {
+                window_push(p_stats, &p_stats->windows[i], position);
+        }
+}
+
+/*!
+ * @brief Get the statistics of a window
+ *
+ * @param[in]           p_stats             Pointer to the statistics instance
+ * @param[in]           window              Window to get the statistics of
+ * @param[out]          p_summary           Pointer where to copy the
+ *                                          statistics
+ *
+ * @return              bool                False if the window has no samples
+ */
+bool window_stats_get(window_stats_t const * const p_stats,
+                      window_stats_window_t const window,
+                      window_stats_summary_t * const p_summary)
+{
+        window_stats_window_state_t const * p_window = NULL;
+        uint16_t newest;
+        uint16_t oldest;
+        bool success = (NULL != p_stats) &&
+                       (WINDOW_STATS_WINDOW_COUNT > window) &&
+                       (NULL != p_summary);
+
+        if (success) {
+                p_window = &p_stats->windows[window];
+                success = (0 != p_window->count);
+        }
+
+        if (success) {
+                newest = ring_position(p_stats, 1);
+                oldest = ring_position(p_stats, p_window->count);
+
+                p_summary->count = p_window->count;
+                p_summary->span_s = p_stats->times_s[newest] -
+                                    p_stats->times_s[oldest];
+                p_summary->min_ppm = p_stats->samples_ppm[
+                                deque_at(&p_window->min_deque, 0)];
+                p_summary->max_ppm = p_stats->samples_ppm[
+                                deque_at(&p_window->max_deque, 0)];
+                p_summary->mean_ppm = (uint16_t)((p_window->sum_ppm +
+                                                  (p_window->count / 2)) /
+                                                 p_window->count);
+                p_summary->p95_ppm = window_percentile(p_stats,
+                                                       p_window,
+                                                       SUMMARY_PERCENTILE);
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Get an approximate percentile of a window
+ *
+ * Costs a walk over the histogram buckets. The error is within a bucket
+ * width, and the result is always within the window minimum and maximum.
+ *
+ * @param[in]           p_stats             Pointer to the statistics instance
+ * @param[in]           window              Window to get the percentile of
+ * @param[in]           percent             Percentile, from 0 to 100
+ * @param[out]          p_ppm               Pointer where to copy the
+ *                                          percentile (in ppm)
+ *
+ * @return              bool                False if the window has no samples
+ */
+bool window_stats_get_percentile(window_stats_t const * const p_stats,
+                                 window_stats_window_t const window,
+                                 uint8_t const percent,
+                                 uint16_t * const p_ppm)
+{
+        bool success = (NULL != p_stats) &&
+                       (WINDOW_STATS_WINDOW_COUNT > window) &&
+                       (100 >= percent) &&
+                       (NULL != p_ppm);
+
+        if (success) {
+                success = (0 != p_stats->windows[window].count);
+        }
+
+        if (success) {
+                *p_ppm = window_percentile(p_stats,
+                                           &p_stats->windows[window],
+                                           percent);
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Get the rate of change of the concentration
+ *
+ * @param[in]           p_stats             Pointer to the statistics instance
+ * @param[out]          p_ppm_per_hour      Pointer where to copy the rate of
+ *                                          change (in ppm per hour), positive
+ *                                          when rising
+ *
+ * @return              bool                False if there aren't samples
+ *                                          enough to tell
+ */
+bool window_stats_get_trend(window_stats_t const * const p_stats,
+                            int32_t * const p_ppm_per_hour)
+{
+        window_stats_window_state_t const * p_short = NULL;
+        window_stats_window_state_t const * p_long = NULL;
+        int64_t separation = 0;
+        int64_t change;
+        bool success = (NULL != p_stats) && (NULL != p_ppm_per_hour);
+
+        if (success) {
+                p_short = &p_stats->windows[TREND_SHORT_WINDOW];
+                p_long = &p_stats->windows[TREND_LONG_WINDOW];
+                success = (2 <= p_long->count);
+        }
+
+        // Differences of the centroids, scaled by both sample counts
+        if (success) {
+                separation = (int64_t)(p_short->sum_time_s * p_long->count) -
+                             (int64_t)(p_long->sum_time_s * p_short->count);
+
+                success = (separation >= ((int64_t)TREND_MIN_SEPARATION_S *
+                                          p_short->count *
+                                          p_long->count));
+        }
+
+        if (success) {
+                change = ((int64_t)p_short->sum_ppm * p_long->count) -
+                         ((int64_t)p_long->sum_ppm * p_short->count);
+
+                *p_ppm_per_hour = (int32_t)((change * 3600) / separation);
+        }
+
+        return success;
+}
+
+/*!
+ * @brief Forget the samples fed so far
+ *
+ * @param[in,out]       p_stats             Pointer to the statistics instance
+ *
+ * @return              -                   -
+ */
+void window_stats_reset(window_stats_t * const p_stats)
+{
+        window_stats_window_state_t * p_window;
+        size_t i;
+
+        if (NULL == p_stats) {
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        p_stats->next = 0;
+        p_stats->has_samples = false;
+
+        for (i = 0; WINDOW_STATS_WINDOW_COUNT > i; ++i) {
+                p_window = &p_stats->windows[i];
+
+                p_window->count = 0;
+                p_window->sum_ppm = 0;
+                p_window->sum_time_s = 0;
+                p_window->min_deque.head = 0;
+                p_window->min_deque.count = 0;
+                p_window->max_deque.head = 0;
+                p_window->max_deque.count = 0;
+
+                memset(p_window->histogram, 0, sizeof(p_window->histogram));
+        }
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Position in the sample ring of a sample, counting back from newest
+ *
+ * @param[in]           p_stats             Pointer to the statistics instance
+ * @param[in]           age                 1 for the newest sample, 2 for the
+ *                                          one before, and so on
+ *
+ * @return              uint16_t            Position of the sample
+ */
+static uint16_t ring_position(window_stats_t const * const p_stats,
+                              uint16_t const age)
+{
+        return (uint16_t)((p_stats->next + SAMPLE_CAPACITY - age) %
+                          SAMPLE_CAPACITY);
+}
+
+/*!
+ * @brief Add the newest sample of the ring to a window
+ *
+ * Samples in the deques which can no longer become the lowest or highest,
+ * because the new one is lower or higher and will stay longer, are dropped.
+ *
+ * @param[in,out]       p_stats             Pointer to the statistics instance
+ * @param[in,out]       p_window            Pointer to the window, with room
+ *                                          for a sample
+ * @param[in]           position            Position of the sample
+ *
+ * @return              -                   -
+ */
+static void window_push(window_stats_t * const p_stats,
+                        window_stats_window_state_t * const p_window,
+                        uint16_t const position)
+{
+        window_stats_deque_t * const p_min = &p_window->min_deque;
+        window_stats_deque_t * const p_max = &p_window->max_deque;
+        uint16_t const ppm = p_stats->samples_ppm[position];
+
+        while ((0 != p_min->count) &&
+               (p_stats->samples_ppm[deque_at(p_min, p_min->count - 1)] >=
+                ppm)) {
+                --p_min->count;
+        }
+
+        while ((0 != p_max->count) &&
+               (p_stats->samples_ppm[deque_at(p_max, p_max->count - 1)] <=
+                ppm)) {
+                --p_max->count;
+        }
+
+        deque_push_back(p_min, position);
+        deque_push_back(p_max, position);
+
+        ++p_window->histogram[histogram_bucket(ppm)];
+        p_window->sum_ppm += ppm;
+        p_window->sum_time_s += p_stats->times_s[position];
+        ++p_window->count;
+}
+
+/*!
+ * @brief Drop the oldest sample of a window
+ *
+ * @param[in,out]       p_stats             Pointer to the statistics instance
+ * @param[in,out]       p_window            Pointer to the window, with
+ *                                          samples
+ *
+ * @return              -                   -
+ */
+static void window_pop(window_stats_t * const p_stats,
+                       window_stats_window_state_t * const p_window)
+{
+        uint16_t const position = ring_position(p_stats, p_window->count);
+        uint16_t const ppm = p_stats->samples_ppm[position];
+
+        // Being the oldest one, it can only be at the front of the deques
+        if ((0 != p_window->min_deque.count) &&
+            (position == deque_at(&p_window->min_deque, 0))) {
+                deque_pop_front(&p_window->min_deque);
+        }
+
+        if ((0 != p_window->max_deque.count) &&
+            (position == deque_at(&p_window->max_deque, 0))) {
+                deque_pop_front(&p_window->max_deque);
+        }
+
+        --p_window->histogram[histogram_bucket(ppm)];
+        p_window->sum_ppm -= ppm;
+        p_window->sum_time_s -= p_stats->times_s[position];
+        --p_window->count;
+}
+
+/*!
+ * @brief Approximate percentile of a window with samples
+ *
+ * @param[in]           p_stats             Pointer to the statistics instance
+ * @param[in]           p_window            Pointer to the window
+ * @param[in]           percent             Percentile, from 0 to 100
+ *
+ * @return              uint16_t            Percentile (in ppm)
+ */
+static uint16_t window_percentile(window_stats_t const * const p_stats,
+                                  window_stats_window_state_t const * const p_window,
+                                  uint8_t const percent)
+{
+        uint32_t const width = WINDOW_STATS_HISTOGRAM_BUCKET_PPM;
+        uint32_t const min_ppm = p_stats->samples_ppm[
+                        deque_at(&p_window->min_deque, 0)];
+        uint32_t const max_ppm = p_stats->samples_ppm[
+                        deque_at(&p_window->max_deque, 0)];
+        uint32_t rank;
+        uint32_t below = 0;
+        uint32_t ppm;
+        size_t bucket = 0;
+
+        // Nearest rank, from 1 to the amount of samples
+        rank = ((uint32_t)percent * p_window->count + 99) / 100;
+
+        if (0 == rank) {
+                rank = 1;
+        }
+
+        while ((below + p_window->histogram[bucket]) < rank) {
+                below += p_window->histogram[bucket];
+                ++bucket;
+        }
+
+        // Middle of the slice of the bucket taken by the sample
+        ppm = (uint32_t)(bucket * width) +
+              ((width * (2 * (rank - below) - 1)) /
+               (2 * p_window->histogram[bucket]));
+
+        if (min_ppm > ppm) {
+                ppm = min_ppm;
+        } else if (max_ppm < ppm) {
+                ppm = max_ppm;
+        }
+
+        return (uint16_t)ppm;
+}
+
+/*!
+ * @brief Histogram bucket a sample falls in
+ *
+ * @param[in]           ppm                 Sample (in ppm)
+ *
+ * @return              size_t              Bucket index
+ */
+static size_t histogram_bucket(uint16_t const ppm)
+{
+        size_t const bucket = ppm / WINDOW_STATS_HISTOGRAM_BUCKET_PPM;
+
+        return (WINDOW_STATS_HISTOGRAM_BUCKETS > bucket) ?
+               bucket : (WINDOW_STATS_HISTOGRAM_BUCKETS - 1);
+}
+
+/*!
+ * @brief Get an item of a deque, counting from the oldest one
+ *
+ * @param[in]           p_deque             Pointer to the deque
+ * @param[in]           index               Index of the item, lower than the
+ *                                          amount of items
+ *
+ * @return              uint16_t            Item
+ */
+static uint16_t deque_at(window_stats_deque_t const * const p_deque,
+                         uint16_t const index)
+{
+        return p_deque->p_items[(p_deque->head + index) % p_deque->capacity];
+}
+
+/*!
+ * @brief Append an item to a deque
+ *
+ * @param[in,out]       p_deque             Pointer to the deque, not full
+ * @param[in]           position            Item to append
+ *
+ * @return              -                   -
+ */
+static void deque_push_back(window_stats_deque_t * const p_deque,
+                            uint16_t const position)
+{
+        p_deque->p_items[(p_deque->head + p_deque->count) %
+                         p_deque->capacity] = position;
+        ++p_deque->count;
+}
+
+/*!
+ * @brief Drop the oldest item of a deque
+ *
+ * @param[in,out]       p_deque             Pointer to the deque, not empty
+ *
+ * @return              -                   -
+ */
+static void deque_pop_front(window_stats_deque_t * const p_deque)
+{
+        p_deque->head = (uint16_t)((p_deque->head + 1) % p_deque->capacity);
+        --p_deque->count;
+}
@@ -0,0 +1,210 @@
+/*!
+ *******************************************************************************
+ * @file window_stats.h
+ *
+ * @brief Rolling statistics of the CO2 readings over fixed time windows
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+//! @brief Most samples kept in the one minute window
+#define WINDOW_STATS_1_MIN_MAX_SAMPLES      (7)
+
+//! @brief Most samples kept in the fifteen minutes window
+#define WINDOW_STATS_15_MIN_MAX_SAMPLES     (91)
+
+//! @brief Most samples kept in the one hour window
+#define WINDOW_STATS_1_HOUR_MAX_SAMPLES     (361)
+
+//! @brief Buckets of the histograms the percentiles are taken from
+#define WINDOW_STATS_HISTOGRAM_BUCKETS      (64)
+
+//! @brief Width of each histogram bucket (in ppm), the last one is unbounded
+#define WINDOW_STATS_HISTOGRAM_BUCKET_PPM   (50)
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Time windows the statistics are kept for
+typedef enum {
+        //! @brief Last minute
+        WINDOW_STATS_WINDOW_1_MIN = 0,
+
+        //! @brief Last fifteen minutes
+        WINDOW_STATS_WINDOW_15_MIN,
+
+        //! @brief Last hour
+        WINDOW_STATS_WINDOW_1_HOUR,
+
+        //! @brief Fence member
+        WINDOW_STATS_WINDOW_COUNT
+} window_stats_window_t;
+
+//! @brief Statistics of the samples within a window
+typedef struct {
+        //! @brief Amount of samples
+        uint16_t count;
+
+        //! @brief Time between the oldest and the newest sample (in seconds)
+        uint32_t span_s;
+
+        //! @brief Lowest CO2 concentration (in ppm)
+        uint16_t min_ppm;
+
+        //! @brief Highest CO2 concentration (in ppm)
+        uint16_t max_ppm;
+
+        //! @brief Mean CO2 concentration (in ppm)
+        uint16_t mean_ppm;
+
+        //! @brief 95th percentile of the CO2 concentration (in ppm), approximate
+        uint16_t p95_ppm;
+} window_stats_summary_t;
+
+/*!
+ * @brief Ring of positions of samples, in arrival order
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Positions of the samples in the sample ring
+        uint16_t * p_items;
+
+        //! @brief Size of `p_items`
+        uint16_t capacity;
+
+        //! @brief Position of the oldest item in `p_items`
+        uint16_t head;
+
+        //! @brief Amount of items
+        uint16_t count;
+} window_stats_deque_t;
+
+/*!
+ * @brief State of a window
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Most samples kept
+        uint16_t capacity;
+
+        //! @brief Amount of samples, the newest ones of the sample ring
+        uint16_t count;
+
+        //! @brief Sum of the samples (in ppm)
+        uint32_t sum_ppm;
+
+        //! @brief Sum of the sample times, relative to the base time
+        uint64_t sum_time_s;
+
+        //! @brief Samples which could still become the lowest one, oldest
+        //!        and lowest first
+        window_stats_deque_t min_deque;
+
+        //! @brief Samples which could still become the highest one, oldest
+        //!        and highest first
+        window_stats_deque_t max_deque;
+
+        //! @brief Amount of samples falling in each bucket
+        uint16_t histogram[WINDOW_STATS_HISTOGRAM_BUCKETS];
+} window_stats_window_state_t;
+
+/*!
+ * @brief Statistics instance, for a single series of samples
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Time of the samples, relative to `base_time_s` (circular)
+        uint32_t times_s[WINDOW_STATS_1_HOUR_MAX_SAMPLES];
+
+        //! @brief Samples (in ppm, circular)
+        uint16_t samples_ppm[WINDOW_STATS_1_HOUR_MAX_SAMPLES];
+
+        //! @brief Position of the next sample in the sample ring
+        uint16_t next;
+
+        //! @brief Whether any sample has been fed since the last reset
+        bool has_samples;
+
+        //! @brief Time the sample times are relative to (in seconds)
+        uint32_t base_time_s;
+
+        //! @brief Time of the newest sample (in seconds)
+        uint32_t last_time_s;
+
+        //! @brief Storage of the deques of every window
+        uint16_t deque_items[2 * (WINDOW_STATS_1_MIN_MAX_SAMPLES +
+                                  WINDOW_STATS_15_MIN_MAX_SAMPLES +
+                                  WINDOW_STATS_1_HOUR_MAX_SAMPLES)];
+
+        //! @brief State of each window
+        window_stats_window_state_t windows[WINDOW_STATS_WINDOW_COUNT];
+} window_stats_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize a statistics instance
+bool window_stats_init(window_stats_t * const p_stats);
+
+//! @brief Feed a new sample
+void window_stats_update(window_stats_t * const p_stats,
+                         uint32_t const time_s,
+                         uint16_t const ppm);
+
+//! @brief Get the statistics of a window
+bool window_stats_get(window_stats_t const * const p_stats,
+                      window_stats_window_t const window,
+                      window_stats_summary_t * const p_summary);
+
+//! @brief Get an approximate percentile of a window
+bool window_stats_get_percentile(window_stats_t const * const p_stats,
+                                 window_stats_window_t const window,
+                                 uint8_t const percent,
+                                 uint16_t * const p_ppm);
+
+//! @brief Get the rate of change of the concentration
+bool window_stats_get_trend(window_stats_t const * const p_stats,
+                            int32_t * const p_ppm_per_hour);
+
+//! @brief Forget the samples fed so far
+void window_stats_reset(window_stats_t * const p_stats);
+
+#endif //WINDOW_STATS_H
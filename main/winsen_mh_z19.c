@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <memory.h>
 #include "winsen_mh_z19.h"
+#include "winsen_mh_z19_parser.h"
 
 /*
  *******************************************************************************
@@ -65,9 +66,29 @@
 #define MH_Z19_MSG_START_VALUE              (0xFF)
 #define MH_Z19_MSG_SENSOR_NUMBER            (0x01)
 
+#define MH_Z19_MSG_TEMPERATURE_OFFSET       (40)
+
 #define MH_Z19B_ABC_SETTING_ON              (0xA0)
 #define MH_Z19B_ABC_SETTING_OFF             (0x00)
 
+#define MH_Z19_MSG_ACK_BYTE                 (2)
+#define MH_Z19_MSG_ACK_VALUE                (0x01)
+
+//! @brief Check value of a write message, computed at compile time
+#define MH_Z19_CHECK_VALUE(b1, b2, b3, b4, b5, b6, b7)                         \
+        ((uint8_t)(0x100 - (((b1) + (b2) + (b3) + (b4) + (b5) + (b6) + (b7))   \
+                            & 0xFF)))
+
+//! @brief Complete write message for a command with a fixed payload
+#define MH_Z19_FIXED_FRAME(command, p0, p1, p2, p3, p4)                        \
+        {                                                                      \
+                MH_Z19_MSG_START_VALUE,                                        \
+                MH_Z19_MSG_SENSOR_NUMBER,                                      \
+                (command), (p0), (p1), (p2), (p3), (p4),                       \
+                MH_Z19_CHECK_VALUE(MH_Z19_MSG_SENSOR_NUMBER,                   \
+                                   (command), (p0), (p1), (p2), (p3), (p4))    \
+        }
+
 /*
  *******************************************************************************
  * Data types                                                                  *
@@ -76,6 +97,9 @@
 
 //! @brief Different available commands
 typedef enum {
+        //! @brief Get raw measurement data
+        MH_Z19_COMMAND_RAW_DATA = 0x85,
+
         //! @brief Get gas concentration
         MH_Z19_COMMAND_GAS_CONCENTRATION = 0x86,
 
@@ -95,6 +119,45 @@ typedef enum {
         MH_Z19_COMMAND_COUNT
 } mh_z19_command_t;
 
+//! @brief Operations supported by the driver, indexes `m_commands`
+typedef enum {
+        COMMAND_ID_RAW_DATA = 0,
+        COMMAND_ID_GAS_CONCENTRATION,
+        COMMAND_ID_CAL_ZERO_POINT,
+        COMMAND_ID_CAL_SPAN_POINT,
+        COMMAND_ID_ABC_ON,
+        COMMAND_ID_ABC_OFF,
+        COMMAND_ID_SET_RANGE,
+        COMMAND_ID_COUNT
+} command_id_t;
+
+//! @brief What the sensor sends back after a command
+typedef enum {
+        //! @brief Nothing, the command is fire-and-forget
+        REPLY_NONE = 0,
+
+        //! @brief A read message carrying data
+        REPLY_DATA,
+
+        //! @brief A read message acknowledging the command
+        REPLY_ACK,
+} reply_type_t;
+
+//! @brief Command descriptor
+typedef struct {
+        //! @brief Command byte of the write message and of its reply
+        mh_z19_command_t command;
+
+        //! @brief Payload to be provided on each call (0 for fixed frames)
+        size_t payload_size;
+
+        //! @brief Expected reply
+        reply_type_t reply;
+
+        //! @brief Precomputed write message (null if built on each call)
+        uint8_t const * p_frame;
+} command_descriptor_t;
+
 /*
  *******************************************************************************
  * Constants                                                                   *
@@ -104,8 +167,8 @@ typedef enum {
 //! @brief Size of the message transferred message
 size_t const m_message_size = 9;
 
-//! @brief Maximum payload size
-size_t const m_max_payload_size = 5;
+//! @brief Maximum amount of bytes read while looking for a reply
+size_t const m_max_reply_size = (3 * 9);
 
 //! @brief Write message template to be filled in
 uint8_t const m_tx_message_template[] = {
@@ -120,25 +183,106 @@ uint8_t const m_tx_message_template[] = {
                 0x00
 };
 
+//! @brief Precomputed raw data request
+static uint8_t const m_frame_raw_data[] =
+                MH_Z19_FIXED_FRAME(MH_Z19_COMMAND_RAW_DATA, 0, 0, 0, 0, 0);
+
+//! @brief Precomputed gas concentration request
+static uint8_t const m_frame_gas_concentration[] =
+                MH_Z19_FIXED_FRAME(MH_Z19_COMMAND_GAS_CONCENTRATION, 0, 0, 0, 0, 0);
+
+//! @brief Precomputed zero point calibration request
+static uint8_t const m_frame_cal_zero_point[] =
+                MH_Z19_FIXED_FRAME(MH_Z19_COMMAND_CAL_ZERO_POINT, 0, 0, 0, 0, 0);
+
+//! @brief Precomputed ABC on request
+static uint8_t const m_frame_abc_on[] =
+                MH_Z19_FIXED_FRAME(MH_Z19_COMMAND_SET_ABC,
+                                   MH_Z19B_ABC_SETTING_ON, 0, 0, 0, 0);
+
+//! @brief Precomputed ABC off request
+static uint8_t const m_frame_abc_off[] =
+                MH_Z19_FIXED_FRAME(MH_Z19_COMMAND_SET_ABC,
+                                   MH_Z19B_ABC_SETTING_OFF, 0, 0, 0, 0);
+
+/*!
+ * @brief Command descriptors, indexed by `command_id_t`
+ *
+ * Calibration commands are not answered by the sensor, according to its
+ * datasheet, so they can't be confirmed.
+ */
+static command_descriptor_t const m_commands[COMMAND_ID_COUNT] = {
+                [COMMAND_ID_RAW_DATA] = {
+                                .command = MH_Z19_COMMAND_RAW_DATA,
+                                .payload_size = 0,
+                                .reply = REPLY_DATA,
+                                .p_frame = m_frame_raw_data,
+                },
+                [COMMAND_ID_GAS_CONCENTRATION] = {
+                                .command = MH_Z19_COMMAND_GAS_CONCENTRATION,
+                                .payload_size = 0,
+                                .reply = REPLY_DATA,
+                                .p_frame = m_frame_gas_concentration,
+                },
+                [COMMAND_ID_CAL_ZERO_POINT] = {
+                                .command = MH_Z19_COMMAND_CAL_ZERO_POINT,
+                                .payload_size = 0,
+                                .reply = REPLY_NONE,
+                                .p_frame = m_frame_cal_zero_point,
+                },
+                [COMMAND_ID_CAL_SPAN_POINT] = {
+                                .command = MH_Z19_COMMAND_CAL_SPAN_POINT,
+                                .payload_size = 2,
+                                .reply = REPLY_NONE,
+                                .p_frame = NULL,
+                },
+                [COMMAND_ID_ABC_ON] = {
+                                .command = MH_Z19_COMMAND_SET_ABC,
+                                .payload_size = 0,
+                                .reply = REPLY_ACK,
+                                .p_frame = m_frame_abc_on,
+                },
+                [COMMAND_ID_ABC_OFF] = {
+                                .command = MH_Z19_COMMAND_SET_ABC,
+                                .payload_size = 0,
+                                .reply = REPLY_ACK,
+                                .p_frame = m_frame_abc_off,
+                },
+                [COMMAND_ID_SET_RANGE] = {
+                                .command = MH_Z19_COMMAND_SET_RANGE,
+                                .payload_size = 5,
+                                .reply = REPLY_ACK,
+                                .p_frame = NULL,
+                },
+};
+
 /*
  *******************************************************************************
  * Private Function Prototypes                                                 *
  *******************************************************************************
  */
 
+//! @brief Send a command and wait for its acknowledgement, if any
+static mh_z19_error_t execute_command(mh_z19_t * const p_sensor,
+                                      command_id_t const id,
+                                      uint8_t const * const p_payload);
+
 //! @brief Send command to the MH-Z19 sensor
-static mh_z19_error_t send_command(mh_z19_command_t command,
-                                   uint8_t const * const p_payload,
-                                   size_t const payload_size);
+static mh_z19_error_t send_command(mh_z19_t * const p_sensor,
+                                   command_id_t const id,
+                                   uint8_t const * const p_payload);
+
+//! @brief Receive the reply to a command
+static mh_z19_error_t receive_reply(mh_z19_t * const p_sensor,
+                                    command_id_t const id,
+                                    uint8_t * const p_message);
 
 //! @brief Calculate the check value
 static uint8_t calculate_check_value(uint8_t const * const p_message);
 
-//! @brief Validate message
-static bool is_valid_message(uint8_t const * const p_message);
-
-//! @brief Validate command
-static bool is_valid_command(mh_z19_command_t const command);
+//! @brief Account a finished transaction in the statistics
+static void update_stats(mh_z19_t * const p_sensor,
+                         mh_z19_error_t const result);
 
 /*
  *******************************************************************************
@@ -152,12 +296,6 @@ static bool is_valid_command(mh_z19_command_t const command);
  *******************************************************************************
  */
 
-//! @brief Whether the module is initialized or not
-static bool m_is_initialized = false;
-
-//! @brief UART transfer function
-static mh_z19_xfer_func m_xfer_func = NULL;
-
 /*
  *******************************************************************************
  * Public Function Bodies                                                      *
@@ -165,29 +303,110 @@ static mh_z19_xfer_func m_xfer_func = NULL;
  */
 
 /*!
- * @brief Initialize the module
+ * @brief Initialize a sensor instance
  *
+ * Each instance keeps its own state and transfer function, so as many sensors
+ * as transports are available can be driven at the same time.
+ *
+ * @note The instance must be zero initialized before the first call (e.g.
+ *       static storage)
+ *
+ * @param[out]          p_sensor            Pointer to the sensor instance
  * @param[in]           xfer_func           Pointer to an UART transfer function
+ * @param[in]           p_xfer_context      Context passed to every `xfer_func`
+ *                                          call (can be null)
  *
  * @return              mh_z19_error_t      Operation result
  * @retval              MH_Z19_ERROR_SUCCESS
  *                                          Everything went well
  * @retval              MH_Z19_ERROR_ALREADY_INITIALIZED
- *                                          Module is already initialized
+ *                                          Instance is already initialized
  * @retval              MH_Z19_ERROR_BAD_PARAMETER
  *                                          Parameter is null
  */
-mh_z19_error_t mh_z19_init(mh_z19_xfer_func const xfer_func)
+mh_z19_error_t mh_z19_init(mh_z19_t * const p_sensor,
+                           mh_z19_xfer_func const xfer_func,
+                           void * const p_xfer_context)
 {
         mh_z19_error_t result = MH_Z19_ERROR_SUCCESS;
 
-        if (m_is_initialized) {
+        if ((NULL == p_sensor) || (NULL == xfer_func)) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+        } else if (p_sensor->is_initialized) {
                 result = MH_Z19_ERROR_ALREADY_INITIALIZED;
-        } else if (NULL == xfer_func) {
+        } else {
+                p_sensor->xfer_func = xfer_func;
+                p_sensor->p_xfer_context = p_xfer_context;
+                mh_z19_parser_reset(&p_sensor->parser);
+                memset(&p_sensor->stats, 0, sizeof(p_sensor->stats));
+                p_sensor->is_initialized = true;
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Set the function used to time the transactions
+ *
+ * Without a time function, transactions are counted but not timed
+ *
+ * @param[in,out]       p_sensor            Pointer to the sensor instance
+ * @param[in]           time_func           Pointer to the time function (null
+ *                                          to stop timing)
+ *
+ * @return              mh_z19_error_t      Operation result
+ * @retval              MH_Z19_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              MH_Z19_ERROR_NOT_INITIALIZED
+ *                                          Instance isn't initialized
+ * @retval              MH_Z19_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ */
+mh_z19_error_t mh_z19_set_time_func(mh_z19_t * const p_sensor,
+                                    mh_z19_time_func const time_func)
+{
+        mh_z19_error_t result = MH_Z19_ERROR_SUCCESS;
+
+        if (NULL == p_sensor) {
                 result = MH_Z19_ERROR_BAD_PARAMETER;
+        } else if (!p_sensor->is_initialized) {
+                result = MH_Z19_ERROR_NOT_INITIALIZED;
         } else {
-                m_xfer_func = xfer_func;
-                m_is_initialized = true;
+                p_sensor->time_func = time_func;
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Get the driver statistics
+ *
+ * @note Statistics are updated by the calls to the driver, so they should be
+ *       read from the same task that uses the instance
+ *
+ * @param[in]           p_sensor            Pointer to the sensor instance
+ * @param[out]          p_stats             Pointer where to copy the statistics
+ *
+ * @return              mh_z19_error_t      Operation result
+ * @retval              MH_Z19_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              MH_Z19_ERROR_NOT_INITIALIZED
+ *                                          Instance isn't initialized
+ * @retval              MH_Z19_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ */
+mh_z19_error_t mh_z19_get_stats(mh_z19_t const * const p_sensor,
+                                mh_z19_stats_t * const p_stats)
+{
+        mh_z19_error_t result = MH_Z19_ERROR_SUCCESS;
+
+        if ((NULL == p_sensor) || (NULL == p_stats)) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+        } else if (!p_sensor->is_initialized) {
+                result = MH_Z19_ERROR_NOT_INITIALIZED;
+        } else {
+                *p_stats = p_sensor->stats;
+                mh_z19_parser_get_stats(&p_sensor->parser, &p_stats->parser);
         }
 
         return result;
@@ -198,6 +417,7 @@ mh_z19_error_t mh_z19_init(mh_z19_xfer_func const xfer_func)
  *
  * Get the CO2 concentration in ppm
  *
+ * @param[in,out]       p_sensor            Pointer to the sensor instance
  * @param[out]          p_concentration     Pointer where to store the gas
  *                                          concentration (in ppm CO2)
  *
@@ -205,33 +425,192 @@ mh_z19_error_t mh_z19_init(mh_z19_xfer_func const xfer_func)
  * @retval              MH_Z19_ERROR_SUCCESS
  *                                          Everything went well
  * @retval              MH_Z19_ERROR_NOT_INITIALIZED
- *                                          Module isn't initialized
+ *                                          Instance isn't initialized
  * @retval              MH_Z19_ERROR_BAD_PARAMETER
  *                                          Parameter is null
+ * @retval              MH_Z19_ERROR_BAD_REPLY
+ *                                          No valid reply was found
+ * @retval              *                   Any other error
  */
-mh_z19_error_t mh_z19_get_gas_concentration(uint32_t * const p_concentration)
+mh_z19_error_t mh_z19_get_gas_concentration(mh_z19_t * const p_sensor,
+                                            uint32_t * const p_concentration)
 {
+        mh_z19_measurement_t measurement;
+        mh_z19_error_t result;
+
+        if (NULL == p_concentration) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+        } else {
+                result = mh_z19_read_measurement(p_sensor, &measurement, false);
+        }
+
+        if (MH_Z19_ERROR_SUCCESS == result) {
+                *p_concentration = measurement.concentration;
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Read a full measurement
+ *
+ * The gas concentration reply carries, besides the concentration, the sensor
+ * temperature and status, so all of them are obtained in a single exchange.
+ *
+ * Raw values are only available through an additional exchange (command
+ * 0x85), therefore they are only read if requested.
+ *
+ * @param[in,out]       p_sensor            Pointer to the sensor instance
+ * @param[out]          p_measurement       Pointer where to store the
+ *                                          measurement
+ * @param[in]           include_raw         Whether to read the raw values too
+ *
+ * @return              mh_z19_error_t      Operation result
+ * @retval              MH_Z19_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              MH_Z19_ERROR_NOT_INITIALIZED
+ *                                          Instance isn't initialized
+ * @retval              MH_Z19_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ * @retval              MH_Z19_ERROR_BAD_REPLY
+ *                                          No valid reply was found
+ * @retval              *                   Any other error
+ */
+mh_z19_error_t mh_z19_read_measurement(mh_z19_t * const p_sensor,
+                                       mh_z19_measurement_t * const p_measurement,
+                                       bool const include_raw)
+{
+        size_t const payload = MH_Z19_MSG_GET_PAYLOAD_START_BYTE;
         mh_z19_error_t result;
         uint8_t rx_buffer[m_message_size];
-        uint16_t concentration;
 
-        if (!m_is_initialized) {
-                result = MH_Z19_ERROR_NOT_INITIALIZED;
-        } else if (NULL == p_concentration) {
+        if (NULL == p_measurement) {
                 result = MH_Z19_ERROR_BAD_PARAMETER;
         } else {
-                result = send_command(MH_Z19_COMMAND_GAS_CONCENTRATION, NULL, 0);
+                result = mh_z19_request_measurement(p_sensor);
         }
 
         if (MH_Z19_ERROR_SUCCESS == result) {
-                result = m_xfer_func(rx_buffer, m_message_size, NULL, 0);
+                result = mh_z19_collect_measurement(p_sensor, p_measurement);
+        }
+
+        if ((MH_Z19_ERROR_SUCCESS == result) && (include_raw)) {
+                result = send_command(p_sensor, COMMAND_ID_RAW_DATA, NULL);
+        }
+
+        if ((MH_Z19_ERROR_SUCCESS == result) && (include_raw)) {
+                result = receive_reply(p_sensor,
+                                       COMMAND_ID_RAW_DATA,
+                                       rx_buffer);
+        }
+
+        if ((MH_Z19_ERROR_SUCCESS == result) && (include_raw)) {
+                p_measurement->raw_temperature = (uint16_t)(
+                                (rx_buffer[payload] << 8) |
+                                (rx_buffer[payload + 1]));
+
+                p_measurement->raw_concentration = (uint16_t)(
+                                (rx_buffer[payload + 2] << 8) |
+                                (rx_buffer[payload + 3]));
+
+                p_measurement->raw_light = (uint16_t)(
+                                (rx_buffer[payload + 4] << 8) |
+                                (rx_buffer[payload + 5]));
+
+                p_measurement->has_raw = true;
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Request a measurement
+ *
+ * First half of a split measurement: only sends the request, so the requests
+ * to several sensors on different UARTs can be sent back to back and their
+ * replies received in parallel. Must be followed by
+ * `mh_z19_collect_measurement` on the same instance.
+ *
+ * @param[in,out]       p_sensor            Pointer to the sensor instance
+ *
+ * @return              mh_z19_error_t      Operation result
+ * @retval              MH_Z19_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              MH_Z19_ERROR_NOT_INITIALIZED
+ *                                          Instance isn't initialized
+ * @retval              MH_Z19_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ * @retval              *                   Any other error
+ */
+mh_z19_error_t mh_z19_request_measurement(mh_z19_t * const p_sensor)
+{
+        mh_z19_error_t result;
+
+        if (NULL == p_sensor) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+        } else if (!p_sensor->is_initialized) {
+                result = MH_Z19_ERROR_NOT_INITIALIZED;
+        } else {
+                result = send_command(p_sensor,
+                                      COMMAND_ID_GAS_CONCENTRATION,
+                                      NULL);
+        }
+
+        return result;
+}
+
+/*!
+ * @brief Collect a requested measurement
+ *
+ * Second half of a split measurement: waits for the reply to a previous
+ * `mh_z19_request_measurement` and decodes it.
+ *
+ * @note The sensor reports a non zero status while it is warming up
+ *
+ * @param[in,out]       p_sensor            Pointer to the sensor instance
+ * @param[out]          p_measurement       Pointer where to store the
+ *                                          measurement
+ *
+ * @return              mh_z19_error_t      Operation result
+ * @retval              MH_Z19_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              MH_Z19_ERROR_NOT_INITIALIZED
+ *                                          Instance isn't initialized
+ * @retval              MH_Z19_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ * @retval              MH_Z19_ERROR_BAD_REPLY
+ *                                          No valid reply was found
+ * @retval              *                   Any other error
+ */
+mh_z19_error_t mh_z19_collect_measurement(mh_z19_t * const p_sensor,
+                                          mh_z19_measurement_t * const p_measurement)
+{
+        size_t const payload = MH_Z19_MSG_GET_PAYLOAD_START_BYTE;
+        mh_z19_error_t result;
+        uint8_t rx_buffer[m_message_size];
+
+        if ((NULL == p_sensor) || (NULL == p_measurement)) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+        } else if (!p_sensor->is_initialized) {
+                result = MH_Z19_ERROR_NOT_INITIALIZED;
+        } else {
+                result = receive_reply(p_sensor,
+                                       COMMAND_ID_GAS_CONCENTRATION,
+                                       rx_buffer);
         }
 
-        if ((MH_Z19_ERROR_SUCCESS == result) && (is_valid_message(rx_buffer))) {
-                concentration =(rx_buffer[MH_Z19_MSG_GET_PAYLOAD_START_BYTE] << 8);
-                concentration |= (rx_buffer[MH_Z19_MSG_GET_PAYLOAD_START_BYTE + 1]);
+        if (MH_Z19_ERROR_SUCCESS == result) {
+                p_measurement->concentration = (uint16_t)(
+                                (rx_buffer[payload] << 8) |
+                                (rx_buffer[payload + 1]));
+
+                p_measurement->temperature = (int8_t)(
+                                rx_buffer[payload + 2] -
+                                MH_Z19_MSG_TEMPERATURE_OFFSET);
 
-                *p_concentration = concentration;
+                p_measurement->status = rx_buffer[payload + 3];
+                p_measurement->is_preheating = (0 != p_measurement->status);
+                p_measurement->has_raw = false;
         }
 
         return result;
@@ -246,23 +625,27 @@ mh_z19_error_t mh_z19_get_gas_concentration(uint32_t * const p_concentration)
  * Suggested calibration method is to let the sensor stabilize outdoors, and
  * where the CO2 concentration is the lowest, and then execute this function
  *
- * @param               -                   -
+ * @param[in,out]       p_sensor            Pointer to the sensor instance
  *
  * @return              mh_z19_error_t      Operation result
  * @retval              MH_Z19_ERROR_SUCCESS
  *                                          Everything went well
  * @retval              MH_Z19_ERROR_NOT_INITIALIZED
- *                                          Module isn't initialized
+ *                                          Instance isn't initialized
  * @retval              *                   Any other error
  */
-mh_z19_error_t mh_z19_calibrate_zero_point(void)
+mh_z19_error_t mh_z19_calibrate_zero_point(mh_z19_t * const p_sensor)
 {
         mh_z19_error_t result;
 
-        if (!m_is_initialized) {
+        if (NULL == p_sensor) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+        } else if (!p_sensor->is_initialized) {
                 result = MH_Z19_ERROR_NOT_INITIALIZED;
         } else {
-                result = send_command(MH_Z19_COMMAND_CAL_ZERO_POINT, NULL, 0);
+                result = execute_command(p_sensor,
+                                         COMMAND_ID_CAL_ZERO_POINT,
+                                         NULL);
         }
 
         return result;
@@ -281,6 +664,7 @@ mh_z19_error_t mh_z19_calibrate_zero_point(void)
  * @note A span value of 2000 ppm is recommended. If this value cannot be
  *       achieved, use a concentration of at least 1000 ppm.
  *
+ * @param[in,out]       p_sensor            Pointer to the sensor instance
  * @param[in]           span_point          Span point to pass to the
  *                                          calibrating function
  *
@@ -288,24 +672,26 @@ mh_z19_error_t mh_z19_calibrate_zero_point(void)
  * @retval              MH_Z19_ERROR_SUCCESS
  *                                          Everything went well
  * @retval              MH_Z19_ERROR_NOT_INITIALIZED
- *                                          Module isn't initialized
+ *                                          Instance isn't initialized
  * @retval              *                   Any other error
  */
-mh_z19_error_t mh_z19_calibrate_span_point(uint16_t const span_point)
+mh_z19_error_t mh_z19_calibrate_span_point(mh_z19_t * const p_sensor,
+                                           uint16_t const span_point)
 {
-        size_t const payload_size = 2;
-        uint8_t payload[payload_size];
+        uint8_t payload[2];
         mh_z19_error_t result;
 
-        if (!m_is_initialized) {
+        if (NULL == p_sensor) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+        } else if (!p_sensor->is_initialized) {
                 result = MH_Z19_ERROR_NOT_INITIALIZED;
         } else {
                 payload[0] = (0xFF & (span_point >> 8));
                 payload[1] = (0xFF & (span_point));
 
-                result = send_command(MH_Z19_COMMAND_CAL_SPAN_POINT,
-                                      payload,
-                                      payload_size);
+                result = execute_command(p_sensor,
+                                         COMMAND_ID_CAL_SPAN_POINT,
+                                         payload);
         }
 
         return result;
@@ -320,6 +706,7 @@ mh_z19_error_t mh_z19_calibrate_span_point(uint16_t const span_point)
  *
  * @note ABC will be active next time device goes through a power cycle
  *
+ * @param[in,out]       p_sensor            Pointer to the sensor instance
  * @param[in]           enabled             Whether the ABC should be enabled
  *                                          or disabled
  *
@@ -327,24 +714,30 @@ mh_z19_error_t mh_z19_calibrate_span_point(uint16_t const span_point)
  * @retval              MH_Z19_ERROR_SUCCESS
  *                                          Everything went well
  * @retval              MH_Z19_ERROR_NOT_INITIALIZED
- *                                          Module isn't initialized
+ *                                          Instance isn't initialized
+ * @retval              MH_Z19_ERROR_BAD_REPLY
+ *                                          No acknowledgement was received
+ * @retval              MH_Z19_ERROR_NOT_ACKNOWLEDGED
+ *                                          Sensor rejected the command
  * @retval              *                   Any other error
  */
-mh_z19_error_t mh_z19_enable_abc(bool enabled)
+mh_z19_error_t mh_z19_enable_abc(mh_z19_t * const p_sensor, bool enabled)
 {
         mh_z19_error_t result;
-        uint8_t payload;
+        command_id_t id;
 
-        if (!m_is_initialized) {
+        if (NULL == p_sensor) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+        } else if (!p_sensor->is_initialized) {
                 result = MH_Z19_ERROR_NOT_INITIALIZED;
         } else {
 
                 if (enabled) {
-                        payload = MH_Z19B_ABC_SETTING_ON;
+                        id = COMMAND_ID_ABC_ON;
                 } else {
-                        payload = MH_Z19B_ABC_SETTING_OFF;
+                        id = COMMAND_ID_ABC_OFF;
                 }
-                result = send_command(MH_Z19_COMMAND_SET_ABC, &payload, 1);
+                result = execute_command(p_sensor, id, NULL);
         }
 
         return result;
@@ -356,16 +749,22 @@ mh_z19_error_t mh_z19_enable_abc(bool enabled)
  * Sets a specific detection range. The allowed ranges are 0 - 2000, 0 - 5000
  * and 0 - 10000 ppm.
  *
+ * @param[in,out]       p_sensor            Pointer to the sensor instance
  * @param[in]           range               Desired range to be set
  *
  * @return              mh_z19_error_t      Operation result
  * @retval              MH_Z19_ERROR_SUCCESS
  *                                          Everything went well
  * @retval              MH_Z19_ERROR_NOT_INITIALIZED
- *                                          Module isn't initialized
+ *                                          Instance isn't initialized
+ * @retval              MH_Z19_ERROR_BAD_REPLY
+ *                                          No acknowledgement was received
+ * @retval              MH_Z19_ERROR_NOT_ACKNOWLEDGED
+ *                                          Sensor rejected the command
  * @retval              *                   Any other error
  */
-mh_z19_error_t mh_z19_set_range(mh_z19b_range_t const range)
+mh_z19_error_t mh_z19_set_range(mh_z19_t * const p_sensor,
+                                mh_z19b_range_t const range)
 {
         uint32_t const ranges[] = {
                         2000,
@@ -373,12 +772,12 @@ mh_z19_error_t mh_z19_set_range(mh_z19b_range_t const range)
                         10000
         };
 
-        size_t const payload_size = 5;
-        uint8_t payload[payload_size];
+        uint8_t payload[5];
         mh_z19_error_t result;
 
-
-        if (!m_is_initialized) {
+        if (NULL == p_sensor) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+        } else if (!p_sensor->is_initialized) {
                 result = MH_Z19_ERROR_NOT_INITIALIZED;
         } else if (MH_Z19B_RANGE_COUNT <= range) {
                 result = MH_Z19_ERROR_BAD_PARAMETER;
@@ -389,9 +788,9 @@ mh_z19_error_t mh_z19_set_range(mh_z19b_range_t const range)
                 payload[3] = (0xFF & (ranges[range] >> 8));
                 payload[4] = (0xFF & (ranges[range]));
 
-                result = send_command(MH_Z19_COMMAND_SET_RANGE,
-                                      payload,
-                                      payload_size);
+                result = execute_command(p_sensor,
+                                         COMMAND_ID_SET_RANGE,
+                                         payload);
         }
 
         return result;
@@ -403,14 +802,50 @@ mh_z19_error_t mh_z19_set_range(mh_z19b_range_t const range)
  *******************************************************************************
  */
 
+/*!
+ * @brief Send a command and wait for its acknowledgement, if any
+ *
+ * @param[in,out]       p_sensor            Pointer to the sensor instance
+ * @param[in]           id                  Command to be executed
+ * @param[in]           p_payload           Pointer to the command payload (null
+ *                                          for commands without payload)
+ *
+ * @return              mh_z19_error_t      Operation result
+ * @retval              MH_Z19_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              MH_Z19_ERROR_BAD_REPLY
+ *                                          No acknowledgement was received
+ * @retval              MH_Z19_ERROR_NOT_ACKNOWLEDGED
+ *                                          Sensor rejected the command
+ * @retval              *                   Any other error
+ */
+static mh_z19_error_t execute_command(mh_z19_t * const p_sensor,
+                                      command_id_t const id,
+                                      uint8_t const * const p_payload)
+{
+        uint8_t rx_buffer[m_message_size];
+        mh_z19_error_t result;
+
+        result = send_command(p_sensor, id, p_payload);
+
+        if (MH_Z19_ERROR_SUCCESS == result) {
+                result = receive_reply(p_sensor, id, rx_buffer);
+        }
+
+        return result;
+}
+
 /*!
  * @brief Send command to the MH-Z19 sensor
  *
- * @param[in]           command             Command to be sent
- * @param[in]           p_payload           Pointer to a payload to be sent
- *                                          (can be null if not needed)
- * @param[in]           payload_size        Size of the sent payload (set it to
- *                                          0 if payload is NULL)
+ * Commands with a fixed payload are sent straight from their precomputed
+ * frame, the rest are built from `m_tx_message_template`.
+ *
+ * @param[in,out]       p_sensor            Pointer to the sensor instance
+ * @param[in]           id                  Command to be sent
+ * @param[in]           p_payload           Pointer to a payload of the size
+ *                                          given by the command descriptor
+ *                                          (null if not needed)
  *
  * @return              mh_z19_error_t      Operation result
  * @retval              MH_Z19_ERROR_SUCCESS
@@ -418,42 +853,167 @@ mh_z19_error_t mh_z19_set_range(mh_z19b_range_t const range)
  * @retval              MH_Z19_ERROR_BAD_PARAMETER
  *                                          Parameter is null
  */
-static mh_z19_error_t send_command(mh_z19_command_t command,
-                                   uint8_t const * const p_payload,
-                                   size_t const payload_size)
+static mh_z19_error_t send_command(mh_z19_t * const p_sensor,
+                                   command_id_t const id,
+                                   uint8_t const * const p_payload)
 {
+        command_descriptor_t const * p_descriptor;
         uint8_t message[m_message_size];
-        mh_z19_error_t result;
-        uint8_t check_val;
+        uint8_t const * p_message = message;
+        mh_z19_error_t result = MH_Z19_ERROR_SUCCESS;
 
-        if (!is_valid_command(command)) {
-                result = MH_Z19_ERROR_BAD_PARAMETER;
+        if (COMMAND_ID_COUNT <= id) {
+                // Code style exception for the shake of readability
+                return MH_Z19_ERROR_BAD_PARAMETER;
+        }
 
-        } else if ((NULL == p_payload) != (0 == payload_size)) { // XOR
-                result = MH_Z19_ERROR_BAD_PARAMETER;
+        p_descriptor = &m_commands[id];
 
-        } else if (m_max_payload_size < payload_size) {
+        if ((NULL == p_payload) != (0 == p_descriptor->payload_size)) { // XOR
                 result = MH_Z19_ERROR_BAD_PARAMETER;
 
+        } else if (NULL != p_descriptor->p_frame) {
+                p_message = p_descriptor->p_frame;
+
         } else {
                 memcpy(message, m_tx_message_template, m_message_size);
-                message[MH_Z19_MSG_SET_COMMAND_BYTE] = command;
+                message[MH_Z19_MSG_SET_COMMAND_BYTE] = p_descriptor->command;
+
+                if ((0 != p_descriptor->payload_size) && (NULL != p_payload)) {
+                        memcpy(&message[MH_Z19_MSG_SET_PAYLOAD_START_BYTE],
+                               p_payload,
+                               p_descriptor->payload_size);
+                }
 
-                // Will be ignored if `payload_size` is 0
-                memcpy(&message[MH_Z19_MSG_SET_PAYLOAD_START_BYTE],
-                       p_payload,
-                       payload_size);
+                message[MH_Z19_MSG_CHECK_VALUE_BYTE] =
+                                calculate_check_value(message);
+        }
 
-                check_val = calculate_check_value(message);
+        if ((MH_Z19_ERROR_SUCCESS == result) &&
+            (NULL != p_sensor->time_func)) {
 
-                message[MH_Z19_MSG_CHECK_VALUE_BYTE] = check_val;
+                p_sensor->transaction_start_us = p_sensor->time_func();
+        }
 
-                result = m_xfer_func(NULL, 0, message, m_message_size);
+        if (MH_Z19_ERROR_SUCCESS == result) {
+                result = p_sensor->xfer_func(p_sensor->p_xfer_context,
+                                             NULL,
+                                             0,
+                                             p_message,
+                                             m_message_size);
+
+                // Otherwise accounted once the reply is received
+                if (MH_Z19_ERROR_SUCCESS != result) {
+                        update_stats(p_sensor, result);
+                }
         }
 
         return result;
 }
 
+/*!
+ * @brief Receive the reply to a command
+ *
+ * Bytes are read from the transfer function and fed to the frame parser, which
+ * skips anything that isn't a valid reply to `command`. After a first read of
+ * a whole message, only the bytes missing to complete the frame being received
+ * are requested, so a stray or lost byte doesn't leave the following replies
+ * misaligned.
+ *
+ * Commands the sensor doesn't answer complete right away, and acknowledgements
+ * are checked to confirm the command was accepted.
+ *
+ * A reply that arrived whole but carried a wrong check value is a bad reply,
+ * even though the parser then waits for another frame until the transfer
+ * times out.
+ *
+ * @param[in,out]       p_sensor            Pointer to the sensor instance
+ * @param[in]           id                  Command whose reply is expected
+ * @param[out]          p_message           Pointer to a buffer of
+ *                                          `m_message_size` bytes where to copy
+ *                                          the reply to
+ *
+ * @return              mh_z19_error_t      Operation result
+ * @retval              MH_Z19_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              MH_Z19_ERROR_BAD_REPLY
+ *                                          No valid reply was found within
+ *                                          `m_max_reply_size` bytes, or only
+ *                                          replies with a wrong check value
+ * @retval              MH_Z19_ERROR_NOT_ACKNOWLEDGED
+ *                                          Sensor rejected the command
+ * @retval              *                   Any error of the transfer function
+ */
+static mh_z19_error_t receive_reply(mh_z19_t * const p_sensor,
+                                    command_id_t const id,
+                                    uint8_t * const p_message)
+{
+        command_descriptor_t const * const p_descriptor = &m_commands[id];
+        uint8_t rx_buffer[m_message_size];
+        mh_z19_parser_stats_t parser_stats;
+        mh_z19_error_t result = MH_Z19_ERROR_SUCCESS;
+        uint32_t checksum_errors;
+        size_t to_read = m_message_size;
+        size_t total_read = 0;
+        bool is_found = false;
+
+        if (REPLY_NONE == p_descriptor->reply) {
+                // Code style exception for the shake of readability
+                return MH_Z19_ERROR_SUCCESS;
+        }
+
+        // Whatever was left from a previous exchange is stale by now
+        mh_z19_parser_flush(&p_sensor->parser);
+        mh_z19_parser_get_stats(&p_sensor->parser, &parser_stats);
+        checksum_errors = parser_stats.checksum_errors;
+
+        while ((MH_Z19_ERROR_SUCCESS == result) &&
+               (!is_found) &&
+               (m_max_reply_size >= (total_read + to_read))) {
+
+                result = p_sensor->xfer_func(p_sensor->p_xfer_context,
+                                             rx_buffer,
+                                             to_read,
+                                             NULL,
+                                             0);
+
+                if (MH_Z19_ERROR_SUCCESS == result) {
+                        (void)mh_z19_parser_push(&p_sensor->parser,
+                                                 rx_buffer,
+                                                 to_read);
+                        total_read += to_read;
+
+                        is_found = mh_z19_parser_pop_frame(
+                                        &p_sensor->parser,
+                                        (uint8_t)p_descriptor->command,
+                                        p_message);
+
+                        to_read = mh_z19_parser_bytes_needed(&p_sensor->parser);
+                }
+        }
+
+        mh_z19_parser_get_stats(&p_sensor->parser, &parser_stats);
+
+        if ((MH_Z19_ERROR_TIMEOUT == result) &&
+            (checksum_errors != parser_stats.checksum_errors)) {
+
+                result = MH_Z19_ERROR_BAD_REPLY;
+
+        } else if ((MH_Z19_ERROR_SUCCESS == result) && (!is_found)) {
+                result = MH_Z19_ERROR_BAD_REPLY;
+
+        } else if ((MH_Z19_ERROR_SUCCESS == result) &&
+                   (REPLY_ACK == p_descriptor->reply) &&
+                   (MH_Z19_MSG_ACK_VALUE != p_message[MH_Z19_MSG_ACK_BYTE])) {
+
+                result = MH_Z19_ERROR_NOT_ACKNOWLEDGED;
+        }
+
+        update_stats(p_sensor, result);
+
+        return result;
+}
+
 /*!
  * @brief Calculate the check value
  *
@@ -492,53 +1052,59 @@ static uint8_t calculate_check_value(uint8_t const * const p_message)
 }
 
 /*!
- * @brief Validate message
- *
- * The function compares the calculated and the message's check value to
- * validate the message integrity.
+ * @brief Account a finished transaction in the statistics
  *
- * @param[in]           p_message          Pointer to the message to validate
+ * @param[in,out]       p_sensor            Pointer to the sensor instance
+ * @param[in]           result              Result of the transaction
  *
- * @return              bool               Operation result
+ * @return              -                   -
  */
-static bool is_valid_message(uint8_t const * const p_message)
+static void update_stats(mh_z19_t * const p_sensor,
+                         mh_z19_error_t const result)
 {
-        uint8_t const start_val = p_message[MH_Z19_MSG_START_VALUE_BYTE];
-        uint8_t const check_val = p_message[MH_Z19_MSG_CHECK_VALUE_BYTE];
-        uint8_t const calculated_check_val = calculate_check_value(p_message);
+        mh_z19_stats_t * const p_stats = &p_sensor->stats;
+        uint32_t elapsed_us;
+        size_t bin = 0;
 
+        ++p_stats->transactions;
 
-        return ((check_val == calculated_check_val) &&
-                (MH_Z19_MSG_START_VALUE == start_val));
-}
-
-/*!
- * @brief Validate command
- *
- * Check whether the command is a valid `mh_z19_command_t` command
- *
- * @param[in]           command            Command to validate
- *
- * @return              bool               Operation result
- */
-static bool is_valid_command(mh_z19_command_t const command)
-{
-        bool success;
-        switch (command) {
-
-        // Intentional fall-through
-        case MH_Z19_COMMAND_GAS_CONCENTRATION:
-        case MH_Z19_COMMAND_CAL_ZERO_POINT:
-        case MH_Z19_COMMAND_CAL_SPAN_POINT:
-        case MH_Z19_COMMAND_SET_ABC:
-                success = true;
+        switch (result) {
+        case MH_Z19_ERROR_SUCCESS:
+                ++p_stats->successes;
+                break;
+        case MH_Z19_ERROR_TIMEOUT:
+                ++p_stats->timeouts;
+                break;
+        case MH_Z19_ERROR_IO_ERROR:
+                ++p_stats->io_errors;
+                break;
+        case MH_Z19_ERROR_BAD_REPLY:
+                ++p_stats->bad_replies;
+                break;
+        case MH_Z19_ERROR_NOT_ACKNOWLEDGED:
+                ++p_stats->nacks;
                 break;
         default:
-                success = false;
                 break;
         }
 
-        return success;
+        if (NULL != p_sensor->time_func) {
+                // Overflow is meant to happen
+                elapsed_us = p_sensor->time_func() -
+                             p_sensor->transaction_start_us;
+
+                while (((MH_Z19_STATS_HISTOGRAM_BINS - 1) > bin) &&
+                       (((uint32_t)MH_Z19_STATS_HISTOGRAM_BASE_US << bin) <= elapsed_us)) {
+                        ++bin;
+                }
+
+                ++p_stats->time_histogram[bin];
+                p_stats->last_time_us = elapsed_us;
+
+                if (elapsed_us > p_stats->max_time_us) {
+                        p_stats->max_time_us = elapsed_us;
+                }
+        }
 }
 
 /*
@@ -16,12 +16,23 @@
 #ifndef WINSEN_MH_Z19_H
 #define WINSEN_MH_Z19_H
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "winsen_mh_z19_parser.h"
+
 /*
  *******************************************************************************
  * Public Macros                                                               *
  *******************************************************************************
  */
 
+//! @brief Amount of bins of the transaction time histogram
+#define MH_Z19_STATS_HISTOGRAM_BINS         (8)
+
+//! @brief Upper limit of the first transaction time bin (in microseconds)
+#define MH_Z19_STATS_HISTOGRAM_BASE_US      (5000)
 
 /*
  *******************************************************************************
@@ -37,6 +48,9 @@ typedef enum {
         MH_Z19_ERROR_BAD_PARAMETER,
         MH_Z19_ERROR_GENERAL_ERROR,
         MH_Z19_ERROR_IO_ERROR,
+        MH_Z19_ERROR_TIMEOUT,
+        MH_Z19_ERROR_BAD_REPLY,
+        MH_Z19_ERROR_NOT_ACKNOWLEDGED,
         MH_Z19_ERROR_COUNT,
 } mh_z19_error_t;
 
@@ -56,6 +70,11 @@ typedef enum {
  *
  * @note `p_rx_buffer` and `p_tx_buffer` cannot be both null
  *
+ * @note Reads of any size up to a frame must be supported, as only the bytes
+ *       missing from a frame are read while resynchronizing
+ *
+ * @param[in]           p_context           Context registered together with
+ *                                          the transfer function
  * @param[out]          p_rx_buffer         Pointer to the buffer where to read
  *                                          the data to
  * @param[in]           rx_buffer_size      Size of the read buffer
@@ -68,12 +87,127 @@ typedef enum {
  *                                          Everything went well
  * @retval              MH_Z19_ERROR_BAD_PARAMETER
  *                                          Parameter is null
+ * @retval              MH_Z19_ERROR_IO_ERROR
+ *                                          Error while doing a transfer
+ *                                          operation
+ * @retval              MH_Z19_ERROR_TIMEOUT
+ *                                          Less bytes than requested were
+ *                                          received in time
  */
-typedef mh_z19_error_t (*mh_z19_xfer_func )(uint8_t * const p_rx_buffer,
+typedef mh_z19_error_t (*mh_z19_xfer_func )(void * const p_context,
+                                            uint8_t * const p_rx_buffer,
                                             size_t const rx_buffer_size,
                                             uint8_t const * const p_tx_buffer,
                                             size_t const tx_buffer_size);
 
+/*!
+ * @brief Time function prototype
+ *
+ * Used to time the transactions with the sensor
+ *
+ * @return              uint32_t            Monotonic time in microseconds
+ *                                          (wrapping around is fine)
+ */
+typedef uint32_t (*mh_z19_time_func)(void);
+
+/*!
+ * @brief Driver statistics
+ *
+ * A transaction is a command that expects a reply, from the moment it is sent
+ * until its reply is received or given up.
+ *
+ * Bin `i` of `time_histogram` counts the transactions that took less than
+ * `MH_Z19_STATS_HISTOGRAM_BASE_US << i` microseconds (and more than the
+ * previous bin limit). The last bin counts all the slower ones.
+ */
+typedef struct {
+        //! @brief Transactions started
+        uint32_t transactions;
+
+        //! @brief Transactions completed with a valid reply
+        uint32_t successes;
+
+        //! @brief Transactions given up because the reply didn't arrive in time
+        uint32_t timeouts;
+
+        //! @brief Transactions given up because the transfer failed
+        uint32_t io_errors;
+
+        //! @brief Transactions given up because no valid reply was found
+        uint32_t bad_replies;
+
+        //! @brief Transactions rejected by the sensor
+        uint32_t nacks;
+
+        //! @brief Duration of the last transaction (in microseconds)
+        uint32_t last_time_us;
+
+        //! @brief Duration of the slowest transaction (in microseconds)
+        uint32_t max_time_us;
+
+        //! @brief Histogram of the transaction durations
+        uint32_t time_histogram[MH_Z19_STATS_HISTOGRAM_BINS];
+
+        //! @brief Statistics of the reply parser
+        mh_z19_parser_stats_t parser;
+} mh_z19_stats_t;
+
+//! @brief Measurement data reported by the sensor
+typedef struct {
+        //! @brief Gas concentration (in ppm CO2)
+        uint16_t concentration;
+
+        //! @brief Sensor internal temperature (in ºC)
+        int8_t temperature;
+
+        //! @brief Status byte of the gas concentration reply
+        uint8_t status;
+
+        //! @brief Whether the sensor is still warming up
+        bool is_preheating;
+
+        //! @brief Whether the raw values below were read
+        bool has_raw;
+
+        //! @brief Raw temperature value (0x85 reply)
+        uint16_t raw_temperature;
+
+        //! @brief Gas concentration not clamped to the detection range (0x85 reply)
+        uint16_t raw_concentration;
+
+        //! @brief Raw light signal of the infrared detector (0x85 reply)
+        uint16_t raw_light;
+} mh_z19_measurement_t;
+
+/*!
+ * @brief Sensor instance
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Whether the instance is initialized or not
+        bool is_initialized;
+
+        //! @brief UART transfer function
+        mh_z19_xfer_func xfer_func;
+
+        //! @brief Context passed to the transfer function
+        void * p_xfer_context;
+
+        //! @brief Parser used to find the replies within the received bytes
+        mh_z19_parser_t parser;
+
+        //! @brief Time function used to time the transactions (can be null)
+        mh_z19_time_func time_func;
+
+        //! @brief Time at which the ongoing transaction started
+        uint32_t transaction_start_us;
+
+        //! @brief Statistics since initialization
+        mh_z19_stats_t stats;
+} mh_z19_t;
+
 //! @brief Allowed detection range settings
 typedef enum {
         MH_Z19B_RANGE_0_2000_PPM = 0,
@@ -95,23 +229,48 @@ typedef enum {
  *******************************************************************************
  */
 
-//! @brief Initialize the module
-mh_z19_error_t mh_z19_init(mh_z19_xfer_func const xfer_func);
+//! @brief Initialize a sensor instance
+mh_z19_error_t mh_z19_init(mh_z19_t * const p_sensor,
+                           mh_z19_xfer_func const xfer_func,
+                           void * const p_xfer_context);
+
+//! @brief Set the function used to time the transactions
+mh_z19_error_t mh_z19_set_time_func(mh_z19_t * const p_sensor,
+                                    mh_z19_time_func const time_func);
+
+//! @brief Get the driver statistics
+mh_z19_error_t mh_z19_get_stats(mh_z19_t const * const p_sensor,
+                                mh_z19_stats_t * const p_stats);
 
 //! @brief Get gas concentration
-mh_z19_error_t mh_z19_get_gas_concentration(uint32_t * const p_concentration);
+mh_z19_error_t mh_z19_get_gas_concentration(mh_z19_t * const p_sensor,
+                                            uint32_t * const p_concentration);
+
+//! @brief Read a full measurement
+mh_z19_error_t mh_z19_read_measurement(mh_z19_t * const p_sensor,
+                                       mh_z19_measurement_t * const p_measurement,
+                                       bool const include_raw);
+
+//! @brief Request a measurement
+mh_z19_error_t mh_z19_request_measurement(mh_z19_t * const p_sensor);
+
+//! @brief Collect a requested measurement
+mh_z19_error_t mh_z19_collect_measurement(mh_z19_t * const p_sensor,
+                                          mh_z19_measurement_t * const p_measurement);
 
 //! @brief Calibrate zero point
-mh_z19_error_t mh_z19_calibrate_zero_point(void);
+mh_z19_error_t mh_z19_calibrate_zero_point(mh_z19_t * const p_sensor);
 
 //! @brief Calibrate span point
-mh_z19_error_t mh_z19_calibrate_span_point(uint16_t const span_point);
+mh_z19_error_t mh_z19_calibrate_span_point(mh_z19_t * const p_sensor,
+                                           uint16_t const span_point);
 
 //! @brief Enable / disable ABC
-mh_z19_error_t mh_z19_enable_abc(bool enabled);
+mh_z19_error_t mh_z19_enable_abc(mh_z19_t * const p_sensor, bool enabled);
 
 //! @brief Set detection range
-mh_z19_error_t mh_z19_set_range(uint32_t const range);
+mh_z19_error_t mh_z19_set_range(mh_z19_t * const p_sensor,
+                                mh_z19b_range_t const range);
 
 
 #endif //WINSEN_MH_Z19_H
\ No newline at end of file
@@ -0,0 +1,454 @@
+/*!
+ *******************************************************************************
+ * @file winsen_mh_z19_emulator.c
+ *
+ * @brief Software emulation of a Winsen MH-Z19 sensor
+ *
+ * The emulator sits behind the same `mh_z19_xfer_func` hook as the real UART,
+ * so the driver can be exercised without the sensor attached. Requests written
+ * to it are decoded as the sensor would do, and the replies are queued into an
+ * emulated receive FIFO, optionally impaired with noise, dropped bytes or bad
+ * check values.
+ *
+ * It doesn't depend on any framework, so it builds for the target as well as
+ * for a Linux host.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <memory.h>
+
+#include "winsen_mh_z19.h"
+
+#include "winsen_mh_z19_emulator.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+#define EMULATOR_MSG_SIZE                   MH_Z19_EMULATOR_MSG_SIZE
+#define EMULATOR_FIFO_SIZE                  MH_Z19_EMULATOR_FIFO_SIZE
+
+#define EMULATOR_MSG_START_VALUE            (0xFF)
+#define EMULATOR_MSG_SENSOR_NUMBER          (0x01)
+#define EMULATOR_MSG_CHECK_VALUE_BYTE       (8)
+
+#define EMULATOR_TEMPERATURE_OFFSET         (40)
+#define EMULATOR_ZERO_POINT_PPM             (400)
+#define EMULATOR_ABC_SETTING_ON             (0xA0)
+#define EMULATOR_LIGHT_SIGNAL               (0x3A98)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Decode a request and queue the corresponding reply, if any
+static void handle_request(mh_z19_emulator_t * const p_emulator,
+                           uint8_t const * const p_request);
+
+//! @brief Queue a reply applying the configured impairments
+static void queue_reply(mh_z19_emulator_t * const p_emulator,
+                        uint8_t * const p_reply);
+
+//! @brief Calculate the check value of a message
+static uint8_t calculate_check_value(uint8_t const * const p_message);
+
+//! @brief Get the next pseudo random number
+static uint32_t next_random(mh_z19_emulator_t * const p_emulator);
+
+//! @brief Whether a random event with the given probability happens
+static bool random_event(mh_z19_emulator_t * const p_emulator,
+                         uint8_t const percent);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize the emulator
+ *
+ * Can be called again to reconfigure the emulator, in which case the emulated
+ * FIFO and calibration are reset.
+ *
+ * @param[out]          p_emulator          Pointer to the emulator instance
+ * @param[in]           p_config            Pointer to the emulator configuration
+ * @param[in]           delay_func          Function used to block for the
+ *                                          response latency (can be null, in
+ *                                          which case replies are immediate)
+ *
+ * @return              mh_z19_error_t      Operation result
+ * @retval              MH_Z19_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              MH_Z19_ERROR_BAD_PARAMETER
+ *                                          Parameter is null or seed is 0
+ */
+mh_z19_error_t mh_z19_emulator_init(
+                mh_z19_emulator_t * const p_emulator,
+                mh_z19_emulator_config_t const * const p_config,
+                mh_z19_emulator_delay_func const delay_func)
+{
+        mh_z19_error_t result = MH_Z19_ERROR_SUCCESS;
+
+        if ((NULL == p_emulator) ||
+            (NULL == p_config) ||
+            (0 == p_config->seed)) {
+
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+        } else {
+                p_emulator->config = *p_config;
+                p_emulator->delay_func = delay_func;
+                p_emulator->random_state = p_config->seed;
+                p_emulator->fifo_head = 0;
+                p_emulator->fifo_count = 0;
+                p_emulator->calibration_offset = 0;
+                p_emulator->range = 5000;
+                p_emulator->abc_enabled = true;
+                p_emulator->is_initialized = true;
+        }
+
+        return result;
+}
+
+/*!
+ * @brief UART transfer function backed by the emulator
+ *
+ * Follows the `mh_z19_xfer_func` prototype. Write operations are decoded as
+ * requests, read operations block for the configured latency and then take the
+ * bytes from the emulated receive FIFO.
+ *
+ * @param[in]           p_context           Pointer to the emulator instance
+ * @param[out]          p_rx_buffer         Pointer to the buffer where to read
+ *                                          the data to
+ * @param[in]           rx_buffer_size      Size of the read buffer
+ * @param[in]           p_tx_buffer         Pointer to the buffer where to read
+ *                                          the data from
+ * @param[in]           tx_buffer_size      Size of the write buffer
+ *
+ * @return              mh_z19_error_t      Operation result
+ * @retval              MH_Z19_ERROR_SUCCESS
+ *                                          Everything went well
+ * @retval              MH_Z19_ERROR_NOT_INITIALIZED
+ *                                          Emulator isn't initialized
+ * @retval              MH_Z19_ERROR_BAD_PARAMETER
+ *                                          Parameter is null
+ * @retval              MH_Z19_ERROR_TIMEOUT
+ *                                          Less bytes than requested were
+ *                                          available
+ */
+mh_z19_error_t mh_z19_emulator_xfer(void * const p_context,
+                                    uint8_t * const p_rx_buffer,
+                                    size_t const rx_buffer_size,
+                                    uint8_t const * const p_tx_buffer,
+                                    size_t const tx_buffer_size)
+{
+        mh_z19_emulator_t * const p_emulator = (mh_z19_emulator_t *)p_context;
+        mh_z19_error_t result = MH_Z19_ERROR_SUCCESS;
+        uint32_t latency_ms;
+        size_t i;
+
+        if (NULL == p_emulator) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+
+        } else if (!p_emulator->is_initialized) {
+                result = MH_Z19_ERROR_NOT_INITIALIZED;
+
+        } else if ((NULL == p_rx_buffer) != (0 == rx_buffer_size)) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+
+        } else if ((NULL == p_tx_buffer) != (0 == tx_buffer_size)) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+
+        } else if ((NULL == p_rx_buffer) && (NULL == p_tx_buffer)) {
+                result = MH_Z19_ERROR_BAD_PARAMETER;
+
+        } else if (NULL != p_tx_buffer) {
+
+                // The sensor silently ignores anything that isn't a full frame
+                if (EMULATOR_MSG_SIZE == tx_buffer_size) {
+                        handle_request(p_emulator, p_tx_buffer);
+                }
+
+        } else {
+                latency_ms = p_emulator->config.response_latency_ms;
+
+                if (0 != p_emulator->config.latency_jitter_ms) {
+                        latency_ms += next_random(p_emulator) %
+                                      (p_emulator->config.latency_jitter_ms + 1);
+                }
+
+                if ((NULL != p_emulator->delay_func) && (0 != latency_ms)) {
+                        p_emulator->delay_func(latency_ms);
+                }
+
+                for (i = 0; (rx_buffer_size > i) && (0 < p_emulator->fifo_count); ++i) {
+                        p_rx_buffer[i] = p_emulator->fifo[p_emulator->fifo_head];
+                        p_emulator->fifo_head = (p_emulator->fifo_head + 1) % EMULATOR_FIFO_SIZE;
+                        --p_emulator->fifo_count;
+                }
+
+                if (rx_buffer_size != i) {
+                        result = MH_Z19_ERROR_TIMEOUT;
+                }
+        }
+
+        return result;
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Decode a request and queue the corresponding reply, if any
+ *
+ * Requests with a wrong start byte, sensor number or check value are ignored,
+ * as the real sensor does.
+ *
+ * @param[in,out]       p_emulator          Pointer to the emulator instance
+ * @param[in]           p_request           Pointer to the 9 byte request
+ *
+ * @return              -                   -
+ */
+static void handle_request(mh_z19_emulator_t * const p_emulator,
+                           uint8_t const * const p_request)
+{
+        uint8_t reply[EMULATOR_MSG_SIZE] = {0};
+        bool has_reply = false;
+        int32_t concentration;
+        uint32_t noise;
+
+        if ((EMULATOR_MSG_START_VALUE != p_request[0]) ||
+            (EMULATOR_MSG_SENSOR_NUMBER != p_request[1]) ||
+            (calculate_check_value(p_request) !=
+             p_request[EMULATOR_MSG_CHECK_VALUE_BYTE])) {
+
+                // Code style exception for the shake of readability
+                return;
+        }
+
+        reply[0] = EMULATOR_MSG_START_VALUE;
+        reply[1] = p_request[2];
+
+        switch (p_request[2]) {
+
+        case 0x85:
+                concentration = (int32_t)p_emulator->config.concentration_ppm;
+                concentration += p_emulator->calibration_offset;
+
+                reply[2] = (uint8_t)(0xFF & ((p_emulator->config.temperature_c * 100) >> 8));
+                reply[3] = (uint8_t)(0xFF & (p_emulator->config.temperature_c * 100));
+                reply[4] = (uint8_t)(0xFF & (concentration >> 8));
+                reply[5] = (uint8_t)(0xFF & concentration);
+                reply[6] = (uint8_t)(0xFF & (EMULATOR_LIGHT_SIGNAL >> 8));
+                reply[7] = (uint8_t)(0xFF & EMULATOR_LIGHT_SIGNAL);
+                has_reply = true;
+                break;
+
+        case 0x86:
+                concentration = (int32_t)p_emulator->config.concentration_ppm;
+                concentration += p_emulator->calibration_offset;
+
+                if (0 != p_emulator->config.noise_ppm) {
+                        noise = next_random(p_emulator) % ((2 * p_emulator->config.noise_ppm) + 1);
+                        concentration += (int32_t)noise - p_emulator->config.noise_ppm;
+                }
+
+                if (0 > concentration) {
+                        concentration = 0;
+                } else if ((int32_t)p_emulator->range < concentration) {
+                        concentration = (int32_t)p_emulator->range;
+                }
+
+                reply[2] = (uint8_t)(0xFF & (concentration >> 8));
+                reply[3] = (uint8_t)(0xFF & concentration);
+                reply[4] = (uint8_t)(p_emulator->config.temperature_c +
+                                     EMULATOR_TEMPERATURE_OFFSET);
+                reply[5] = p_emulator->config.status;
+                has_reply = true;
+                break;
+
+        case 0x87:
+                p_emulator->calibration_offset = EMULATOR_ZERO_POINT_PPM -
+                                       (int32_t)p_emulator->config.concentration_ppm;
+                break;
+
+        case 0x88:
+                p_emulator->calibration_offset = ((p_request[3] << 8) | p_request[4]) -
+                                       (int32_t)p_emulator->config.concentration_ppm;
+                break;
+
+        case 0x79:
+                p_emulator->abc_enabled = (EMULATOR_ABC_SETTING_ON == p_request[3]);
+                reply[2] = 0x01;
+                has_reply = true;
+                break;
+
+        case 0x99:
+                p_emulator->range = ((uint32_t)p_request[4] << 24) |
+                          ((uint32_t)p_request[5] << 16) |
+                          ((uint32_t)p_request[6] << 8) |
+                          ((uint32_t)p_request[7]);
+                reply[2] = 0x01;
+                has_reply = true;
+                break;
+
+        default:
+                break;
+        }
+
+        if (has_reply) {
+                queue_reply(p_emulator, reply);
+        }
+}
+
+/*!
+ * @brief Queue a reply applying the configured impairments
+ *
+ * Bytes that don't fit in the emulated FIFO are lost, as they would be with
+ * an overflowing UART.
+ *
+ * @param[in,out]       p_emulator          Pointer to the emulator instance
+ * @param[in,out]       p_reply             Pointer to the 9 byte reply, without
+ *                                          check value
+ *
+ * @return              -                   -
+ */
+static void queue_reply(mh_z19_emulator_t * const p_emulator,
+                        uint8_t * const p_reply)
+{
+        size_t dropped_byte = EMULATOR_MSG_SIZE;
+        size_t tail;
+        size_t i;
+
+        p_reply[EMULATOR_MSG_CHECK_VALUE_BYTE] = calculate_check_value(p_reply);
+
+        if (random_event(p_emulator, p_emulator->config.bad_checksum_percent)) {
+                p_reply[EMULATOR_MSG_CHECK_VALUE_BYTE] ^= 0x5A;
+        }
+
+        if (random_event(p_emulator, p_emulator->config.drop_byte_percent)) {
+                dropped_byte = next_random(p_emulator) % EMULATOR_MSG_SIZE;
+        }
+
+        for (i = 0; (EMULATOR_MSG_SIZE > i) &&
+                    (EMULATOR_FIFO_SIZE > p_emulator->fifo_count); ++i) {
+
+                if (dropped_byte != i) {
+                        tail = (p_emulator->fifo_head + p_emulator->fifo_count) % EMULATOR_FIFO_SIZE;
+                        p_emulator->fifo[tail] = p_reply[i];
+                        ++p_emulator->fifo_count;
+                }
+        }
+}
+
+/*!
+ * @brief Calculate the check value of a message
+ *
+ * Same formula as the sensor: inv(byte_1 + byte_2 + ... + byte_7) + 1
+ *
+ * @param[in]           p_message           Pointer to the 9 byte message
+ *
+ * @return              uint8_t             Calculation result
+ */
+static uint8_t calculate_check_value(uint8_t const * const p_message)
+{
+        uint8_t temp_check_val = 0x00;
+        size_t i;
+
+        for (i = 1; EMULATOR_MSG_CHECK_VALUE_BYTE > i; ++i) {
+                // Overflow is meant to happen
+                temp_check_val += p_message[i];
+        }
+
+        return (uint8_t)(~temp_check_val + 1);
+}
+
+/*!
+ * @brief Get the next pseudo random number
+ *
+ * Xorshift32 generator: cheap, and reproducible for a given seed, so a run can
+ * be repeated with the same impairments.
+ *
+ * @param[in,out]       p_emulator          Pointer to the emulator instance
+ *
+ * @return              uint32_t            Pseudo random number
+ */
+static uint32_t next_random(mh_z19_emulator_t * const p_emulator)
+{
+        uint32_t x = p_emulator->random_state;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+
+        p_emulator->random_state = x;
+
+        return x;
+}
+
+/*!
+ * @brief Whether a random event with the given probability happens
+ *
+ * @param[in,out]       p_emulator          Pointer to the emulator instance
+ * @param[in]           percent             Probability of the event (in %)
+ *
+ * @return              bool                Whether the event happens
+ */
+static bool random_event(mh_z19_emulator_t * const p_emulator,
+                         uint8_t const percent)
+{
+        return ((0 != percent) && ((next_random(p_emulator) % 100) < percent));
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
@@ -0,0 +1,151 @@
+/*!
+ *******************************************************************************
+ * @file winsen_mh_z19_emulator.h
+ *
+ * @brief Software emulation of a Winsen MH-Z19 sensor
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef WINSEN_MH_Z19_EMULATOR_H
+#define WINSEN_MH_Z19_EMULATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "winsen_mh_z19.h"
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+//! @brief Size of the emulated messages
+#define MH_Z19_EMULATOR_MSG_SIZE            (9)
+
+//! @brief Size of the emulated receive FIFO
+#define MH_Z19_EMULATOR_FIFO_SIZE           (MH_Z19_EMULATOR_MSG_SIZE * 4)
+
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Delay function prototype
+ *
+ * Used by the emulator to block the caller for the configured response latency.
+ * On the target it will wrap `vTaskDelay`, on a host it can wrap `usleep` or
+ * just advance a simulated clock.
+ *
+ * @param[in]           delay_ms            Time to block, in milliseconds
+ *
+ * @return              -                   -
+ */
+typedef void (*mh_z19_emulator_delay_func)(uint32_t const delay_ms);
+
+//! @brief Emulated sensor behaviour and line impairments
+typedef struct {
+        //! @brief Time between the request and the first reply byte
+        uint32_t response_latency_ms;
+
+        //! @brief Maximum random latency added on top of `response_latency_ms`
+        uint32_t latency_jitter_ms;
+
+        //! @brief Concentration reported by the emulated sensor (in ppm)
+        uint16_t concentration_ppm;
+
+        //! @brief Maximum random deviation added to each reading (in ppm)
+        uint16_t noise_ppm;
+
+        //! @brief Temperature reported by the emulated sensor (in ºC)
+        int8_t temperature_c;
+
+        //! @brief Status byte reported in the gas concentration reply
+        uint8_t status;
+
+        //! @brief Probability (in %) of a reply losing one of its bytes
+        uint8_t drop_byte_percent;
+
+        //! @brief Probability (in %) of a reply carrying a wrong check value
+        uint8_t bad_checksum_percent;
+
+        //! @brief Seed for the pseudo random generator (0 is not allowed)
+        uint32_t seed;
+} mh_z19_emulator_config_t;
+
+/*!
+ * @brief Emulator instance
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Whether the instance is initialized or not
+        bool is_initialized;
+
+        //! @brief Emulated sensor configuration
+        mh_z19_emulator_config_t config;
+
+        //! @brief Function used to emulate the response latency
+        mh_z19_emulator_delay_func delay_func;
+
+        //! @brief Emulated receive FIFO
+        uint8_t fifo[MH_Z19_EMULATOR_FIFO_SIZE];
+
+        //! @brief Index of the oldest byte at the receive FIFO
+        size_t fifo_head;
+
+        //! @brief Amount of bytes waiting at the receive FIFO
+        size_t fifo_count;
+
+        //! @brief Correction applied by the calibration commands (in ppm)
+        int32_t calibration_offset;
+
+        //! @brief Upper limit of the detection range (in ppm)
+        uint32_t range;
+
+        //! @brief Whether automatic baseline correction is enabled
+        bool abc_enabled;
+
+        //! @brief State of the pseudo random generator
+        uint32_t random_state;
+} mh_z19_emulator_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize the emulator
+mh_z19_error_t mh_z19_emulator_init(
+                mh_z19_emulator_t * const p_emulator,
+                mh_z19_emulator_config_t const * const p_config,
+                mh_z19_emulator_delay_func const delay_func);
+
+//! @brief UART transfer function backed by the emulator
+mh_z19_error_t mh_z19_emulator_xfer(void * const p_context,
+                                    uint8_t * const p_rx_buffer,
+                                    size_t const rx_buffer_size,
+                                    uint8_t const * const p_tx_buffer,
+                                    size_t const tx_buffer_size);
+
+#endif //WINSEN_MH_Z19_EMULATOR_H
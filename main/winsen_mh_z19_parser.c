@@ -0,0 +1,344 @@
+/*!
+ *******************************************************************************
+ * @file winsen_mh_z19_parser.c
+ *
+ * @brief Streaming frame parser for the Winsen MH-Z19 sensor
+ *
+ * Received bytes are accumulated in a small ring buffer. Frames are searched
+ * by sliding a 9 byte window over it: the window must start with the 0xFF
+ * start byte and the expected command, and its check value must match. Any
+ * byte that can't be the start of such a window is discarded, so a stray or
+ * lost byte only costs the frame it hit, and the parser is aligned again for
+ * the next one.
+ *
+ * It doesn't depend on any framework, so it builds for the target as well as
+ * for a Linux host.
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * #include Statements                                                         *
+ *******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "winsen_mh_z19_parser.h"
+
+/*
+ *******************************************************************************
+ * Private Macros                                                              *
+ *******************************************************************************
+ */
+
+#define PARSER_START_VALUE                  (0xFF)
+#define PARSER_COMMAND_BYTE                 (1)
+#define PARSER_CHECK_VALUE_BYTE             (8)
+#define PARSER_BUFFER_MASK                  (MH_Z19_PARSER_BUFFER_SIZE - 1)
+
+/*
+ *******************************************************************************
+ * Data types                                                                  *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Constants                                                                   *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Private Function Prototypes                                                 *
+ *******************************************************************************
+ */
+
+//! @brief Get a byte relative to the oldest one at the buffer
+static inline uint8_t peek(mh_z19_parser_t const * const p_parser,
+                           size_t const offset);
+
+//! @brief Discard bytes from the oldest end of the buffer
+static inline void discard(mh_z19_parser_t * const p_parser,
+                           size_t const amount);
+
+//! @brief Whether the window at the oldest end has a valid check value
+static bool is_valid_window(mh_z19_parser_t const * const p_parser);
+
+/*
+ *******************************************************************************
+ * Public Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Static Data Declarations                                                    *
+ *******************************************************************************
+ */
+
+/*
+ *******************************************************************************
+ * Public Function Bodies                                                      *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Initialize or reset a parser instance
+ *
+ * Discards any buffered byte and clears the statistics
+ *
+ * @param[out]          p_parser            Pointer to the parser instance
+ *
+ * @return              -                   -
+ */
+void mh_z19_parser_reset(mh_z19_parser_t * const p_parser)
+{
+        if (NULL != p_parser) {
+                memset(p_parser, 0, sizeof(*p_parser));
+        }
+}
+
+/*!
+ * @brief Discard the buffered bytes
+ *
+ * Unlike `mh_z19_parser_reset`, statistics are kept
+ *
+ * @param[in,out]       p_parser            Pointer to the parser instance
+ *
+ * @return              -                   -
+ */
+void mh_z19_parser_flush(mh_z19_parser_t * const p_parser)
+{
+        if (NULL != p_parser) {
+                p_parser->head = 0;
+                p_parser->count = 0;
+        }
+}
+
+/*!
+ * @brief Feed received bytes to the parser
+ *
+ * @note Bytes that don't fit at the buffer are not accepted. Popping all the
+ *       available frames after each push keeps at least
+ *       `MH_Z19_PARSER_BUFFER_SIZE - MH_Z19_PARSER_FRAME_SIZE + 1` bytes free.
+ *
+ * @param[in,out]       p_parser            Pointer to the parser instance
+ * @param[in]           p_data              Pointer to the received bytes
+ * @param[in]           size                Amount of received bytes
+ *
+ * @return              size_t              Amount of accepted bytes
+ */
+size_t mh_z19_parser_push(mh_z19_parser_t * const p_parser,
+                          uint8_t const * const p_data,
+                          size_t const size)
+{
+        size_t accepted = 0;
+        size_t tail;
+
+        if ((NULL != p_parser) && (NULL != p_data)) {
+                while ((size > accepted) &&
+                       (MH_Z19_PARSER_BUFFER_SIZE > p_parser->count)) {
+
+                        tail = (p_parser->head + p_parser->count) &
+                               PARSER_BUFFER_MASK;
+
+                        p_parser->buffer[tail] = p_data[accepted];
+                        ++p_parser->count;
+                        ++accepted;
+                }
+        }
+
+        return accepted;
+}
+
+/*!
+ * @brief Extract the next valid frame
+ *
+ * Bytes that can't start a valid frame are discarded on the way. If the
+ * buffered bytes are a valid beginning of a frame, they are kept until the
+ * rest of the frame is pushed.
+ *
+ * @param[in,out]       p_parser            Pointer to the parser instance
+ * @param[in]           command             Command the frame has to carry, or
+ *                                          `MH_Z19_PARSER_ANY_COMMAND`
+ * @param[out]          p_frame             Pointer to a buffer of
+ *                                          `MH_Z19_PARSER_FRAME_SIZE` bytes
+ *                                          where to copy the frame to
+ *
+ * @return              bool                Whether a frame was found
+ */
+bool mh_z19_parser_pop_frame(mh_z19_parser_t * const p_parser,
+                             uint8_t const command,
+                             uint8_t * const p_frame)
+{
+        bool is_found = false;
+        bool is_skipping = false;
+        bool is_waiting = false;
+        size_t i;
+
+        if ((NULL == p_parser) || (NULL == p_frame)) {
+                // Code style exception for the shake of readability
+                return false;
+        }
+
+        while ((!is_found) && (!is_waiting) && (0 < p_parser->count)) {
+
+                if (PARSER_START_VALUE != peek(p_parser, 0)) {
+                        discard(p_parser, 1);
+                        ++p_parser->stats.start_byte_errors;
+                        is_skipping = true;
+
+                } else if ((PARSER_COMMAND_BYTE < p_parser->count) &&
+                           (MH_Z19_PARSER_ANY_COMMAND != command) &&
+                           (command != peek(p_parser, PARSER_COMMAND_BYTE))) {
+
+                        discard(p_parser, 1);
+                        ++p_parser->stats.command_errors;
+                        is_skipping = true;
+
+                } else if (MH_Z19_PARSER_FRAME_SIZE > p_parser->count) {
+                        is_waiting = true;
+
+                } else if (!is_valid_window(p_parser)) {
+                        discard(p_parser, 1);
+                        ++p_parser->stats.checksum_errors;
+                        is_skipping = true;
+
+                } else {
+                        for (i = 0; MH_Z19_PARSER_FRAME_SIZE > i; ++i) {
+                                p_frame[i] = peek(p_parser, i);
+                        }
+
+                        p_parser->head = (p_parser->head +
+                                          MH_Z19_PARSER_FRAME_SIZE) &
+                                         PARSER_BUFFER_MASK;
+
+                        p_parser->count -= MH_Z19_PARSER_FRAME_SIZE;
+                        is_found = true;
+                }
+        }
+
+        if (is_skipping) {
+                ++p_parser->stats.resyncs;
+        }
+
+        return is_found;
+}
+
+/*!
+ * @brief Amount of bytes needed to complete the frame being received
+ *
+ * Meant to be called after `mh_z19_parser_pop_frame` failed, to know how many
+ * bytes to read next.
+ *
+ * @param[in]           p_parser            Pointer to the parser instance
+ *
+ * @return              size_t              Amount of missing bytes
+ */
+size_t mh_z19_parser_bytes_needed(mh_z19_parser_t const * const p_parser)
+{
+        size_t needed = MH_Z19_PARSER_FRAME_SIZE;
+
+        if ((NULL != p_parser) &&
+            (MH_Z19_PARSER_FRAME_SIZE > p_parser->count)) {
+
+                needed -= p_parser->count;
+        }
+
+        return needed;
+}
+
+/*!
+ * @brief Get the parser statistics
+ *
+ * @note A frame discarded for its command or check value shows up as one
+ *       error, the remaining bytes of it as start byte errors.
+ *
+ * @param[in]           p_parser            Pointer to the parser instance
+ * @param[out]          p_stats             Pointer where to copy the statistics
+ *
+ * @return              -                   -
+ */
+void mh_z19_parser_get_stats(mh_z19_parser_t const * const p_parser,
+                             mh_z19_parser_stats_t * const p_stats)
+{
+        if ((NULL != p_parser) && (NULL != p_stats)) {
+                *p_stats = p_parser->stats;
+        }
+}
+
+/*
+ *******************************************************************************
+ * Private Function Bodies                                                     *
+ *******************************************************************************
+ */
+
+/*!
+ * @brief Get a byte relative to the oldest one at the buffer
+ *
+ * @param[in]           p_parser            Pointer to the parser instance
+ * @param[in]           offset              Position relative to the oldest byte
+ *
+ * @return              uint8_t             Byte at the requested position
+ */
+static inline uint8_t peek(mh_z19_parser_t const * const p_parser,
+                           size_t const offset)
+{
+        return p_parser->buffer[(p_parser->head + offset) & PARSER_BUFFER_MASK];
+}
+
+/*!
+ * @brief Discard bytes from the oldest end of the buffer
+ *
+ * @param[in,out]       p_parser            Pointer to the parser instance
+ * @param[in]           amount              Amount of bytes to discard
+ *
+ * @return              -                   -
+ */
+static inline void discard(mh_z19_parser_t * const p_parser,
+                           size_t const amount)
+{
+        p_parser->head = (p_parser->head + amount) & PARSER_BUFFER_MASK;
+        p_parser->count -= amount;
+        p_parser->stats.discarded_bytes += amount;
+}
+
+/*!
+ * @brief Whether the window at the oldest end has a valid check value
+ *
+ * check_value = inv(byte_1 + byte_2 + ... + byte_7) + 1
+ *
+ * @param[in]           p_parser            Pointer to the parser instance
+ *
+ * @return              bool                Whether the window is valid
+ */
+static bool is_valid_window(mh_z19_parser_t const * const p_parser)
+{
+        uint8_t sum = 0x00;
+        size_t i;
+
+        for (i = 1; PARSER_CHECK_VALUE_BYTE > i; ++i) {
+                // Overflow is meant to happen
+                sum += peek(p_parser, i);
+        }
+
+        return ((uint8_t)(~sum + 1) == peek(p_parser, PARSER_CHECK_VALUE_BYTE));
+}
+
+/*
+ *******************************************************************************
+ * Interrupt Service Routines / Tasks / Thread Main Functions                  *
+ *******************************************************************************
+ */
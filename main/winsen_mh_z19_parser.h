@@ -0,0 +1,118 @@
+/*!
+ *******************************************************************************
+ * @file winsen_mh_z19_parser.h
+ *
+ * @brief Streaming frame parser for the Winsen MH-Z19 sensor
+ *
+ * @author Raúl Gotor (raulgotor@gmail.com)
+ * @date 16.10.26
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2022 Raúl Gotor
+ * All rights reserved.
+ *******************************************************************************
+ */
+
+#ifndef WINSEN_MH_Z19_PARSER_H
+#define WINSEN_MH_Z19_PARSER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ *******************************************************************************
+ * Public Macros                                                               *
+ *******************************************************************************
+ */
+
+//! @brief Size of a sensor frame
+#define MH_Z19_PARSER_FRAME_SIZE            (9)
+
+//! @brief Size of the parser ring buffer (must be a power of two)
+#define MH_Z19_PARSER_BUFFER_SIZE           (32)
+
+//! @brief Command value matching any frame
+#define MH_Z19_PARSER_ANY_COMMAND           (0x00)
+
+/*
+ *******************************************************************************
+ * Public Data Types                                                           *
+ *******************************************************************************
+ */
+
+//! @brief Parser statistics
+typedef struct {
+        //! @brief Bytes discarded while looking for a frame
+        uint32_t discarded_bytes;
+
+        //! @brief Times the parser had to skip bytes to find a frame
+        uint32_t resyncs;
+
+        //! @brief Bytes discarded for not being a start byte
+        uint32_t start_byte_errors;
+
+        //! @brief Frames discarded for carrying an unexpected command
+        uint32_t command_errors;
+
+        //! @brief Frames discarded for carrying a wrong check value
+        uint32_t checksum_errors;
+} mh_z19_parser_stats_t;
+
+/*!
+ * @brief Parser instance
+ *
+ * @note Members are private to the module, the structure is only public so
+ *       instances can be statically allocated
+ */
+typedef struct {
+        //! @brief Received bytes not consumed yet
+        uint8_t buffer[MH_Z19_PARSER_BUFFER_SIZE];
+
+        //! @brief Index of the oldest byte at `buffer`
+        size_t head;
+
+        //! @brief Amount of bytes at `buffer`
+        size_t count;
+
+        //! @brief Statistics since the last reset
+        mh_z19_parser_stats_t stats;
+} mh_z19_parser_t;
+
+/*
+ *******************************************************************************
+ * Public Constants                                                            *
+ *******************************************************************************
+ */
+
+
+/*
+ *******************************************************************************
+ * Public Function Prototypes                                                  *
+ *******************************************************************************
+ */
+
+//! @brief Initialize or reset a parser instance
+void mh_z19_parser_reset(mh_z19_parser_t * const p_parser);
+
+//! @brief Discard the buffered bytes
+void mh_z19_parser_flush(mh_z19_parser_t * const p_parser);
+
+//! @brief Feed received bytes to the parser
+size_t mh_z19_parser_push(mh_z19_parser_t * const p_parser,
+                          uint8_t const * const p_data,
+                          size_t const size);
+
+//! @brief Extract the next valid frame
+bool mh_z19_parser_pop_frame(mh_z19_parser_t * const p_parser,
+                             uint8_t const command,
+                             uint8_t * const p_frame);
+
+//! @brief Amount of bytes needed to complete the frame being received
+size_t mh_z19_parser_bytes_needed(mh_z19_parser_t const * const p_parser);
+
+//! @brief Get the parser statistics
+void mh_z19_parser_get_stats(mh_z19_parser_t const * const p_parser,
+                             mh_z19_parser_stats_t * const p_stats);
+
+#endif //WINSEN_MH_Z19_PARSER_H